@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <solis.h>
+
+/*
+    Compares HashTable against the linear probing table it replaced.
+    Each size is filled with distinct string keys, then hits, misses and inserts into an empty table are timed.
+    The sizes land each table at a spread of load factors, the load printed is the one the table grew to.
+    Keys are plain ObjString structs built here so nothing goes through the collector.
+*/
+
+#define TARGET_OPERATIONS 20000000
+
+static const int sizes[] = { 1000, 5000, 6000, 7000, 40000, 48000, 56000, 400000 };
+
+// The table HashTable used before, kept here to measure against
+// It counted a new key twice, that is fixed so it grows at the load it was meant to
+#define LINEAR_MAX_LOAD 0.75
+
+typedef struct
+{
+    int count;
+    int capacity;
+    TableEntry* entries;
+} LinearTable;
+
+static TableEntry* linearFind(TableEntry* entries, int capacity, ObjString* key)
+{
+    uint32_t index = key->hash & (capacity - 1);
+    TableEntry* tombstone = NULL;
+
+    for (;;)
+    {
+        TableEntry* entry = &entries[index];
+        if (entry->key == NULL)
+        {
+            if (SOLIS_IS_NULL(entry->value))
+                return tombstone != NULL ? tombstone : entry;
+            else if (tombstone == NULL)
+                tombstone = entry;
+        }
+        else if (entry->key == key)
+            return entry;
+
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+static void linearAdjust(LinearTable* table, int capacity)
+{
+    TableEntry* entries = (TableEntry*)malloc(sizeof(TableEntry) * capacity);
+    for (int i = 0; i < capacity; i++)
+    {
+        entries[i].key = NULL;
+        entries[i].value = SOLIS_NULL_VALUE();
+    }
+
+    table->count = 0;
+    for (int i = 0; i < table->capacity; i++)
+    {
+        TableEntry* entry = &table->entries[i];
+        if (entry->key == NULL)
+            continue;
+
+        *linearFind(entries, capacity, entry->key) = *entry;
+        table->count++;
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+static void linearInsert(LinearTable* table, ObjString* key, Value value)
+{
+    if (table->count + 1 > table->capacity * LINEAR_MAX_LOAD)
+        linearAdjust(table, table->capacity < 8 ? 8 : table->capacity * 2);
+
+    TableEntry* entry = linearFind(table->entries, table->capacity, key);
+
+    if (entry->key == NULL && SOLIS_IS_NULL(entry->value))
+        table->count++;
+
+    entry->key = key;
+    entry->value = value;
+}
+
+static bool linearGet(LinearTable* table, ObjString* key, Value* value)
+{
+    if (table->count == 0)
+        return false;
+
+    TableEntry* entry = linearFind(table->entries, table->capacity, key);
+    if (entry->key == NULL)
+        return false;
+
+    *value = entry->value;
+    return true;
+}
+
+static ObjString* makeKeys(int count, const char* prefix, char** storage)
+{
+    ObjString* keys = (ObjString*)calloc(count, sizeof(ObjString));
+    char* chars = (char*)malloc((size_t)count * 32);
+
+    for (int i = 0; i < count; i++)
+    {
+        char* key = chars + (size_t)i * 32;
+        int length = snprintf(key, 32, "%s%d", prefix, i);
+
+        keys[i].chars = key;
+        keys[i].length = length;
+        keys[i].hash = solisHashString(key, length);
+    }
+
+    *storage = chars;
+    return keys;
+}
+
+static double secondsSince(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Millions of operations a second
+static double rate(double operations, double seconds)
+{
+    return seconds > 0.0 ? operations / seconds / 1e6 : 0.0;
+}
+
+int main(void)
+{
+    VM vm;
+    solisInitVM(&vm, false);
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    printf("Group probing with SSE2\n\n");
+#else
+    printf("Group probing with the scalar fallback\n\n");
+#endif
+
+    printf("%8s | %-6s %6s %10s %10s %10s\n", "keys", "table", "load", "hit M/s", "miss M/s", "insert M/s");
+
+    // Checked so the lookups can't be optimised away
+    volatile double sink = 0.0;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int count = sizes[s];
+        int rounds = TARGET_OPERATIONS / count + 1;
+
+        char* hitChars;
+        char* missChars;
+        ObjString* hits = makeKeys(count, "key", &hitChars);
+        ObjString* misses = makeKeys(count, "missing", &missChars);
+
+        HashTable table;
+        solisInitHashTable(&table, &vm);
+
+        LinearTable linear = { 0, 0, NULL };
+
+        for (int i = 0; i < count; i++)
+        {
+            solisHashTableInsert(&table, &hits[i], SOLIS_NUMERIC_VALUE(i));
+            linearInsert(&linear, &hits[i], SOLIS_NUMERIC_VALUE(i));
+        }
+
+        for (int variant = 0; variant < 2; variant++)
+        {
+            bool swiss = variant == 0;
+            Value value;
+
+            clock_t start = clock();
+            for (int r = 0; r < rounds; r++)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    if (swiss ? solisHashTableGet(&table, &hits[i], &value) : linearGet(&linear, &hits[i], &value))
+                        sink += SOLIS_AS_NUMBER(value);
+                }
+            }
+            double hitSeconds = secondsSince(start);
+
+            start = clock();
+            for (int r = 0; r < rounds; r++)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    if (swiss ? solisHashTableGet(&table, &misses[i], &value) : linearGet(&linear, &misses[i], &value))
+                        sink += 1.0;
+                }
+            }
+            double missSeconds = secondsSince(start);
+
+            // Growing is part of inserting so every round starts from an empty table
+            int insertRounds = rounds / 4 + 1;
+
+            start = clock();
+            for (int r = 0; r < insertRounds; r++)
+            {
+                if (swiss)
+                {
+                    HashTable fresh;
+                    solisInitHashTable(&fresh, &vm);
+
+                    for (int i = 0; i < count; i++)
+                        solisHashTableInsert(&fresh, &hits[i], SOLIS_NUMERIC_VALUE(i));
+
+                    sink += fresh.count;
+                    solisFreeHashTable(&fresh);
+                }
+                else
+                {
+                    LinearTable fresh = { 0, 0, NULL };
+
+                    for (int i = 0; i < count; i++)
+                        linearInsert(&fresh, &hits[i], SOLIS_NUMERIC_VALUE(i));
+
+                    sink += fresh.count;
+                    free(fresh.entries);
+                }
+            }
+            double insertSeconds = secondsSince(start);
+
+            double load = swiss ? (double)table.count / table.capacity : (double)linear.count / linear.capacity;
+            double operations = (double)rounds * count;
+
+            printf("%8d | %-6s %6.2f %10.1f %10.1f %10.1f\n", count, swiss ? "swiss" : "linear", load,
+                rate(operations, hitSeconds), rate(operations, missSeconds), rate((double)insertRounds * count, insertSeconds));
+        }
+
+        solisFreeHashTable(&table);
+        free(linear.entries);
+
+        free(hits);
+        free(misses);
+        free(hitChars);
+        free(missChars);
+    }
+
+    solisFreeVM(&vm);
+
+    return sink < 0.0 ? 1 : 0;
+}
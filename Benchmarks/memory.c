@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <solis.h>
+
+/*
+    Measures how many bytes of heap each kind of object costs once it is live.
+    Every workload keeps COUNT objects alive in a list, a full collection is run and the heap size is read back.
+    The same loop keeping numbers is run first so the list itself isn't counted.
+*/
+
+#define COUNT 100000
+
+typedef struct
+{
+    const char* name;
+    const char* expression;
+} Workload;
+
+static const char* prelude =
+    "class Empty\n"
+    "end\n"
+    "class Pair\n"
+    "\tvar a = null\n"
+    "\tvar b = null\n"
+    "\tfunction get()\n"
+    "\t\treturn self.a\n"
+    "\tend\n"
+    "end\n"
+    "var pair = Pair()\n";
+
+static const Workload workloads[] = {
+    { "empty instance", "Empty()" },
+    { "instance with two fields", "Pair()" },
+    { "string", "\"s\" + i.toString()" },
+    { "bound method", "pair.get" },
+    { "empty list", "[]" },
+};
+
+static uint64_t liveBytes(const char* expression)
+{
+    char source[1024];
+    snprintf(source, sizeof(source),
+        "%s"
+        "var keep = []\n"
+        "var i = 0\n"
+        "while i < %d do\n"
+        "\tkeep.append(%s)\n"
+        "\ti = i + 1\n"
+        "end\n",
+        prelude, COUNT, expression);
+
+    VM vm;
+    solisInitVM(&vm, false);
+
+    if (solisInterpret(&vm, source, "memory") != INTERPRET_ALL_GOOD)
+    {
+        printf("Failed to run workload: %s\n", expression);
+        exit(EXIT_FAILURE);
+    }
+
+    solisCollectFull(&vm);
+    uint64_t bytes = vm.allocatedBytes;
+
+    solisFreeVM(&vm);
+
+    return bytes;
+}
+
+int main(void)
+{
+    printf("Object header: %zu bytes\n\n", sizeof(Object));
+
+    uint64_t baseline = liveBytes("i");
+
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        uint64_t bytes = liveBytes(workloads[i].expression);
+
+        printf("%-26s %8.1f bytes per object\n", workloads[i].name, (double)(bytes - baseline) / COUNT);
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <solis.h>
+
+/*
+    Times building strings in a script.
+    Appending to a string with + copies, hashes and interns the whole string every time, StringBuilder only copies what is added.
+    The chain workload formats lines with several + in one expression, which is joined in one allocation.
+*/
+
+#define PIECES 20000
+
+typedef struct
+{
+    const char* name;
+    const char* source;
+} Workload;
+
+static const Workload workloads[] = {
+    {
+        "+ in a loop",
+        "var str = \"\"\n"
+        "var i = 0\n"
+        "while i < %d do\n"
+        "\tstr = str + i.toString()\n"
+        "\ti = i + 1\n"
+        "end\n"
+    },
+    {
+        "StringBuilder",
+        "var str = StringBuilder()\n"
+        "var i = 0\n"
+        "while i < %d do\n"
+        "\tstr.append(i)\n"
+        "\ti = i + 1\n"
+        "end\n"
+        "var result = str.toString()\n"
+    },
+    {
+        "List.toString",
+        "var list = []\n"
+        "var i = 0\n"
+        "while i < %d do\n"
+        "\tlist.append(i)\n"
+        "\ti = i + 1\n"
+        "end\n"
+        "var result = list.toString()\n"
+    },
+    {
+        "chained +",
+        "var i = 0\n"
+        "var name = \"item\"\n"
+        "while i < %d do\n"
+        "\tvar line = name + \" \" + i.toString() + \": \" + name + \"\\n\"\n"
+        "\ti = i + 1\n"
+        "end\n"
+    },
+};
+
+int main(void)
+{
+    printf("%-16s %10s\n", "workload", "seconds");
+
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        char source[1024];
+        snprintf(source, sizeof(source), workloads[i].source, PIECES);
+
+        VM vm;
+        solisInitVM(&vm, false);
+
+        clock_t start = clock();
+
+        if (solisInterpret(&vm, source, "strings") != INTERPRET_ALL_GOOD)
+        {
+            printf("Failed to run workload: %s\n", workloads[i].name);
+            exit(EXIT_FAILURE);
+        }
+
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        printf("%-16s %10.3f\n", workloads[i].name, seconds);
+
+        solisFreeVM(&vm);
+    }
+
+    return 0;
+}
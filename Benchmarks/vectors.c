@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <solis.h>
+
+/*
+    Compares the built in Vec3 and Mat4 against the same math written as script classes.
+    Both run a small particle integration, every step transforms each position by a matrix and adds a scaled velocity.
+    The script version is how vector math had to be written before, a class with methods and a list for the matrix.
+*/
+
+#define PARTICLES 1000
+#define STEPS 200
+
+static const char* scriptSource =
+    "class V3\n"
+    "\tvar x\n"
+    "\tvar y\n"
+    "\tvar z\n"
+    "\tV3(x, y, z)\n"
+    "\t\tself.x = x\n"
+    "\t\tself.y = y\n"
+    "\t\tself.z = z\n"
+    "\tend\n"
+    "\tfunction add(o)\n"
+    "\t\treturn V3(self.x + o.x, self.y + o.y, self.z + o.z)\n"
+    "\tend\n"
+    "\tfunction scale(s)\n"
+    "\t\treturn V3(self.x * s, self.y * s, self.z * s)\n"
+    "\tend\n"
+    "end\n"
+    "function transform(m, p)\n"
+    "\treturn V3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12], m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13], m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14])\n"
+    "end\n"
+    "var m = [0.99, 0.01, 0, 0, -0.01, 0.99, 0, 0, 0, 0, 1, 0, 0.1, 0, 0, 1]\n"
+    "var velocity = V3(0.5, 0.25, 0.125)\n"
+    "var positions = []\n"
+    "var i = 0\n"
+    "while i < %d do\n"
+    "\tpositions.append(V3(i, i * 2, i * 3))\n"
+    "\ti = i + 1\n"
+    "end\n"
+    "var step = 0\n"
+    "while step < %d do\n"
+    "\tvar j = 0\n"
+    "\twhile j < %d do\n"
+    "\t\tpositions[j] = transform(m, positions[j]).add(velocity.scale(0.016))\n"
+    "\t\tj = j + 1\n"
+    "\tend\n"
+    "\tstep = step + 1\n"
+    "end\n";
+
+static const char* builtinSource =
+    "var m = Mat4([0.99, 0.01, 0, 0, -0.01, 0.99, 0, 0, 0, 0, 1, 0, 0.1, 0, 0, 1])\n"
+    "var velocity = Vec3(0.5, 0.25, 0.125)\n"
+    "var positions = []\n"
+    "var i = 0\n"
+    "while i < %d do\n"
+    "\tpositions.append(Vec3(i, i * 2, i * 3))\n"
+    "\ti = i + 1\n"
+    "end\n"
+    "var step = 0\n"
+    "while step < %d do\n"
+    "\tvar j = 0\n"
+    "\twhile j < %d do\n"
+    "\t\tpositions[j] = m * positions[j] + velocity * 0.016\n"
+    "\t\tj = j + 1\n"
+    "\tend\n"
+    "\tstep = step + 1\n"
+    "end\n";
+
+static double run(const char* name, const char* format)
+{
+    char source[4096];
+    snprintf(source, sizeof(source), format, PARTICLES, STEPS, PARTICLES);
+
+    VM vm;
+    solisInitVM(&vm, false);
+
+    clock_t start = clock();
+
+    if (solisInterpret(&vm, source, name) != INTERPRET_ALL_GOOD)
+    {
+        printf("Failed to run workload: %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    solisFreeVM(&vm);
+
+    return seconds;
+}
+
+int main(void)
+{
+    printf("Mat4 kernels use %s\n\n", solisSimdLevelName(solisSimdLevel()));
+
+    double script = run("script", scriptSource);
+    double builtin = run("builtin", builtinSource);
+
+    double transforms = (double)PARTICLES * STEPS;
+
+    printf("%-16s %8.3f s %10.2f M transforms/s\n", "script classes", script, transforms / script / 1e6);
+    printf("%-16s %8.3f s %10.2f M transforms/s\n", "Vec3 and Mat4", builtin, transforms / builtin / 1e6);
+    printf("\n%.1fx faster\n", script / builtin);
+
+    return 0;
+}
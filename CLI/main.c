@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <solis.h>
 #include "terminal.h"
@@ -80,12 +81,62 @@ static void help()
     printf("- repl -> starts the repl for running code.\n");
     printf("          :help can be typed to get repl help while within the repl.\n\n");
 
-    printf("- solis {filepath} -> executes a file immediately with a clean VM.\n\n");
+    printf("- solis {filepath} -> executes a file immediately with a clean VM.\n");
+    printf("- solis --register {filepath} -> executes a file using the register based interpreter where possible.\n");
+    printf("- solis --jit {filepath} -> compiles hot functions to machine code where supported.\n");
+    printf("- solis --jit-threshold={calls} {filepath} -> compiles a function once it has been called {calls} times.\n");
+    printf("- solis --cache {filepath} -> loads the compiled file from {filepath}.solc when it is up to date, otherwise compiles and writes it.\n");
+    printf("- solis --compile {filepath} -> compiles the file to {filepath}.solc without running it.\n");
+    printf("- solis --gc-threads={count} {filepath} -> shares the marking of large collections between {count} threads.\n");
+    printf("- solis --gc-grow={factor} {filepath} -> lets the heap grow by {factor} after a full collection before the next one.\n");
+    printf("- solis --gc-min-heap={mb} {filepath} -> never starts a full collection below {mb} megabytes.\n");
+    printf("- solis --gc-max-heap={mb} {filepath} -> collects sooner to keep the heap under {mb} megabytes.\n");
+    printf("- solis --gc-stats {filepath} -> prints what the collector did once the file has run.\n");
+    printf("- solis --heap-snapshot={path} {filepath} -> writes a JSON snapshot of the live heap once the file has run.\n");
+    printf("          options can be combined before the file path.\n");
+    printf("- solis {filepath}.solc -> executes a compiled file.\n\n");
 
     printf("- run -> Checks for a package file in the working directory and then buils and runs it.\n");
 
 }
 
+// Replaces a .solis extension with .solc, the result needs freeing
+static char* bytecodePath(const char* filepath)
+{
+    size_t length = strlen(filepath);
+
+    const char* extension = ".solis";
+    size_t extensionLength = strlen(extension);
+
+    if (length >= extensionLength && strcmp(filepath + length - extensionLength, extension) == 0)
+        length -= extensionLength;
+
+    char* path = (char*)malloc(length + 6);
+    if (path == NULL)
+        return NULL;
+
+    memcpy(path, filepath, length);
+    memcpy(path + length, ".solc", 6);
+
+    return path;
+}
+
+static bool isBytecodePath(const char* filepath)
+{
+    size_t length = strlen(filepath);
+    return length >= 5 && strcmp(filepath + length - 5, ".solc") == 0;
+}
+
+// Seconds of processor time, scripts use it to time themselves
+static bool clockNative(VM* vm)
+{
+    double time = (double)clock() / CLOCKS_PER_SEC;
+
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(time));
+
+    return true;
+}
+
 static void version()
 {
 	printf(" Solis v%d.%d %s -- CLI build %d\n", SOLIS_MAJOR_VERSION, SOLIS_MINOR_VERSION, SOLIS_RELEASE_STRING, SOLIS_CLI_VERSION);
@@ -99,6 +150,8 @@ static void repl()
     VM vm;
     solisInitVM(&vm, false);
 
+    solisPushGlobalCFunction(&vm, "clock", clockNative, 0);
+
     char* last_filepath = NULL;
 
     for (;;)
@@ -222,6 +275,27 @@ static void repl()
 }
 
 
+static void printGCStats(VM* vm)
+{
+    SolisGCStats stats;
+    solisGetGCStats(vm, &stats);
+
+    printf("\n-- GC Stats --\n");
+    printf("minor collections: %llu\n", (unsigned long long)stats.minorCollections);
+    printf("full collections: %llu\n", (unsigned long long)stats.fullCollections);
+    printf("pauses: %llu, total %.3f ms, max %.3f ms\n", (unsigned long long)stats.pauseCount,
+        stats.totalPauseNanoseconds / 1e6, stats.maxPauseNanoseconds / 1e6);
+    printf("bytes freed: %llu\n", (unsigned long long)stats.bytesFreed);
+    printf("heap: %llu bytes\n", (unsigned long long)vm->allocatedBytes);
+
+    printf("live objects at the last full collection:\n");
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+    {
+        if (stats.liveObjects[i] > 0)
+            printf("  %s: %llu\n", solisObjectTypeName((ObjectType)i), (unsigned long long)stats.liveObjects[i]);
+    }
+}
+
 Command commands[] = {
 	{ "help", 4, help },
 	{ "version", 7, version },
@@ -241,8 +315,69 @@ int main(int argc, char* argv[])
 		return 0;
 
     const char* file = NULL;
+    const char* filepath = argv[1];
+
+    SolisVMConfig config;
+    config.sandboxed = false;
+    config.executionMode = SOLIS_EXECUTION_STACK;
+    config.jit = false;
+    config.jitThreshold = 0;
+    config.coreCachePath = NULL;
+    config.nurserySize = 0;
+    config.gcThreads = 0;
+    config.allocator = NULL;
+    config.gcPacing.growFactor = 0;
+    config.gcPacing.minHeap = 0;
+    config.gcPacing.maxHeap = 0;
+
+    bool useCache = false;
+    bool compileOnly = false;
+    bool gcStats = false;
+    const char* snapshotPath = NULL;
+
+    // Options come before the file path
+    int argIndex = 1;
+    while (argIndex < argc - 1 && strncmp(argv[argIndex], "--", 2) == 0)
+    {
+        if (strcmp(argv[argIndex], "--register") == 0)
+            config.executionMode = SOLIS_EXECUTION_REGISTER;
+        else if (strcmp(argv[argIndex], "--jit") == 0)
+            config.jit = true;
+        else if (strncmp(argv[argIndex], "--jit-threshold=", 16) == 0)
+            config.jitThreshold = atoi(argv[argIndex] + 16);
+        else if (strcmp(argv[argIndex], "--cache") == 0)
+            useCache = true;
+        else if (strcmp(argv[argIndex], "--compile") == 0)
+            compileOnly = true;
+        else if (strncmp(argv[argIndex], "--gc-threads=", 13) == 0)
+            config.gcThreads = atoi(argv[argIndex] + 13);
+        else if (strncmp(argv[argIndex], "--gc-grow=", 10) == 0)
+            config.gcPacing.growFactor = atof(argv[argIndex] + 10);
+        else if (strncmp(argv[argIndex], "--gc-min-heap=", 14) == 0)
+            config.gcPacing.minHeap = (size_t)atoi(argv[argIndex] + 14) * 1024 * 1024;
+        else if (strncmp(argv[argIndex], "--gc-max-heap=", 14) == 0)
+            config.gcPacing.maxHeap = (size_t)atoi(argv[argIndex] + 14) * 1024 * 1024;
+        else if (strcmp(argv[argIndex], "--gc-stats") == 0)
+            gcStats = true;
+        else if (strncmp(argv[argIndex], "--heap-snapshot=", 16) == 0)
+            snapshotPath = argv[argIndex] + 16;
+        else
+        {
+            printf("Unknown option: %s\n", argv[argIndex]);
+            return 1;
+        }
 
-	if (argc == 2)
+        argIndex++;
+    }
+
+    if (argIndex > 1 && argIndex == argc - 1)
+    {
+        filepath = argv[argIndex];
+
+        if (!isBytecodePath(filepath))
+            file = readFileIntoString(filepath);
+    }
+	else if (argc == 2)
 	{
 		// Get the arg
 		const char* arg = argv[1];
@@ -268,16 +403,26 @@ int main(int argc, char* argv[])
 		// If we reach this point we should try and run the argument
 		// We shall assume its a path
 
-        file = readFileIntoString(arg);
+        if (!isBytecodePath(arg))
+            file = readFileIntoString(arg);
 
 
 	}
 
+    // Compiled files are loaded by the VM directly
+    bool runBytecode = isBytecodePath(filepath);
+
+    if (runBytecode && (useCache || compileOnly))
+    {
+        printf("--cache and --compile need a source file\n");
+        return 1;
+    }
+
     // At this point the file buffer should be filled from various arguments
     // If it isn't it should've returned at an earlier point. 
 
     // if the file is null return
-    if (file == NULL)
+    if (file == NULL && !runBytecode)
     {
         return 1;
     }
@@ -285,9 +430,39 @@ int main(int argc, char* argv[])
     // Initialise and run the VM with the code
     VM vm;
 
-    solisInitVM(&vm, false);
+    solisInitVMWithConfig(&vm, &config);
+
+    solisPushGlobalCFunction(&vm, "clock", clockNative, 0);
+
+    InterpretResult result;
+
+    if (runBytecode)
+    {
+        result = solisInterpretBytecode(&vm, filepath, filepath);
 
-    InterpretResult result = solisInterpret(&vm, file, argv[1]);
+        if (result == INTERPRET_COMPILE_ERROR)
+            printf("Could not load compiled file: %s\n", filepath);
+    }
+    else if (useCache || compileOnly)
+    {
+        char* cachePath = bytecodePath(filepath);
+        if (cachePath == NULL)
+            return 1;
+
+        if (compileOnly)
+        {
+            if (solisCompileToBytecode(&vm, file, filepath, cachePath))
+                result = INTERPRET_ALL_GOOD;
+            else
+                result = INTERPRET_COMPILE_ERROR;
+        }
+        else
+            result = solisInterpretCached(&vm, file, filepath, cachePath);
+
+        free(cachePath);
+    }
+    else
+        result = solisInterpret(&vm, file, filepath);
 
     if (result == INTERPRET_COMPILE_ERROR)
     {
@@ -298,10 +473,23 @@ int main(int argc, char* argv[])
         printf("Runtime Error\n");
     }
 
+    if (gcStats)
+        printGCStats(&vm);
+
+    if (snapshotPath != NULL && !solisWriteHeapSnapshot(&vm, snapshotPath))
+        printf("Could not write heap snapshot to %s\n", snapshotPath);
+
     solisFreeVM(&vm);
 
 
 
     terminalShutdown();
+
+    // Scripts and test runners can tell a failed run apart from one that finished
+    if (result == INTERPRET_COMPILE_ERROR)
+        return 65;
+    if (result == INTERPRET_RUNTIME_ERROR)
+        return 70;
+
 	return 0;
 }
\ No newline at end of file
@@ -4,6 +4,12 @@
 
 #include <solis.h>
 
-__declspec(dllexport) void solis_openlib(VM* vm);
+#ifdef _WIN32
+#define SOLISLIB_EXPORT __declspec(dllexport)
+#else
+#define SOLISLIB_EXPORT __attribute__((visibility("default")))
+#endif
+
+SOLISLIB_EXPORT void solis_openlib(VM* vm);
 
 #endif // SOLISLIB_H
\ No newline at end of file
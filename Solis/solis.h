@@ -6,5 +6,6 @@
 #include "solis_chunk.h"
 #include "solis_vm.h"
 #include "solis_hashtable.h"
+#include "solis_snapshot.h"
 
 #endif // SOLIS_H
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "solis_allocator.h"
+
+#include <string.h>
+
+#include "solis_vm.h"
+#include "solis_gc.h"
+
+static void* defaultReallocate(void* ptr, size_t size, void* userdata)
+{
+	(void)userdata;
+
+	if (size == 0)
+	{
+		SOLIS_FREE_FUNC(ptr);
+		return NULL;
+	}
+
+	return SOLIS_REALLOC_FUNC(ptr, size);
+}
+
+static void* defaultAllocateAligned(size_t alignment, size_t size, void* userdata)
+{
+	(void)userdata;
+	return SOLIS_ALIGNED_ALLOC_FUNC(alignment, size);
+}
+
+static void defaultFreeAligned(void* ptr, void* userdata)
+{
+	(void)userdata;
+	SOLIS_ALIGNED_FREE_FUNC(ptr);
+}
+
+SolisAllocator solisDefaultAllocator(void)
+{
+	SolisAllocator allocator;
+	allocator.reallocate = defaultReallocate;
+	allocator.allocateAligned = defaultAllocateAligned;
+	allocator.freeAligned = defaultFreeAligned;
+	allocator.userdata = NULL;
+
+	return allocator;
+}
+
+void* solisRawReallocate(VM* vm, void* ptr, size_t size)
+{
+	void* result = vm->allocator.reallocate(ptr, size, vm->allocator.userdata);
+
+	if (result == NULL && size != 0) exit(1);
+
+	return result;
+}
+
+void solisRawFree(VM* vm, void* ptr)
+{
+	if (ptr != NULL)
+		vm->allocator.reallocate(ptr, 0, vm->allocator.userdata);
+}
+
+void* solisRawAllocateAligned(VM* vm, size_t alignment, size_t size)
+{
+	void* result = vm->allocator.allocateAligned(alignment, size, vm->allocator.userdata);
+
+	if (result == NULL) exit(1);
+
+	return result;
+}
+
+void solisRawFreeAligned(VM* vm, void* ptr)
+{
+	vm->allocator.freeAligned(ptr, vm->allocator.userdata);
+}
+
+void solisInitSmallAllocator(SolisSmallAllocator* allocator)
+{
+	memset(allocator->classes, 0, sizeof(allocator->classes));
+
+	allocator->pages = NULL;
+	allocator->pageBytes = 0;
+}
+
+void solisFreeSmallAllocator(VM* vm, SolisSmallAllocator* allocator)
+{
+	SmallPage* page = allocator->pages;
+	while (page != NULL)
+	{
+		SmallPage* next = page->next;
+		solisRawFree(vm, page);
+		page = next;
+	}
+
+	solisInitSmallAllocator(allocator);
+}
+
+static inline int sizeClassOf(size_t size)
+{
+	return (int)((size - 1) / SOLIS_SMALL_GRANULE);
+}
+
+// Pages aren't counted in allocatedBytes, only the slots handed out are
+static void newPage(VM* vm, SolisSmallAllocator* allocator, SizeClass* sizeClass)
+{
+	SmallPage* page = (SmallPage*)solisRawReallocate(vm, NULL, SOLIS_SMALL_PAGE_SIZE);
+
+	page->next = allocator->pages;
+	allocator->pages = page;
+	allocator->pageBytes += SOLIS_SMALL_PAGE_SIZE;
+
+	sizeClass->cursor = (uint8_t*)(page + 1);
+	sizeClass->limit = (uint8_t*)page + SOLIS_SMALL_PAGE_SIZE;
+}
+
+void* solisAllocateSmall(VM* vm, size_t size)
+{
+	if (size == 0)
+		return NULL;
+
+	if (size > SOLIS_MAX_SMALL_SIZE)
+		return solisReallocate(vm, NULL, 0, size);
+
+#ifdef SOLIS_DEBUG_STRESS_GC
+	solisCollectFull(vm);
+#endif
+
+	// Collecting can free slots so it happens before one is taken
+	solisCheckGarbage(vm, size);
+
+	vm->allocatedBytes += size;
+
+	SizeClass* sizeClass = &vm->smallAllocator.classes[sizeClassOf(size)];
+
+	SmallSlot* slot = sizeClass->freeSlots;
+	if (slot != NULL)
+	{
+		sizeClass->freeSlots = slot->next;
+		return slot;
+	}
+
+	size_t slotSize = (size_t)(sizeClassOf(size) + 1) * SOLIS_SMALL_GRANULE;
+
+	// The end of a page too small for another slot is left unused
+	if (sizeClass->cursor == NULL || sizeClass->cursor + slotSize > sizeClass->limit)
+		newPage(vm, &vm->smallAllocator, sizeClass);
+
+	void* memory = sizeClass->cursor;
+	sizeClass->cursor += slotSize;
+
+	return memory;
+}
+
+void solisFreeSmall(VM* vm, void* ptr, size_t size)
+{
+	if (ptr == NULL || size == 0)
+		return;
+
+	if (size > SOLIS_MAX_SMALL_SIZE)
+	{
+		solisReallocate(vm, ptr, size, 0);
+		return;
+	}
+
+	vm->allocatedBytes -= size;
+
+#ifdef SOLIS_DEBUG_STRESS_GC
+	// Slots are reused rather than freed so scribble over them to catch anything still using them
+	memset(ptr, 0xdd, (size_t)(sizeClassOf(size) + 1) * SOLIS_SMALL_GRANULE);
+#endif
+
+	SizeClass* sizeClass = &vm->smallAllocator.classes[sizeClassOf(size)];
+
+	SmallSlot* slot = (SmallSlot*)ptr;
+	slot->next = sizeClass->freeSlots;
+	sizeClass->freeSlots = slot;
+}
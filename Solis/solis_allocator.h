@@ -0,0 +1,95 @@
+#ifndef SOLIS_ALLOCATOR_H
+#define SOLIS_ALLOCATOR_H
+
+#include "solis_common.h"
+
+/*
+	Small allocations that objects own, like string characters, closure upvalue arrays and hash table entries.
+	Objects themselves live in the nursery blocks, this is for the memory they point at.
+	Sizes are rounded up to a size class, each class carves its own pages into slots and keeps a free list of them.
+	Freeing needs the size it was allocated with so the slot goes back to the right class.
+	Anything bigger than the largest class goes through solisReallocate.
+*/
+
+/*
+	Where a VM gets all of its memory from, passed in SolisVMConfig so every VM can have its own.
+	reallocate behaves like realloc, a size of 0 frees ptr and returns NULL.
+	Nursery blocks have to be aligned to their size so they come from allocateAligned and go back through freeAligned,
+	both can be left NULL to use the defaults for the blocks.
+	With more than one gc thread reallocate is also called from the marking threads, so it has to be thread safe.
+*/
+typedef struct
+{
+	void* (*reallocate)(void* ptr, size_t size, void* userdata);
+	void* (*allocateAligned)(size_t alignment, size_t size, void* userdata);
+	void (*freeAligned)(void* ptr, void* userdata);
+
+	void* userdata;
+} SolisAllocator;
+
+// Built on SOLIS_REALLOC_FUNC, SOLIS_FREE_FUNC and the aligned versions of them
+SolisAllocator solisDefaultAllocator(void);
+
+/*
+	Memory straight from the VM's allocator.
+	It isn't counted in allocatedBytes and never starts a collection, so it is safe to use from inside one.
+*/
+void* solisRawReallocate(VM* vm, void* ptr, size_t size);
+void solisRawFree(VM* vm, void* ptr);
+void* solisRawAllocateAligned(VM* vm, size_t alignment, size_t size);
+void solisRawFreeAligned(VM* vm, void* ptr);
+
+#define SOLIS_SMALL_PAGE_SIZE (16 * 1024)
+
+// Size classes are multiples of this, which is also the alignment of every slot
+#define SOLIS_SMALL_GRANULE 16
+#define SOLIS_MAX_SMALL_SIZE 256
+#define SOLIS_SIZE_CLASS_COUNT (SOLIS_MAX_SMALL_SIZE / SOLIS_SMALL_GRANULE)
+
+typedef struct SmallSlot
+{
+	struct SmallSlot* next;
+} SmallSlot;
+
+typedef struct SmallPage
+{
+	struct SmallPage* next;
+
+	// Keeps the slots after the header aligned to a granule
+	uint8_t padding[SOLIS_SMALL_GRANULE - sizeof(struct SmallPage*)];
+} SmallPage;
+
+typedef struct
+{
+	SmallSlot* freeSlots;
+
+	// Slots in the newest page that haven't been handed out yet
+	uint8_t* cursor;
+	uint8_t* limit;
+} SizeClass;
+
+typedef struct
+{
+	SizeClass classes[SOLIS_SIZE_CLASS_COUNT];
+
+	// Every page of every class, they are only given back when the VM is freed
+	SmallPage* pages;
+	size_t pageBytes;
+} SolisSmallAllocator;
+
+void solisInitSmallAllocator(SolisSmallAllocator* allocator);
+
+void solisFreeSmallAllocator(VM* vm, SolisSmallAllocator* allocator);
+
+// Counted in allocatedBytes and can start a collection, just like solisReallocate
+void* solisAllocateSmall(VM* vm, size_t size);
+
+void solisFreeSmall(VM* vm, void* ptr, size_t size);
+
+#define SOLIS_ALLOCATE_SMALL(vm, type, count) \
+    (type*)solisAllocateSmall(vm, sizeof(type) * (count))
+
+#define SOLIS_FREE_SMALL(vm, type, pointer, count) \
+    solisFreeSmall(vm, pointer, sizeof(type) * (count))
+
+#endif // SOLIS_ALLOCATOR_H
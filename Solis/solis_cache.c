@@ -0,0 +1,619 @@
+#include "solis_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "solis_chunk.h"
+#include "solis_hashtable.h"
+#include "solis_object.h"
+#include "solis_vm.h"
+
+// Counted from the opcode lists so a build with different opcodes never loads an old file
+enum
+{
+	OPCODE_COUNT = 0
+#define OPCODE(code) + 1
+#include "solis_opcode.h"
+#undef OPCODE
+};
+
+enum
+{
+	REGISTER_OPCODE_COUNT = 0
+#define OPCODE(code) + 1
+#include "solis_register_opcode.h"
+#undef OPCODE
+};
+
+typedef enum
+{
+	CONSTANT_NULL,
+	CONSTANT_TRUE,
+	CONSTANT_FALSE,
+	CONSTANT_NUMBER,
+	CONSTANT_STRING,
+	CONSTANT_FUNCTION,
+	CONSTANT_ENUM
+} ConstantTag;
+
+// Nested functions deeper than this are treated as a malformed file
+#define MAX_FUNCTION_DEPTH 256
+
+uint64_t solisHashSource(const char* source)
+{
+	// 64 bit FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+
+	for (const char* c = source; *c != '\0'; c++)
+	{
+		hash ^= (uint8_t)*c;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+// ----- Writing -----
+
+typedef struct
+{
+	VM* vm;
+
+	uint8_t* data;
+	size_t count;
+	size_t capacity;
+
+	// Set when something can't be stored, the file is not written
+	bool failed;
+} Writer;
+
+static void writeBytes(Writer* writer, const void* bytes, size_t length)
+{
+	if (length == 0)
+		return;
+
+	if (writer->count + length > writer->capacity)
+	{
+		while (writer->count + length > writer->capacity)
+			writer->capacity = GROW_CAPACITY(writer->capacity);
+
+		writer->data = (uint8_t*)solisRawReallocate(writer->vm, writer->data, writer->capacity);
+	}
+
+	memcpy(writer->data + writer->count, bytes, length);
+	writer->count += length;
+}
+
+static void writeU8(Writer* writer, uint8_t value)
+{
+	writeBytes(writer, &value, 1);
+}
+
+// Everything is little endian regardless of the host
+static void writeU32(Writer* writer, uint32_t value)
+{
+	uint8_t bytes[4];
+	for (int i = 0; i < 4; i++)
+		bytes[i] = (value >> (i * 8)) & 0xff;
+
+	writeBytes(writer, bytes, 4);
+}
+
+static void writeU64(Writer* writer, uint64_t value)
+{
+	uint8_t bytes[8];
+	for (int i = 0; i < 8; i++)
+		bytes[i] = (value >> (i * 8)) & 0xff;
+
+	writeBytes(writer, bytes, 8);
+}
+
+static void writeNumber(Writer* writer, double number)
+{
+	uint64_t bits;
+	memcpy(&bits, &number, sizeof(double));
+	writeU64(writer, bits);
+}
+
+static void writeString(Writer* writer, ObjString* string)
+{
+	writeU32(writer, (uint32_t)string->length);
+	writeBytes(writer, string->chars, string->length);
+}
+
+static void writeCode(Writer* writer, Chunk* chunk)
+{
+	writeU32(writer, (uint32_t)chunk->count);
+	writeBytes(writer, chunk->code, chunk->count);
+
+	for (int i = 0; i < chunk->count; i++)
+		writeU32(writer, (uint32_t)chunk->lines.data[i]);
+}
+
+static void writeFunction(Writer* writer, ObjFunction* function);
+
+static void writeConstant(Writer* writer, Value value)
+{
+	if (SOLIS_IS_NULL(value))
+	{
+		writeU8(writer, CONSTANT_NULL);
+	}
+	else if (SOLIS_IS_BOOL(value))
+	{
+		writeU8(writer, SOLIS_AS_BOOL(value) ? CONSTANT_TRUE : CONSTANT_FALSE);
+	}
+	else if (SOLIS_IS_NUMERIC(value))
+	{
+		writeU8(writer, CONSTANT_NUMBER);
+		writeNumber(writer, SOLIS_AS_NUMBER(value));
+	}
+	else if (SOLIS_IS_STRING(value))
+	{
+		writeU8(writer, CONSTANT_STRING);
+		writeString(writer, SOLIS_AS_STRING(value));
+	}
+	else if (SOLIS_IS_FUNCTION(value))
+	{
+		writeU8(writer, CONSTANT_FUNCTION);
+		writeFunction(writer, SOLIS_AS_FUNCTION(value));
+	}
+	else if (SOLIS_IS_ENUM(value))
+	{
+		ObjEnum* enumObj = SOLIS_AS_ENUM(value);
+
+		writeU8(writer, CONSTANT_ENUM);
+		writeU32(writer, (uint32_t)enumObj->fieldCount);
+		writeU32(writer, (uint32_t)enumObj->fields.count);
+
+		for (int i = 0; i < enumObj->fields.capacity; i++)
+		{
+			TableEntry* entry = &enumObj->fields.entries[i];
+
+			if (entry->key == NULL)
+				continue;
+
+			writeString(writer, entry->key);
+			writeNumber(writer, SOLIS_AS_NUMBER(entry->value));
+		}
+	}
+	else
+	{
+		// The compiler never makes any other constants
+		writer->failed = true;
+	}
+}
+
+static void writeFunction(Writer* writer, ObjFunction* function)
+{
+	writeU8(writer, function->name != NULL);
+	if (function->name != NULL)
+		writeString(writer, function->name);
+
+	writeU32(writer, (uint32_t)function->arity);
+	writeU32(writer, (uint32_t)function->upvalueCount);
+
+	Chunk* chunk = &function->chunk;
+
+	writeCode(writer, chunk);
+
+	writeU32(writer, (uint32_t)chunk->constants.count);
+	for (int i = 0; i < chunk->constants.count; i++)
+		writeConstant(writer, chunk->constants.data[i]);
+
+	writeU32(writer, (uint32_t)chunk->caches.count);
+
+	writeU32(writer, (uint32_t)function->registerCount);
+	writeCode(writer, &function->registerChunk);
+}
+
+bool solisWriteBytecodeFile(VM* vm, ObjModule* mdl, int globalBase, uint64_t sourceHash, const char* path)
+{
+	if (mdl->closure == NULL)
+		return false;
+
+	Writer writer = { 0 };
+	writer.vm = vm;
+
+	writeBytes(&writer, SOLIS_BYTECODE_MAGIC, 4);
+	writeU32(&writer, SOLIS_BYTECODE_VERSION);
+	writeU32(&writer, OPCODE_COUNT);
+	writeU32(&writer, REGISTER_OPCODE_COUNT);
+	writeU8(&writer, (uint8_t)vm->executionMode);
+	writeU64(&writer, sourceHash);
+
+	// The globals the code refers to by index
+	writeU32(&writer, (uint32_t)globalBase);
+	writeU32(&writer, (uint32_t)mdl->globals.count);
+
+	writeU32(&writer, (uint32_t)mdl->globalMap.count);
+
+	for (int i = 0; i < mdl->globalMap.capacity; i++)
+	{
+		TableEntry* entry = &mdl->globalMap.entries[i];
+
+		if (entry->key == NULL)
+			continue;
+
+		writeString(&writer, entry->key);
+		writeU32(&writer, (uint32_t)SOLIS_AS_NUMBER(entry->value));
+	}
+
+	writeFunction(&writer, mdl->closure->function);
+
+	bool success = !writer.failed;
+
+	if (success)
+	{
+		FILE* file = fopen(path, "wb");
+
+		success = file != NULL && fwrite(writer.data, 1, writer.count, file) == writer.count;
+
+		if (file != NULL && fclose(file) != 0)
+			success = false;
+
+		// Never leave a partial file that could be picked up later
+		if (!success && file != NULL)
+			remove(path);
+	}
+
+	solisRawFree(vm, writer.data);
+
+	return success;
+}
+
+// ----- Reading -----
+
+typedef struct
+{
+	VM* vm;
+
+	const uint8_t* data;
+	size_t size;
+	size_t position;
+
+	// Set on any read past the end or invalid value, every read after that returns zero
+	bool failed;
+} Reader;
+
+static bool readBytes(Reader* reader, void* bytes, size_t length)
+{
+	if (reader->failed || length > reader->size - reader->position)
+	{
+		reader->failed = true;
+		memset(bytes, 0, length);
+		return false;
+	}
+
+	memcpy(bytes, reader->data + reader->position, length);
+	reader->position += length;
+	return true;
+}
+
+static uint8_t readU8(Reader* reader)
+{
+	uint8_t value;
+	readBytes(reader, &value, 1);
+	return value;
+}
+
+static uint32_t readU32(Reader* reader)
+{
+	uint8_t bytes[4];
+	readBytes(reader, bytes, 4);
+
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++)
+		value |= (uint32_t)bytes[i] << (i * 8);
+
+	return value;
+}
+
+static uint64_t readU64(Reader* reader)
+{
+	uint8_t bytes[8];
+	readBytes(reader, bytes, 8);
+
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++)
+		value |= (uint64_t)bytes[i] << (i * 8);
+
+	return value;
+}
+
+static double readNumber(Reader* reader)
+{
+	uint64_t bits = readU64(reader);
+
+	double number;
+	memcpy(&number, &bits, sizeof(double));
+
+	// A damaged NaN could carry tag bits and look like an object once boxed
+	if (isnan(number))
+		return NAN;
+
+	return number;
+}
+
+// Counts that are larger than what is left in the file can't be right
+static uint32_t readCount(Reader* reader, size_t elementSize)
+{
+	uint32_t count = readU32(reader);
+
+	if (!reader->failed && (uint64_t)count * elementSize > reader->size - reader->position)
+	{
+		reader->failed = true;
+		return 0;
+	}
+
+	return count;
+}
+
+static ObjString* readString(Reader* reader)
+{
+	uint32_t length = readCount(reader, 1);
+
+	if (reader->failed)
+		return NULL;
+
+	const char* chars = (const char*)(reader->data + reader->position);
+	reader->position += length;
+
+	return solisCopyString(reader->vm, chars, (int)length);
+}
+
+static void readCode(Reader* reader, Chunk* chunk)
+{
+	uint32_t count = readCount(reader, 5);
+
+	if (reader->failed)
+		return;
+
+	const uint8_t* code = reader->data + reader->position;
+	reader->position += count;
+
+	for (uint32_t i = 0; i < count; i++)
+		solisWriteChunk(reader->vm, chunk, code[i], (int)readU32(reader));
+}
+
+static ObjFunction* readFunction(Reader* reader, int depth);
+
+static Value readConstant(Reader* reader, int depth)
+{
+	VM* vm = reader->vm;
+
+	switch (readU8(reader))
+	{
+	case CONSTANT_NULL:
+		return SOLIS_NULL_VALUE();
+	case CONSTANT_TRUE:
+		return SOLIS_BOOL_VALUE(true);
+	case CONSTANT_FALSE:
+		return SOLIS_BOOL_VALUE(false);
+	case CONSTANT_NUMBER:
+		return SOLIS_NUMERIC_VALUE(readNumber(reader));
+	case CONSTANT_STRING:
+	{
+		ObjString* string = readString(reader);
+		return string != NULL ? SOLIS_OBJECT_VALUE(string) : SOLIS_NULL_VALUE();
+	}
+	case CONSTANT_FUNCTION:
+	{
+		ObjFunction* function = readFunction(reader, depth + 1);
+		return function != NULL ? SOLIS_OBJECT_VALUE(function) : SOLIS_NULL_VALUE();
+	}
+	case CONSTANT_ENUM:
+	{
+		ObjEnum* enumObj = solisNewEnum(vm);
+		solisPush(vm, SOLIS_OBJECT_VALUE(enumObj));
+
+		enumObj->fieldCount = (int)readU32(reader);
+		uint32_t count = readCount(reader, 12);
+
+		for (uint32_t i = 0; i < count && !reader->failed; i++)
+		{
+			ObjString* name = readString(reader);
+			double index = readNumber(reader);
+
+			if (name == NULL)
+				break;
+
+			solisPush(vm, SOLIS_OBJECT_VALUE(name));
+			solisHashTableInsert(&enumObj->fields, name, SOLIS_NUMERIC_VALUE(index));
+			solisWriteBarrier(vm, (Object*)enumObj, SOLIS_OBJECT_VALUE(name));
+			solisPop(vm);
+		}
+
+		solisPop(vm);
+		return SOLIS_OBJECT_VALUE(enumObj);
+	}
+	default:
+		reader->failed = true;
+		return SOLIS_NULL_VALUE();
+	}
+}
+
+static ObjFunction* readFunction(Reader* reader, int depth)
+{
+	VM* vm = reader->vm;
+
+	if (depth > MAX_FUNCTION_DEPTH)
+	{
+		reader->failed = true;
+		return NULL;
+	}
+
+	// Keep the function reachable while its constants allocate
+	ObjFunction* function = solisNewFunction(vm);
+	solisPush(vm, SOLIS_OBJECT_VALUE(function));
+
+	if (readU8(reader))
+		function->name = readString(reader);
+
+	function->arity = (int)readU32(reader);
+	function->upvalueCount = (int)readU32(reader);
+
+	Chunk* chunk = &function->chunk;
+
+	readCode(reader, chunk);
+
+	uint32_t constantCount = readCount(reader, 1);
+	for (uint32_t i = 0; i < constantCount && !reader->failed; i++)
+	{
+		Value constant = readConstant(reader, depth);
+		solisAddConstant(vm, chunk, constant);
+
+		// Reading collects so the function can be promoted before all its constants are in
+		solisWriteBarrier(vm, (Object*)function, constant);
+	}
+
+	// Every inline cache belongs to an instruction
+	uint32_t cacheCount = readU32(reader);
+	if (cacheCount > (uint32_t)chunk->count)
+		reader->failed = true;
+
+	for (uint32_t i = 0; i < cacheCount && !reader->failed; i++)
+		solisAddInlineCache(vm, chunk);
+
+	function->registerCount = (int)readU32(reader);
+	readCode(reader, &function->registerChunk);
+
+	solisPop(vm);
+
+	return reader->failed ? NULL : function;
+}
+
+typedef struct
+{
+	ObjString* name;
+	uint32_t index;
+} GlobalEntry;
+
+static bool readFile(VM* vm, const char* path, uint8_t** data, size_t* size)
+{
+	FILE* file = fopen(path, "rb");
+
+	if (file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (length <= 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	*data = (uint8_t*)solisRawReallocate(vm, NULL, (size_t)length);
+	*size = fread(*data, 1, (size_t)length, file);
+
+	fclose(file);
+
+	if (*size != (size_t)length)
+	{
+		solisRawFree(vm, *data);
+		return false;
+	}
+
+	return true;
+}
+
+bool solisReadBytecodeFile(VM* vm, ObjModule* mdl, const char* path, bool checkHash, uint64_t sourceHash)
+{
+	uint8_t* data = NULL;
+	size_t size = 0;
+
+	if (!readFile(vm, path, &data, &size))
+		return false;
+
+	Reader reader;
+	reader.vm = vm;
+	reader.data = data;
+	reader.size = size;
+	reader.position = 0;
+	reader.failed = false;
+
+	char magic[4];
+	readBytes(&reader, magic, 4);
+
+	bool valid = memcmp(magic, SOLIS_BYTECODE_MAGIC, 4) == 0
+		&& readU32(&reader) == SOLIS_BYTECODE_VERSION
+		&& readU32(&reader) == OPCODE_COUNT
+		&& readU32(&reader) == REGISTER_OPCODE_COUNT
+		&& readU8(&reader) == (uint8_t)vm->executionMode;
+
+	uint64_t hash = readU64(&reader);
+
+	if (!valid || reader.failed || (checkHash && hash != sourceHash))
+	{
+		solisRawFree(vm, data);
+		return false;
+	}
+
+	// The code addresses globals by index so the ones that existed before the script must be exactly where they were
+	uint32_t globalBase = readU32(&reader);
+	uint32_t globalCount = readU32(&reader);
+	uint32_t entryCount = readCount(&reader, 8);
+
+	valid = !reader.failed && globalBase == (uint32_t)mdl->globals.count && globalCount >= globalBase;
+
+	GlobalEntry* entries = NULL;
+	if (valid && entryCount > 0)
+		entries = (GlobalEntry*)solisRawReallocate(vm, NULL, sizeof(GlobalEntry) * entryCount);
+
+	// Holds the names so they survive a collection until they are in the module
+	ObjFunction* names = solisNewFunction(vm);
+	solisPush(vm, SOLIS_OBJECT_VALUE(names));
+
+	for (uint32_t i = 0; valid && i < entryCount; i++)
+	{
+		entries[i].name = readString(&reader);
+		entries[i].index = readU32(&reader);
+
+		if (reader.failed || entries[i].index >= globalCount)
+		{
+			valid = false;
+			break;
+		}
+
+		solisAddConstant(vm, &names->chunk, SOLIS_OBJECT_VALUE(entries[i].name));
+		solisWriteBarrier(vm, (Object*)names, SOLIS_OBJECT_VALUE(entries[i].name));
+
+		if (entries[i].index < globalBase)
+		{
+			Value existing;
+			valid = solisHashTableGet(&mdl->globalMap, entries[i].name, &existing)
+				&& (uint32_t)SOLIS_AS_NUMBER(existing) == entries[i].index;
+		}
+	}
+
+	ObjFunction* function = valid ? readFunction(&reader, 0) : NULL;
+
+	valid = function != NULL && !reader.failed && reader.position == reader.size;
+
+	if (valid)
+	{
+		solisAddConstant(vm, &names->chunk, SOLIS_OBJECT_VALUE(function));
+		solisWriteBarrier(vm, (Object*)names, SOLIS_OBJECT_VALUE(function));
+
+		for (uint32_t i = mdl->globals.count; i < globalCount; i++)
+			solisValueBufferWrite(vm, &mdl->globals, SOLIS_NULL_VALUE());
+
+		for (uint32_t i = 0; i < entryCount; i++)
+		{
+			if (entries[i].index >= globalBase)
+				solisHashTableInsert(&mdl->globalMap, entries[i].name, SOLIS_NUMERIC_VALUE((double)entries[i].index));
+		}
+
+		mdl->closure = solisNewClosure(vm, function);
+	}
+
+	solisPop(vm);
+
+	solisRawFree(vm, entries);
+	solisRawFree(vm, data);
+
+	return valid;
+}
@@ -0,0 +1,38 @@
+#ifndef SOLIS_CACHE_H
+#define SOLIS_CACHE_H
+
+#include "solis_common.h"
+#include "solis_value.h"
+
+/*
+	Bytecode cache files (.solc) hold the compiled function tree of a script so it can run without the scanner or compiler.
+	They are only valid for the VM build that wrote them, the header records the format version and opcode counts.
+	The file layout is checked when loading but the bytecode itself isn't verified, only load files you trust.
+*/
+
+#define SOLIS_BYTECODE_MAGIC "SOLC"
+
+// Bump whenever the layout of the file or the meaning of any opcode changes
+#define SOLIS_BYTECODE_VERSION 1
+
+/*
+	Hashes a source string so a cache can tell if it was written from the same source
+*/
+uint64_t solisHashSource(const char* source);
+
+/*
+	Writes the compiled script of a module to path.
+	globalBase is how many globals the module had before the script was compiled, those are checked again on load.
+	Returns false if the file can't be written or a constant can't be stored.
+*/
+bool solisWriteBytecodeFile(VM* vm, ObjModule* mdl, int globalBase, uint64_t sourceHash, const char* path);
+
+/*
+	Loads a bytecode file into a module and sets its closure, ready to be run.
+	If checkHash is set the file must have been written from a source with sourceHash.
+	Returns false if the file is missing, stale, malformed or the module's globals don't line up with it,
+	the module is left as it was in that case.
+*/
+bool solisReadBytecodeFile(VM* vm, ObjModule* mdl, const char* path, bool checkHash, uint64_t sourceHash);
+
+#endif // SOLIS_CACHE_H
@@ -11,6 +11,8 @@ SOLIS_DEFINE_BUFFER(Value, Value);
 
 SOLIS_DEFINE_BUFFER(Int, int);
 
+SOLIS_DEFINE_BUFFER(InlineCache, InlineCache);
+
 
 static int simpleInstruction(const char* name, int offset) {
 	printf("%s\n", name);
@@ -84,6 +86,61 @@ static int jumpInstruction(const char* name, int sign,
 	return offset + 3;
 }
 
+static int cachedInstruction(const char* name, Chunk* chunk, int offset) {
+	uint16_t constant = (uint16_t)(chunk->code[offset + 1] << 8);
+	constant |= chunk->code[offset + 2];
+
+	uint16_t cache = (uint16_t)(chunk->code[offset + 3] << 8);
+	cache |= chunk->code[offset + 4];
+
+	printf("%-16s %4d '", name, constant);
+	solisPrintValue(chunk->constants.data[constant]);
+	printf("' cache %d\n", cache);
+
+	return offset + 5;
+}
+
+static int rangeInstruction(const char* name, int sign, Chunk* chunk, int offset) {
+	uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8);
+	slot |= chunk->code[offset + 2];
+
+	uint16_t jump = (uint16_t)(chunk->code[offset + 3] << 8);
+	jump |= chunk->code[offset + 4];
+
+	printf("%-16s %4d %4d -> %d\n", name, slot, offset,
+		offset + 5 + sign * jump);
+	return offset + 5;
+}
+
+static int forInstruction(const char* name, Chunk* chunk, int offset, int length) {
+	uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8);
+	slot |= chunk->code[offset + 2];
+
+	uint16_t body = (uint16_t)(chunk->code[offset + 3] << 8);
+	body |= chunk->code[offset + 4];
+
+	uint16_t exit = (uint16_t)(chunk->code[offset + 5] << 8);
+	exit |= chunk->code[offset + 6];
+
+	printf("%-16s %4d body -> %d exit -> %d\n", name, slot,
+		offset + length + body, offset + length + exit);
+	return offset + length;
+}
+
+static int localConstantInstruction(const char* name, Chunk* chunk, int offset) {
+	uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8);
+	slot |= chunk->code[offset + 2];
+
+	uint16_t constant = (uint16_t)(chunk->code[offset + 3] << 8);
+	constant |= chunk->code[offset + 4];
+
+	printf("%-16s %4d '", name, slot);
+	solisPrintValue(chunk->constants.data[constant]);
+	printf("'\n");
+
+	return offset + 5;
+}
+
 static int invokeInstruction(const char* name, Chunk* chunk,
 	int offset) {
 	uint8_t upper = chunk->code[offset + 1];
@@ -92,10 +149,14 @@ static int invokeInstruction(const char* name, Chunk* chunk,
 	uint16_t constant = upper << 8;
 	constant |= lower;
 	uint8_t argCount = chunk->code[offset + 3];
+
+	uint16_t cache = (uint16_t)(chunk->code[offset + 4] << 8);
+	cache |= chunk->code[offset + 5];
+
 	printf("%-16s (%d args) %4d '", name, argCount, constant);
 	solisPrintValue(chunk->constants.data[constant]);
-	printf("'\n");
-	return offset + 4;
+	printf("' cache %d\n", cache);
+	return offset + 6;
 }
 
 void solisInitChunk(VM* vm, Chunk* chunk)
@@ -107,14 +168,17 @@ void solisInitChunk(VM* vm, Chunk* chunk)
 
 	solisIntBufferInit(vm, &chunk->lines);
 	chunk->lastLine = 0;
+
+	solisInlineCacheBufferInit(vm, &chunk->caches);
 }
 
 void solisFreeChunk(VM* vm, Chunk* chunk)
 {
 	solisReallocate(vm, chunk->code, sizeof(uint8_t) * chunk->capacity, 0);
-	solisInitChunk(vm, chunk);
 	solisValueBufferClear(vm, &chunk->constants);
 	solisIntBufferClear(vm, &chunk->lines);
+	solisInlineCacheBufferClear(vm, &chunk->caches);
+	solisInitChunk(vm, chunk);
 }
 
 
@@ -143,6 +207,78 @@ int solisAddConstant(VM* vm, Chunk* chunk, Value value)
 	return chunk->constants.count - 1;
 }
 
+int solisAddInlineCache(VM* vm, Chunk* chunk)
+{
+	InlineCache cache;
+	memset(&cache, 0, sizeof(InlineCache));
+
+	solisInlineCacheBufferWrite(vm, &chunk->caches, cache);
+	return chunk->caches.count - 1;
+}
+
+int solisInstructionLength(Chunk* chunk, int offset)
+{
+	switch (chunk->code[offset])
+	{
+	case OP_CONSTANT:
+	case OP_CONCAT:
+		return 2;
+
+	case OP_CONSTANT_LONG:
+	case OP_SET_GLOBAL:
+	case OP_GET_GLOBAL:
+	case OP_SET_LOCAL:
+	case OP_GET_LOCAL:
+	case OP_JUMP_IF_FALSE:
+	case OP_JUMP:
+	case OP_LOOP:
+	case OP_GET_UPVALUE:
+	case OP_SET_UPVALUE:
+	case OP_IS:
+	case OP_CLASS:
+	case OP_DEFINE_STATIC:
+	case OP_DEFINE_FIELD:
+	case OP_DEFINE_METHOD:
+	case OP_DEFINE_CONSTRUCTOR:
+	case OP_JUMP_IF_FALSE_POP:
+		return 3;
+
+	case OP_RANGE_LOOP:
+	case OP_RANGE_NEXT:
+	case OP_GET_FIELD:
+	case OP_SET_FIELD:
+	case OP_ADD_LOCALS:
+	case OP_ADD_LOCAL_CONST:
+	case OP_SUBTRACT_LOCAL_CONST:
+	case OP_INCREMENT_LOCAL:
+		return 5;
+
+	case OP_INVOKE:
+		return 6;
+
+	case OP_LESS_LOCAL_CONST_JUMP:
+		return 7;
+
+	case OP_FOR_NEXT:
+		return SOLIS_FOR_NEXT_LENGTH;
+
+	case OP_FOR_ITER:
+		return 11;
+
+	case OP_CLOSURE:
+	{
+		uint16_t constant = (uint16_t)(chunk->code[offset + 1] << 8);
+		constant |= chunk->code[offset + 2];
+
+		// Each upvalue is stored as an isLocal and index byte pair
+		ObjFunction* function = SOLIS_AS_FUNCTION(chunk->constants.data[constant]);
+		return 3 + function->upvalueCount * 2;
+	}
+
+	default:
+		return 1;
+	}
+}
 
 void solisDisassembleChunk(Chunk* chunk, const char* name)
 {
@@ -205,6 +341,14 @@ int solisDisassembleInstruction(Chunk* chunk, int offset)
 		return jumpInstruction("OP_JUMP_IF_FALSE", 1, chunk, offset);
 	case OP_LOOP:
 		return jumpInstruction("OP_LOOP", -1, chunk, offset);
+	case OP_RANGE_LOOP:
+		return rangeInstruction("OP_RANGE_LOOP", 1, chunk, offset);
+	case OP_RANGE_NEXT:
+		return rangeInstruction("OP_RANGE_NEXT", -1, chunk, offset);
+	case OP_FOR_ITER:
+		return forInstruction("OP_FOR_ITER", chunk, offset, 11);
+	case OP_FOR_NEXT:
+		return forInstruction("OP_FOR_NEXT", chunk, offset, SOLIS_FOR_NEXT_LENGTH);
 	case OP_CALL_0:
 		return simpleInstruction("OP_CALL_0", offset);
 	case OP_CALL_1:
@@ -259,15 +403,15 @@ int solisDisassembleInstruction(Chunk* chunk, int offset)
 		return offset;
 	}
 	case OP_GET_UPVALUE:
-		return byteInstruction("OP_GET_UPVALUE", chunk, offset);
+		return shortInstruction("OP_GET_UPVALUE", chunk, offset);
 	case OP_SET_UPVALUE:
-		return byteInstruction("OP_SET_UPVALUE", chunk, offset);
+		return shortInstruction("OP_SET_UPVALUE", chunk, offset);
 	case OP_CLOSE_UPVALUE:
 		return simpleInstruction("OP_CLOSE_UPVALUE", offset);
 	case OP_GET_FIELD:
-		return constantInstructionLong("OP_GET_FIELD", chunk, offset);
+		return cachedInstruction("OP_GET_FIELD", chunk, offset);
 	case OP_SET_FIELD:
-		return constantInstructionLong("OP_SET_FIELD", chunk, offset);
+		return cachedInstruction("OP_SET_FIELD", chunk, offset);
 	case OP_CLASS:
 		return constantInstructionLong("OP_CLASS", chunk, offset);
 	case OP_DEFINE_STATIC:
@@ -284,8 +428,178 @@ int solisDisassembleInstruction(Chunk* chunk, int offset)
 		return simpleInstruction("OP_CREATE_LIST", offset);
 	case OP_APPEND_LIST:
 		return simpleInstruction("OP_APPEND_LIST", offset);
+	case OP_CREATE_DICTIONARY:
+		return simpleInstruction("OP_CREATE_DICTIONARY", offset);
+	case OP_INSERT_DICTIONARY:
+		return simpleInstruction("OP_INSERT_DICTIONARY", offset);
+	case OP_JUMP_IF_FALSE_POP:
+		return jumpInstruction("OP_JUMP_IF_FALSE_POP", 1, chunk, offset);
+	case OP_LESS_EQUAL:
+		return simpleInstruction("OP_LESS_EQUAL", offset);
+	case OP_GREATER_EQUAL:
+		return simpleInstruction("OP_GREATER_EQUAL", offset);
+	case OP_ADD_LOCALS:
+	{
+		uint16_t a = (uint16_t)(chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+		uint16_t b = (uint16_t)(chunk->code[offset + 3] << 8) | chunk->code[offset + 4];
+		printf("%-16s %4d %4d\n", "OP_ADD_LOCALS", a, b);
+		return offset + 5;
+	}
+	case OP_ADD_LOCAL_CONST:
+		return localConstantInstruction("OP_ADD_LOCAL_CONST", chunk, offset);
+	case OP_SUBTRACT_LOCAL_CONST:
+		return localConstantInstruction("OP_SUBTRACT_LOCAL_CONST", chunk, offset);
+	case OP_INCREMENT_LOCAL:
+		return localConstantInstruction("OP_INCREMENT_LOCAL", chunk, offset);
+	case OP_LESS_LOCAL_CONST_JUMP:
+	{
+		uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+		uint16_t constant = (uint16_t)(chunk->code[offset + 3] << 8) | chunk->code[offset + 4];
+		uint16_t jump = (uint16_t)(chunk->code[offset + 5] << 8) | chunk->code[offset + 6];
+		printf("%-16s %4d '", "OP_LESS_LOCAL_CONST_JUMP", slot);
+		solisPrintValue(chunk->constants.data[constant]);
+		printf("' -> %d\n", offset + 7 + jump);
+		return offset + 7;
+	}
+	case OP_CONCAT:
+		return byteInstruction("OP_CONCAT", chunk, offset);
 	default:
 		printf("Unknown opcode %d\n", instruction);
 		return offset + 1;
 	}
-}
\ No newline at end of file
+}
+static inline uint16_t registerShort(Chunk* chunk, int offset)
+{
+	return (uint16_t)((chunk->code[offset] << 8) | chunk->code[offset + 1]);
+}
+
+static int registerConstantInstruction(const char* name, Chunk* chunk, ValueBuffer* constants, int offset, int registers) 
+{
+	printf("%-24s", name);
+
+	for (int i = 0; i < registers; i++)
+		printf(" r%-3d", chunk->code[offset + 1 + i]);
+
+	uint16_t constant = registerShort(chunk, offset + 1 + registers);
+	printf(" k%d '", constant);
+	solisPrintValue(constants->data[constant]);
+	printf("'\n");
+
+	return offset + 3 + registers;
+}
+
+static int registerInstruction(const char* name, Chunk* chunk, int offset, int registers)
+{
+	printf("%-24s", name);
+
+	for (int i = 0; i < registers; i++)
+		printf(" r%-3d", chunk->code[offset + 1 + i]);
+
+	printf("\n");
+
+	return offset + 1 + registers;
+}
+
+static int registerJumpInstruction(const char* name, int sign, Chunk* chunk, int offset, int registers)
+{
+	printf("%-24s", name);
+
+	for (int i = 0; i < registers; i++)
+		printf(" r%-3d", chunk->code[offset + 1 + i]);
+
+	int next = offset + 3 + registers;
+	printf(" -> %d\n", next + sign * registerShort(chunk, offset + 1 + registers));
+
+	return next;
+}
+
+void solisDisassembleRegisterChunk(Chunk* chunk, ValueBuffer* constants, const char* name)
+{
+	printf("== %s (registers) ==\n", name);
+
+	for (int offset = 0; offset < chunk->count;) {
+		offset = solisDisassembleRegisterInstruction(chunk, constants, offset);
+	}
+}
+
+int solisDisassembleRegisterInstruction(Chunk* chunk, ValueBuffer* constants, int offset)
+{
+	printf("%06d ", offset);
+
+	uint8_t instruction = chunk->code[offset];
+	switch (instruction) {
+	case ROP_MOVE:
+		return registerInstruction("ROP_MOVE", chunk, offset, 2);
+	case ROP_LOAD_CONSTANT:
+		return registerConstantInstruction("ROP_LOAD_CONSTANT", chunk, constants, offset, 1);
+	case ROP_LOAD_NULL:
+		return registerInstruction("ROP_LOAD_NULL", chunk, offset, 1);
+	case ROP_LOAD_TRUE:
+		return registerInstruction("ROP_LOAD_TRUE", chunk, offset, 1);
+	case ROP_LOAD_FALSE:
+		return registerInstruction("ROP_LOAD_FALSE", chunk, offset, 1);
+	case ROP_GET_GLOBAL:
+	case ROP_SET_GLOBAL:
+		printf("%-24s r%-3d g%d\n", instruction == ROP_GET_GLOBAL ? "ROP_GET_GLOBAL" : "ROP_SET_GLOBAL", 
+			chunk->code[offset + 1], registerShort(chunk, offset + 2));
+		return offset + 4;
+	case ROP_ADD:
+		return registerInstruction("ROP_ADD", chunk, offset, 3);
+	case ROP_SUBTRACT:
+		return registerInstruction("ROP_SUBTRACT", chunk, offset, 3);
+	case ROP_MULTIPLY:
+		return registerInstruction("ROP_MULTIPLY", chunk, offset, 3);
+	case ROP_DIVIDE:
+		return registerInstruction("ROP_DIVIDE", chunk, offset, 3);
+	case ROP_FLOOR_DIVIDE:
+		return registerInstruction("ROP_FLOOR_DIVIDE", chunk, offset, 3);
+	case ROP_POWER:
+		return registerInstruction("ROP_POWER", chunk, offset, 3);
+	case ROP_ADD_CONSTANT:
+		return registerConstantInstruction("ROP_ADD_CONSTANT", chunk, constants, offset, 2);
+	case ROP_SUBTRACT_CONSTANT:
+		return registerConstantInstruction("ROP_SUBTRACT_CONSTANT", chunk, constants, offset, 2);
+	case ROP_EQUAL:
+		return registerInstruction("ROP_EQUAL", chunk, offset, 3);
+	case ROP_NOT_EQUAL:
+		return registerInstruction("ROP_NOT_EQUAL", chunk, offset, 3);
+	case ROP_LESS:
+		return registerInstruction("ROP_LESS", chunk, offset, 3);
+	case ROP_LESS_EQUAL:
+		return registerInstruction("ROP_LESS_EQUAL", chunk, offset, 3);
+	case ROP_GREATER:
+		return registerInstruction("ROP_GREATER", chunk, offset, 3);
+	case ROP_GREATER_EQUAL:
+		return registerInstruction("ROP_GREATER_EQUAL", chunk, offset, 3);
+	case ROP_NEGATE:
+		return registerInstruction("ROP_NEGATE", chunk, offset, 2);
+	case ROP_NOT:
+		return registerInstruction("ROP_NOT", chunk, offset, 2);
+	case ROP_JUMP:
+		return registerJumpInstruction("ROP_JUMP", 1, chunk, offset, 0);
+	case ROP_LOOP:
+		return registerJumpInstruction("ROP_LOOP", -1, chunk, offset, 0);
+	case ROP_JUMP_IF_FALSE:
+		return registerJumpInstruction("ROP_JUMP_IF_FALSE", 1, chunk, offset, 1);
+	case ROP_JUMP_IF_TRUE:
+		return registerJumpInstruction("ROP_JUMP_IF_TRUE", 1, chunk, offset, 1);
+	case ROP_JUMP_IF_NOT_LESS:
+		return registerJumpInstruction("ROP_JUMP_IF_NOT_LESS", 1, chunk, offset, 2);
+	case ROP_JUMP_IF_NOT_LESS_EQUAL:
+		return registerJumpInstruction("ROP_JUMP_IF_NOT_LESS_EQUAL", 1, chunk, offset, 2);
+	case ROP_JUMP_IF_NOT_GREATER:
+		return registerJumpInstruction("ROP_JUMP_IF_NOT_GREATER", 1, chunk, offset, 2);
+	case ROP_JUMP_IF_NOT_GREATER_EQUAL:
+		return registerJumpInstruction("ROP_JUMP_IF_NOT_GREATER_EQUAL", 1, chunk, offset, 2);
+	case ROP_CALL:
+		printf("%-24s r%-3d %d args\n", "ROP_CALL", chunk->code[offset + 1], chunk->code[offset + 2]);
+		return offset + 3;
+	case ROP_RETURN:
+		return registerInstruction("ROP_RETURN", chunk, offset, 1);
+	case ROP_RETURN_NULL:
+		return registerInstruction("ROP_RETURN_NULL", chunk, offset, 0);
+	default:
+		printf("Unknown register opcode %d\n", instruction);
+		return offset + 1;
+	}
+}
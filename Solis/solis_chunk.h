@@ -13,11 +13,66 @@ typedef enum  {
 
 } OpCode;
 
+/*
+	Three address instructions used by functions compiled for register mode. 
+	Operands are frame slots, slot 0 is the callee and the parameters follow it like on the stack. 
+*/
+typedef enum {
+
+#define OPCODE(code) ROP_##code,
+#include "solis_register_opcode.h"
+#undef OPCODE 
+
+} RegisterOpCode;
+
 
 SOLIS_DECLARE_BUFFER(Value, Value);
 
 SOLIS_DECLARE_BUFFER(Int, int);
 
+// Number of receiver classes a single call site remembers before it stops caching new ones
+#define SOLIS_INLINE_CACHE_SIZE 4
+
+typedef enum
+{
+	CACHE_FIELD,
+	CACHE_METHOD,
+	CACHE_STATIC
+} InlineCacheKind;
+
+/*
+	One resolved lookup for a receiver class at a call site. 
+	Only valid while the class version matches, the version is bumped when the class layout changes. 
+*/
+typedef struct
+{
+	ObjClass* klass;
+	uint32_t version;
+
+	// Set when the receiver was the class itself rather than an instance of it
+	bool isStatic;
+
+	InlineCacheKind kind;
+
+	// The field slot for CACHE_FIELD entries, the slot in the class's statics table for CACHE_STATIC entries
+	int slot;
+
+	// The method for CACHE_METHOD entries
+	Value value;
+} InlineCacheEntry;
+
+/*
+	Per call site cache used by OP_GET_FIELD, OP_SET_FIELD and OP_INVOKE. 
+	The instruction stores the index of its cache in the bytecode after the name constant. 
+*/
+typedef struct
+{
+	InlineCacheEntry entries[SOLIS_INLINE_CACHE_SIZE];
+	int count;
+} InlineCache;
+
+SOLIS_DECLARE_BUFFER(InlineCache, InlineCache);
+
 struct Chunk
 {
 	uint8_t* code;
@@ -31,6 +86,8 @@ struct Chunk
 	int lastLine;
 
 	ValueBuffer constants;
+
+	InlineCacheBuffer caches;
 };
 
 void solisInitChunk(VM* vm, Chunk* chunk);
@@ -41,8 +98,27 @@ void solisWriteChunk(VM* vm, Chunk* chunk, uint8_t byte, int line);
 
 int solisAddConstant(VM* vm, Chunk* chunk, Value value);
 
+/*
+	Adds an empty inline cache to the chunk and returns its index
+*/
+int solisAddInlineCache(VM* vm, Chunk* chunk);
+
+
+/*
+	Returns the size in bytes of the instruction at offset including its operands
+*/
+int solisInstructionLength(Chunk* chunk, int offset);
+
+// OP_FOR_ITER skips over the OP_FOR_NEXT that follows it when it doesn't call next
+#define SOLIS_FOR_NEXT_LENGTH 7
 
 void solisDisassembleChunk(Chunk* chunk, const char* name);
 int solisDisassembleInstruction(Chunk* chunk, int offset);
 
+/*
+	Register chunks don't own their constants, they use the ones from the stack chunk of the same function
+*/
+void solisDisassembleRegisterChunk(Chunk* chunk, ValueBuffer* constants, const char* name);
+int solisDisassembleRegisterInstruction(Chunk* chunk, ValueBuffer* constants, int offset);
+
 #endif // SOLIS_CHUNK_H
\ No newline at end of file
@@ -10,33 +10,19 @@
 void* solisReallocate(VM* vm, void* ptr, size_t oldSize, size_t newSize)
 {
 
-    vm->allocatedBytes += newSize - oldSize;
-
-
-
     if (newSize > oldSize)
     {
 #ifdef SOLIS_DEBUG_STRESS_GC
-        solisCollectGarbage(vm);
+        solisCollectFull(vm);
 #endif
 
-        // see if we need to run the gc
-        if (vm->allocatedBytes > vm->nextGC)
-        {
-            solisCollectGarbage(vm);
-        }
+        // Starts a collection cycle or does some of the running one
+        solisCheckGarbage(vm, newSize - oldSize);
     }
 
+    vm->allocatedBytes += newSize - oldSize;
 
-
-    if (newSize == 0) {
-        SOLIS_FREE_FUNC(ptr);
-        return NULL;
-    }
-
-    void* result = SOLIS_REALLOC_FUNC(ptr, newSize);
-
-    if (result == NULL) exit(1);
+    void* result = solisRawReallocate(vm, ptr, newSize);
 
 
     // printf("Allocated bytes: %d\n", vm->allocatedBytes);
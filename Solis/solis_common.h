@@ -47,6 +47,12 @@ typedef struct ObjUserdata ObjUserdata;
 
 typedef struct ObjModule ObjModule;
 typedef struct ObjDictionary ObjDictionary;
+typedef struct ObjWeakRef ObjWeakRef;
+typedef struct ObjWeakTable ObjWeakTable;
+typedef struct ObjTypedArray ObjTypedArray;
+typedef struct ObjVector ObjVector;
+typedef struct ObjMatrix ObjMatrix;
+typedef struct ObjStringBuilder ObjStringBuilder;
 
 typedef enum
 {
@@ -71,9 +77,27 @@ typedef enum
     OBJ_BOUND_METHOD, 
     OBJ_LIST,
     OBJ_MODULE,
-    OBJ_DICTIONARY
+    OBJ_DICTIONARY,
+    OBJ_WEAK_REF,
+    OBJ_WEAK_TABLE,
+    OBJ_TYPED_ARRAY,
+    OBJ_VECTOR,
+    OBJ_MATRIX,
+    OBJ_STRING_BUILDER,
+
+    OBJ_TYPE_COUNT
 } ObjectType;
 
+// Element types of the typed arrays, each has its own class
+typedef enum
+{
+    SOLIS_ARRAY_FLOAT64,
+    SOLIS_ARRAY_FLOAT32,
+    SOLIS_ARRAY_INT32,
+
+    SOLIS_ARRAY_KIND_COUNT
+} SolisArrayKind;
+
 typedef enum
 {
     OPERATOR_ADD,
@@ -90,6 +114,7 @@ typedef enum
 } Operators;
 
 
+// The default allocator is built on these, a VM can be given its own with SolisVMConfig
 #ifndef SOLIS_REALLOC_FUNC
 #define SOLIS_REALLOC_FUNC(ptr, newSize) realloc(ptr, newSize)
 #endif
@@ -98,6 +123,17 @@ typedef enum
 #define SOLIS_FREE_FUNC(ptr) free(ptr)
 #endif
 
+// Used for the nursery blocks, which are aligned to their size
+#ifndef SOLIS_ALIGNED_ALLOC_FUNC
+#if defined(_MSC_VER)
+#define SOLIS_ALIGNED_ALLOC_FUNC(alignment, size) _aligned_malloc(size, alignment)
+#define SOLIS_ALIGNED_FREE_FUNC(ptr) _aligned_free(ptr)
+#else
+#define SOLIS_ALIGNED_ALLOC_FUNC(alignment, size) aligned_alloc(alignment, size)
+#define SOLIS_ALIGNED_FREE_FUNC(ptr) free(ptr)
+#endif
+#endif
+
 void* solisReallocate(VM* vm, void* ptr, size_t oldSize, size_t newSize);
 
 
@@ -1,5 +1,3 @@
-
-
 #include "solis_compiler.h"
 
 #include "solis_scanner.h"
@@ -9,9 +7,11 @@
 #include "solis_hashtable.h"
 
 #include <string.h>
+#include <math.h>
 
 #include "solis_object.h"
 #include "solis_chunk.h"
+#include "solis_peephole.h"
 
 #include "solis_gc.h"
 
@@ -88,6 +88,7 @@ static void returnStatement();
 
 static void arrayCreate(bool canAssign);
 static void arrayAssign(bool canAssign);
+static void dictionaryCreate(bool canAssign);
 
 
 static void function(FunctionType type);
@@ -113,11 +114,12 @@ static ParseRule* getRule(SolisTokenType type);
 ParseRule rules[] = {
   [TOKEN_LEFT_PAREN] = {grouping, call,   PREC_CALL},
   [TOKEN_RIGHT_PAREN] = {NULL,     NULL,   PREC_NONE},
-  [TOKEN_LEFT_BRACE] = {NULL,     NULL,   PREC_NONE},
+  [TOKEN_LEFT_BRACE] = {dictionaryCreate,     NULL,   PREC_NONE},
   [TOKEN_RIGHT_BRACE] = {NULL,     NULL,   PREC_NONE},
   [TOKEN_LEFT_BRACKET] = {arrayCreate,     arrayAssign,   PREC_SUBSCRIPT},
   [TOKEN_RIGHT_BRACKET] = {NULL,     NULL,   PREC_NONE},
   [TOKEN_COMMA] = {NULL,     NULL,   PREC_NONE},
+  [TOKEN_COLON] = {NULL,     NULL,   PREC_NONE},
   [TOKEN_DOT] = {NULL,     dot,   PREC_CALL},
   [TOKEN_MINUS] = {unary,    binary, PREC_TERM},
   [TOKEN_PLUS] = {NULL,     binary, PREC_TERM},
@@ -394,6 +396,19 @@ typedef struct
 } Local;
 
 
+#define MAX_CONSTANT_LOADS 8
+
+// An instruction that pushes a value known at compile time
+typedef struct
+{
+	int start;
+	int end;
+	Value value;
+
+	// Index in the constant table if this load added a new constant, otherwise -1
+	int constant;
+} ConstantLoad;
+
 struct sCompiler 
 {
 	struct sCompiler* parent;
@@ -418,6 +433,20 @@ struct sCompiler
 	IntBuffer breakStatements;
 	bool withinLoop;
 
+	// Locals below this index outlive the innermost loop, a break pops everything above it
+	int loopLocalCount;
+
+	// Offset of the last OP_DOTDOT emitted so a for loop can tell if it is iterating a range literal
+	int lastRangeOffset;
+
+	// Where the left operand of the infix rule being compiled begins
+	int infixLeftStart;
+
+	// The most recent constant loads so operators on them can be folded
+	// Operands are only folded when their loads run right up to the end of the chunk
+	ConstantLoad constantLoads[MAX_CONSTANT_LOADS];
+	int constantLoadCount;
+
 	ObjFunction* function;
 	FunctionType type;
 
@@ -450,6 +479,17 @@ static void emitShort(uint16_t s)
 	emitBytes((s >> 8) & 0xFF, s & 0xFF);
 }
 
+// Reserves an inline cache in the current chunk and writes its index into the bytecode
+static void emitInlineCache()
+{
+	int cache = solisAddInlineCache(current->vm, currentChunk());
+
+	if (cache > UINT16_MAX)
+		error("Too many field accesses and method calls in one function.");
+
+	emitShort((uint16_t)cache);
+}
+
 static void emitReturn() {
 
 	if (current->type == TYPE_CONSTRUCTOR)
@@ -475,6 +515,10 @@ static void initCompiler(VM* vm, Compiler* compiler, FunctionType type, ObjModul
 	compiler->vm = vm;
 	//compiler->globalCount = 0;
 	compiler->withinLoop = false;
+	compiler->loopLocalCount = 0;
+	compiler->lastRangeOffset = -1;
+	compiler->infixLeftStart = 0;
+	compiler->constantLoadCount = 0;
 
 	compiler->parent = current;
 
@@ -515,12 +559,18 @@ static ObjFunction* endCompiler(Compiler* compiler)
 {
 	emitReturn();
 
+	if (!parser.hadError)
+		solisPeepholeOptimize(compiler->vm, currentChunk());
+
 	// solisFreeHashTable(&compiler->globalTable);
 	// solisUpvalueBufferClear(&compiler->upvalues);
 	solisIntBufferClear(compiler->vm, &compiler->breakStatements);
 
 	ObjFunction* function = current->function;
 
+	// Once it stops being a root any writes since the last collection have to be traced
+	solisRememberObject(compiler->vm, (Object*)function);
+
 	current = compiler->parent;
 	return function;
 }
@@ -557,17 +607,181 @@ static uint16_t makeConstant(Value value) {
 	return (uint16_t)constant;
 }
 
+static void recordConstantLoad(int start, Value value, int constant)
+{
+	// Forget the oldest load once full, it is too far back to be folded
+	if (current->constantLoadCount == MAX_CONSTANT_LOADS)
+	{
+		memmove(&current->constantLoads[0], &current->constantLoads[1], sizeof(ConstantLoad) * (MAX_CONSTANT_LOADS - 1));
+		current->constantLoadCount--;
+	}
+
+	ConstantLoad* load = &current->constantLoads[current->constantLoadCount++];
+	load->start = start;
+	load->end = currentChunk()->count;
+	load->value = value;
+	load->constant = constant;
+}
+
 static void emitConstant(Value value) {
 
+	int start = currentChunk()->count;
+	int constantCount = currentChunk()->constants.count;
+
 	uint16_t constant = makeConstant(value);
 
 	if (constant > 0xff)
 	{
 		emitByte(OP_CONSTANT_LONG);
 		emitShort(constant);
+	}
+	else
+		emitBytes(OP_CONSTANT, (uint8_t)constant);
+
+	recordConstantLoad(start, value, currentChunk()->constants.count > constantCount ? constant : -1);
+}
+
+// Pushes a value known at compile time, true, false and null have their own opcodes
+static void emitValue(Value value)
+{
+	int start = currentChunk()->count;
+
+	if (SOLIS_IS_NULL(value))
+		emitByte(OP_NIL);
+	else if (SOLIS_IS_BOOL(value))
+		emitByte(SOLIS_AS_BOOL(value) ? OP_TRUE : OP_FALSE);
+	else
+	{
+		emitConstant(value);
 		return;
 	}
-	emitBytes(OP_CONSTANT, (uint8_t)constant);
+
+	recordConstantLoad(start, value, -1);
+}
+
+// Removes everything emitted from offset onwards
+static void truncateChunk(int offset)
+{
+	currentChunk()->count = offset;
+	currentChunk()->lines.count = offset;
+
+	while (current->constantLoadCount > 0 && current->constantLoads[current->constantLoadCount - 1].end > offset)
+		current->constantLoadCount--;
+
+	current->lastRangeOffset = -1;
+}
+
+// Finds the constant load that makes up all of the code from start to end
+static ConstantLoad* constantLoadBetween(int start, int end)
+{
+	for (int i = current->constantLoadCount - 1; i >= 0; i--)
+	{
+		ConstantLoad* load = &current->constantLoads[i];
+
+		if (load->start == start && load->end == end)
+			return load;
+	}
+
+	return NULL;
+}
+
+// Finds the constant load that makes up all of the code from start to the end of the chunk
+static ConstantLoad* constantLoadFrom(int start)
+{
+	return constantLoadBetween(start, currentChunk()->count);
+}
+
+static bool isStringLoad(ConstantLoad* load)
+{
+	return load != NULL && SOLIS_IS_STRING(load->value);
+}
+
+// Removes the last count constant loads from the chunk
+static void dropConstantLoads(int count)
+{
+	int start = current->constantLoads[current->constantLoadCount - count].start;
+
+	// Constants the loads added can go as long as nothing was added after them
+	for (int i = current->constantLoadCount - 1; i >= current->constantLoadCount - count; i--)
+	{
+		int constant = current->constantLoads[i].constant;
+
+		if (constant >= 0 && constant == currentChunk()->constants.count - 1)
+			currentChunk()->constants.count--;
+	}
+
+	truncateChunk(start);
+}
+
+// Replaces the last count constant loads with a single value
+static void replaceConstantLoads(int count, Value value)
+{
+	dropConstantLoads(count);
+	emitValue(value);
+}
+
+// Works out a binary operator on two constants, returns false if it has to be left to the runtime
+static bool evaluateBinary(SolisTokenType operatorType, Value a, Value b, Value* result)
+{
+	if (SOLIS_IS_NUMERIC(a) && SOLIS_IS_NUMERIC(b))
+	{
+		double x = SOLIS_AS_NUMBER(a);
+		double y = SOLIS_AS_NUMBER(b);
+
+		switch (operatorType)
+		{
+		case TOKEN_PLUS:		*result = SOLIS_NUMERIC_VALUE(x + y); return true;
+		case TOKEN_MINUS:		*result = SOLIS_NUMERIC_VALUE(x - y); return true;
+		case TOKEN_STAR:		*result = SOLIS_NUMERIC_VALUE(x * y); return true;
+		case TOKEN_SLASH:		*result = SOLIS_NUMERIC_VALUE(x / y); return true;
+		case TOKEN_STAR_STAR:	*result = SOLIS_NUMERIC_VALUE(pow(x, y)); return true;
+		case TOKEN_SLASH_SLASH:	*result = SOLIS_NUMERIC_VALUE(floor(x / y)); return true;
+		case TOKEN_GT:			*result = SOLIS_BOOL_VALUE(x > y); return true;
+		case TOKEN_GTEQ:		*result = SOLIS_BOOL_VALUE(!(x < y)); return true;
+		case TOKEN_LT:			*result = SOLIS_BOOL_VALUE(x < y); return true;
+		case TOKEN_LTEQ:		*result = SOLIS_BOOL_VALUE(!(x > y)); return true;
+		default: break;
+		}
+	}
+
+	bool aString = SOLIS_IS_STRING(a);
+	bool bString = SOLIS_IS_STRING(b);
+
+	if (aString && bString && operatorType == TOKEN_PLUS)
+	{
+		*result = SOLIS_OBJECT_VALUE(solisConcatenateStrings(current->vm, SOLIS_AS_STRING(a), SOLIS_AS_STRING(b)));
+		return true;
+	}
+
+	// Same argument order as OP_EQUAL, which can't compare a string against anything else
+	if ((operatorType == TOKEN_EQEQ || operatorType == TOKEN_BANGEQ) && aString == bString)
+	{
+		bool equal = solisValuesEqual(b, a);
+		*result = SOLIS_BOOL_VALUE(operatorType == TOKEN_EQEQ ? equal : !equal);
+		return true;
+	}
+
+	return false;
+}
+
+// Folds a binary operator whose operands are both constant loads, rightStart is where the right operand begins
+static bool foldBinary(SolisTokenType operatorType, int rightStart)
+{
+	if (current->constantLoadCount < 2)
+		return false;
+
+	ConstantLoad* left = &current->constantLoads[current->constantLoadCount - 2];
+	ConstantLoad* right = &current->constantLoads[current->constantLoadCount - 1];
+
+	if (right != constantLoadFrom(rightStart) || left->end != rightStart)
+		return false;
+
+	Value result;
+	if (!evaluateBinary(operatorType, left->value, right->value, &result))
+		return false;
+
+	replaceConstantLoads(2, result);
+	return true;
 }
 
 static void beginScope() 
@@ -605,9 +819,28 @@ static void number(bool canAssign) {
 static void unary(bool canAssign) {
 	SolisTokenType operatorType = parser.previous.type;
 
+	int operandStart = currentChunk()->count;
+
 	// Compile the operand.
 	parsePrecedence(PREC_UNARY);
 
+	ConstantLoad* operand = constantLoadFrom(operandStart);
+
+	if (operand != NULL)
+	{
+		if (operatorType == TOKEN_MINUS && SOLIS_IS_NUMERIC(operand->value))
+		{
+			replaceConstantLoads(1, SOLIS_NUMERIC_VALUE(-SOLIS_AS_NUMBER(operand->value)));
+			return;
+		}
+
+		if (operatorType == TOKEN_BANG)
+		{
+			replaceConstantLoads(1, SOLIS_BOOL_VALUE(solisIsFalsy(operand->value)));
+			return;
+		}
+	}
+
 	// Emit the operator instruction.
 	switch (operatorType) {
 	case TOKEN_MINUS: emitByte(OP_NEGATE); break;
@@ -616,23 +849,101 @@ static void unary(bool canAssign) {
 	}
 }
 
+// Compiles a chain like a + b + c whose first two operands have been compiled, rightStart is where the second begins
+// Each operand is added as soon as it is pushed, so the order operands run and errors are raised in is the pairwise one
+// Once a string literal has been added the result can only be a string or a number, neither of which can fail to add
+// The rest of the chain is then pushed first and joined by one OP_CONCAT in a single allocation
+static void additionChain(int leftStart, int rightStart)
+{
+	// Values waiting on the stack for the OP_CONCAT, zero while additions are emitted one at a time
+	int operandCount = 0;
+
+	ConstantLoad* left = constantLoadBetween(leftStart, rightStart);
+	bool stringOperand = isStringLoad(constantLoadFrom(rightStart));
+
+	if (foldBinary(TOKEN_PLUS, rightStart))
+		operandCount = isStringLoad(constantLoadFrom(leftStart)) ? 1 : 0;
+	else if (isStringLoad(left))
+		operandCount = 2;
+	else
+	{
+		emitByte(OP_ADD);
+		operandCount = stringOperand ? 1 : 0;
+	}
+
+	while (match(TOKEN_PLUS))
+	{
+		int operandStart = currentChunk()->count;
+
+		parsePrecedence((Precedence)(PREC_TERM + 1));
+
+		// Only the value at the start of the chain can be a constant to fold into
+		if (operandCount <= 1 && foldBinary(TOKEN_PLUS, operandStart))
+		{
+			if (operandCount == 0 && isStringLoad(constantLoadFrom(leftStart)))
+				operandCount = 1;
+
+			continue;
+		}
+
+		if (operandCount == 0)
+		{
+			stringOperand = isStringLoad(constantLoadFrom(operandStart));
+			emitByte(OP_ADD);
+
+			if (stringOperand)
+				operandCount = 1;
+
+			continue;
+		}
+
+		operandCount++;
+
+		// The count is a byte, a longer chain carries on from the result
+		if (operandCount == UINT8_MAX)
+		{
+			emitBytes(OP_CONCAT, UINT8_MAX);
+			operandCount = 1;
+		}
+	}
+
+	if (operandCount == 2)
+		emitByte(OP_ADD);
+	else if (operandCount > 2)
+		emitBytes(OP_CONCAT, (uint8_t)operandCount);
+}
+
 static void binary(bool canAssign)
 {
 
 	SolisTokenType operatorType = parser.previous.type;
 	ParseRule* rule = getRule(operatorType);
 
+	int leftStart = current->infixLeftStart;
+	int rightStart = currentChunk()->count;
+
 	parsePrecedence((Precedence)(rule->precedence + 1));
 
+	if (operatorType == TOKEN_PLUS)
+	{
+		additionChain(leftStart, rightStart);
+		return;
+	}
+
+	if (foldBinary(operatorType, rightStart))
+		return;
+
 	switch (operatorType) {
-	case TOKEN_PLUS:			emitByte(OP_ADD); break;
 	case TOKEN_MINUS:			emitByte(OP_SUBTRACT); break;
 	case TOKEN_STAR:			emitByte(OP_MULTIPLY); break;
 	case TOKEN_SLASH:			emitByte(OP_DIVIDE); break;
 	case TOKEN_STAR_STAR:		emitByte(OP_POWER); break;
 	case TOKEN_SLASH_SLASH:		emitByte(OP_FLOOR_DIVIDE); break;
 
-	case TOKEN_DOT_DOT:			emitByte(OP_DOTDOT); break;
+	case TOKEN_DOT_DOT:
+		current->lastRangeOffset = currentChunk()->count;
+		emitByte(OP_DOTDOT); 
+		break;
 
 	case TOKEN_EQEQ:			emitByte(OP_EQUAL); break;
 	case TOKEN_BANGEQ:			emitBytes(OP_EQUAL, OP_NOT); break;
@@ -646,9 +957,9 @@ static void binary(bool canAssign)
 
 static void literal(bool canAssign) {
 	switch (parser.previous.type) {
-	case TOKEN_FALSE: emitByte(OP_FALSE); break;
-	case TOKEN_NULL: emitByte(OP_NIL); break;
-	case TOKEN_TRUE: emitByte(OP_TRUE); break;
+	case TOKEN_FALSE: emitValue(SOLIS_BOOL_VALUE(false)); break;
+	case TOKEN_NULL: emitValue(SOLIS_NULL_VALUE()); break;
+	case TOKEN_TRUE: emitValue(SOLIS_BOOL_VALUE(true)); break;
 	default: return; // Unreachable.
 	}
 }
@@ -657,6 +968,8 @@ static void string(bool canAssign) {
 	emitConstant(SOLIS_OBJECT_VALUE(solisCopyString(current->vm, parser.previous.start + 1, parser.previous.length - 2)));
 }
 
+
+
 static void declaration()
 {
 	ignoreNewlines();
@@ -1042,10 +1355,11 @@ static int emitJump(uint8_t instruction)
 	return currentChunk()->count - 2;
 }
 
-static void patchJump(int offset) 
+// Patches a jump operand so it lands on the current instruction
+// The jump is taken relative to from, which is where the ip sits once the instruction has been read
+static void patchJumpFrom(int offset, int from)
 {
-	// -2 to adjust for the bytecode for the jump offset itself.
-	int jump = currentChunk()->count - offset - 2;
+	int jump = currentChunk()->count - from;
 
 	if (jump > UINT16_MAX) {
 		error("Too much code to jump over.");
@@ -1053,6 +1367,18 @@ static void patchJump(int offset)
 
 	currentChunk()->code[offset] = (jump >> 8) & 0xff;
 	currentChunk()->code[offset + 1] = jump & 0xff;
+
+	// Something jumps to after the last range so it can't be rewritten by a for loop
+	current->lastRangeOffset = -1;
+
+	// Nor can anything before here be folded into what comes next
+	current->constantLoadCount = 0;
+}
+
+static void patchJump(int offset) 
+{
+	// +2 to adjust for the bytecode for the jump offset itself.
+	patchJumpFrom(offset, offset + 2);
 }
 
 static void emitLoop(int loopStart) {
@@ -1065,14 +1391,89 @@ static void emitLoop(int loopStart) {
 	emitByte(offset & 0xff);
 }
 
+// Throws away code that can never run, it is still compiled so errors in it are reported
+static void discardCode(int start, int firstBreak)
+{
+	truncateChunk(start);
+	current->breakStatements.count = firstBreak;
+}
+
+// If the condition that was just compiled from start is a constant it is removed and its value returned
+static bool takeConstantCondition(int start, Value* value)
+{
+	ConstantLoad* condition = constantLoadFrom(start);
+
+	if (condition == NULL)
+		return false;
+
+	*value = condition->value;
+	dropConstantLoads(1);
+
+	return true;
+}
+
+// Only the branch that can be taken is kept, there are no jumps or condition left
+static void constantIfStatement(bool taken)
+{
+	int start = currentChunk()->count;
+	int firstBreak = current->breakStatements.count;
+
+	beginScope();
+
+	while (!check(TOKEN_END) && !check(TOKEN_EOF) && !check(TOKEN_ELSE))
+	{
+		declaration();
+	}
+
+	endScope();
+
+	if (!taken)
+		discardCode(start, firstBreak);
+
+	if (match(TOKEN_ELSE))
+	{
+		start = currentChunk()->count;
+		firstBreak = current->breakStatements.count;
+
+		beginScope();
+
+		ignoreNewlines();
+
+		while (!check(TOKEN_END) && !check(TOKEN_EOF))
+		{
+			declaration();
+		}
+
+		consume(TOKEN_END, "Expected 'end' after else block.");
+
+		endScope();
+
+		if (taken)
+			discardCode(start, firstBreak);
+	}
+	else
+	{
+		consume(TOKEN_END, "Expected 'end' after if block.");
+	}
+}
+
 static void ifStatement()
 {
+	int conditionStart = currentChunk()->count;
+
 	expression();
 
 	consume(TOKEN_THEN, "Expected 'then' after if condition");
 
 	ignoreNewlines();
 
+	Value condition;
+	if (takeConstantCondition(conditionStart, &condition))
+	{
+		constantIfStatement(!solisIsFalsy(condition));
+		return;
+	}
+
 	// Begin a scope
 	// Scopes are handled by if statements here 
 	beginScope();
@@ -1087,13 +1488,14 @@ static void ifStatement()
 		declaration();
 	}
 
+	// Locals of the branch only exist when it was taken so they are popped before jumping over the else
+	endScope();
+
 	int elseJump = emitJump(OP_JUMP);
 
 	patchJump(thenJump);
 	emitByte(OP_POP);
 
-	endScope();
-
 	if (match(TOKEN_ELSE))
 	{
 		beginScope();
@@ -1118,6 +1520,31 @@ static void ifStatement()
 	patchJump(elseJump);
 }
 
+static int beginLoop(bool* wasWithinLoop, int* outerLoopLocals)
+{
+	*wasWithinLoop = current->withinLoop;
+	*outerLoopLocals = current->loopLocalCount;
+
+	current->withinLoop = true;
+	current->loopLocalCount = current->localCount;
+
+	return current->breakStatements.count;
+}
+
+static void endLoop(int firstBreak, bool wasWithinLoop, int outerLoopLocals)
+{
+	// Patch the break jumps that belong to this loop
+	for (int i = firstBreak; i < current->breakStatements.count; i++)
+	{
+		patchJump(current->breakStatements.data[i]);
+	}
+
+	current->breakStatements.count = firstBreak;
+
+	current->withinLoop = wasWithinLoop;
+	current->loopLocalCount = outerLoopLocals;
+}
+
 static void whileStatement()
 {
 	int loopStart = currentChunk()->count;
@@ -1126,7 +1553,29 @@ static void whileStatement()
 
 	consume(TOKEN_DO, "Expected 'do' after while expression.");
 
-	current->withinLoop = true;
+	Value condition;
+	bool constantCondition = takeConstantCondition(loopStart, &condition);
+
+	bool wasWithinLoop;
+	int outerLoopLocals;
+	int firstBreak = beginLoop(&wasWithinLoop, &outerLoopLocals);
+
+	// A constant condition is never tested, the loop either runs until a break or not at all
+	if (constantCondition)
+	{
+		beginScope();
+		block();
+		endScope();
+
+		if (solisIsFalsy(condition))
+			discardCode(loopStart, firstBreak);
+		else
+			emitLoop(loopStart);
+
+		endLoop(firstBreak, wasWithinLoop, outerLoopLocals);
+		return;
+	}
+
 	beginScope();
 
 	int exitJump = emitJump(OP_JUMP_IF_FALSE);
@@ -1142,19 +1591,7 @@ static void whileStatement()
 
 	emitByte(OP_POP);
 
-	for (int i = 0; i < current->breakStatements.count; i++)
-	{
-		// Patch all break the jumps
-		int offset = current->breakStatements.data[i];
-		patchJump(offset);
-	}
-
-	// Clear the buffer for the next loop
-	solisIntBufferClear(current->vm, &current->breakStatements);
-
-	
-	current->withinLoop = false;
-	
+	endLoop(firstBreak, wasWithinLoop, outerLoopLocals);
 }
 
 static void loadLocal(int slot)
@@ -1164,44 +1601,109 @@ static void loadLocal(int slot)
 	emitShort(slot);
 }
 
-static void forStatement()
+// Adds a hidden local for loop state that already sits on the stack
+static int addLoopLocal(const char* name, int length)
 {
-	beginScope();
-
-	consume(TOKEN_IDENTIFIER, "Expected identifier in for loop.");
+	Token token = {
+		.start = name,
+		.length = length
+	};
 
-	const char* name = parser.previous.start;
-	int length =  parser.previous.length;
+	int slot = addLocal(token);
+	markInitialized();
 
-	consume(TOKEN_IN, "Expected 'in' in for loop.");
+	return slot;
+}
 
-	ignoreNewlines();
+static void rangeForStatement(Token loopVar)
+{
+	// The start and end of the range are on the stack
+	// The start becomes the counter and the end the limit
+	int counterSlot = addLoopLocal("counter ", 8);
+	addLoopLocal("limit ", 6);
 
-	expression();
+	consume(TOKEN_DO, "Expected 'do' after for expression");
 
-	Token seqTk = {
-		.start = "seq ",
-		.length = 4
-	};
+	bool wasWithinLoop;
+	int outerLoopLocals;
+	int firstBreak = beginLoop(&wasWithinLoop, &outerLoopLocals);
 
-	int seqSlot = addLocal(seqTk);
+	int loopStart = currentChunk()->count;
 
-	emitByte(OP_NIL);
+	// Pushes the counter as the loop variable or jumps out once it reaches the limit
+	emitByte(OP_RANGE_LOOP);
+	emitShort((uint16_t)counterSlot);
+	emitBytes(0xff, 0xff);
+	int exitJump = currentChunk()->count - 2;
 
-	Token iterTk = {
-		.start = "iter ",
-		.length = 5
-	};
-	int iterSlot = addLocal(iterTk);
+	beginScope();
 
-	consume(TOKEN_DO, "Expected 'do' after for expression");
+	addLocal(loopVar);
+	markInitialized();
 
+	block();
 
-	current->withinLoop = true;
-	int loopStart = currentChunk()->count;
+	endScope();
 
-	loadLocal(seqSlot);
-	loadLocal(iterSlot);
+	// Increment the counter and jump back to the test
+	emitByte(OP_RANGE_NEXT);
+	emitShort((uint16_t)counterSlot);
+
+	int offset = currentChunk()->count - loopStart + 2;
+	if (offset > UINT16_MAX) error("Loop body too large.");
+
+	emitShort((uint16_t)offset);
+
+	patchJump(exitJump);
+
+	endLoop(firstBreak, wasWithinLoop, outerLoopLocals);
+}
+
+static void forStatement()
+{
+	beginScope();
+
+	consume(TOKEN_IDENTIFIER, "Expected identifier in for loop.");
+
+	Token localIter = {
+		.start = parser.previous.start,
+		.length = parser.previous.length
+	};
+
+	consume(TOKEN_IN, "Expected 'in' in for loop.");
+
+	ignoreNewlines();
+
+	expression();
+
+	// A range literal as the sequence becomes a counted loop
+	// Drop the OP_DOTDOT and leave the start and end on the stack so no Range is ever created
+	if (current->lastRangeOffset != -1 && current->lastRangeOffset == currentChunk()->count - 1)
+	{
+		truncateChunk(currentChunk()->count - 1);
+
+		rangeForStatement(localIter);
+
+		endScope();
+		return;
+	}
+
+	int seqSlot = addLoopLocal("seq ", 4);
+
+	emitByte(OP_NIL);
+
+	int iterSlot = addLoopLocal("iter ", 5);
+
+	consume(TOKEN_DO, "Expected 'do' after for expression");
+
+	bool wasWithinLoop;
+	int outerLoopLocals;
+	int firstBreak = beginLoop(&wasWithinLoop, &outerLoopLocals);
+
+	int loopStart = currentChunk()->count;
+
+	ObjString* nextName = solisCopyString(current->vm, "next", 4);
+	solisPush(current->vm, SOLIS_OBJECT_VALUE(nextName));
 
 	ObjString* iterValue = solisCopyString(current->vm, "iterate", 7);
 	solisPush(current->vm, SOLIS_OBJECT_VALUE(iterValue));
@@ -1209,16 +1711,44 @@ static void forStatement()
 	ObjString* iterValueValue = solisCopyString(current->vm, "iteratorValue", 13);
 	solisPush(current->vm, SOLIS_OBJECT_VALUE(iterValueValue));
 
+	uint16_t nextMethod = makeConstant(SOLIS_OBJECT_VALUE(nextName));
 	uint16_t iterateMethod = makeConstant(SOLIS_OBJECT_VALUE(iterValue));
 	uint16_t iteratorValueMethod = makeConstant(SOLIS_OBJECT_VALUE(iterValueValue));
 
+	solisPop(current->vm);
 	solisPop(current->vm);
 	solisPop(current->vm);
 
+	// Lists and ranges are stepped natively, objects with a next method call it once per element
+	// Both jump straight to the body or out of the loop
+	emitByte(OP_FOR_ITER);
+	emitShort(seqSlot);
+	int iterBodyJump = currentChunk()->count;
+	emitBytes(0xff, 0xff);
+	int iterExitJump = currentChunk()->count;
+	emitBytes(0xff, 0xff);
+	emitShort(nextMethod);
+	emitInlineCache();
+	int iterEnd = currentChunk()->count;
+
+	// Takes the result of next off the stack, StopIteration ends the loop
+	emitByte(OP_FOR_NEXT);
+	emitShort(seqSlot);
+	int nextBodyJump = currentChunk()->count;
+	emitBytes(0xff, 0xff);
+	int nextExitJump = currentChunk()->count;
+	emitBytes(0xff, 0xff);
+	int nextEnd = currentChunk()->count;
+
+	// Anything else uses the iterate and iteratorValue protocol
+	loadLocal(seqSlot);
+	loadLocal(iterSlot);
+
 	// Call iterate(x)
 	emitByte(OP_INVOKE);
 	emitShort(iterateMethod);
 	emitByte(1);
+	emitInlineCache();
 
 	emitByte(OP_SET_LOCAL);
 	emitShort(iterSlot);
@@ -1234,13 +1764,12 @@ static void forStatement()
 	emitByte(OP_INVOKE);
 	emitShort(iteratorValueMethod);
 	emitByte(1);
+	emitInlineCache();
 
-	beginScope();
+	patchJumpFrom(iterBodyJump, iterEnd);
+	patchJumpFrom(nextBodyJump, nextEnd);
 
-	Token localIter = {
-		.start = name,
-		.length = length
-	};
+	beginScope();
 
 	addLocal(localIter);
 	markInitialized();
@@ -1252,6 +1781,10 @@ static void forStatement()
 	emitLoop(loopStart);
 
 	patchJump(exitJump);
+	patchJumpFrom(iterExitJump, iterEnd);
+	patchJumpFrom(nextExitJump, nextEnd);
+
+	endLoop(firstBreak, wasWithinLoop, outerLoopLocals);
 
 	endScope();
 }
@@ -1265,6 +1798,12 @@ static void breakStatement()
 		error("Cannot 'break' when not within a loop.");
 	}
 
+	// Pop the locals declared inside the loop since we jump over the end of their scopes
+	for (int i = current->localCount - 1; i >= current->loopLocalCount; i--)
+	{
+		emitByte(current->locals[i].isCaptured ? OP_CLOSE_UPVALUE : OP_POP);
+	}
+
 	int exitJump = emitJump(OP_JUMP);
 
 	// Write it into the int buffer
@@ -1294,6 +1833,814 @@ static void functionDeclaration()
 	emitByte(OP_POP);
 }
 
+/*
+	Register code generation for register execution mode.
+
+	Once a plain function has compiled to stack bytecode its tokens are walked a second time to emit register code.
+	Slot 0 holds the callee followed by the parameters, then locals, then temporaries which are freed like a stack.
+	Anything outside the supported subset makes the function keep only its stack bytecode.
+*/
+
+typedef struct
+{
+	Token name;
+	int depth;
+	int reg;
+} RegisterLocal;
+
+typedef struct
+{
+	VM* vm;
+	ObjFunction* function;
+	Chunk* chunk;
+
+	Token* tokens;
+	size_t tokenCount;
+	size_t position;
+
+	RegisterLocal locals[UINT8_COUNT];
+	int localCount;
+	int scopeDepth;
+
+	// First register not used by a local, temporaries live above it
+	int localTop;
+
+	// First free register
+	int top;
+	int registerCount;
+
+	IntBuffer breakStatements;
+	bool withinLoop;
+
+	bool failed;
+} RegisterCompiler;
+
+static int registerExpression(RegisterCompiler* rc, Precedence precedence, int dest);
+static void registerDeclaration(RegisterCompiler* rc);
+
+static Token* registerPeek(RegisterCompiler* rc)
+{
+	return &rc->tokens[rc->position];
+}
+
+static Token* registerPeekNext(RegisterCompiler* rc)
+{
+	if (rc->position + 1 >= rc->tokenCount)
+		return &rc->tokens[rc->tokenCount - 1];
+
+	return &rc->tokens[rc->position + 1];
+}
+
+static Token* registerAdvance(RegisterCompiler* rc)
+{
+	Token* token = &rc->tokens[rc->position];
+
+	if (token->type != TOKEN_EOF)
+		rc->position++;
+
+	return token;
+}
+
+static bool registerCheck(RegisterCompiler* rc, SolisTokenType type)
+{
+	return registerPeek(rc)->type == type;
+}
+
+static bool registerMatch(RegisterCompiler* rc, SolisTokenType type)
+{
+	if (!registerCheck(rc, type))
+		return false;
+
+	registerAdvance(rc);
+	return true;
+}
+
+static void registerConsume(RegisterCompiler* rc, SolisTokenType type)
+{
+	if (!registerMatch(rc, type))
+		rc->failed = true;
+}
+
+static void registerIgnoreNewlines(RegisterCompiler* rc)
+{
+	while (registerMatch(rc, TOKEN_LINE));
+}
+
+static void registerConsumeLine(RegisterCompiler* rc)
+{
+	if (registerCheck(rc, TOKEN_EOF))
+		return;
+
+	registerConsume(rc, TOKEN_LINE);
+	registerIgnoreNewlines(rc);
+}
+
+static void registerEmit(RegisterCompiler* rc, uint8_t byte)
+{
+	// Use the line of the last token consumed, the next one can already be on the following line
+	solisWriteChunk(rc->vm, rc->chunk, byte, rc->tokens[rc->position - 1].line);
+}
+
+static void registerEmitShort(RegisterCompiler* rc, uint16_t value)
+{
+	registerEmit(rc, (value >> 8) & 0xff);
+	registerEmit(rc, value & 0xff);
+}
+
+static void registerEmitOp(RegisterCompiler* rc, uint8_t op, int a, int b, int c)
+{
+	registerEmit(rc, op);
+	registerEmit(rc, (uint8_t)a);
+	registerEmit(rc, (uint8_t)b);
+	registerEmit(rc, (uint8_t)c);
+}
+
+// Emits a forward jump with a placeholder offset and returns where the offset is
+static int registerEmitJump(RegisterCompiler* rc, uint8_t op)
+{
+	registerEmit(rc, op);
+	registerEmitShort(rc, 0xffff);
+	return rc->chunk->count - 2;
+}
+
+static void registerPatchJump(RegisterCompiler* rc, int offset)
+{
+	int jump = rc->chunk->count - (offset + 2);
+
+	if (jump > UINT16_MAX)
+	{
+		rc->failed = true;
+		return;
+	}
+
+	rc->chunk->code[offset] = (jump >> 8) & 0xff;
+	rc->chunk->code[offset + 1] = jump & 0xff;
+}
+
+static void registerEmitLoop(RegisterCompiler* rc, int loopStart)
+{
+	registerEmit(rc, ROP_LOOP);
+
+	int offset = rc->chunk->count - loopStart + 2;
+	if (offset > UINT16_MAX)
+		rc->failed = true;
+
+	registerEmitShort(rc, (uint16_t)offset);
+}
+
+static int registerAllocate(RegisterCompiler* rc)
+{
+	// Registers are encoded in a single byte
+	if (rc->top >= UINT8_MAX)
+	{
+		rc->failed = true;
+		return 0;
+	}
+
+	int reg = rc->top++;
+
+	if (rc->top > rc->registerCount)
+		rc->registerCount = rc->top;
+
+	return reg;
+}
+
+// Reuses a constant of the stack chunk when the value is already there
+static uint16_t registerConstant(RegisterCompiler* rc, Value value)
+{
+	ValueBuffer* constants = &rc->function->chunk.constants;
+
+	for (int i = 0; i < constants->count; i++)
+	{
+		Value constant = constants->data[i];
+
+		if (SOLIS_IS_NUMERIC(value))
+		{
+			if (!SOLIS_IS_NUMERIC(constant))
+				continue;
+
+			// Compare the bits so 0 and -0 stay apart
+			double a = SOLIS_AS_NUMBER(value);
+			double b = SOLIS_AS_NUMBER(constant);
+
+			if (memcmp(&a, &b, sizeof(double)) == 0)
+				return (uint16_t)i;
+		}
+		else if (SOLIS_IS_OBJECT(constant) && SOLIS_AS_OBJECT(constant) == SOLIS_AS_OBJECT(value))
+		{
+			return (uint16_t)i;
+		}
+	}
+
+	int constant = solisAddConstant(rc->vm, &rc->function->chunk, value);
+
+	if (constant > UINT16_MAX)
+		rc->failed = true;
+
+	return (uint16_t)constant;
+}
+
+static int registerResolveLocal(RegisterCompiler* rc, Token* name)
+{
+	for (int i = rc->localCount - 1; i >= 0; i--)
+	{
+		if (identifiersEqual(name, &rc->locals[i].name))
+			return rc->locals[i].reg;
+	}
+
+	return -1;
+}
+
+static void registerAddLocal(RegisterCompiler* rc, Token name, int reg)
+{
+	RegisterLocal* local = &rc->locals[rc->localCount++];
+	local->name = name;
+	local->depth = rc->scopeDepth;
+	local->reg = reg;
+
+	rc->localTop = reg + 1;
+	rc->top = rc->localTop;
+}
+
+static void registerEndScope(RegisterCompiler* rc)
+{
+	rc->scopeDepth--;
+
+	while (rc->localCount > 0 && rc->locals[rc->localCount - 1].depth > rc->scopeDepth)
+		rc->localCount--;
+
+	rc->localTop = rc->locals[rc->localCount - 1].reg + 1;
+	rc->top = rc->localTop;
+}
+
+// Where the result of an operator goes, only the last operator of an expression writes to dest
+static int registerTarget(RegisterCompiler* rc, Precedence precedence, int dest, int base)
+{
+	rc->top = base;
+
+	if (dest >= 0 && precedence > getRule(registerPeek(rc)->type)->precedence)
+		return dest;
+
+	return registerAllocate(rc);
+}
+
+// Writes to hint when there is one, otherwise to a new temporary
+static int registerHint(RegisterCompiler* rc, int hint)
+{
+	return hint >= 0 ? hint : registerAllocate(rc);
+}
+
+static int registerPrefix(RegisterCompiler* rc, int hint)
+{
+	int base = rc->top;
+	Token* token = registerAdvance(rc);
+
+	switch (token->type)
+	{
+	case TOKEN_NUMBER:
+	{
+		uint16_t constant = registerConstant(rc, SOLIS_NUMERIC_VALUE(strtod(token->start, NULL)));
+		int reg = registerHint(rc, hint);
+
+		registerEmit(rc, ROP_LOAD_CONSTANT);
+		registerEmit(rc, (uint8_t)reg);
+		registerEmitShort(rc, constant);
+		return reg;
+	}
+	case TOKEN_STRING:
+	{
+		ObjString* string = solisCopyString(rc->vm, token->start + 1, token->length - 2);
+		uint16_t constant = registerConstant(rc, SOLIS_OBJECT_VALUE(string));
+		int reg = registerHint(rc, hint);
+
+		registerEmit(rc, ROP_LOAD_CONSTANT);
+		registerEmit(rc, (uint8_t)reg);
+		registerEmitShort(rc, constant);
+		return reg;
+	}
+	case TOKEN_TRUE:
+	case TOKEN_FALSE:
+	case TOKEN_NULL:
+	{
+		int reg = registerHint(rc, hint);
+
+		registerEmit(rc, token->type == TOKEN_TRUE ? ROP_LOAD_TRUE : token->type == TOKEN_FALSE ? ROP_LOAD_FALSE : ROP_LOAD_NULL);
+		registerEmit(rc, (uint8_t)reg);
+		return reg;
+	}
+	case TOKEN_IDENTIFIER:
+	{
+		// Assignments are only handled as statements
+		if (registerCheck(rc, TOKEN_EQ))
+			break;
+
+		// Locals are used in place, the expression moves them into its destination if it needs to
+		int local = registerResolveLocal(rc, token);
+
+		if (local >= 0)
+			return local;
+
+		// Without upvalues any other name is a global
+		int global = resolveGlobalVariable(current, *token);
+		if (global < 0)
+			break;
+
+		int reg = registerHint(rc, hint);
+
+		registerEmit(rc, ROP_GET_GLOBAL);
+		registerEmit(rc, (uint8_t)reg);
+		registerEmitShort(rc, (uint16_t)global);
+		return reg;
+	}
+	case TOKEN_LEFT_PAREN:
+	{
+		int reg = registerExpression(rc, PREC_ASSIGNMENT, hint);
+		registerConsume(rc, TOKEN_RIGHT_PAREN);
+		return reg;
+	}
+	case TOKEN_MINUS:
+	case TOKEN_BANG:
+	{
+		int operand = registerExpression(rc, PREC_UNARY, -1);
+
+		rc->top = base;
+		int reg = registerHint(rc, hint);
+
+		registerEmit(rc, token->type == TOKEN_MINUS ? ROP_NEGATE : ROP_NOT);
+		registerEmit(rc, (uint8_t)reg);
+		registerEmit(rc, (uint8_t)operand);
+		return reg;
+	}
+	default:
+		break;
+	}
+
+	rc->failed = true;
+	return 0;
+}
+
+static int registerCall(RegisterCompiler* rc, int callee, int base)
+{
+	// The callee and arguments have to be next to each other at the top
+	int callBase = callee;
+
+	if (callee != rc->top - 1 || callee < rc->localTop)
+	{
+		rc->top = base;
+		callBase = registerAllocate(rc);
+
+		registerEmit(rc, ROP_MOVE);
+		registerEmit(rc, (uint8_t)callBase);
+		registerEmit(rc, (uint8_t)callee);
+	}
+
+	int argCount = 0;
+	if (!registerCheck(rc, TOKEN_RIGHT_PAREN))
+	{
+		do
+		{
+			int arg = registerAllocate(rc);
+			registerExpression(rc, PREC_ASSIGNMENT, arg);
+
+			rc->top = arg + 1;
+			argCount++;
+		} while (!rc->failed && registerMatch(rc, TOKEN_COMMA));
+	}
+
+	registerConsume(rc, TOKEN_RIGHT_PAREN);
+
+	if (argCount > 16)
+		rc->failed = true;
+
+	registerEmit(rc, ROP_CALL);
+	registerEmit(rc, (uint8_t)callBase);
+	registerEmit(rc, (uint8_t)argCount);
+
+	rc->top = callBase + 1;
+	return callBase;
+}
+
+static int registerInfix(RegisterCompiler* rc, Precedence precedence, int dest, int left, int base)
+{
+	while (!rc->failed && precedence <= getRule(registerPeek(rc)->type)->precedence)
+	{
+		SolisTokenType operatorType = registerAdvance(rc)->type;
+		Precedence operatorPrecedence = getRule(operatorType)->precedence;
+
+		uint8_t op;
+
+		switch (operatorType)
+		{
+		case TOKEN_LEFT_PAREN:
+			left = registerCall(rc, left, base);
+			continue;
+		case TOKEN_AND:
+		case TOKEN_OR:
+		{
+			rc->top = base;
+			int result = registerAllocate(rc);
+
+			if (result != left)
+			{
+				registerEmit(rc, ROP_MOVE);
+				registerEmit(rc, (uint8_t)result);
+				registerEmit(rc, (uint8_t)left);
+			}
+
+			registerEmit(rc, operatorType == TOKEN_AND ? ROP_JUMP_IF_FALSE : ROP_JUMP_IF_TRUE);
+			registerEmit(rc, (uint8_t)result);
+			registerEmitShort(rc, 0xffff);
+			int endJump = rc->chunk->count - 2;
+
+			registerExpression(rc, operatorPrecedence, result);
+			registerPatchJump(rc, endJump);
+
+			rc->top = result + 1;
+			left = result;
+			continue;
+		}
+		case TOKEN_PLUS:
+		case TOKEN_MINUS:
+		{
+			// Adding a number literal doesn't need a register for it
+			Token* next = registerPeek(rc);
+			if (next->type == TOKEN_NUMBER && getRule(registerPeekNext(rc)->type)->precedence <= PREC_TERM)
+			{
+				registerAdvance(rc);
+				uint16_t constant = registerConstant(rc, SOLIS_NUMERIC_VALUE(strtod(next->start, NULL)));
+				int target = registerTarget(rc, precedence, dest, base);
+
+				registerEmit(rc, operatorType == TOKEN_PLUS ? ROP_ADD_CONSTANT : ROP_SUBTRACT_CONSTANT);
+				registerEmit(rc, (uint8_t)target);
+				registerEmit(rc, (uint8_t)left);
+				registerEmitShort(rc, constant);
+
+				left = target;
+				continue;
+			}
+
+			op = operatorType == TOKEN_PLUS ? ROP_ADD : ROP_SUBTRACT;
+			break;
+		}
+		case TOKEN_STAR:			op = ROP_MULTIPLY; break;
+		case TOKEN_SLASH:			op = ROP_DIVIDE; break;
+		case TOKEN_SLASH_SLASH:		op = ROP_FLOOR_DIVIDE; break;
+		case TOKEN_STAR_STAR:		op = ROP_POWER; break;
+		case TOKEN_EQEQ:			op = ROP_EQUAL; break;
+		case TOKEN_BANGEQ:			op = ROP_NOT_EQUAL; break;
+		case TOKEN_LT:				op = ROP_LESS; break;
+		case TOKEN_LTEQ:			op = ROP_LESS_EQUAL; break;
+		case TOKEN_GT:				op = ROP_GREATER; break;
+		case TOKEN_GTEQ:			op = ROP_GREATER_EQUAL; break;
+		default:
+			// Fields, subscripts, ranges and type checks only exist in stack bytecode
+			rc->failed = true;
+			return left;
+		}
+
+		int right = registerExpression(rc, (Precedence)(operatorPrecedence + 1), -1);
+		int target = registerTarget(rc, precedence, dest, base);
+
+		registerEmitOp(rc, op, target, left, right);
+		left = target;
+	}
+
+	if (dest >= 0 && left != dest)
+	{
+		registerEmit(rc, ROP_MOVE);
+		registerEmit(rc, (uint8_t)dest);
+		registerEmit(rc, (uint8_t)left);
+
+		rc->top = base;
+		return dest;
+	}
+
+	return left;
+}
+
+/*
+	Compiles an expression and returns the register holding its value.
+	With a dest the value always ends up there, otherwise it can be a local or a new temporary.
+*/
+static int registerExpression(RegisterCompiler* rc, Precedence precedence, int dest)
+{
+	int base = rc->top;
+
+	// Registers that don't belong to a local can be written before the rest of the expression is read
+	// A local can only be written straight away when the expression is a single operand
+	int hint = -1;
+	if (dest >= rc->localTop)
+	{
+		hint = dest;
+	}
+	else if (dest >= 0)
+	{
+		SolisTokenType type = registerPeek(rc)->type;
+		bool single = type == TOKEN_NUMBER || type == TOKEN_STRING || type == TOKEN_IDENTIFIER
+			|| type == TOKEN_TRUE || type == TOKEN_FALSE || type == TOKEN_NULL;
+
+		if (single && getRule(registerPeekNext(rc)->type)->precedence < precedence)
+			hint = dest;
+	}
+
+	int left = registerPrefix(rc, hint);
+
+	return registerInfix(rc, precedence, dest, left, base);
+}
+
+// Compiles the condition of an if or while and returns the jump taken when it is false
+static int registerCondition(RegisterCompiler* rc, SolisTokenType terminator)
+{
+	int base = rc->top;
+
+	int left = registerPrefix(rc, -1);
+	left = registerInfix(rc, PREC_TERM, -1, left, base);
+
+	// A single comparison jumps on the operands directly
+	SolisTokenType comparison = registerPeek(rc)->type;
+	if (comparison == TOKEN_LT || comparison == TOKEN_LTEQ || comparison == TOKEN_GT || comparison == TOKEN_GTEQ)
+	{
+		registerAdvance(rc);
+		int right = registerExpression(rc, PREC_TERM, -1);
+
+		uint8_t op;
+		switch (comparison)
+		{
+		case TOKEN_LT:		op = registerCheck(rc, terminator) ? ROP_JUMP_IF_NOT_LESS : ROP_LESS; break;
+		case TOKEN_LTEQ:	op = registerCheck(rc, terminator) ? ROP_JUMP_IF_NOT_LESS_EQUAL : ROP_LESS_EQUAL; break;
+		case TOKEN_GT:		op = registerCheck(rc, terminator) ? ROP_JUMP_IF_NOT_GREATER : ROP_GREATER; break;
+		default:			op = registerCheck(rc, terminator) ? ROP_JUMP_IF_NOT_GREATER_EQUAL : ROP_GREATER_EQUAL; break;
+		}
+
+		if (registerCheck(rc, terminator))
+		{
+			registerAdvance(rc);
+
+			registerEmit(rc, op);
+			registerEmit(rc, (uint8_t)left);
+			registerEmit(rc, (uint8_t)right);
+			registerEmitShort(rc, 0xffff);
+
+			rc->top = base;
+			return rc->chunk->count - 2;
+		}
+
+		rc->top = base;
+		int result = registerAllocate(rc);
+		registerEmitOp(rc, op, result, left, right);
+		left = result;
+	}
+
+	left = registerInfix(rc, PREC_ASSIGNMENT, -1, left, base);
+	registerConsume(rc, terminator);
+
+	registerEmit(rc, ROP_JUMP_IF_FALSE);
+	registerEmit(rc, (uint8_t)left);
+	registerEmitShort(rc, 0xffff);
+
+	rc->top = base;
+	return rc->chunk->count - 2;
+}
+
+static void registerBlock(RegisterCompiler* rc)
+{
+	while (!rc->failed && !registerCheck(rc, TOKEN_END) && !registerCheck(rc, TOKEN_EOF))
+	{
+		registerDeclaration(rc);
+	}
+}
+
+static void registerIfStatement(RegisterCompiler* rc)
+{
+	int thenJump = registerCondition(rc, TOKEN_THEN);
+
+	registerIgnoreNewlines(rc);
+
+	rc->scopeDepth++;
+	while (!rc->failed && !registerCheck(rc, TOKEN_END) && !registerCheck(rc, TOKEN_EOF) && !registerCheck(rc, TOKEN_ELSE))
+	{
+		registerDeclaration(rc);
+	}
+	registerEndScope(rc);
+
+	if (registerMatch(rc, TOKEN_ELSE))
+	{
+		int elseJump = registerEmitJump(rc, ROP_JUMP);
+		registerPatchJump(rc, thenJump);
+
+		registerIgnoreNewlines(rc);
+
+		rc->scopeDepth++;
+		registerBlock(rc);
+		registerEndScope(rc);
+
+		registerConsume(rc, TOKEN_END);
+		registerPatchJump(rc, elseJump);
+	}
+	else
+	{
+		registerConsume(rc, TOKEN_END);
+		registerPatchJump(rc, thenJump);
+	}
+}
+
+static void registerWhileStatement(RegisterCompiler* rc)
+{
+	int loopStart = rc->chunk->count;
+
+	int exitJump = registerCondition(rc, TOKEN_DO);
+
+	bool wasWithinLoop = rc->withinLoop;
+	int firstBreak = rc->breakStatements.count;
+	rc->withinLoop = true;
+
+	rc->scopeDepth++;
+	registerBlock(rc);
+	registerEndScope(rc);
+
+	registerConsume(rc, TOKEN_END);
+
+	registerEmitLoop(rc, loopStart);
+	registerPatchJump(rc, exitJump);
+
+	for (int i = firstBreak; i < rc->breakStatements.count; i++)
+	{
+		registerPatchJump(rc, rc->breakStatements.data[i]);
+	}
+
+	rc->breakStatements.count = firstBreak;
+	rc->withinLoop = wasWithinLoop;
+}
+
+static void registerStatement(RegisterCompiler* rc)
+{
+	if (registerMatch(rc, TOKEN_RETURN))
+	{
+		if (registerCheck(rc, TOKEN_LINE))
+		{
+			registerEmit(rc, ROP_RETURN_NULL);
+		}
+		else
+		{
+			int reg = registerExpression(rc, PREC_ASSIGNMENT, -1);
+
+			registerEmit(rc, ROP_RETURN);
+			registerEmit(rc, (uint8_t)reg);
+		}
+	}
+	else if (registerMatch(rc, TOKEN_DO))
+	{
+		rc->scopeDepth++;
+		registerBlock(rc);
+		registerEndScope(rc);
+
+		registerConsume(rc, TOKEN_END);
+	}
+	else if (registerMatch(rc, TOKEN_IF))
+	{
+		registerIfStatement(rc);
+	}
+	else if (registerMatch(rc, TOKEN_WHILE))
+	{
+		registerWhileStatement(rc);
+	}
+	else if (registerMatch(rc, TOKEN_BREAK))
+	{
+		if (!rc->withinLoop)
+			rc->failed = true;
+
+		solisIntBufferWrite(rc->vm, &rc->breakStatements, registerEmitJump(rc, ROP_JUMP));
+	}
+	else if (registerCheck(rc, TOKEN_IDENTIFIER) && registerPeekNext(rc)->type == TOKEN_EQ)
+	{
+		Token name = *registerAdvance(rc);
+		registerAdvance(rc);
+
+		int local = registerResolveLocal(rc, &name);
+
+		if (local >= 0)
+		{
+			registerExpression(rc, PREC_ASSIGNMENT, local);
+		}
+		else
+		{
+			int global = resolveGlobalVariable(current, name);
+			if (global < 0)
+			{
+				rc->failed = true;
+				return;
+			}
+
+			int reg = registerExpression(rc, PREC_ASSIGNMENT, -1);
+
+			registerEmit(rc, ROP_SET_GLOBAL);
+			registerEmit(rc, (uint8_t)reg);
+			registerEmitShort(rc, (uint16_t)global);
+		}
+	}
+	else if (registerCheck(rc, TOKEN_FOR))
+	{
+		rc->failed = true;
+	}
+	else
+	{
+		registerExpression(rc, PREC_ASSIGNMENT, -1);
+	}
+
+	rc->top = rc->localTop;
+
+	registerConsumeLine(rc);
+}
+
+static void registerDeclaration(RegisterCompiler* rc)
+{
+	registerIgnoreNewlines(rc);
+
+	if (registerCheck(rc, TOKEN_EOF))
+		return;
+
+	if (registerMatch(rc, TOKEN_VAR))
+	{
+		Token* name = registerAdvance(rc);
+		if (name->type != TOKEN_IDENTIFIER)
+		{
+			rc->failed = true;
+			return;
+		}
+
+		int reg = registerAllocate(rc);
+
+		if (registerMatch(rc, TOKEN_EQ))
+		{
+			registerExpression(rc, PREC_ASSIGNMENT, reg);
+		}
+		else
+		{
+			registerEmit(rc, ROP_LOAD_NULL);
+			registerEmit(rc, (uint8_t)reg);
+		}
+
+		registerConsumeLine(rc);
+
+		// Added afterwards so the initialiser can't see it
+		registerAddLocal(rc, *name, reg);
+	}
+	else if (registerCheck(rc, TOKEN_FUNCTION) || registerCheck(rc, TOKEN_CLASS) || registerCheck(rc, TOKEN_ENUM))
+	{
+		rc->failed = true;
+	}
+	else
+	{
+		registerStatement(rc);
+	}
+}
+
+// Compiles the body of the current function again into its register chunk, bodyStart is the token after the parameters
+static void compileRegisterFunction(size_t bodyStart)
+{
+	ObjFunction* function = current->function;
+
+	if (function->upvalueCount > 0)
+		return;
+
+	RegisterCompiler rc;
+	rc.vm = current->vm;
+	rc.function = function;
+	rc.chunk = &function->registerChunk;
+	rc.tokens = parser.tokenList.tokens;
+	rc.tokenCount = parser.tokenList.count;
+	rc.position = bodyStart;
+	rc.localCount = 0;
+	rc.scopeDepth = 1;
+	rc.top = 0;
+	rc.registerCount = 0;
+	rc.withinLoop = false;
+	rc.failed = false;
+
+	solisIntBufferInit(rc.vm, &rc.breakStatements);
+
+	// The callee and the parameters are where the caller put them
+	for (int i = 0; i <= function->arity; i++)
+	{
+		registerAllocate(&rc);
+		registerAddLocal(&rc, current->locals[i].name, i);
+	}
+
+	registerBlock(&rc);
+
+	registerEmit(&rc, ROP_RETURN_NULL);
+
+	solisIntBufferClear(rc.vm, &rc.breakStatements);
+
+	if (rc.failed)
+	{
+		solisFreeChunk(rc.vm, rc.chunk);
+		return;
+	}
+
+	function->registerCount = rc.registerCount;
+}
+
 static void function(FunctionType type)
 {
 	Compiler compiler;
@@ -1321,17 +2668,26 @@ static void function(FunctionType type)
 
 	ignoreNewlines();
 
+	// The parser is one token ahead
+	size_t bodyStart = parser.tokenOffset - 1;
+
 	// TODO: Empty functions don't parse correctly
 	block();
 
+	if (type == TYPE_FUNCTION && current->vm->executionMode == SOLIS_EXECUTION_REGISTER && !parser.hadError)
+		compileRegisterFunction(bodyStart);
+
 	ObjFunction* function = endCompiler(&compiler);
 
 	// emitConstant(SOLIS_OBJECT_VALUE(function));
 
 	// TODO: Only emit a closure when its not in global scope 
 
+	// Nothing refers to the function until it is a constant so add it before emitting can collect
+	uint16_t constant = makeConstant(SOLIS_OBJECT_VALUE(function));
+
 	emitByte(OP_CLOSURE);
-	emitShort(makeConstant(SOLIS_OBJECT_VALUE(function)));
+	emitShort(constant);
 
 	// Handle the upvalues
 
@@ -1364,6 +2720,7 @@ static void enumDeclaration()
 		ObjString* iden = solisCopyString(current->vm, parser.previous.start, parser.previous.length);
 
 		solisHashTableInsert(&enumObj->fields, iden, SOLIS_NUMERIC_VALUE((double)idx));
+		solisWriteBarrier(current->vm, (Object*)enumObj, SOLIS_OBJECT_VALUE(iden));
 
 		ignoreNewlines();
 
@@ -1606,6 +2963,7 @@ static void dot(bool canAssign)
 		expression();
 		emitByte(OP_SET_FIELD);
 		emitShort(name);
+		emitInlineCache();
 	}
 	else if (match(TOKEN_LEFT_PAREN))
 	{
@@ -1613,11 +2971,13 @@ static void dot(bool canAssign)
 		emitByte(OP_INVOKE);
 		emitShort(name);
 		emitByte(argCount);
+		emitInlineCache();
 	}
 	else
 	{
 		emitByte(OP_GET_FIELD);
 		emitShort(name);
+		emitInlineCache();
 	}
 }
 
@@ -1642,6 +3002,32 @@ static void arrayCreate(bool canAssign)
 
 }
 
+// Entries of a dictionary literal can be spread over lines
+static void dictionaryCreate(bool canAssign)
+{
+	emitByte(OP_CREATE_DICTIONARY);
+
+	ignoreNewlines();
+
+	while (!check(TOKEN_RIGHT_BRACE))
+	{
+		expression();
+		consume(TOKEN_COLON, "Expected ':' after dictionary key");
+		expression();
+
+		emitByte(OP_INSERT_DICTIONARY);
+
+		ignoreNewlines();
+
+		if (!match(TOKEN_COMMA))
+			break;
+
+		ignoreNewlines();
+	}
+
+	consume(TOKEN_RIGHT_BRACE, "Expected '}' at end of dictionary");
+}
+
 static void arrayAssign(bool canAssign)
 {
 	expression();
@@ -1675,12 +3061,15 @@ static void parsePrecedence(Precedence precedence)
 		return;
 	}
 
+	int leftStart = currentChunk()->count;
+
 	bool canAssign = precedence <= PREC_ASSIGNMENT;
 	prefixRule(canAssign);
 
 	while (precedence <= getRule(parser.current.type)->precedence) {
 		advance();
 		ParseFn infixRule = getRule(parser.previous.type)->infix;
+		current->infixLeftStart = leftStart;
 		infixRule(canAssign);
 	}
 
@@ -1729,7 +3118,7 @@ bool solisCompile(VM* vm, const char* source, ObjModule* mdl, const char* source
 
 
 	ObjFunction* function = endCompiler(&compiler);
-	solisFreeTokenList(&tokenList);
+	solisFreeTokenList(vm, &tokenList);
 	// return parser.hadError ? NULL : function;
 
 	solisPush(vm, SOLIS_OBJECT_VALUE(function));
@@ -1745,6 +3134,9 @@ void solisMarkCompilerRoots(VM* vm)
 {
 	Compiler* compiler = current;
 	while (compiler != NULL) {
+		// The compiler writes to its functions without a barrier
+		solisRememberObject(vm, (Object*)compiler->function);
+
 		markObject(vm, (Object*)compiler->function);
 
 		// markTable(vm, &compiler->globalTable);
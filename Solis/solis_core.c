@@ -1,5 +1,6 @@
 
 #include "solis_core.h"
+#include "solis_vecmath.h"
 #include "core.solis.inc"
 
 #include <float.h>
@@ -128,9 +129,7 @@ bool num_dotdot(VM* vm)
 
     if (SOLIS_IS_NUMERIC(obj2))
     {
-        Value rangeClass = solisGetGlobal(vm, "Range");
-
-        ObjInstance* inst = solisNewInstance(vm, SOLIS_AS_CLASS(rangeClass));
+        ObjInstance* inst = solisNewInstance(vm, vm->rangeClass);
 
         solisSetInstanceField(vm, SOLIS_OBJECT_VALUE(inst), "min", solisGetSelf(vm));
         solisSetInstanceField(vm, SOLIS_OBJECT_VALUE(inst), "max", obj2);
@@ -217,6 +216,7 @@ bool list_append(VM* vm)
     ObjList* list = SOLIS_AS_LIST(solisGetSelf(vm));
 
     solisValueBufferWrite(vm, &list->values, solisGetArgument(vm, 0));
+    solisWriteBarrier(vm, (Object*)list, solisGetArgument(vm, 0));
 
     solisSetReturnValue(vm, SOLIS_NULL_VALUE());
 
@@ -238,6 +238,7 @@ bool list_insert(VM* vm)
     memmove(&list->values.data[idx + 1], &list->values.data[idx], sizeof(Value) * moveCount);
 
     list->values.data[idx] = solisGetArgument(vm, 1);
+    solisWriteBarrier(vm, (Object*)list, solisGetArgument(vm, 1));
 
     solisSetReturnValue(vm, SOLIS_NULL_VALUE());
 
@@ -274,105 +275,1210 @@ bool list_operator_subscriptSet(VM* vm)
     // TODO: Safety checks
 
     list->values.data[idx] = val;
+    solisWriteBarrier(vm, (Object*)list, val);
 
     solisSetReturnValue(vm, SOLIS_NULL_VALUE());
 
     return true;
 }
 
+bool dictionary_construct(VM* vm)
+{
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(solisNewDictionary(vm)));
 
-bool os_getPlatformString(VM* vm)
+    return true;
+}
+
+bool dictionary_length(VM* vm)
 {
-    ObjString* str = solisCopyString(vm, SOLIS_PLATFORM_STRING, strlen(SOLIS_PLATFORM_STRING));
+    ObjDictionary* dictionary = SOLIS_AS_DICTIONARY(solisGetSelf(vm));
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE((double)dictionary->table.count));
 
-    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(str));
+    return true;
+}
+
+bool dictionary_has(VM* vm)
+{
+    ObjDictionary* dictionary = SOLIS_AS_DICTIONARY(solisGetSelf(vm));
+
+    Value value;
+    bool found = solisValueTableGet(&dictionary->table, solisGetArgument(vm, 0), &value);
+
+    solisSetReturnValue(vm, SOLIS_BOOL_VALUE(found));
 
     return true;
 }
 
-bool ffi_loadLibrary(VM* vm)
+bool dictionary_remove(VM* vm)
 {
-    Value path = solisGetArgument(vm, 0);
+    ObjDictionary* dictionary = SOLIS_AS_DICTIONARY(solisGetSelf(vm));
+    bool removed = solisValueTableDelete(&dictionary->table, solisGetArgument(vm, 0));
 
-    LibraryHandle handle = solisOpenLibrary(SOLIS_AS_CSTRING(path));
+    solisSetReturnValue(vm, SOLIS_BOOL_VALUE(removed));
 
-    if (!handle)
+    return true;
+}
+
+// Collects the keys or the values into a new list, in slot order
+static bool dictionaryToList(VM* vm, bool keys)
+{
+    ObjList* list = solisNewList(vm);
+    solisPush(vm, SOLIS_OBJECT_VALUE(list));
+
+    ValueTable* table = &SOLIS_AS_DICTIONARY(solisGetSelf(vm))->table;
+
+    for (int i = 0; i < table->capacity; i++)
     {
-        // Failed to load the library
-        solisVMRaiseError(vm, "Failed to find and load library: %s\n", SOLIS_AS_CSTRING(path));
+        if (!solisValueTableOccupied(table, i))
+            continue;
+
+        Value value = keys ? table->entries[i].key : table->entries[i].value;
+
+        solisValueBufferWrite(vm, &list->values, value);
+        solisWriteBarrier(vm, (Object*)list, value);
+    }
+
+    solisPop(vm);
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(list));
+
+    return true;
+}
+
+bool dictionary_keys(VM* vm)
+{
+    return dictionaryToList(vm, true);
+}
+
+bool dictionary_values(VM* vm)
+{
+    return dictionaryToList(vm, false);
+}
+
+bool dictionary_operator_subscriptGet(VM* vm)
+{
+    ObjDictionary* dictionary = SOLIS_AS_DICTIONARY(solisGetSelf(vm));
+
+    Value value;
+    if (!solisValueTableGet(&dictionary->table, solisGetArgument(vm, 0), &value))
+        value = SOLIS_NULL_VALUE();
+
+    solisSetReturnValue(vm, value);
+
+    return true;
+}
+
+bool dictionary_operator_subscriptSet(VM* vm)
+{
+    ObjDictionary* dictionary = SOLIS_AS_DICTIONARY(solisGetSelf(vm));
+
+    solisDictionarySet(vm, dictionary, solisGetArgument(vm, 0), solisGetArgument(vm, 1));
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+bool weakref_construct(VM* vm)
+{
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(solisNewWeakRef(vm, solisGetArgument(vm, 0))));
+
+    return true;
+}
+
+bool weakref_get(VM* vm)
+{
+    ObjWeakRef* ref = SOLIS_AS_WEAK_REF(solisGetSelf(vm));
+    solisSetReturnValue(vm, ref->target);
+
+    return true;
+}
 
+bool weaktable_construct(VM* vm)
+{
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(solisNewWeakTable(vm)));
+
+    return true;
+}
+
+bool weaktable_length(VM* vm)
+{
+    ObjWeakTable* weak = SOLIS_AS_WEAK_TABLE(solisGetSelf(vm));
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE((double)weak->table.count));
+
+    return true;
+}
+
+bool weaktable_has(VM* vm)
+{
+    ObjWeakTable* weak = SOLIS_AS_WEAK_TABLE(solisGetSelf(vm));
+
+    Value value;
+    bool found = solisValueTableGet(&weak->table, solisGetArgument(vm, 0), &value);
+
+    solisSetReturnValue(vm, SOLIS_BOOL_VALUE(found));
+
+    return true;
+}
+
+bool weaktable_remove(VM* vm)
+{
+    ObjWeakTable* weak = SOLIS_AS_WEAK_TABLE(solisGetSelf(vm));
+    bool removed = solisValueTableDelete(&weak->table, solisGetArgument(vm, 0));
+
+    solisSetReturnValue(vm, SOLIS_BOOL_VALUE(removed));
+
+    return true;
+}
+
+bool weaktable_operator_subscriptGet(VM* vm)
+{
+    ObjWeakTable* weak = SOLIS_AS_WEAK_TABLE(solisGetSelf(vm));
+
+    Value value;
+    if (!solisValueTableGet(&weak->table, solisGetArgument(vm, 0), &value))
+        value = SOLIS_NULL_VALUE();
+
+    solisSetReturnValue(vm, value);
+
+    return true;
+}
+
+bool weaktable_operator_subscriptSet(VM* vm)
+{
+    ObjWeakTable* weak = SOLIS_AS_WEAK_TABLE(solisGetSelf(vm));
+    Value key = solisGetArgument(vm, 0);
+    Value value = solisGetArgument(vm, 1);
+
+    solisValueTableSet(vm, &weak->table, key, value);
+    solisWriteBarrier(vm, (Object*)weak, key);
+    solisWriteBarrier(vm, (Object*)weak, value);
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+static const char* typedArrayClassNames[SOLIS_ARRAY_KIND_COUNT] = {
+    [SOLIS_ARRAY_FLOAT64] = "Float64Array",
+    [SOLIS_ARRAY_FLOAT32] = "Float32Array",
+    [SOLIS_ARRAY_INT32] = "Int32Array",
+};
+
+static bool checkNumberArgument(VM* vm, int argIndex, double* number)
+{
+    Value value = solisGetArgument(vm, argIndex);
+
+    if (!SOLIS_IS_NUMERIC(value))
+    {
+        solisVMRaiseError(vm, "Expected a number\n");
         return false;
     }
 
+    *number = SOLIS_AS_NUMBER(value);
+    return true;
+}
 
-    // We want to grab solis_openlib
+// Operations between two typed arrays need them to have the same element type and length
+static ObjTypedArray* checkMatchingArray(VM* vm, ObjTypedArray* array, int argIndex)
+{
+    Value value = solisGetArgument(vm, argIndex);
 
-    SolisNativeSignature openlib = (SolisNativeSignature)solisGetProcAddress(handle, "solis_openlib");
+    if (!SOLIS_IS_TYPED_ARRAY(value) || SOLIS_AS_TYPED_ARRAY(value)->kind != array->kind)
+    {
+        solisVMRaiseError(vm, "Expected a %s\n", typedArrayClassNames[array->kind]);
+        return NULL;
+    }
 
-    if (!openlib)
+    ObjTypedArray* other = SOLIS_AS_TYPED_ARRAY(value);
+
+    if (other->count != array->count)
     {
-        solisVMRaiseError(vm, "Failed to find solis_openlib function in library: %s\n", SOLIS_AS_CSTRING(path));
+        solisVMRaiseError(vm, "Typed arrays have different lengths, %d and %d\n", array->count, other->count);
+        return NULL;
+    }
+
+    return other;
+}
+
+static bool checkArrayIndex(VM* vm, ObjTypedArray* array, Value indexValue, int* index)
+{
+    if (!SOLIS_IS_NUMERIC(indexValue))
+    {
+        solisVMRaiseError(vm, "Typed array index must be a number\n");
         return false;
     }
 
-    ObjNative* nativeFunc = solisNewNativeFunction(vm, openlib);
+    double i = SOLIS_AS_NUMBER(indexValue);
 
-    // return it
-    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(nativeFunc));
+    if (!(i >= 0.0 && i < (double)array->count))
+    {
+        solisVMRaiseError(vm, "Index %g is out of range for a typed array of length %d\n", i, array->count);
+        return false;
+    }
 
+    *index = (int)i;
     return true;
-
 }
 
-void solisInitialiseCore(VM* vm, bool sandboxed)
+// Shared by every typed array class, self is the class being constructed
+bool typedarray_construct(VM* vm)
 {
-    // const char* str = read_file_into_cstring("F:/Dev/Solis/Solis/core.solis");
+    ObjClass* klass = SOLIS_AS_CLASS(solisGetSelf(vm));
 
-    solisPushGlobalCFunction(vm, "__c_printf", core_printf, 1);
+    SolisArrayKind kind = SOLIS_ARRAY_FLOAT64;
+    for (int i = 0; i < SOLIS_ARRAY_KIND_COUNT; i++)
+    {
+        if (vm->typedArrayClasses[i] == klass)
+            kind = (SolisArrayKind)i;
+    }
+
+    Value arg = solisGetArgument(vm, 0);
 
+    if (SOLIS_IS_NUMERIC(arg))
+    {
+        double length = SOLIS_AS_NUMBER(arg);
 
-    InterpretResult result = solisInterpret(vm, coreModuleSource, "Core");
+        if (!(length >= 0.0 && length <= (double)(INT32_MAX / sizeof(double))) || length != floor(length))
+        {
+            solisVMRaiseError(vm, "Typed array length must be a whole number from 0\n");
+            return false;
+        }
 
-    if (result == INTERPRET_RUNTIME_ERROR || result == INTERPRET_COMPILE_ERROR)
+        solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(solisNewTypedArray(vm, kind, (int)length)));
+        return true;
+    }
+
+    if (SOLIS_IS_LIST(arg))
     {
-        printf("Error running core module\n");
-        return;
+        // The list is still an argument on the stack so creating the array can't collect it
+        ObjList* list = SOLIS_AS_LIST(arg);
+        ObjTypedArray* array = solisNewTypedArray(vm, kind, list->values.count);
+
+        for (int i = 0; i < list->values.count; i++)
+        {
+            Value value = list->values.data[i];
+
+            if (!SOLIS_IS_NUMERIC(value))
+            {
+                solisVMRaiseError(vm, "Typed arrays can only hold numbers\n");
+                return false;
+            }
+
+            solisTypedArraySet(array, i, SOLIS_AS_NUMBER(value));
+        }
+
+        solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(array));
+        return true;
     }
 
-    vm->numberClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "Number"));
+    solisVMRaiseError(vm, "Expected a length or a list of numbers\n");
+    return false;
+}
 
-    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "MIN", true, SOLIS_NUMERIC_VALUE(DBL_MIN));
-    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "MAX", true, SOLIS_NUMERIC_VALUE(DBL_MAX));
-    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "PI", true, SOLIS_NUMERIC_VALUE(3.14159265358979323846));
-    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "TAU", true, SOLIS_NUMERIC_VALUE(6.283185307179586));
+bool typedarray_length(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE((double)array->count));
 
-    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "toString", num_toString, 0);
-    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "truncate", num_truncate, 0);
+    return true;
+}
 
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_ADD, num_add);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_MINUS, num_minus);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_STAR, num_mul);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_SLASH, num_div);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_POWER, num_pow);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_SLASH_SLASH, num_int_divide);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_DOTDOT, num_dotdot);
+bool typedarray_fill(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
 
-    vm->stringClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "String"));
+    double value;
+    if (!checkNumberArgument(vm, 0, &value))
+        return false;
 
-    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->stringClass), "length", string_length, 0);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->stringClass), OPERATOR_ADD, string_add);
+    solisGetArrayKernels(array->kind)->fill(array->data, array->count, value);
 
-    vm->boolClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "Bool"));
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
 
-    vm->listClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "List"));
+    return true;
+}
 
-    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "at", list_at, 1);
-    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "length", list_length, 0);
-    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "append", list_append, 1);
-    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "insert", list_insert, 2);
+bool typedarray_sum(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+    double sum = solisGetArrayKernels(array->kind)->sum(array->data, array->count);
 
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->listClass), OPERATOR_SUBSCRIPT_GET, list_operator_subscriptGet);
-    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->listClass), OPERATOR_SUBSCRIPT_SET, list_operator_subscriptSet);
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(sum));
+
+    return true;
+}
+
+// An empty array has no smallest or largest element so they give null
+bool typedarray_min(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    if (array->count == 0)
+        solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+    else
+        solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(solisGetArrayKernels(array->kind)->min(array->data, array->count)));
+
+    return true;
+}
+
+bool typedarray_max(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    if (array->count == 0)
+        solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+    else
+        solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(solisGetArrayKernels(array->kind)->max(array->data, array->count)));
+
+    return true;
+}
+
+bool typedarray_dot(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    ObjTypedArray* other = checkMatchingArray(vm, array, 0);
+    if (other == NULL)
+        return false;
+
+    double dot = solisGetArrayKernels(array->kind)->dot(array->data, other->data, array->count);
+
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(dot));
+
+    return true;
+}
+
+// self = self + a * x
+bool typedarray_axpy(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    double a;
+    if (!checkNumberArgument(vm, 0, &a))
+        return false;
+
+    ObjTypedArray* x = checkMatchingArray(vm, array, 1);
+    if (x == NULL)
+        return false;
+
+    solisGetArrayKernels(array->kind)->axpy(array->data, x->data, a, array->count);
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+bool typedarray_scale(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    double a;
+    if (!checkNumberArgument(vm, 0, &a))
+        return false;
+
+    solisGetArrayKernels(array->kind)->scale(array->data, a, array->count);
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+bool typedarray_add(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    ObjTypedArray* other = checkMatchingArray(vm, array, 0);
+    if (other == NULL)
+        return false;
+
+    solisGetArrayKernels(array->kind)->add(array->data, other->data, array->count);
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+bool typedarray_mul(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    ObjTypedArray* other = checkMatchingArray(vm, array, 0);
+    if (other == NULL)
+        return false;
+
+    solisGetArrayKernels(array->kind)->mul(array->data, other->data, array->count);
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+bool typedarray_toList(VM* vm)
+{
+    ObjList* list = solisNewList(vm);
+    solisPush(vm, SOLIS_OBJECT_VALUE(list));
+
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    for (int i = 0; i < array->count; i++)
+        solisValueBufferWrite(vm, &list->values, SOLIS_NUMERIC_VALUE(solisTypedArrayGet(array, i)));
+
+    solisPop(vm);
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(list));
+
+    return true;
+}
+
+bool typedarray_operator_subscriptGet(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    int index;
+    if (!checkArrayIndex(vm, array, solisGetArgument(vm, 0), &index))
+        return false;
+
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(solisTypedArrayGet(array, index)));
+
+    return true;
+}
+
+bool typedarray_operator_subscriptSet(VM* vm)
+{
+    ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(solisGetSelf(vm));
+
+    int index;
+    if (!checkArrayIndex(vm, array, solisGetArgument(vm, 0), &index))
+        return false;
+
+    double value;
+    if (!checkNumberArgument(vm, 1, &value))
+        return false;
+
+    solisTypedArraySet(array, index, value);
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+static const char* vectorClassNames[3] = { "Vec2", "Vec3", "Vec4" };
+
+// Vectors of the same size as self for methods that take another vector
+static ObjVector* checkMatchingVector(VM* vm, ObjVector* vector, int argIndex)
+{
+    Value value = solisGetArgument(vm, argIndex);
+
+    if (!SOLIS_IS_VECTOR(value) || SOLIS_AS_VECTOR(value)->size != vector->size)
+    {
+        solisVMRaiseError(vm, "Expected a %s\n", vectorClassNames[vector->size - 2]);
+        return NULL;
+    }
+
+    return SOLIS_AS_VECTOR(value);
+}
+
+static double vectorDot(ObjVector* a, ObjVector* b)
+{
+    double sum = 0.0;
+    for (int i = 0; i < a->size; i++)
+        sum += a->v[i] * b->v[i];
+
+    return sum;
+}
+
+// Shared by every vector class, takes no components, one to fill every component or one for each
+bool vector_construct(VM* vm)
+{
+    ObjClass* klass = SOLIS_AS_CLASS(solisGetSelf(vm));
+    int argCount = solisGetArgumentCount(vm);
+
+    int size = 4;
+    for (int i = 0; i < 3; i++)
+    {
+        if (vm->vectorClasses[i] == klass)
+            size = i + 2;
+    }
+
+    if (argCount != 0 && argCount != 1 && argCount != size)
+    {
+        solisVMRaiseError(vm, "%s takes 0, 1 or %d components, got %d\n", vectorClassNames[size - 2], size, argCount);
+        return false;
+    }
+
+    double components[4] = { 0.0, 0.0, 0.0, 0.0 };
+    for (int i = 0; i < argCount; i++)
+    {
+        if (!checkNumberArgument(vm, i, &components[i]))
+            return false;
+    }
+
+    ObjVector* vector = solisNewVector(vm, size);
+    for (int i = 0; i < size; i++)
+        vector->v[i] = argCount == 1 ? components[0] : components[i];
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(vector));
+
+    return true;
+}
+
+bool vector_dot(VM* vm)
+{
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+
+    ObjVector* other = checkMatchingVector(vm, vector, 0);
+    if (other == NULL)
+        return false;
+
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(vectorDot(vector, other)));
+
+    return true;
+}
+
+bool vector_length(VM* vm)
+{
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(sqrt(vectorDot(vector, vector))));
+
+    return true;
+}
+
+bool vector_lengthSquared(VM* vm)
+{
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(vectorDot(vector, vector)));
+
+    return true;
+}
+
+// A zero vector stays zero rather than becoming NaN
+bool vector_normalize(VM* vm)
+{
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+    ObjVector* result = solisNewVector(vm, vector->size);
+
+    double length = sqrt(vectorDot(vector, vector));
+    if (length > 0.0)
+    {
+        for (int i = 0; i < vector->size; i++)
+            result->v[i] = vector->v[i] / length;
+    }
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(result));
+
+    return true;
+}
+
+bool vector_distance(VM* vm)
+{
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+
+    ObjVector* other = checkMatchingVector(vm, vector, 0);
+    if (other == NULL)
+        return false;
+
+    double sum = 0.0;
+    for (int i = 0; i < vector->size; i++)
+        sum += (vector->v[i] - other->v[i]) * (vector->v[i] - other->v[i]);
+
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(sqrt(sum)));
+
+    return true;
+}
+
+bool vector_lerp(VM* vm)
+{
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+
+    ObjVector* other = checkMatchingVector(vm, vector, 0);
+    if (other == NULL)
+        return false;
+
+    double t;
+    if (!checkNumberArgument(vm, 1, &t))
+        return false;
+
+    ObjVector* result = solisNewVector(vm, vector->size);
+    for (int i = 0; i < vector->size; i++)
+        result->v[i] = vector->v[i] + (other->v[i] - vector->v[i]) * t;
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(result));
+
+    return true;
+}
+
+// Only registered on Vec3
+bool vector_cross(VM* vm)
+{
+    ObjVector* a = SOLIS_AS_VECTOR(solisGetSelf(vm));
+
+    ObjVector* b = checkMatchingVector(vm, a, 0);
+    if (b == NULL)
+        return false;
+
+    ObjVector* result = solisNewVector(vm, 3);
+    result->v[0] = a->v[1] * b->v[2] - a->v[2] * b->v[1];
+    result->v[1] = a->v[2] * b->v[0] - a->v[0] * b->v[2];
+    result->v[2] = a->v[0] * b->v[1] - a->v[1] * b->v[0];
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(result));
+
+    return true;
+}
+
+bool vector_toList(VM* vm)
+{
+    ObjList* list = solisNewList(vm);
+    solisPush(vm, SOLIS_OBJECT_VALUE(list));
+
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+
+    for (int i = 0; i < vector->size; i++)
+        solisValueBufferWrite(vm, &list->values, SOLIS_NUMERIC_VALUE(vector->v[i]));
+
+    solisPop(vm);
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(list));
+
+    return true;
+}
+
+// The VM does vector and matrix arithmetic itself, these are reached when an operator is looked up by hand
+static bool vectorOperator(VM* vm, int op)
+{
+    Value result;
+    if (!solisVectorArithmetic(vm, op, solisGetSelf(vm), solisGetArgument(vm, 0), &result))
+    {
+        solisVMRaiseError(vm, "Operator %s isn't supported between these values\n", vm->operatorStrings[op]->chars);
+        return false;
+    }
+
+    solisSetReturnValue(vm, result);
+
+    return true;
+}
+
+bool vector_operator_add(VM* vm)
+{
+    return vectorOperator(vm, OPERATOR_ADD);
+}
+
+bool vector_operator_minus(VM* vm)
+{
+    return vectorOperator(vm, OPERATOR_MINUS);
+}
+
+bool vector_operator_star(VM* vm)
+{
+    return vectorOperator(vm, OPERATOR_STAR);
+}
+
+bool vector_operator_slash(VM* vm)
+{
+    return vectorOperator(vm, OPERATOR_SLASH);
+}
+
+bool vector_operator_subscriptGet(VM* vm)
+{
+    ObjVector* vector = SOLIS_AS_VECTOR(solisGetSelf(vm));
+
+    double index;
+    if (!checkNumberArgument(vm, 0, &index))
+        return false;
+
+    if (!(index >= 0.0 && index < (double)vector->size))
+    {
+        solisVMRaiseError(vm, "Index %g is out of range for a %s\n", index, vectorClassNames[vector->size - 2]);
+        return false;
+    }
+
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(vector->v[(int)index]));
+
+    return true;
+}
+
+static void setIdentity(ObjMatrix* matrix)
+{
+    for (int i = 0; i < 16; i++)
+        matrix->m[i] = (i % 5 == 0) ? 1.0 : 0.0;
+}
+
+// Takes nothing for the identity or a list of 16 numbers in column major order
+bool matrix_construct(VM* vm)
+{
+    int argCount = solisGetArgumentCount(vm);
+
+    if (argCount == 0)
+    {
+        ObjMatrix* matrix = solisNewMatrix(vm);
+        setIdentity(matrix);
+
+        solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(matrix));
+        return true;
+    }
+
+    Value arg = solisGetArgument(vm, 0);
+
+    if (argCount != 1 || !SOLIS_IS_LIST(arg) || SOLIS_AS_LIST(arg)->values.count != 16)
+    {
+        solisVMRaiseError(vm, "Expected a list of 16 numbers\n");
+        return false;
+    }
+
+    ObjList* list = SOLIS_AS_LIST(arg);
+    ObjMatrix* matrix = solisNewMatrix(vm);
+
+    for (int i = 0; i < 16; i++)
+    {
+        Value value = list->values.data[i];
+
+        if (!SOLIS_IS_NUMERIC(value))
+        {
+            solisVMRaiseError(vm, "Expected a list of 16 numbers\n");
+            return false;
+        }
+
+        matrix->m[i] = SOLIS_AS_NUMBER(value);
+    }
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(matrix));
+
+    return true;
+}
+
+bool matrix_identity(VM* vm)
+{
+    ObjMatrix* matrix = solisNewMatrix(vm);
+    setIdentity(matrix);
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(matrix));
+
+    return true;
+}
+
+bool matrix_translation(VM* vm)
+{
+    double x, y, z;
+    if (!checkNumberArgument(vm, 0, &x) || !checkNumberArgument(vm, 1, &y) || !checkNumberArgument(vm, 2, &z))
+        return false;
+
+    ObjMatrix* matrix = solisNewMatrix(vm);
+    setIdentity(matrix);
+    matrix->m[12] = x;
+    matrix->m[13] = y;
+    matrix->m[14] = z;
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(matrix));
+
+    return true;
+}
+
+bool matrix_scaling(VM* vm)
+{
+    double x, y, z;
+    if (!checkNumberArgument(vm, 0, &x) || !checkNumberArgument(vm, 1, &y) || !checkNumberArgument(vm, 2, &z))
+        return false;
+
+    ObjMatrix* matrix = solisNewMatrix(vm);
+    matrix->m[0] = x;
+    matrix->m[5] = y;
+    matrix->m[10] = z;
+    matrix->m[15] = 1.0;
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(matrix));
+
+    return true;
+}
+
+// Rotations are counter clockwise in radians looking down the axis towards the origin
+static bool makeRotation(VM* vm, int axis)
+{
+    double angle;
+    if (!checkNumberArgument(vm, 0, &angle))
+        return false;
+
+    double c = cos(angle);
+    double s = sin(angle);
+
+    // The two axes that turn, the first goes towards the second
+    int a = (axis + 1) % 3;
+    int b = (axis + 2) % 3;
+
+    ObjMatrix* matrix = solisNewMatrix(vm);
+    setIdentity(matrix);
+    matrix->m[a * 4 + a] = c;
+    matrix->m[a * 4 + b] = s;
+    matrix->m[b * 4 + a] = -s;
+    matrix->m[b * 4 + b] = c;
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(matrix));
+
+    return true;
+}
+
+bool matrix_rotationX(VM* vm)
+{
+    return makeRotation(vm, 0);
+}
+
+bool matrix_rotationY(VM* vm)
+{
+    return makeRotation(vm, 1);
+}
+
+bool matrix_rotationZ(VM* vm)
+{
+    return makeRotation(vm, 2);
+}
+
+bool matrix_transpose(VM* vm)
+{
+    ObjMatrix* matrix = SOLIS_AS_MATRIX(solisGetSelf(vm));
+    ObjMatrix* result = solisNewMatrix(vm);
+
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+            result->m[row * 4 + column] = matrix->m[column * 4 + row];
+    }
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(result));
+
+    return true;
+}
+
+bool matrix_at(VM* vm)
+{
+    ObjMatrix* matrix = SOLIS_AS_MATRIX(solisGetSelf(vm));
+
+    double row, column;
+    if (!checkNumberArgument(vm, 0, &row) || !checkNumberArgument(vm, 1, &column))
+        return false;
+
+    if (!(row >= 0.0 && row < 4.0 && column >= 0.0 && column < 4.0))
+    {
+        solisVMRaiseError(vm, "Row %g and column %g are out of range for a Mat4\n", row, column);
+        return false;
+    }
+
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE(matrix->m[(int)column * 4 + (int)row]));
+
+    return true;
+}
+
+bool matrix_toList(VM* vm)
+{
+    ObjList* list = solisNewList(vm);
+    solisPush(vm, SOLIS_OBJECT_VALUE(list));
+
+    ObjMatrix* matrix = SOLIS_AS_MATRIX(solisGetSelf(vm));
+
+    for (int i = 0; i < 16; i++)
+        solisValueBufferWrite(vm, &list->values, SOLIS_NUMERIC_VALUE(matrix->m[i]));
+
+    solisPop(vm);
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(list));
+
+    return true;
+}
+
+// Takes nothing or a string to start with
+bool stringbuilder_construct(VM* vm)
+{
+    int argCount = solisGetArgumentCount(vm);
+    Value initial = solisGetArgument(vm, 0);
+
+    if (argCount > 1 || (argCount == 1 && !SOLIS_IS_STRING(initial)))
+    {
+        solisVMRaiseError(vm, "Expected nothing or a string to start the StringBuilder with\n");
+        return false;
+    }
+
+    ObjStringBuilder* builder = solisNewStringBuilder(vm);
+    solisPush(vm, SOLIS_OBJECT_VALUE(builder));
+
+    if (argCount == 1)
+        solisStringBuilderAppend(vm, builder, SOLIS_AS_STRING(initial)->chars, SOLIS_AS_STRING(initial)->length);
+
+    solisPop(vm);
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(builder));
+
+    return true;
+}
+
+// Returns the builder so appends can be chained
+bool stringbuilder_append(VM* vm)
+{
+    ObjStringBuilder* builder = SOLIS_AS_STRING_BUILDER(solisGetSelf(vm));
+    Value value = solisGetArgument(vm, 0);
+
+    if (SOLIS_IS_STRING(value))
+        solisStringBuilderAppend(vm, builder, SOLIS_AS_STRING(value)->chars, SOLIS_AS_STRING(value)->length);
+    else if (SOLIS_IS_STRING_BUILDER(value))
+        solisStringBuilderAppend(vm, builder, SOLIS_AS_STRING_BUILDER(value)->chars, SOLIS_AS_STRING_BUILDER(value)->length);
+    else if (SOLIS_IS_NUMERIC(value))
+    {
+        // The same format as Number.toString
+        char buffer[24];
+        int length = sprintf(buffer, "%.14g", SOLIS_AS_NUMBER(value));
+        solisStringBuilderAppend(vm, builder, buffer, length);
+    }
+    else if (SOLIS_IS_BOOL(value))
+    {
+        if (SOLIS_AS_BOOL(value))
+            solisStringBuilderAppend(vm, builder, "true", 4);
+        else
+            solisStringBuilderAppend(vm, builder, "false", 5);
+    }
+    else if (SOLIS_IS_NULL(value))
+        solisStringBuilderAppend(vm, builder, "null", 4);
+    else
+    {
+        const char* type = SOLIS_IS_OBJECT(value) ? solisObjectTypeName((ObjectType)SOLIS_AS_OBJECT(value)->type) : "value";
+        solisVMRaiseError(vm, "StringBuilder can't append a %s, call toString on it first\n", type);
+        return false;
+    }
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(builder));
+
+    return true;
+}
+
+bool stringbuilder_length(VM* vm)
+{
+    ObjStringBuilder* builder = SOLIS_AS_STRING_BUILDER(solisGetSelf(vm));
+    solisSetReturnValue(vm, SOLIS_NUMERIC_VALUE((double)builder->length));
+
+    return true;
+}
+
+// Keeps the buffer so the builder can be filled again without growing
+bool stringbuilder_clear(VM* vm)
+{
+    ObjStringBuilder* builder = SOLIS_AS_STRING_BUILDER(solisGetSelf(vm));
+    builder->length = 0;
+
+    solisSetReturnValue(vm, SOLIS_NULL_VALUE());
+
+    return true;
+}
+
+bool stringbuilder_toString(VM* vm)
+{
+    ObjStringBuilder* builder = SOLIS_AS_STRING_BUILDER(solisGetSelf(vm));
+
+    const char* chars = builder->chars != NULL ? builder->chars : "";
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(solisCopyString(vm, chars, builder->length)));
+
+    return true;
+}
+
+bool os_getPlatformString(VM* vm)
+{
+    ObjString* str = solisCopyString(vm, SOLIS_PLATFORM_STRING, strlen(SOLIS_PLATFORM_STRING));
+
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(str));
+
+    return true;
+}
+
+bool ffi_loadLibrary(VM* vm)
+{
+    Value path = solisGetArgument(vm, 0);
+
+    LibraryHandle handle = solisOpenLibrary(SOLIS_AS_CSTRING(path));
+
+    if (!handle)
+    {
+        // Failed to load the library
+        solisVMRaiseError(vm, "Failed to find and load library: %s\n", SOLIS_AS_CSTRING(path));
+
+        return false;
+    }
+
+
+    // We want to grab solis_openlib
+
+    SolisNativeSignature openlib = (SolisNativeSignature)solisGetProcAddress(handle, "solis_openlib");
+
+    if (!openlib)
+    {
+        solisVMRaiseError(vm, "Failed to find solis_openlib function in library: %s\n", SOLIS_AS_CSTRING(path));
+        return false;
+    }
+
+    ObjNative* nativeFunc = solisNewNativeFunction(vm, openlib);
+
+    // return it
+    solisSetReturnValue(vm, SOLIS_OBJECT_VALUE(nativeFunc));
+
+    return true;
+
+}
+
+void solisInitialiseCore(VM* vm, bool sandboxed, const char* cachePath)
+{
+    // const char* str = read_file_into_cstring("F:/Dev/Solis/Solis/core.solis");
+
+    solisPushGlobalCFunction(vm, "__c_printf", core_printf, 1);
+
+
+    InterpretResult result;
+    if (cachePath != NULL)
+        result = solisInterpretCached(vm, coreModuleSource, "Core", cachePath);
+    else
+        result = solisInterpret(vm, coreModuleSource, "Core");
+
+    if (result == INTERPRET_RUNTIME_ERROR || result == INTERPRET_COMPILE_ERROR)
+    {
+        printf("Error running core module\n");
+        return;
+    }
+
+    vm->numberClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "Number"));
+
+    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "MIN", true, SOLIS_NUMERIC_VALUE(DBL_MIN));
+    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "MAX", true, SOLIS_NUMERIC_VALUE(DBL_MAX));
+    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "PI", true, SOLIS_NUMERIC_VALUE(3.14159265358979323846));
+    solisAddClassField(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "TAU", true, SOLIS_NUMERIC_VALUE(6.283185307179586));
+
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "toString", num_toString, 0);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->numberClass), "truncate", num_truncate, 0);
+
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_ADD, num_add);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_MINUS, num_minus);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_STAR, num_mul);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_SLASH, num_div);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_POWER, num_pow);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_SLASH_SLASH, num_int_divide);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->numberClass), OPERATOR_DOTDOT, num_dotdot);
+
+    vm->stringClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "String"));
+
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->stringClass), "length", string_length, 0);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->stringClass), OPERATOR_ADD, string_add);
+
+    vm->boolClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "Bool"));
+
+    vm->listClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "List"));
+
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "at", list_at, 1);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "length", list_length, 0);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "append", list_append, 1);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->listClass), "insert", list_insert, 2);
+
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->listClass), OPERATOR_SUBSCRIPT_GET, list_operator_subscriptGet);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->listClass), OPERATOR_SUBSCRIPT_SET, list_operator_subscriptSet);
+
+    vm->rangeClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "Range"));
+
+    vm->rangeMinSlot = solisGetFieldSlot(vm->rangeClass, solisCopyString(vm, "min", 3));
+    vm->rangeMaxSlot = solisGetFieldSlot(vm->rangeClass, solisCopyString(vm, "max", 3));
+    vm->rangeStepSlot = solisGetFieldSlot(vm->rangeClass, solisCopyString(vm, "step", 4));
+
+    vm->stopIterationClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "StopIteration"));
+
+    vm->dictionaryClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "Dictionary"));
+
+    solisAddClassNativeConstructor(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), dictionary_construct);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), "length", dictionary_length, 0);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), "has", dictionary_has, 1);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), "remove", dictionary_remove, 1);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), "keys", dictionary_keys, 0);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), "values", dictionary_values, 0);
+
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), OPERATOR_SUBSCRIPT_GET, dictionary_operator_subscriptGet);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->dictionaryClass), OPERATOR_SUBSCRIPT_SET, dictionary_operator_subscriptSet);
+
+    vm->weakRefClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "WeakRef"));
+
+    solisAddClassNativeConstructor(vm, SOLIS_OBJECT_VALUE(vm->weakRefClass), weakref_construct);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->weakRefClass), "get", weakref_get, 0);
+
+    vm->weakTableClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "WeakTable"));
+
+    solisAddClassNativeConstructor(vm, SOLIS_OBJECT_VALUE(vm->weakTableClass), weaktable_construct);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->weakTableClass), "length", weaktable_length, 0);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->weakTableClass), "has", weaktable_has, 1);
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->weakTableClass), "remove", weaktable_remove, 1);
+
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->weakTableClass), OPERATOR_SUBSCRIPT_GET, weaktable_operator_subscriptGet);
+    solisAddClassNativeOperator(vm, SOLIS_OBJECT_VALUE(vm->weakTableClass), OPERATOR_SUBSCRIPT_SET, weaktable_operator_subscriptSet);
+
+    for (int i = 0; i < SOLIS_ARRAY_KIND_COUNT; i++)
+    {
+        vm->typedArrayClasses[i] = SOLIS_AS_CLASS(solisGetGlobal(vm, typedArrayClassNames[i]));
+
+        Value klass = SOLIS_OBJECT_VALUE(vm->typedArrayClasses[i]);
+
+        solisAddClassNativeConstructor(vm, klass, typedarray_construct);
+        solisAddClassNativeMethod(vm, klass, "length", typedarray_length, 0);
+        solisAddClassNativeMethod(vm, klass, "fill", typedarray_fill, 1);
+        solisAddClassNativeMethod(vm, klass, "sum", typedarray_sum, 0);
+        solisAddClassNativeMethod(vm, klass, "min", typedarray_min, 0);
+        solisAddClassNativeMethod(vm, klass, "max", typedarray_max, 0);
+        solisAddClassNativeMethod(vm, klass, "dot", typedarray_dot, 1);
+        solisAddClassNativeMethod(vm, klass, "axpy", typedarray_axpy, 2);
+        solisAddClassNativeMethod(vm, klass, "scale", typedarray_scale, 1);
+        solisAddClassNativeMethod(vm, klass, "add", typedarray_add, 1);
+        solisAddClassNativeMethod(vm, klass, "mul", typedarray_mul, 1);
+        solisAddClassNativeMethod(vm, klass, "toList", typedarray_toList, 0);
+
+        solisAddClassNativeOperator(vm, klass, OPERATOR_SUBSCRIPT_GET, typedarray_operator_subscriptGet);
+        solisAddClassNativeOperator(vm, klass, OPERATOR_SUBSCRIPT_SET, typedarray_operator_subscriptSet);
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        vm->vectorClasses[i] = SOLIS_AS_CLASS(solisGetGlobal(vm, vectorClassNames[i]));
+
+        Value klass = SOLIS_OBJECT_VALUE(vm->vectorClasses[i]);
+
+        solisAddClassNativeConstructor(vm, klass, vector_construct);
+        solisAddClassNativeMethod(vm, klass, "dot", vector_dot, 1);
+        solisAddClassNativeMethod(vm, klass, "length", vector_length, 0);
+        solisAddClassNativeMethod(vm, klass, "lengthSquared", vector_lengthSquared, 0);
+        solisAddClassNativeMethod(vm, klass, "normalize", vector_normalize, 0);
+        solisAddClassNativeMethod(vm, klass, "distance", vector_distance, 1);
+        solisAddClassNativeMethod(vm, klass, "lerp", vector_lerp, 2);
+        solisAddClassNativeMethod(vm, klass, "toList", vector_toList, 0);
+
+        solisAddClassNativeOperator(vm, klass, OPERATOR_ADD, vector_operator_add);
+        solisAddClassNativeOperator(vm, klass, OPERATOR_MINUS, vector_operator_minus);
+        solisAddClassNativeOperator(vm, klass, OPERATOR_STAR, vector_operator_star);
+        solisAddClassNativeOperator(vm, klass, OPERATOR_SLASH, vector_operator_slash);
+        solisAddClassNativeOperator(vm, klass, OPERATOR_SUBSCRIPT_GET, vector_operator_subscriptGet);
+    }
+
+    solisAddClassNativeMethod(vm, SOLIS_OBJECT_VALUE(vm->vectorClasses[1]), "cross", vector_cross, 1);
+
+    vm->matrixClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "Mat4"));
+
+    Value matrixClass = SOLIS_OBJECT_VALUE(vm->matrixClass);
+
+    solisAddClassNativeConstructor(vm, matrixClass, matrix_construct);
+    solisAddClassNativeStaticMethod(vm, matrixClass, "identity", matrix_identity, 0);
+    solisAddClassNativeStaticMethod(vm, matrixClass, "translation", matrix_translation, 3);
+    solisAddClassNativeStaticMethod(vm, matrixClass, "scaling", matrix_scaling, 3);
+    solisAddClassNativeStaticMethod(vm, matrixClass, "rotationX", matrix_rotationX, 1);
+    solisAddClassNativeStaticMethod(vm, matrixClass, "rotationY", matrix_rotationY, 1);
+    solisAddClassNativeStaticMethod(vm, matrixClass, "rotationZ", matrix_rotationZ, 1);
+    solisAddClassNativeMethod(vm, matrixClass, "transpose", matrix_transpose, 0);
+    solisAddClassNativeMethod(vm, matrixClass, "at", matrix_at, 2);
+    solisAddClassNativeMethod(vm, matrixClass, "toList", matrix_toList, 0);
+
+    solisAddClassNativeOperator(vm, matrixClass, OPERATOR_ADD, vector_operator_add);
+    solisAddClassNativeOperator(vm, matrixClass, OPERATOR_MINUS, vector_operator_minus);
+    solisAddClassNativeOperator(vm, matrixClass, OPERATOR_STAR, vector_operator_star);
+    solisAddClassNativeOperator(vm, matrixClass, OPERATOR_SLASH, vector_operator_slash);
+
+    vm->stringBuilderClass = SOLIS_AS_CLASS(solisGetGlobal(vm, "StringBuilder"));
+
+    Value stringBuilderClass = SOLIS_OBJECT_VALUE(vm->stringBuilderClass);
+
+    solisAddClassNativeConstructor(vm, stringBuilderClass, stringbuilder_construct);
+    solisAddClassNativeMethod(vm, stringBuilderClass, "append", stringbuilder_append, 1);
+    solisAddClassNativeMethod(vm, stringBuilderClass, "length", stringbuilder_length, 0);
+    solisAddClassNativeMethod(vm, stringBuilderClass, "clear", stringbuilder_clear, 0);
+    solisAddClassNativeMethod(vm, stringBuilderClass, "toString", stringbuilder_toString, 0);
 
     // Only load these functions in if we are sandboxing the VM
     if (!sandboxed)
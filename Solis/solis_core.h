@@ -5,6 +5,6 @@
 
 #include "solis_vm.h"
 
-void solisInitialiseCore(VM* vm, bool sandboxed);
+void solisInitialiseCore(VM* vm, bool sandboxed, const char* cachePath);
 
 #endif
\ No newline at end of file
@@ -2,18 +2,109 @@
 #include "solis_gc.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "solis_vm.h"
 #include "solis_compiler.h"
+#include "solis_os.h"
 
-#define GC_HEAP_GROW_FACTOR 2
+// Bytes allocated during a cycle before it does some work
+#define GC_STEP_SIZE (16 * 1024)
+
+// Bytes of objects traced or swept for every byte allocated during a cycle
+#define GC_STEP_MULTIPLIER 4
+
+// Work done between looking at the clock in a timed collection
+#define GC_TIMED_STEP (8 * 1024)
+
+// Most threads a collection will mark with
+#define GC_MAX_MARK_THREADS 64
+
+// Bytes that could need tracing before marking is shared between threads, less isn't worth starting them for
+#define GC_PARALLEL_MIN_WORK (4 * 1024 * 1024)
+
+// Grey objects a marking thread keeps to itself before sharing half of them
+#define GC_SHARE_THRESHOLD 64
+
+typedef struct MarkWork MarkWork;
+
+typedef struct
+{
+    // Only the thread that owns it pushes and pops here
+    Object** stack;
+    int count;
+    int capacity;
+
+    // Objects any thread can steal, guarded by the lock
+    Object** shared;
+    volatile int sharedStart;
+    volatile int sharedEnd;
+    int sharedCapacity;
+    volatile bool lock;
+
+    // Bytes of objects in blocks this thread has marked
+    uint64_t markedBytes;
+    uint64_t markedObjects[OBJ_TYPE_COUNT];
+
+    MarkWork* work;
+    int index;
+} MarkThread;
+
+struct MarkWork
+{
+    VM* vm;
+    MarkThread* threads;
+    int count;
+
+    // Threads that have run out of objects, marking is done once they all have
+    volatile int idle;
+};
+
+// Set while a thread is helping to mark, objects it marks go on its own stack rather than the grey stack
+static SOLIS_THREAD_LOCAL MarkThread* currentMarkThread = NULL;
+
+static void pushMarkThread(MarkThread* thread, Object* object);
+
+static void pushGrey(VM* vm, Object* object)
+{
+    if (vm->greyCapacity < vm->greyCount + 1) {
+        vm->greyCapacity = GROW_CAPACITY(vm->greyCapacity);
+        vm->greyStack = (Object**)solisRawReallocate(vm, vm->greyStack, sizeof(Object*) * vm->greyCapacity);
+    }
+
+    vm->greyStack[vm->greyCount++] = object;
+}
+
+// Lines taken up by the block header
+#define HEADER_LINES ((int)((sizeof(GCBlock) + SOLIS_LINE_SIZE - 1) / SOLIS_LINE_SIZE))
+
+// A minor collection marks straight into the line marks, young objects are never in a block the allocator could be using
+static void markLines(VM* vm, GCBlock* block, Object* object, size_t size)
+{
+    uint8_t* lines = vm->minorCollection ? block->lineMarks : block->liveLines;
+
+    size_t offset = (uint8_t*)object - (uint8_t*)block;
+    size_t first = offset / SOLIS_LINE_SIZE;
+    size_t last = (offset + size - 1) / SOLIS_LINE_SIZE;
+
+    for (size_t line = first; line <= last; line++)
+        lines[line] = 1;
+}
 
 void markObject(VM* vm, Object* object)
 {
     if (object == NULL)
         return;
 
-    if (object->isMarked) 
+    if (vm->referenceVisitor != NULL)
+    {
+        vm->referenceVisitor(vm, object, vm->referenceVisitorData);
+        return;
+    }
+
+    // Old objects are already marked so a minor collection stops at them
+    if (solisIsMarked(object)) 
         return;
 
 //#ifdef SOLIS_DEBUG_LOG_GC
@@ -22,16 +113,54 @@ void markObject(VM* vm, Object* object)
 //    printf("\n");
 //#endif
 
-    object->isMarked = true;
+    // Other marking threads can reach the same object so they claim the mark atomically
+    MarkThread* thread = currentMarkThread;
 
-    if (vm->greyCapacity < vm->greyCount + 1) {
-        vm->greyCapacity = GROW_CAPACITY(vm->greyCapacity);
-        vm->greyStack = (Object**)realloc(vm->greyStack, sizeof(Object*) * vm->greyCapacity);
+    if (object->inBlock)
+    {
+        GCBlock* block = SOLIS_BLOCK_OF(object);
+        size_t granule = SOLIS_GRANULE_OF(object);
+        uint64_t bit = (uint64_t)1 << (granule % 64);
+
+        if (thread != NULL)
+        {
+            if (solisAtomicOr64(&block->markBits[granule / 64], bit) & bit)
+                return;
+        }
+        else
+            block->markBits[granule / 64] |= bit;
+
+        size_t size = solisObjectSize(object);
+        markLines(vm, block, object, size);
+
+        if (thread != NULL)
+            thread->markedBytes += size;
+        else
+            vm->markedBytes += size;
+    }
+    else if (thread != NULL)
+    {
+        if (solisAtomicExchangeBool((volatile bool*)&object->isMarked, true))
+            return;
     }
+    else
+        object->isMarked = true;
 
-    if (vm->greyStack == NULL) exit(1);
+    // Minor collections only see young objects so only full ones are counted
+    if (thread != NULL)
+    {
+        if (!vm->minorCollection)
+            thread->markedObjects[object->type]++;
 
-    vm->greyStack[vm->greyCount++] = object;
+        pushMarkThread(thread, object);
+    }
+    else
+    {
+        if (!vm->minorCollection)
+            vm->markedObjects[object->type]++;
+
+        pushGrey(vm, object);
+    }
 }
 
 void markValue(VM* vm, Value value)
@@ -50,6 +179,18 @@ void markTable(VM* vm, HashTable* table)
     }
 }
 
+void markValueTable(VM* vm, ValueTable* table)
+{
+    for (int i = 0; i < table->capacity; i++)
+    {
+        if (!solisValueTableOccupied(table, i))
+            continue;
+
+        markValue(vm, table->entries[i].key);
+        markValue(vm, table->entries[i].value);
+    }
+}
+
 void markValueBuffer(VM* vm, ValueBuffer* buffer)
 {
     for (int i = 0; i < buffer->count; i++)
@@ -74,18 +215,41 @@ static void markRoots(VM* vm)
    /* markTable(vm, &vm->globalMap);
     markValueBuffer(vm, &vm->globals);*/
 
+    // Compiled code stores globals without a barrier so the module is always traced
+    solisRememberObject(vm, (Object*)vm->currentModule);
+
     markObject(vm, (Object*)vm->currentModule);
 
     markObject(vm, (Object*)vm->numberClass);
     markObject(vm, (Object*)vm->stringClass);
     markObject(vm, (Object*)vm->boolClass);
     markObject(vm, (Object*)vm->listClass);
+    markObject(vm, (Object*)vm->rangeClass);
+    markObject(vm, (Object*)vm->dictionaryClass);
+    markObject(vm, (Object*)vm->weakRefClass);
+    markObject(vm, (Object*)vm->weakTableClass);
+
+    for (int i = 0; i < SOLIS_ARRAY_KIND_COUNT; i++)
+    {
+        markObject(vm, (Object*)vm->typedArrayClasses[i]);
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        markObject(vm, (Object*)vm->vectorClasses[i]);
+    }
+
+    markObject(vm, (Object*)vm->matrixClass);
+    markObject(vm, (Object*)vm->stringBuilderClass);
+    markObject(vm, (Object*)vm->stopIterationClass);
 
     for (int i = 0; i < OPERATOR_COUNT; i++)
     {
         markObject(vm, (Object*)vm->operatorStrings[i]);
     }
 
+    markObject(vm, (Object*)vm->iterateString);
+
     for (ObjUpvalue* upvalue = vm->openUpvalues;
         upvalue != NULL;
         upvalue = upvalue->next)
@@ -113,6 +277,17 @@ static void blackenObject(VM* vm, Object* object)
         ObjFunction* function = (ObjFunction*)object;
         markObject(vm, (Object*)function->name);
         markValueBuffer(vm, &function->chunk.constants);
+
+        // Cached classes are kept alive so a new class can't reuse the address of a stale entry
+        for (int i = 0; i < function->chunk.caches.count; i++)
+        {
+            InlineCache* cache = &function->chunk.caches.data[i];
+            for (int j = 0; j < cache->count; j++)
+            {
+                markObject(vm, (Object*)cache->entries[j].klass);
+                markValue(vm, cache->entries[j].value);
+            }
+        }
         break;
     }
     case OBJ_CLOSURE: {
@@ -131,6 +306,7 @@ static void blackenObject(VM* vm, Object* object)
         ObjClass* klass = (ObjClass*)object;
         markObject(vm, (Object*)klass->name);
         markTable(vm, &klass->fields);
+        markValueBuffer(vm, &klass->fieldDefaults);
         markTable(vm, &klass->methods);
         markTable(vm, &klass->statics);
         markObject(vm, (Object*)klass->constructor);
@@ -140,11 +316,16 @@ static void blackenObject(VM* vm, Object* object)
             markObject(vm, klass->operators[i]);
         }
 
+        break;
     }
     case OBJ_INSTANCE: {
         ObjInstance* instance = (ObjInstance*)object;
         markObject(vm, (Object*)instance->klass);
-        markTable(vm, &instance->fields);
+
+        for (int i = 0; i < instance->fieldCount; i++)
+        {
+            markValue(vm, instance->fields[i]);
+        }
         break;
     }
     case OBJ_BOUND_METHOD: {
@@ -177,82 +358,1162 @@ static void blackenObject(VM* vm, Object* object)
 
         break;
     }
+    case OBJ_DICTIONARY:
+        markValueTable(vm, &((ObjDictionary*)object)->table);
+        break;
+    case OBJ_WEAK_REF:
+        // The target is weak, it is cleared after marking if nothing else reached it
+        ((ObjWeakRef*)object)->tracedEpoch = vm->gcEpoch;
+        break;
+    case OBJ_WEAK_TABLE:
+    {
+        ObjWeakTable* weak = (ObjWeakTable*)object;
+        weak->tracedEpoch = vm->gcEpoch;
+
+        // Values under object keys are marked once their key is, see traceEphemerons
+        // Snapshots count every value as held by the table
+        for (int i = 0; i < weak->table.capacity; i++)
+        {
+            ValueTableEntry* entry = &weak->table.entries[i];
+
+            if (!solisValueTableOccupied(&weak->table, i))
+                continue;
+
+            if (!SOLIS_IS_OBJECT(entry->key) || vm->referenceVisitor != NULL)
+                markValue(vm, entry->value);
+        }
+
+        break;
+    }
     case OBJ_NATIVE_FUNCTION:
     case OBJ_STRING:
+    case OBJ_TYPED_ARRAY:
+    case OBJ_VECTOR:
+    case OBJ_MATRIX:
+    case OBJ_STRING_BUILDER:
         break;
     }
 }
 
-static void traceReferences(VM* vm) 
+// The root that is always traced can also be remembered or greyed on the way, neither changes what is live
+void solisTraceRoots(VM* vm, SolisReferenceVisitor visitor, void* data)
 {
-    while (vm->greyCount > 0) {
-        Object* object = vm->greyStack[--vm->greyCount];
-        blackenObject(vm, object);
+    vm->referenceVisitor = visitor;
+    vm->referenceVisitorData = data;
+
+    markRoots(vm);
+
+    vm->referenceVisitor = NULL;
+    vm->referenceVisitorData = NULL;
+}
+
+void solisTraceObject(VM* vm, Object* object, SolisReferenceVisitor visitor, void* data)
+{
+    vm->referenceVisitor = visitor;
+    vm->referenceVisitorData = data;
+
+    blackenObject(vm, object);
+
+    vm->referenceVisitor = NULL;
+    vm->referenceVisitorData = NULL;
+}
+
+static void growMarkStack(VM* vm, Object*** stack, int* capacity, int needed)
+{
+    if (*capacity >= needed)
+        return;
+
+    while (*capacity < needed)
+        *capacity = GROW_CAPACITY(*capacity);
+
+    *stack = (Object**)solisRawReallocate(vm, *stack, sizeof(Object*) * *capacity);
+}
+
+// Only ever held for a copy so spinning is fine
+static void lockMarkThread(MarkThread* thread)
+{
+    while (solisAtomicExchangeBool(&thread->lock, true))
+        solisYieldThread();
+}
+
+static void unlockMarkThread(MarkThread* thread)
+{
+    solisAtomicExchangeBool(&thread->lock, false);
+}
+
+// Moves the oldest half of a thread's objects to where the others can steal them
+static void shareGrey(MarkThread* thread)
+{
+    int half = thread->count / 2;
+
+    lockMarkThread(thread);
+
+    if (thread->sharedStart == thread->sharedEnd)
+    {
+        thread->sharedStart = 0;
+        thread->sharedEnd = 0;
     }
+
+    growMarkStack(thread->work->vm, &thread->shared, &thread->sharedCapacity, thread->sharedEnd + half);
+    memcpy(thread->shared + thread->sharedEnd, thread->stack, sizeof(Object*) * half);
+    thread->sharedEnd += half;
+
+    unlockMarkThread(thread);
+
+    memmove(thread->stack, thread->stack + half, sizeof(Object*) * (thread->count - half));
+    thread->count -= half;
 }
 
-static void sweep(VM* vm) {
-    Object* previous = NULL;
-    Object* object = vm->objects;
-    while (object != NULL) 
+static void pushMarkThread(MarkThread* thread, Object* object)
+{
+    growMarkStack(thread->work->vm, &thread->stack, &thread->capacity, thread->count + 1);
+    thread->stack[thread->count++] = object;
+
+    // Only shared once the last lot has been taken so the lock is rarely touched
+    if (thread->count >= GC_SHARE_THRESHOLD && thread->sharedStart == thread->sharedEnd)
+        shareGrey(thread);
+}
+
+// Takes half of the first shared objects found, a thread's own come first
+static bool stealGrey(MarkThread* thread)
+{
+    MarkWork* work = thread->work;
+
+    for (int i = 0; i < work->count; i++)
     {
-        if (object->isMarked) 
+        MarkThread* victim = &work->threads[(thread->index + i) % work->count];
+
+        if (victim->sharedStart == victim->sharedEnd)
+            continue;
+
+        lockMarkThread(victim);
+
+        int take = (victim->sharedEnd - victim->sharedStart + 1) / 2;
+
+        if (take > 0)
         {
-            object->isMarked = false;
-            previous = object;
-            object = object->next;
+            growMarkStack(thread->work->vm, &thread->stack, &thread->capacity, thread->count + take);
+            memcpy(thread->stack + thread->count, victim->shared + victim->sharedStart, sizeof(Object*) * take);
+            thread->count += take;
+            victim->sharedStart += take;
         }
-        else 
+
+        unlockMarkThread(victim);
+
+        if (take > 0)
+            return true;
+    }
+
+    return false;
+}
+
+// Returns false once every thread is out of objects, nothing is left to share then
+static bool waitForGrey(MarkThread* thread)
+{
+    MarkWork* work = thread->work;
+
+    solisAtomicAdd(&work->idle, 1);
+
+    for (;;)
+    {
+        if (solisAtomicLoad(&work->idle) == work->count)
+            return false;
+
+        for (int i = 0; i < work->count; i++)
         {
-            Object* unreached = object;
-            object = object->next;
-            if (previous != NULL) 
+            MarkThread* other = &work->threads[i];
+
+            if (other->sharedStart != other->sharedEnd)
             {
-                previous->next = object;
+                solisAtomicAdd(&work->idle, -1);
+                return true;
             }
-            else {
-                vm->objects = object;
-            }
-
-            solisFreeObject(vm, unreached);
         }
+
+        solisYieldThread();
     }
 }
 
-void tableRemoveWhite(VM* vm, HashTable* table)
+static void markThreadMain(void* data)
 {
-    // NOTE: There is a bug here in somewhere
-    // It only happens when stressing the GC atm but it should probably be fixed 
-    for (int i = 0; i < table->capacity; i++) 
+    MarkThread* thread = (MarkThread*)data;
+    VM* vm = thread->work->vm;
+
+    currentMarkThread = thread;
+
+    do
     {
-        TableEntry* entry = &table->entries[i];
-        if (entry->key != NULL && !entry->key->obj.isMarked) 
+        while (thread->count > 0 || stealGrey(thread))
         {
-            solisHashTableDelete(table, entry->key);
+            Object* object = thread->stack[--thread->count];
+            blackenObject(vm, object);
         }
+    } while (waitForGrey(thread));
+
+    currentMarkThread = NULL;
+}
+
+// The grey stack is dealt out between the threads, this thread marks too
+static void traceParallel(VM* vm)
+{
+    int count = vm->markThreadCount < GC_MAX_MARK_THREADS ? vm->markThreadCount : GC_MAX_MARK_THREADS;
+
+    MarkThread threads[GC_MAX_MARK_THREADS];
+    ThreadHandle handles[GC_MAX_MARK_THREADS];
+
+    MarkWork work;
+    work.vm = vm;
+    work.threads = threads;
+    work.count = count;
+    work.idle = 0;
+
+    memset(threads, 0, sizeof(MarkThread) * count);
+
+    for (int i = 0; i < count; i++)
+    {
+        threads[i].work = &work;
+        threads[i].index = i;
+    }
+
+    for (int i = 0; i < vm->greyCount; i++)
+    {
+        MarkThread* thread = &threads[i % count];
+
+        growMarkStack(thread->work->vm, &thread->shared, &thread->sharedCapacity, thread->sharedEnd + 1);
+        thread->shared[thread->sharedEnd++] = vm->greyStack[i];
+    }
+
+    vm->greyCount = 0;
+
+    for (int i = 1; i < count; i++)
+    {
+        handles[i] = solisCreateThread(vm, markThreadMain, &threads[i]);
+
+        // A thread that didn't start counts as idle for good, its objects get stolen
+        if (handles[i] == NULL)
+            solisAtomicAdd(&work.idle, 1);
+    }
+
+    markThreadMain(&threads[0]);
+
+    for (int i = 1; i < count; i++)
+    {
+        if (handles[i] != NULL)
+            solisJoinThread(vm, handles[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        vm->markedBytes += threads[i].markedBytes;
+
+        for (int type = 0; type < OBJ_TYPE_COUNT; type++)
+            vm->markedObjects[type] += threads[i].markedObjects[type];
+
+        solisRawFree(vm, threads[i].stack);
+        solisRawFree(vm, threads[i].shared);
     }
 }
 
-void solisCollectGarbage(VM* vm)
+// Traces everything left, reachableBytes is roughly how much that could be
+static void traceReferences(VM* vm, uint64_t reachableBytes) 
 {
+    if (vm->markThreadCount > 1 && reachableBytes >= GC_PARALLEL_MIN_WORK && vm->greyCount > 0)
+    {
+        traceParallel(vm);
+        return;
+    }
 
+    while (vm->greyCount > 0) {
+        Object* object = vm->greyStack[--vm->greyCount];
+        blackenObject(vm, object);
+    }
+}
 
-#ifdef SOLIS_DEBUG_LOG_GC
-    printf("-- gc begin\n");
+static int lowestBit(uint64_t bits)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctzll(bits);
 #endif
+}
 
-    markRoots(vm);
+// Counts what the object and the buffers it owns give back, wherever the sweep frees it
+static void freeDeadObject(VM* vm, Object* object)
+{
+    uint64_t before = vm->allocatedBytes;
 
-    traceReferences(vm);
+    solisFreeObject(vm, object);
 
-    tableRemoveWhite(vm, &vm->strings);
+    vm->gcStats.bytesFreed += before - vm->allocatedBytes;
+}
+
+// Frees the objects in a block that own memory and weren't marked, nothing else in a block needs to be looked at
+static void freeDeadObjects(VM* vm, GCBlock* block, bool removeStrings)
+{
+    for (int i = 0; i < SOLIS_GRANULES_PER_BLOCK / 64; i++)
+    {
+        uint64_t dead = block->finalizeBits[i] & ~block->markBits[i];
 
-    sweep(vm);
+        if (dead == 0)
+            continue;
 
-    vm->nextGC = vm->allocatedBytes * GC_HEAP_GROW_FACTOR;
+        block->finalizeBits[i] &= block->markBits[i];
 
-#ifdef SOLIS_DEBUG_LOG_GC
-    printf("-- gc end\n");
-#endif
+        while (dead != 0)
+        {
+            Object* object = (Object*)((uint8_t*)block + (i * 64 + lowestBit(dead)) * SOLIS_GRANULE_SIZE);
+            dead &= dead - 1;
+
+            // Interned strings are weak so the dead ones are removed as they are freed
+            if (removeStrings && object->type == OBJ_STRING)
+                solisHashTableDelete(&vm->strings, (ObjString*)object);
+
+            freeDeadObject(vm, object);
+        }
+    }
+}
+
+// Young objects too big for a block are freed or moved onto the old list, they stay marked once they are old
+static void sweepYoungObjects(VM* vm) 
+{
+    Object* object = vm->youngObjects;
+    while (object != NULL) 
+    {
+        Object* next = SOLIS_LARGE_HEADER(object)->next;
+
+        if (object->isMarked)
+        {
+            SOLIS_LARGE_HEADER(object)->next = vm->objects;
+            vm->objects = object;
+        }
+        else
+        {
+            if (object->type == OBJ_STRING)
+                solisHashTableDelete(&vm->strings, (ObjString*)object);
+
+            freeDeadObject(vm, object);
+        }
+
+        object = next;
+    }
+
+    vm->youngObjects = NULL;
+}
+
+static Object** nextWeak(Object* object)
+{
+    if (object->type == OBJ_WEAK_REF)
+        return &((ObjWeakRef*)object)->nextWeak;
+
+    return &((ObjWeakTable*)object)->nextWeak;
+}
 
-}
\ No newline at end of file
+// Weak tables this collection traced, the rest are old and unchanged since the last one so nothing in them can die
+static ValueTable* tracedWeakTable(VM* vm, Object* object)
+{
+    if (object->type != OBJ_WEAK_TABLE || !solisIsMarked(object))
+        return NULL;
+
+    ObjWeakTable* weak = (ObjWeakTable*)object;
+    return weak->tracedEpoch == vm->gcEpoch ? &weak->table : NULL;
+}
+
+static bool isDeadKey(Value key)
+{
+    return SOLIS_IS_OBJECT(key) && !solisIsMarked(SOLIS_AS_OBJECT(key));
+}
+
+// Marks the values of weak table entries whose key is alive, which can bring more keys to life so it goes until nothing changes
+static void traceEphemerons(VM* vm)
+{
+    bool marked = true;
+
+    while (marked)
+    {
+        marked = false;
+
+        for (Object* object = vm->weakObjects; object != NULL; object = *nextWeak(object))
+        {
+            ValueTable* table = tracedWeakTable(vm, object);
+            if (table == NULL)
+                continue;
+
+            for (int i = 0; i < table->capacity; i++)
+            {
+                ValueTableEntry* entry = &table->entries[i];
+
+                if (!solisValueTableOccupied(table, i) || !SOLIS_IS_OBJECT(entry->key) || isDeadKey(entry->key))
+                    continue;
+
+                if (SOLIS_IS_OBJECT(entry->value) && !solisIsMarked(SOLIS_AS_OBJECT(entry->value)))
+                {
+                    markObject(vm, SOLIS_AS_OBJECT(entry->value));
+                    marked = true;
+                }
+            }
+        }
+
+        traceReferences(vm, 0);
+    }
+}
+
+// Drops dead weak objects from the list and clears what the live ones held that didn't survive
+static void clearWeakObjects(VM* vm)
+{
+    Object** link = &vm->weakObjects;
+
+    while (*link != NULL)
+    {
+        Object* object = *link;
+
+        if (!solisIsMarked(object))
+        {
+            *link = *nextWeak(object);
+            continue;
+        }
+
+        if (object->type == OBJ_WEAK_REF)
+        {
+            ObjWeakRef* ref = (ObjWeakRef*)object;
+
+            if (ref->tracedEpoch == vm->gcEpoch && isDeadKey(ref->target))
+                ref->target = SOLIS_NULL_VALUE();
+        }
+        else
+        {
+            ValueTable* table = tracedWeakTable(vm, object);
+
+            for (int i = 0; table != NULL && i < table->capacity; i++)
+            {
+                if (solisValueTableOccupied(table, i) && isDeadKey(table->entries[i].key))
+                    solisValueTableRemoveAt(table, i);
+            }
+        }
+
+        link = nextWeak(object);
+    }
+}
+
+// Weak structures are dealt with once marking is done and before anything is freed
+static void processWeakObjects(VM* vm)
+{
+    traceEphemerons(vm);
+    clearWeakObjects(vm);
+}
+
+void tableRemoveWhite(VM* vm, HashTable* table)
+{
+    // NOTE: There is a bug here in somewhere
+    // It only happens when stressing the GC atm but it should probably be fixed 
+    for (int i = 0; i < table->capacity; i++) 
+    {
+        TableEntry* entry = &table->entries[i];
+        if (entry->key != NULL && !solisIsMarked((Object*)entry->key)) 
+        {
+            solisHashTableDelete(table, entry->key);
+        }
+    }
+}
+
+static void clearLiveMarks(GCBlock* block)
+{
+    memset(block->markBits, 0, sizeof(block->markBits));
+    memset(block->liveLines, 0, sizeof(block->liveLines));
+    memset(block->liveLines, 1, HEADER_LINES);
+}
+
+static GCBlock* newBlock(VM* vm)
+{
+    GCBlock* block = (GCBlock*)solisRawAllocateAligned(vm, SOLIS_BLOCK_SIZE, SOLIS_BLOCK_SIZE);
+
+    memset(block->lineMarks, 0, sizeof(block->lineMarks));
+    memset(block->lineMarks, 1, HEADER_LINES);
+    memset(block->finalizeBits, 0, sizeof(block->finalizeBits));
+    clearLiveMarks(block);
+    block->next = NULL;
+
+    return block;
+}
+
+static void resetAllocator(SolisNursery* nursery)
+{
+    nursery->cursor = NULL;
+    nursery->limit = NULL;
+    nursery->current = NULL;
+    nursery->nextLine = 0;
+    nursery->usedBlocks = NULL;
+}
+
+// Files a block under how many of its lines are free, the line marks have to be up to date
+static void sortBlock(VM* vm, GCBlock* block)
+{
+    SolisNursery* nursery = &vm->nursery;
+
+    // Enough empty blocks to refill the nursery are kept, the rest go back to the system
+    int keepFree = (int)(nursery->size / SOLIS_BLOCK_SIZE) + 1;
+
+    int used = 0;
+    for (int i = HEADER_LINES; i < SOLIS_LINES_PER_BLOCK; i++)
+        used += block->lineMarks[i];
+
+#ifdef SOLIS_DEBUG_STRESS_GC
+    // Free lines are reused rather than freed so scribble over them to catch anything still using them
+    for (int i = HEADER_LINES; i < SOLIS_LINES_PER_BLOCK; i++)
+    {
+        if (!block->lineMarks[i])
+            memset((uint8_t*)block + i * SOLIS_LINE_SIZE, 0xdd, SOLIS_LINE_SIZE);
+    }
+#endif
+
+    if (used == 0)
+    {
+        if (nursery->freeBlockCount >= keepFree)
+        {
+            solisRawFreeAligned(vm, block);
+            return;
+        }
+
+        block->next = nursery->freeBlocks;
+        nursery->freeBlocks = block;
+        nursery->freeBlockCount++;
+    }
+    else if (used == SOLIS_LINES_PER_BLOCK - HEADER_LINES)
+    {
+        block->next = nursery->fullBlocks;
+        nursery->fullBlocks = block;
+    }
+    else
+    {
+        block->next = nursery->recyclableBlocks;
+        nursery->recyclableBlocks = block;
+    }
+}
+
+static void sortBlocks(VM* vm, GCBlock* blocks)
+{
+    while (blocks != NULL)
+    {
+        GCBlock* block = blocks;
+        blocks = blocks->next;
+
+        sortBlock(vm, block);
+    }
+}
+
+// The dead objects that own memory are freed and the lines marked by the cycle take over
+static void sweepNextBlock(VM* vm)
+{
+    GCBlock* block = vm->nursery.sweepingBlocks;
+    vm->nursery.sweepingBlocks = block->next;
+
+    freeDeadObjects(vm, block, false);
+    memcpy(block->lineMarks, block->liveLines, sizeof(block->lineMarks));
+
+    sortBlock(vm, block);
+}
+
+// Moves to the next run of free lines in the current block
+static bool nextHole(SolisNursery* nursery)
+{
+    GCBlock* block = nursery->current;
+
+    if (block == NULL)
+        return false;
+
+    int line = nursery->nextLine;
+    while (line < SOLIS_LINES_PER_BLOCK && block->lineMarks[line])
+        line++;
+
+    if (line == SOLIS_LINES_PER_BLOCK)
+        return false;
+
+    int end = line;
+    while (end < SOLIS_LINES_PER_BLOCK && !block->lineMarks[end])
+        end++;
+
+    nursery->cursor = (uint8_t*)block + line * SOLIS_LINE_SIZE;
+    nursery->limit = (uint8_t*)block + end * SOLIS_LINE_SIZE;
+    nursery->nextLine = end;
+
+    return true;
+}
+
+// Recycled blocks are filled before empty ones
+static void nextBlock(VM* vm)
+{
+    SolisNursery* nursery = &vm->nursery;
+    GCBlock* block;
+
+    // Blocks still waiting to be swept are swept as they are needed
+    while (nursery->recyclableBlocks == NULL && nursery->freeBlocks == NULL && nursery->sweepingBlocks != NULL)
+        sweepNextBlock(vm);
+
+    if (nursery->recyclableBlocks != NULL)
+    {
+        block = nursery->recyclableBlocks;
+        nursery->recyclableBlocks = block->next;
+    }
+    else if (nursery->freeBlocks != NULL)
+    {
+        block = nursery->freeBlocks;
+        nursery->freeBlocks = block->next;
+        nursery->freeBlockCount--;
+    }
+    else
+        block = newBlock(vm);
+
+    block->next = nursery->usedBlocks;
+    nursery->usedBlocks = block;
+
+    nursery->current = block;
+    nursery->nextLine = HEADER_LINES;
+}
+
+static void* nurseryAllocate(VM* vm, size_t size)
+{
+    SolisNursery* nursery = &vm->nursery;
+
+    // A fresh block always has room so this can't loop forever
+    while ((size_t)(nursery->limit - nursery->cursor) < size)
+    {
+        if (!nextHole(nursery))
+            nextBlock(vm);
+    }
+
+    void* memory = nursery->cursor;
+    nursery->cursor += size;
+
+    return memory;
+}
+
+void solisInitNursery(VM* vm, size_t size)
+{
+    SolisNursery* nursery = &vm->nursery;
+
+    resetAllocator(nursery);
+    nursery->recyclableBlocks = NULL;
+    nursery->freeBlocks = NULL;
+    nursery->freeBlockCount = 0;
+    nursery->fullBlocks = NULL;
+    nursery->sweepingBlocks = NULL;
+    nursery->size = size > 0 ? size : SOLIS_DEFAULT_NURSERY_SIZE;
+}
+
+// Every object that owns memory is freed along with the blocks
+static void freeBlocks(VM* vm, GCBlock* block)
+{
+    while (block != NULL)
+    {
+        GCBlock* next = block->next;
+
+        memset(block->markBits, 0, sizeof(block->markBits));
+        freeDeadObjects(vm, block, false);
+
+        solisRawFreeAligned(vm, block);
+        block = next;
+    }
+}
+
+void solisFreeNursery(VM* vm)
+{
+    SolisNursery* nursery = &vm->nursery;
+
+    freeBlocks(vm, nursery->usedBlocks);
+    freeBlocks(vm, nursery->recyclableBlocks);
+    freeBlocks(vm, nursery->freeBlocks);
+    freeBlocks(vm, nursery->fullBlocks);
+    freeBlocks(vm, nursery->sweepingBlocks);
+
+    solisInitNursery(vm, nursery->size);
+}
+
+// After a collection there are no young objects left for old ones to point at
+static void clearRememberedSet(VM* vm)
+{
+    for (int i = 0; i < vm->rememberedCount; i++)
+        vm->rememberedSet[i]->isRemembered = false;
+
+    vm->rememberedCount = 0;
+}
+
+static uint64_t nanosecondsNow(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+typedef struct
+{
+    uint64_t start;
+} Pause;
+
+static Pause beginPause(VM* vm)
+{
+    Pause pause;
+    pause.start = nanosecondsNow();
+
+    return pause;
+}
+
+static void endPause(VM* vm, Pause pause)
+{
+    SolisGCStats* stats = &vm->gcStats;
+    uint64_t length = nanosecondsNow() - pause.start;
+
+    stats->pauseCount++;
+    stats->totalPauseNanoseconds += length;
+
+    if (length > stats->maxPauseNanoseconds)
+        stats->maxPauseNanoseconds = length;
+}
+
+// How big the heap can get before the next cycle starts
+static uint64_t heapThreshold(VM* vm)
+{
+    SolisGCPacing* pacing = &vm->gcPacing;
+
+    // The nursery fills up between full collections so leave room for it on top of the growth
+    uint64_t threshold = (uint64_t)((double)vm->liveBytes * pacing->growFactor) + vm->nursery.size;
+
+    if (threshold < pacing->minHeap)
+        threshold = pacing->minHeap;
+
+    if (pacing->maxHeap != 0 && threshold > pacing->maxHeap)
+    {
+        // With no room left under the target a cycle runs after every nursery's worth
+        uint64_t least = vm->liveBytes + vm->nursery.size;
+        threshold = pacing->maxHeap > least ? pacing->maxHeap : least;
+    }
+
+    return threshold;
+}
+
+// Marks are sticky between cycles so a cycle starts by clearing them all
+static void clearMarks(VM* vm)
+{
+    SolisNursery* nursery = &vm->nursery;
+    GCBlock* lists[3] = { nursery->usedBlocks, nursery->recyclableBlocks, nursery->fullBlocks };
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (GCBlock* block = lists[i]; block != NULL; block = block->next)
+            clearLiveMarks(block);
+    }
+
+    for (Object* object = vm->objects; object != NULL; object = SOLIS_LARGE_HEADER(object)->next)
+        object->isMarked = false;
+}
+
+static void startCycle(VM* vm)
+{
+#ifdef SOLIS_DEBUG_LOG_GC
+    printf("-- gc cycle begin\n");
+#endif
+
+    clearMarks(vm);
+
+    // Nothing is old while marking, the barrier marks what is stored instead
+    clearRememberedSet(vm);
+
+    vm->gcState = SOLIS_GC_MARKING;
+    vm->gcEpoch++;
+    vm->gcDebt = 0;
+    vm->markedBytes = 0;
+    memset(vm->markedObjects, 0, sizeof(vm->markedObjects));
+
+    markRoots(vm);
+}
+
+static void traceStep(VM* vm, size_t budget)
+{
+    size_t work = 0;
+
+    while (vm->greyCount > 0 && work < budget)
+    {
+        Object* object = vm->greyStack[--vm->greyCount];
+        blackenObject(vm, object);
+
+        work += solisObjectSize(object);
+    }
+}
+
+// Unlinks every block that holds objects for the sweep, the lines the cycle marked replace their line marks as each is swept
+static GCBlock* takeBlocks(SolisNursery* nursery)
+{
+    GCBlock* lists[3] = { nursery->usedBlocks, nursery->recyclableBlocks, nursery->fullBlocks };
+    GCBlock* blocks = NULL;
+
+    for (int i = 0; i < 3; i++)
+    {
+        GCBlock* block = lists[i];
+        while (block != NULL)
+        {
+            GCBlock* next = block->next;
+
+            block->next = blocks;
+            blocks = block;
+
+            block = next;
+        }
+    }
+
+    resetAllocator(nursery);
+    nursery->recyclableBlocks = NULL;
+    nursery->fullBlocks = NULL;
+
+    return blocks;
+}
+
+// The grey stack has run dry so all that is left is what changed without a barrier, this part can't be split up
+static void finishMarking(VM* vm)
+{
+    markRoots(vm);
+
+    // Nearly everything still white was allocated after the marking started
+    traceReferences(vm, vm->youngBytes);
+
+    processWeakObjects(vm);
+
+    // Interned strings are weak, the dead ones are dropped now so they can't be found again while they wait to be swept
+    tableRemoveWhite(vm, &vm->strings);
+
+    memcpy(vm->gcStats.liveObjects, vm->markedObjects, sizeof(vm->markedObjects));
+
+    // Old objects are swept a step at a time, their blocks are swept when the allocator runs out of lines
+    vm->sweepingObjects = vm->objects;
+    vm->objects = NULL;
+    vm->nursery.sweepingBlocks = takeBlocks(&vm->nursery);
+
+    // Every young object is promoted or freed here so nothing old can point at a young one afterwards
+    sweepYoungObjects(vm);
+
+    // Objects in blocks are only freed if they own memory so what they take up is known straight away
+    vm->allocatedBytes -= vm->blockBytes - vm->markedBytes;
+    vm->gcStats.bytesFreed += vm->blockBytes - vm->markedBytes;
+    vm->blockBytes = vm->markedBytes;
+    vm->youngBlockBytes = 0;
+
+    vm->youngBytes = 0;
+
+    vm->gcState = SOLIS_GC_SWEEPING;
+}
+
+static void sweepStep(VM* vm, size_t budget)
+{
+    size_t work = 0;
+
+    while (vm->nursery.sweepingBlocks != NULL && work < budget)
+    {
+        sweepNextBlock(vm);
+        work += sizeof(GCBlock);
+    }
+
+    while (vm->sweepingObjects != NULL && work < budget)
+    {
+        Object* object = vm->sweepingObjects;
+        vm->sweepingObjects = SOLIS_LARGE_HEADER(object)->next;
+
+        work += solisObjectSize(object);
+
+        if (object->isMarked)
+        {
+            SOLIS_LARGE_HEADER(object)->next = vm->objects;
+            vm->objects = object;
+        }
+        else
+            freeDeadObject(vm, object);
+    }
+}
+
+static void finishSweeping(VM* vm)
+{
+    vm->liveBytes = vm->allocatedBytes;
+    vm->nextGC = heapThreshold(vm);
+
+    vm->gcState = SOLIS_GC_IDLE;
+    vm->gcStats.fullCollections++;
+
+#ifdef SOLIS_DEBUG_LOG_GC
+    printf("-- gc cycle end\n");
+#endif
+}
+
+static void collectStep(VM* vm, size_t budget)
+{
+    if (vm->gcState == SOLIS_GC_MARKING)
+    {
+        traceStep(vm, budget);
+
+        if (vm->greyCount == 0)
+            finishMarking(vm);
+    }
+    else if (vm->gcState == SOLIS_GC_SWEEPING)
+    {
+        sweepStep(vm, budget);
+
+        if (vm->nursery.sweepingBlocks == NULL && vm->sweepingObjects == NULL)
+            finishSweeping(vm);
+    }
+}
+
+static void finishCycle(VM* vm)
+{
+    // With no budget to keep to the whole heap is traced at once, which can be shared between threads
+    if (vm->gcState == SOLIS_GC_MARKING)
+    {
+        traceReferences(vm, vm->allocatedBytes);
+        finishMarking(vm);
+    }
+
+    while (vm->gcState != SOLIS_GC_IDLE)
+        collectStep(vm, SIZE_MAX);
+}
+
+void solisCheckGarbage(VM* vm, size_t size)
+{
+    if (vm->gcState == SOLIS_GC_IDLE)
+    {
+        if (vm->allocatedBytes + size > vm->nextGC)
+        {
+            Pause pause = beginPause(vm);
+            startCycle(vm);
+            endPause(vm, pause);
+        }
+
+        return;
+    }
+
+    // Debt is paid off in chunks so small allocations don't each take a step
+    vm->gcDebt += size;
+    if (vm->gcDebt < GC_STEP_SIZE)
+        return;
+
+    size_t budget = (size_t)vm->gcDebt * GC_STEP_MULTIPLIER;
+    vm->gcDebt = 0;
+
+    Pause pause = beginPause(vm);
+    collectStep(vm, budget);
+    endPause(vm, pause);
+}
+
+void* solisAllocateObjectMemory(VM* vm, size_t size, bool ownsMemory, bool* inBlock)
+{
+#ifdef SOLIS_DEBUG_STRESS_GC
+    solisCollectMinorGarbage(vm);
+
+    // A cycle is always running in small steps so the barriers are tested too
+    if (vm->gcState == SOLIS_GC_IDLE)
+        startCycle(vm);
+    else
+        collectStep(vm, SOLIS_LINE_SIZE);
+#endif
+
+    // The nursery isn't collected while marking so it keeps growing until the cycle reaches the sweep
+    if (vm->gcState != SOLIS_GC_MARKING && vm->youngBytes + size > vm->nursery.size)
+        solisCollectMinorGarbage(vm);
+
+    solisCheckGarbage(vm, size);
+
+    vm->allocatedBytes += size;
+    vm->youngBytes += size;
+
+    if (size > SOLIS_MAX_NURSERY_OBJECT)
+    {
+        *inBlock = false;
+
+        LargeObject* large = (LargeObject*)solisRawReallocate(vm, NULL, sizeof(LargeObject) + size);
+
+        // Nothing can collect before the caller fills the object in
+        Object* object = (Object*)(large + 1);
+        large->next = vm->youngObjects;
+        vm->youngObjects = object;
+
+        return object;
+    }
+
+    *inBlock = true;
+
+    vm->blockBytes += size;
+    vm->youngBlockBytes += size;
+
+    // Keep everything aligned to a granule
+    Object* object = (Object*)nurseryAllocate(vm, (size + SOLIS_GRANULE_SIZE - 1) & ~(size_t)(SOLIS_GRANULE_SIZE - 1));
+
+    // Only objects with memory of their own have to be visited when they die
+    if (ownsMemory)
+    {
+        size_t granule = SOLIS_GRANULE_OF(object);
+        SOLIS_BLOCK_OF(object)->finalizeBits[granule / 64] |= (uint64_t)1 << (granule % 64);
+    }
+
+    return object;
+}
+
+void solisFreeObjectMemory(VM* vm, Object* object)
+{
+    if (object->inBlock)
+        return;
+
+    vm->allocatedBytes -= solisObjectSize(object);
+    solisRawFree(vm, SOLIS_LARGE_HEADER(object));
+}
+
+void solisRememberObject(VM* vm, Object* object)
+{
+    // Unmarked objects are young or haven't been reached by the marking yet
+    if (object == NULL || !solisIsMarked(object))
+        return;
+
+    // A black object written to while marking is traced again
+    if (vm->gcState == SOLIS_GC_MARKING)
+    {
+        pushGrey(vm, object);
+        return;
+    }
+
+    if (object->isRemembered)
+        return;
+
+    // Raw memory so a barrier can never start a collection
+    if (vm->rememberedCapacity < vm->rememberedCount + 1) {
+        vm->rememberedCapacity = GROW_CAPACITY(vm->rememberedCapacity);
+        vm->rememberedSet = (Object**)solisRawReallocate(vm, vm->rememberedSet, sizeof(Object*) * vm->rememberedCapacity);
+    }
+
+    object->isRemembered = true;
+    vm->rememberedSet[vm->rememberedCount++] = object;
+}
+
+void solisWriteBarrierSlow(VM* vm, Object* owner, Object* object)
+{
+    // While marking the stored object is shaded, otherwise the old owner now points at a young object
+    if (vm->gcState == SOLIS_GC_MARKING)
+        markObject(vm, object);
+    else
+        solisRememberObject(vm, owner);
+}
+
+void solisCollectMinorGarbage(VM* vm)
+{
+    // Young objects are being marked along with the old ones, the end of the marking deals with them
+    if (vm->gcState == SOLIS_GC_MARKING)
+        return;
+
+#ifdef SOLIS_DEBUG_LOG_GC
+    printf("-- minor gc begin\n");
+#endif
+
+    Pause pause = beginPause(vm);
+
+    vm->minorCollection = true;
+    vm->markedBytes = 0;
+    vm->gcEpoch++;
+
+    markRoots(vm);
+
+    // Remembered objects are old so they are traced here rather than marked
+    for (int i = 0; i < vm->rememberedCount; i++)
+        blackenObject(vm, vm->rememberedSet[i]);
+
+    traceReferences(vm, vm->youngBytes);
+
+    processWeakObjects(vm);
+
+    // Survivors stay marked which makes them old, old objects don't die in a minor collection
+    // so only the blocks allocated into can have changed
+    for (GCBlock* block = vm->nursery.usedBlocks; block != NULL; block = block->next)
+        freeDeadObjects(vm, block, true);
+
+    sweepYoungObjects(vm);
+
+    size_t freed = vm->youngBlockBytes - vm->markedBytes;
+    vm->allocatedBytes -= freed;
+    vm->gcStats.bytesFreed += freed;
+    vm->blockBytes -= freed;
+    vm->youngBlockBytes = 0;
+
+    sortBlocks(vm, vm->nursery.usedBlocks);
+    resetAllocator(&vm->nursery);
+
+    clearRememberedSet(vm);
+    vm->youngBytes = 0;
+
+    vm->minorCollection = false;
+
+    vm->gcStats.minorCollections++;
+    endPause(vm, pause);
+
+#ifdef SOLIS_DEBUG_LOG_GC
+    printf("-- minor gc end\n");
+#endif
+}
+
+void solisCollectFull(VM* vm)
+{
+    Pause pause = beginPause(vm);
+
+    // Objects that died after a running cycle marked them would outlive it so it is finished first
+    finishCycle(vm);
+
+    startCycle(vm);
+    finishCycle(vm);
+
+    endPause(vm, pause);
+}
+
+bool solisCollectStep(VM* vm, size_t budget)
+{
+    Pause pause = beginPause(vm);
+
+    if (vm->gcState == SOLIS_GC_IDLE)
+        startCycle(vm);
+
+    collectStep(vm, budget);
+
+    // Allocation doesn't have to pay for work already done
+    vm->gcDebt = 0;
+
+    endPause(vm, pause);
+
+    return vm->gcState == SOLIS_GC_IDLE;
+}
+
+bool solisCollectGarbageFor(VM* vm, uint64_t microseconds)
+{
+    Pause pause = beginPause(vm);
+    uint64_t limit = microseconds * 1000;
+
+    if (vm->gcState == SOLIS_GC_IDLE && vm->allocatedBytes > vm->nextGC / 2)
+        startCycle(vm);
+
+    while (vm->gcState != SOLIS_GC_IDLE && nanosecondsNow() - pause.start < limit)
+        collectStep(vm, GC_TIMED_STEP);
+
+    // Allocation doesn't have to pay for work already done
+    vm->gcDebt = 0;
+
+    endPause(vm, pause);
+
+    return vm->gcState == SOLIS_GC_IDLE;
+}
+
+void solisSetGCPacing(VM* vm, const SolisGCPacing* pacing)
+{
+    vm->gcPacing.growFactor = pacing->growFactor > 0 ? pacing->growFactor : SOLIS_DEFAULT_GC_GROW_FACTOR;
+    vm->gcPacing.minHeap = pacing->minHeap > 0 ? pacing->minHeap : SOLIS_DEFAULT_GC_MIN_HEAP;
+    vm->gcPacing.maxHeap = pacing->maxHeap;
+
+    // A running cycle sets the threshold when it finishes
+    if (vm->gcState == SOLIS_GC_IDLE)
+        vm->nextGC = heapThreshold(vm);
+}
+
+void solisGetGCStats(VM* vm, SolisGCStats* stats)
+{
+    *stats = vm->gcStats;
+}
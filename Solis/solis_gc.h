@@ -7,14 +7,245 @@
 #include "solis_hashtable.h"
 #include "solis_object.h"
 
-void solisCollectGarbage(VM* vm);
+/*
+	The heap is split into two generations.
+	New objects are young and small ones are bump allocated into the nursery, a set of blocks divided into lines.
+	A minor collection only traces young objects, from the roots and the remembered set of old objects that were written to.
+	Objects never move so pointers held by C code stay valid.
+	A line holding a live object can't be reused, the free lines between them are bump allocated into again.
+
+	Mark bits for objects in blocks are kept in a bitmap in the block header rather than in the objects.
+	They are sticky, a marked object is an old one so survivors of a minor collection are promoted just by being marked.
+	Only a full collection clears them. Lines are marked as objects are traced, so nothing has to walk the live objects afterwards.
+	Objects that own other memory also have a bit set in a second bitmap, the dead ones are found by comparing the two.
+	Everything else in a block is freed just by its lines being reused.
+
+	Full collections of both generations are incremental, a cycle is spread over many small steps paid for by allocation.
+	Marking is tri-colour, a marked object on the grey stack is grey and one taken off it is black.
+	Write barriers shade a white object stored into a marked one so a black object never points at a white one.
+	When the grey stack runs dry the roots are marked again and the marking finishes in one go.
+	Blocks are then swept lazily, when the allocator needs one or when allocation pays for a step.
+	Minor collections don't run while marking, the nursery keeps growing until the cycle reaches the sweep.
+*/
+
+#define SOLIS_BLOCK_SIZE (32 * 1024)
+#define SOLIS_LINE_SIZE 128
+#define SOLIS_LINES_PER_BLOCK (SOLIS_BLOCK_SIZE / SOLIS_LINE_SIZE)
+
+// Anything bigger is allocated on its own
+#define SOLIS_MAX_NURSERY_OBJECT 1024
+
+// Bytes of young objects allocated before a minor collection
+#define SOLIS_DEFAULT_NURSERY_SIZE (1024 * 1024)
+
+// Objects in blocks are aligned to this, each granule has a bit in the block bitmaps
+#define SOLIS_GRANULE_SIZE 8
+#define SOLIS_GRANULES_PER_BLOCK (SOLIS_BLOCK_SIZE / SOLIS_GRANULE_SIZE)
+
+typedef struct GCBlock
+{
+	struct GCBlock* next;
+
+	// Non zero for lines holding a live object, the lines holding this header are always set
+	uint8_t lineMarks[SOLIS_LINES_PER_BLOCK];
+
+	// Lines holding objects marked by the running full collection, these become the line marks when the block is swept
+	uint8_t liveLines[SOLIS_LINES_PER_BLOCK];
+
+	// Set at the first granule of every marked object
+	uint64_t markBits[SOLIS_GRANULES_PER_BLOCK / 64];
+
+	// Set at the first granule of every object that has to be freed rather than just forgotten
+	uint64_t finalizeBits[SOLIS_GRANULES_PER_BLOCK / 64];
+} GCBlock;
+
+#define SOLIS_BLOCK_OF(object) ((GCBlock*)((uintptr_t)(object) & ~(uintptr_t)(SOLIS_BLOCK_SIZE - 1)))
+#define SOLIS_GRANULE_OF(object) (((uintptr_t)(object) & (SOLIS_BLOCK_SIZE - 1)) / SOLIS_GRANULE_SIZE)
+
+typedef struct
+{
+	// Bump allocation happens between cursor and limit, a run of free lines in the current block
+	uint8_t* cursor;
+	uint8_t* limit;
+
+	GCBlock* current;
+	int nextLine;
+
+	// Blocks allocated into since the last collection, including current
+	GCBlock* usedBlocks;
+
+	// Blocks with some free lines
+	GCBlock* recyclableBlocks;
+
+	// Blocks with no live objects
+	GCBlock* freeBlocks;
+	int freeBlockCount;
+
+	// Blocks with no free lines
+	GCBlock* fullBlocks;
+
+	// Blocks the running cycle hasn't swept yet, they aren't allocated into until it has
+	GCBlock* sweepingBlocks;
+
+	size_t size;
+} SolisNursery;
+
+typedef enum
+{
+	SOLIS_GC_IDLE,
+	SOLIS_GC_MARKING,
+	SOLIS_GC_SWEEPING
+} SolisGCState;
+
+#define SOLIS_DEFAULT_GC_GROW_FACTOR 2.0
+#define SOLIS_DEFAULT_GC_MIN_HEAP (1024 * 1024)
+
+/*
+	When full collections start, set in SolisVMConfig or changed at any time with solisSetGCPacing.
+	After a cycle the next one starts once the heap has grown by growFactor, never below minHeap.
+	maxHeap is a target rather than a hard limit, cycles start early to stay under it and once the live heap is over it
+	a cycle starts after every nursery's worth of allocation.
+	Zero for any of them uses the default, which for maxHeap is no target.
+*/
+typedef struct
+{
+	double growFactor;
+	size_t minHeap;
+	size_t maxHeap;
+} SolisGCPacing;
+
+/*
+	What the collector has done since the VM started, read with solisGetGCStats.
+	A pause is any stretch of collection work done on the VM's thread, a minor collection or an incremental step count as one each.
+*/
+typedef struct
+{
+	uint64_t minorCollections;
+
+	// Full cycles that ran to the end
+	uint64_t fullCollections;
+
+	uint64_t pauseCount;
+	uint64_t totalPauseNanoseconds;
+	uint64_t maxPauseNanoseconds;
+
+	// Counted as the sweep frees memory, including blocks swept lazily on the allocation path
+	uint64_t bytesFreed;
+
+	// Counted by the marking of the last full cycle, objects allocated since aren't included
+	uint64_t liveObjects[OBJ_TYPE_COUNT];
+} SolisGCStats;
+
+/*
+	Objects too big for a block are allocated on their own with this just in front of them.
+	It links them into the lists of large objects, objects in blocks aren't linked at all.
+*/
+typedef struct
+{
+	Object* next;
+} LargeObject;
+
+#define SOLIS_LARGE_HEADER(object) ((LargeObject*)(object) - 1)
+
+void solisInitNursery(VM* vm, size_t size);
+void solisFreeNursery(VM* vm);
+
+/*
+	Allocates the memory for a new object, collecting first if needed.
+	inBlock is set if it came from the nursery and must not be freed on its own, otherwise it is already on the young list.
+	ownsMemory says the object has to be passed to solisFreeObject when it dies.
+*/
+void* solisAllocateObjectMemory(VM* vm, size_t size, bool ownsMemory, bool* inBlock);
+
+/*
+	Gives back the memory of a dead object, the collection has already accounted for objects in blocks
+*/
+void solisFreeObjectMemory(VM* vm, Object* object);
+
+/*
+	Starts a cycle once the heap has grown past its limit, otherwise does the share of the running cycle owed for size newly allocated bytes
+*/
+void solisCheckGarbage(VM* vm, size_t size);
+
+/*
+	Full collection of both generations, any cycle already running is finished first
+*/
+void solisCollectFull(VM* vm);
+
+/*
+	Does about budget bytes of marking or sweeping, starting a cycle if none is running.
+	Returns true once the cycle has finished.
+*/
+bool solisCollectStep(VM* vm, size_t budget);
+
+void solisSetGCPacing(VM* vm, const SolisGCPacing* pacing);
+
+void solisGetGCStats(VM* vm, SolisGCStats* stats);
+
+/*
+	Does incremental collection work for at most the given time, meant for the host to call when it is idle such as at the end of a frame.
+	A new cycle is only started once the heap is half way to the point allocation would start one.
+	Returns true if no cycle is left running.
+*/
+bool solisCollectGarbageFor(VM* vm, uint64_t microseconds);
+
+/*
+	Collects only young objects, survivors are promoted to the old generation
+*/
+void solisCollectMinorGarbage(VM* vm);
+
+/*
+	For an object that was written to without a barrier.
+	An old object is added to the remembered set so the next minor collection traces it, a black one is greyed again while marking.
+*/
+void solisRememberObject(VM* vm, Object* object);
+
+/*
+	A marked object had an unmarked one stored into it, see solisWriteBarrier
+*/
+void solisWriteBarrierSlow(VM* vm, Object* owner, Object* object);
+
+/*
+	Marked means old outside of a full collection's marking and black or grey during it
+*/
+static inline bool solisIsMarked(Object* object)
+{
+	if (!object->inBlock)
+		return object->isMarked;
+
+	size_t granule = SOLIS_GRANULE_OF(object);
+	return (SOLIS_BLOCK_OF(object)->markBits[granule / 64] >> (granule % 64)) & 1;
+}
+
+/*
+	Has to be called after storing a value into an object that could already be marked.
+	An old object pointing at a young one is remembered, otherwise a minor collection would miss the young one.
+	A white object stored into a marked one is shaded while marking, otherwise an incremental cycle would miss it.
+	Nothing is remembered while marking so the remembered flag only skips the slow path when it matters.
+*/
+static inline void solisWriteBarrier(VM* vm, Object* owner, Value value)
+{
+	if (SOLIS_IS_OBJECT(value) && !owner->isRemembered && solisIsMarked(owner) && !solisIsMarked(SOLIS_AS_OBJECT(value)))
+		solisWriteBarrierSlow(vm, owner, SOLIS_AS_OBJECT(value));
+}
+
+/*
+	Follows references with the same traversal the collector marks with, so it always knows about every object type.
+	The visitor is called for every reference instead of marking, the same object can be visited more than once.
+	Nothing is allocated or collected while tracing.
+*/
+typedef void (*SolisReferenceVisitor)(VM* vm, Object* object, void* data);
+
+void solisTraceRoots(VM* vm, SolisReferenceVisitor visitor, void* data);
+void solisTraceObject(VM* vm, Object* object, SolisReferenceVisitor visitor, void* data);
 
 void markObject(VM* vm, Object* object);
 void markValue(VM* vm, Value value);
 void markTable(VM* vm, HashTable* table);
 void markValueBuffer(VM* vm, ValueBuffer* buffer);
+void markValueTable(VM* vm, ValueTable* table);
 
 
 void tableRemoveWhite(VM* vm, HashTable* table);
 
-#endif // SOLIS_GC_H
\ No newline at end of file
+#endif // SOLIS_GC_H
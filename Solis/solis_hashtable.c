@@ -5,60 +5,158 @@
 #include "solis_object.h"
 #include "solis_vm.h"
 
-static TableEntry* findEntry(TableEntry* entries, int capacity, ObjString* key)
-{
-	// Instead of modulus use some bitwise magic 
-	// Since its faster
-	// Because % and / are slow on CPUs... well not really but slower than this 
-	uint32_t index = key->hash & (capacity - 1);
-	TableEntry* tombstone = NULL;
-
-	for (;;) {
-		TableEntry* entry = &entries[index];
-		if (entry->key == NULL) {
-			if (SOLIS_IS_NULL(entry->value)) {
-				// Empty entry.
-				return tombstone != NULL ? tombstone : entry;
-			}
-			else {
-				// We found a tombstone.
-				if (tombstone == NULL) tombstone = entry;
-			}
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOLIS_HASH_SSE2
+#include <emmintrin.h>
+#endif
+
+// Group probing stays short until the table is 7/8 full, deleted slots count towards it
+#define MAX_FILLED(capacity) ((capacity) - (capacity) / 8)
+
+// The low 7 bits go in the control byte, the rest pick the group
+#define HASH_TAG(hash) ((uint8_t)((hash) & 0x7f))
+#define HASH_GROUP(hash) ((hash) >> 7)
+
+// Bit i is set where control byte i of the group equals byte
+static inline uint32_t matchByte(const uint8_t* group, uint8_t byte)
+{
+#ifdef SOLIS_HASH_SSE2
+	__m128i control = _mm_loadu_si128((const __m128i*)group);
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < SOLIS_HASH_GROUP_WIDTH; i++)
+		mask |= (uint32_t)(group[i] == byte) << i;
+	return mask;
+#endif
+}
+
+// Empty and deleted slots are the only ones with the top bit set
+static inline uint32_t matchAvailable(const uint8_t* group)
+{
+#ifdef SOLIS_HASH_SSE2
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < SOLIS_HASH_GROUP_WIDTH; i++)
+		mask |= (uint32_t)(group[i] >> 7) << i;
+	return mask;
+#endif
+}
+
+static inline int lowestSetBit(uint32_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// The probe for lookups, findSlot without tracking where an insert would go
+static inline int findKey(const HashTable* table, ObjString* key)
+{
+	int groupMask = table->capacity / SOLIS_HASH_GROUP_WIDTH - 1;
+	int group = (int)(HASH_GROUP(key->hash) & (uint32_t)groupMask);
+	uint8_t tag = HASH_TAG(key->hash);
+
+	for (int step = 1; ; step++)
+	{
+		const uint8_t* control = &table->control[group * SOLIS_HASH_GROUP_WIDTH];
+		TableEntry* entries = &table->entries[group * SOLIS_HASH_GROUP_WIDTH];
+
+		for (uint32_t match = matchByte(control, tag); match != 0; match &= match - 1)
+		{
+			int index = lowestSetBit(match);
+
+			if (entries[index].key == key)
+				return group * SOLIS_HASH_GROUP_WIDTH + index;
 		}
-		else if (entry->key == key) {
-			// We found the key.
-			return entry;
+
+		if (matchByte(control, SOLIS_CONTROL_EMPTY) != 0)
+			return -1;
+
+		group = (group + step) & groupMask;
+	}
+}
+
+/*
+	Groups are visited in triangular steps, which reach every group once when the group count is a power of two.
+	Returns the slot holding key, or -1 with the first empty or deleted slot on the way in insertAt.
+*/
+static int findSlot(const HashTable* table, ObjString* key, int* insertAt)
+{
+	int groupMask = table->capacity / SOLIS_HASH_GROUP_WIDTH - 1;
+	int group = (int)(HASH_GROUP(key->hash) & (uint32_t)groupMask);
+	uint8_t tag = HASH_TAG(key->hash);
+
+	*insertAt = -1;
+
+	for (int step = 1; ; step++)
+	{
+		const uint8_t* control = &table->control[group * SOLIS_HASH_GROUP_WIDTH];
+		TableEntry* entries = &table->entries[group * SOLIS_HASH_GROUP_WIDTH];
+
+		for (uint32_t match = matchByte(control, tag); match != 0; match &= match - 1)
+		{
+			int index = lowestSetBit(match);
+
+			if (entries[index].key == key)
+				return group * SOLIS_HASH_GROUP_WIDTH + index;
 		}
 
-		index = (index + 1) & (capacity - 1);
+		uint32_t available = matchAvailable(control);
+
+		if (*insertAt == -1 && available != 0)
+			*insertAt = group * SOLIS_HASH_GROUP_WIDTH + lowestSetBit(available);
+
+		// Nothing was ever placed past a group that still has an empty slot
+		if (matchByte(control, SOLIS_CONTROL_EMPTY) != 0)
+			return -1;
+
+		group = (group + step) & groupMask;
 	}
 }
 
+// Deleted slots are dropped along the way, which is all a rehash at the same capacity does
+static void adjustCapacity(HashTable* table, int capacity)
+{
+	uint8_t* control = SOLIS_ALLOCATE_SMALL(table->parent, uint8_t, capacity);
+	TableEntry* entries = SOLIS_ALLOCATE_SMALL(table->parent, TableEntry, capacity);
 
-static void adjustCapacity(HashTable* table, int capacity) {
-	TableEntry* entries = SOLIS_ALLOCATE(table->parent, TableEntry, capacity);
+	memset(control, SOLIS_CONTROL_EMPTY, capacity);
 	for (int i = 0; i < capacity; i++) {
 		entries[i].key = NULL;
 		entries[i].value = SOLIS_NULL_VALUE();
 	}
 
-	table->count = 0;
+	HashTable resized = *table;
+	resized.control = control;
+	resized.entries = entries;
+	resized.capacity = capacity;
+
 	for (int i = 0; i < table->capacity; i++) {
 		TableEntry* entry = &table->entries[i];
 		if (entry->key == NULL) continue;
 
-		TableEntry* dest = findEntry(entries, capacity, entry->key);
-		dest->key = entry->key;
-		dest->value = entry->value;
-		table->count++;
+		int slot;
+		findSlot(&resized, entry->key, &slot);
+
+		control[slot] = HASH_TAG(entry->key->hash);
+		entries[slot] = *entry;
 	}
 
 	// Free the old memory
-	SOLIS_FREE_ARRAY(table->parent, TableEntry, table->entries, table->capacity);
+	SOLIS_FREE_SMALL(table->parent, uint8_t, table->control, table->capacity);
+	SOLIS_FREE_SMALL(table->parent, TableEntry, table->entries, table->capacity);
 
 	// Assign the new values
+	table->control = control;
 	table->entries = entries;
 	table->capacity = capacity;
+	table->deleted = 0;
 }
 
 
@@ -66,35 +164,50 @@ void solisInitHashTable(HashTable* table, VM* vm)
 {
 	table->capacity = 0;
 	table->count = 0;
+	table->deleted = 0;
+	table->control = NULL;
 	table->entries = NULL;
 	table->parent = vm;
 }
 
 void solisFreeHashTable(HashTable* table)
 {
-	SOLIS_FREE_ARRAY(table->parent, TableEntry, table->entries, table->capacity);
+	SOLIS_FREE_SMALL(table->parent, uint8_t, table->control, table->capacity);
+	SOLIS_FREE_SMALL(table->parent, TableEntry, table->entries, table->capacity);
 	solisInitHashTable(table, table->parent);
 }
 
 bool solisHashTableInsert(HashTable* table, ObjString* key, Value value)
 {
-	if (table->count + 1 > table->capacity * SOLIS_HASH_TABLE_MAX_LOAD) 
+	if (table->count + table->deleted + 1 > MAX_FILLED(table->capacity)) 
 	{
-		int capacity = GROW_CAPACITY(table->capacity);
+		// When deleted slots are what filled the table it is cleaned at the same size rather than grown
+		int capacity = table->capacity == 0 ? SOLIS_HASH_GROUP_WIDTH : table->capacity;
+
+		if (table->count + 1 > capacity / 2)
+			capacity *= 2;
+
 		adjustCapacity(table, capacity);
 	}
 
-	TableEntry* entry = findEntry(table->entries, table->capacity, key);
+	int insertAt;
+	int slot = findSlot(table, key, &insertAt);
 
-	bool isNewKey = entry->key == NULL;
+	bool isNewKey = slot == -1;
 
-	if (isNewKey && SOLIS_IS_NULL(entry->value)) 
-		table->count++;
+	if (isNewKey)
+	{
+		slot = insertAt;
 
-	if (isNewKey) table->count++;
+		if (table->control[slot] == SOLIS_CONTROL_DELETED)
+			table->deleted--;
+
+		table->control[slot] = HASH_TAG(key->hash);
+		table->count++;
+	}
 
-	entry->key = key;
-	entry->value = value;
+	table->entries[slot].key = key;
+	table->entries[slot].value = value;
 
 	return isNewKey;
 }
@@ -104,53 +217,80 @@ bool solisHashTableGet(HashTable* table, ObjString* key, Value* value)
 	if (table->count == 0) 
 		return false;
 
-	TableEntry* entry = findEntry(table->entries, table->capacity, key);
+	int slot = findKey(table, key);
 
-	if (entry->key == NULL) 
+	if (slot == -1) 
 		return false;
 
-	*value = entry->value;
+	*value = table->entries[slot].value;
 	return true;
 }
 
+int solisHashTableFindSlot(HashTable* table, ObjString* key)
+{
+	if (table->count == 0) 
+		return -1;
+
+	return findKey(table, key);
+}
 
 bool solisHashTableDelete(HashTable* table, ObjString* key)
 {
 	if (table->count == 0) 
 		return false;
 
-	TableEntry* entry = findEntry(table->entries, table->capacity, key);
+	int slot = findKey(table, key);
 
-	if (entry->key == NULL) 
+	if (slot == -1) 
 		return false;
 
-	entry->key = NULL;
-	entry->value = SOLIS_BOOL_VALUE(true);
-	return true;
+	// A group with an empty slot already ends every probe so the slot can go straight back to empty
+	const uint8_t* group = &table->control[slot - slot % SOLIS_HASH_GROUP_WIDTH];
+
+	if (matchByte(group, SOLIS_CONTROL_EMPTY) != 0)
+		table->control[slot] = SOLIS_CONTROL_EMPTY;
+	else
+	{
+		table->control[slot] = SOLIS_CONTROL_DELETED;
+		table->deleted++;
+	}
 
+	table->entries[slot].key = NULL;
+	table->entries[slot].value = SOLIS_NULL_VALUE();
+	table->count--;
+
+	return true;
 }
 
 ObjString* solisHashTableFindString(HashTable* table, const char* chars, int length, uint32_t hash)
 {
 	if (table->count == 0) return NULL;
 
-	uint32_t index = hash & (table->capacity - 1);
-	for (;;) 
+	int groupMask = table->capacity / SOLIS_HASH_GROUP_WIDTH - 1;
+	int group = (int)(HASH_GROUP(hash) & (uint32_t)groupMask);
+	uint8_t tag = HASH_TAG(hash);
+
+	for (int step = 1; ; step++)
 	{
-		TableEntry* entry = &table->entries[index];
+		const uint8_t* control = &table->control[group * SOLIS_HASH_GROUP_WIDTH];
+		TableEntry* entries = &table->entries[group * SOLIS_HASH_GROUP_WIDTH];
 
-		if (entry->key == NULL) 
+		for (uint32_t match = matchByte(control, tag); match != 0; match &= match - 1)
 		{
-			if (SOLIS_IS_NULL(entry->value)) return NULL;
-		}
-		else if (entry->key->length == length &&
-			entry->key->hash == hash &&
-			memcmp(entry->key->chars, chars, length) == 0) 
-		{
-			return entry->key;
+			ObjString* key = entries[lowestSetBit(match)].key;
+
+			if (key->length == length &&
+				key->hash == hash &&
+				memcmp(key->chars, chars, length) == 0) 
+			{
+				return key;
+			}
 		}
 
-		index = (index + 1) & (table->capacity - 1);
+		if (matchByte(control, SOLIS_CONTROL_EMPTY) != 0)
+			return NULL;
+
+		group = (group + step) & groupMask;
 	}
 }
 
@@ -164,4 +304,143 @@ void solisHashTableCopy(HashTable* from, HashTable* to)
 			solisHashTableInsert(to, entry->key, entry->value);
 		}
 	}
-}
\ No newline at end of file
+}
+
+// Hashes are never the empty or deleted markers
+static uint32_t valueTableHash(Value key)
+{
+	uint32_t hash = solisHashValue(key);
+	return hash > SOLIS_HASH_DELETED ? hash : hash + 2;
+}
+
+// Returns the slot holding key, or where it should go which reuses the first deleted slot on the way
+static int findValueSlot(uint32_t* hashes, ValueTableEntry* entries, int capacity, Value key, uint32_t hash)
+{
+	uint32_t index = hash & (capacity - 1);
+	int tombstone = -1;
+
+	for (;;)
+	{
+		uint32_t slotHash = hashes[index];
+
+		if (slotHash == SOLIS_HASH_EMPTY)
+			return tombstone != -1 ? tombstone : (int)index;
+
+		if (slotHash == SOLIS_HASH_DELETED)
+		{
+			if (tombstone == -1)
+				tombstone = (int)index;
+		}
+		else if (slotHash == hash && solisValuesSame(entries[index].key, key))
+			return (int)index;
+
+		index = (index + 1) & (capacity - 1);
+	}
+}
+
+static void adjustValueTable(VM* vm, ValueTable* table, int capacity)
+{
+	uint32_t* hashes = SOLIS_ALLOCATE_SMALL(vm, uint32_t, capacity);
+	ValueTableEntry* entries = SOLIS_ALLOCATE_SMALL(vm, ValueTableEntry, capacity);
+	memset(hashes, 0, sizeof(uint32_t) * capacity);
+
+	// Deleted entries aren't copied over
+	for (int i = 0; i < table->capacity; i++)
+	{
+		if (!solisValueTableOccupied(table, i))
+			continue;
+
+		int slot = findValueSlot(hashes, entries, capacity, table->entries[i].key, table->hashes[i]);
+		hashes[slot] = table->hashes[i];
+		entries[slot] = table->entries[i];
+	}
+
+	SOLIS_FREE_SMALL(vm, uint32_t, table->hashes, table->capacity);
+	SOLIS_FREE_SMALL(vm, ValueTableEntry, table->entries, table->capacity);
+
+	table->hashes = hashes;
+	table->entries = entries;
+	table->capacity = capacity;
+	table->used = table->count;
+}
+
+void solisInitValueTable(ValueTable* table)
+{
+	table->count = 0;
+	table->used = 0;
+	table->capacity = 0;
+	table->hashes = NULL;
+	table->entries = NULL;
+}
+
+void solisFreeValueTable(VM* vm, ValueTable* table)
+{
+	SOLIS_FREE_SMALL(vm, uint32_t, table->hashes, table->capacity);
+	SOLIS_FREE_SMALL(vm, ValueTableEntry, table->entries, table->capacity);
+	solisInitValueTable(table);
+}
+
+bool solisValueTableGet(ValueTable* table, Value key, Value* value)
+{
+	if (table->count == 0)
+		return false;
+
+	int slot = findValueSlot(table->hashes, table->entries, table->capacity, key, valueTableHash(key));
+
+	if (!solisValueTableOccupied(table, slot))
+		return false;
+
+	*value = table->entries[slot].value;
+	return true;
+}
+
+bool solisValueTableSet(VM* vm, ValueTable* table, Value key, Value value)
+{
+	if (table->used + 1 > table->capacity * SOLIS_VALUE_TABLE_MAX_LOAD)
+	{
+		// A table that is mostly deleted entries is rehashed at the same size instead of growing
+		int capacity = table->count + 1 > table->capacity / 2 ? GROW_CAPACITY(table->capacity) : table->capacity;
+		adjustValueTable(vm, table, capacity);
+	}
+
+	uint32_t hash = valueTableHash(key);
+	int slot = findValueSlot(table->hashes, table->entries, table->capacity, key, hash);
+
+	bool isNewKey = !solisValueTableOccupied(table, slot);
+
+	if (isNewKey)
+	{
+		table->count++;
+
+		if (table->hashes[slot] == SOLIS_HASH_EMPTY)
+			table->used++;
+	}
+
+	table->hashes[slot] = hash;
+	table->entries[slot].key = key;
+	table->entries[slot].value = value;
+
+	return isNewKey;
+}
+
+void solisValueTableRemoveAt(ValueTable* table, int index)
+{
+	table->hashes[index] = SOLIS_HASH_DELETED;
+	table->entries[index].key = SOLIS_NULL_VALUE();
+	table->entries[index].value = SOLIS_NULL_VALUE();
+	table->count--;
+}
+
+bool solisValueTableDelete(ValueTable* table, Value key)
+{
+	if (table->count == 0)
+		return false;
+
+	int slot = findValueSlot(table->hashes, table->entries, table->capacity, key, valueTableHash(key));
+
+	if (!solisValueTableOccupied(table, slot))
+		return false;
+
+	solisValueTableRemoveAt(table, slot);
+	return true;
+}
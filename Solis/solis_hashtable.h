@@ -23,14 +23,19 @@ static inline uint32_t solisHashString(const char* key, int length)
 
 
 /*
-	hash tables are implemented with the help of crafting interpreters. 
+	Hash tables are laid out like Swiss tables. Each slot has a control byte next to the entry array,
+	holding the low 7 bits of the key's hash when the slot is full or marking it empty or deleted.
+	Slots are probed a group of SOLIS_HASH_GROUP_WIDTH control bytes at a time, with SSE2 where it is available,
+	so an entry is only read once its 7 bits match. Groups are aligned so a group with an empty slot ends every probe through it.
 */
 
-#define SOLIS_HASH_TABLE_MAX_LOAD 0.75
+#define SOLIS_HASH_GROUP_WIDTH 16
+
+#define SOLIS_CONTROL_EMPTY ((uint8_t)0x80)
+#define SOLIS_CONTROL_DELETED ((uint8_t)0xfe)
 
 /*
-	Each table entry has a string key and a value
-	TODO: Make it not just use a string as key. This could be done with using a value and a hash function for each value? 
+	Each table entry has a string key and a value, the key is NULL for slots that aren't full
 */
 typedef struct
 {
@@ -44,8 +49,14 @@ typedef struct
 */
 typedef struct
 {
+	// Live entries, deleted counts the slots that still stretch probes
 	int count;
+	int deleted;
+
+	// Zero or a multiple of the group width
 	int capacity;
+
+	uint8_t* control;
 	TableEntry* entries;
 
 	VM* parent;
@@ -71,6 +82,24 @@ bool solisHashTableInsert(HashTable* table, ObjString* key, Value value);
 */
 bool solisHashTableGet(HashTable* table, ObjString* key, Value* value);
 
+/*
+	The index in entries holding key, or -1. 
+	It stays valid until a new key is inserted, which can grow the table, so read it back with solisHashTableSlotValue. 
+*/
+int solisHashTableFindSlot(HashTable* table, ObjString* key);
+
+/*
+	The value at an index from solisHashTableFindSlot, NULL once key no longer lives there. 
+	Writing through it is how a value is updated without probing again. 
+*/
+static inline Value* solisHashTableSlotValue(HashTable* table, int slot, ObjString* key)
+{
+	if (slot < 0 || slot >= table->capacity || table->entries[slot].key != key)
+		return NULL;
+
+	return &table->entries[slot].value;
+}
+
 /*
 	Deletes a value from the hash table by key. 
 */
@@ -88,4 +117,58 @@ ObjString* solisHashTableFindString(HashTable* table, const char* chars, int len
 */
 void solisHashTableCopy(HashTable* from, HashTable* to);
 
+/*
+	A table keyed by any value, used by dictionaries and weak tables. Keys are compared with solisValuesSame.
+	Each slot's hash is kept in its own array so probing only reads the hashes until one matches,
+	a hash of SOLIS_HASH_EMPTY marks an empty slot and SOLIS_HASH_DELETED a removed one.
+*/
+#define SOLIS_HASH_EMPTY 0
+#define SOLIS_HASH_DELETED 1
+
+#define SOLIS_VALUE_TABLE_MAX_LOAD 0.75
+
+typedef struct
+{
+	Value key;
+	Value value;
+} ValueTableEntry;
+
+typedef struct
+{
+	// Live entries, used counts the deleted ones as well for the load factor
+	int count;
+	int used;
+	int capacity;
+
+	uint32_t* hashes;
+	ValueTableEntry* entries;
+} ValueTable;
+
+static inline bool solisValueTableOccupied(ValueTable* table, int index)
+{
+	return table->hashes[index] > SOLIS_HASH_DELETED;
+}
+
+void solisInitValueTable(ValueTable* table);
+
+void solisFreeValueTable(VM* vm, ValueTable* table);
+
+/*
+	Returns true if the key is in the table and copies its value into value
+*/
+bool solisValueTableGet(ValueTable* table, Value key, Value* value);
+
+/*
+	Inserts or replaces the value for key, returns true if the key is new.
+	The owner of the table has to apply the write barrier.
+*/
+bool solisValueTableSet(VM* vm, ValueTable* table, Value key, Value value);
+
+bool solisValueTableDelete(ValueTable* table, Value key);
+
+/*
+	Removes the entry in an occupied slot, for clearing entries while walking the slots
+*/
+void solisValueTableRemoveAt(ValueTable* table, int index);
+
 #endif // SOLIS_HASHTABLE_H
\ No newline at end of file
@@ -9,6 +9,11 @@ Value solisGetArgument(VM* vm, int argIndex)
 	return *(vm->apiStack + (argIndex + 1));
 }
 
+int solisGetArgumentCount(VM* vm)
+{
+	return (int)(vm->sp - vm->apiStack) - 1;
+}
+
 double solisCheckNumber(VM* vm, int argIndex)
 {
 	Value v = solisGetArgument(vm, argIndex);
@@ -73,9 +78,10 @@ void solisBindEnumEntry(VM* vm, Value enumObj, const char* name)
 
 	// Push onto stack so it exists somewhere the gc can see
 	// As insert could cause a realloc 
-	solisPush(vm, SOLIS_OBJECT_VALUE(name));
+	solisPush(vm, SOLIS_OBJECT_VALUE(nameStr));
 
 	solisHashTableInsert(&_enum->fields, nameStr, SOLIS_NUMERIC_VALUE((double)_enum->fieldCount));
+	solisWriteBarrier(vm, (Object*)_enum, SOLIS_OBJECT_VALUE(nameStr));
 
 	solisPop(vm);
 
@@ -106,21 +112,31 @@ Value solisCreateClassInstance(VM* vm, const char* name, Value klass)
 	return SOLIS_OBJECT_VALUE(instance);
 }
 
-void solisAddClassField(VM* vm, Value klassValue, const char* name, bool isStatic, Value defaultValue)
+bool solisAddClassField(VM* vm, Value klassValue, const char* name, bool isStatic, Value defaultValue)
 {
 	ObjClass* klass = SOLIS_AS_CLASS(klassValue);
 
 	ObjString* str = solisCopyString(vm, name, strlen(name));
 
-	HashTable* table = &klass->fields;
+	solisPush(vm, SOLIS_OBJECT_VALUE(str));
+
+	bool added = true;
 
 	if (isStatic)
-		table = &klass->statics;
+	{
+		solisHashTableInsert(&klass->statics, str, defaultValue);
+		solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(str));
+		solisWriteBarrier(vm, (Object*)klass, defaultValue);
+		klass->version++;
+	}
+	else
+	{
+		added = solisDefineClassField(vm, klass, str, defaultValue) != -1;
+	}
 
-	solisPush(vm, SOLIS_OBJECT_VALUE(str));
-	solisHashTableInsert(table, str, defaultValue);
 	solisPop(vm);
 
+	return added;
 }
 
 void solisSetStaticField(VM* vm, Value klassValue, const char* name, Value value)
@@ -141,12 +157,13 @@ void solisSetStaticField(VM* vm, Value klassValue, const char* name, Value value
 
 	solisPush(vm, SOLIS_OBJECT_VALUE(str));
 
-	if (solisHashTableInsert(&klass->statics, str, value))
-	{
-		// Delete it since we don't want to add on a set call
-		solisHashTableDelete(&klass->statics, str);
+	Value* staticValue = solisHashTableSlotValue(&klass->statics, solisHashTableFindSlot(&klass->statics, str), str);
 
-		// TODO: We should raise an error here
+	// TODO: We should raise an error when the static doesn't exist
+	if (staticValue != NULL)
+	{
+		*staticValue = value;
+		solisWriteBarrier(vm, (Object*)klass, value);
 	}
 
 	solisPop(vm);
@@ -194,14 +211,13 @@ void solisSetInstanceField(VM* vm, Value instance, const char* name, Value value
 
 	ObjString* str = solisCopyString(vm, name, strlen(name));
 
-	solisPush(vm, SOLIS_OBJECT_VALUE(str));
+	int slot = solisGetFieldSlot(inst->klass, str);
 
-	if (solisHashTableInsert(&inst->fields, str, value))
+	if (slot != -1 && slot < inst->fieldCount)
 	{
-		solisHashTableDelete(&inst->fields, str);
+		inst->fields[slot] = value;
+		solisWriteBarrier(vm, (Object*)inst, value);
 	}
-
-	solisPop(vm);
 }
 
 Value solisGetInstanceField(VM* vm, Value instance, const char* name)
@@ -216,38 +232,39 @@ Value solisGetInstanceField(VM* vm, Value instance, const char* name)
 
 	ObjString* str = solisCopyString(vm, name, strlen(name));
 
-	solisPush(vm, SOLIS_OBJECT_VALUE(str));
+	int slot = solisGetFieldSlot(inst->klass, str);
 
-	Value val;
-	if (!solisHashTableGet(&inst->fields, str, &val))
+	if (slot == -1)
 	{
 		return SOLIS_NULL_VALUE();
 	}
 
-	solisPop(vm);
-
-	return val;
+	return solisGetInstanceSlot(inst, slot);
 }
 
 void solisAddClassNativeConstructor(VM* vm, Value klassValue, SolisNativeSignature func)
 {
 	ObjClass* klass = SOLIS_AS_CLASS(klassValue);
-	
-	assert(false && "Not implmented");
+
+	klass->nativeConstructor = func;
+	klass->version++;
 }
 
 void solisAddClassNativeMethod(VM* vm, Value klassValue, const char* name, SolisNativeSignature func, int arity)
 {
 	ObjClass* klass = SOLIS_AS_CLASS(klassValue);
 	ObjString* str = solisCopyString(vm, name, strlen(name));
+	solisPush(vm, SOLIS_OBJECT_VALUE(str));
+
 	ObjNative* native = solisNewNativeFunction(vm, func);
 	native->arity = arity;
 
-
-	solisPush(vm, SOLIS_OBJECT_VALUE(str));
 	solisPush(vm, SOLIS_OBJECT_VALUE(native));
 
 	solisHashTableInsert(&klass->methods, str, SOLIS_OBJECT_VALUE(native));
+	solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(str));
+	solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(native));
+	klass->version++;
 
 	solisPop(vm);
 	solisPop(vm);
@@ -258,14 +275,17 @@ void solisAddClassNativeStaticMethod(VM* vm, Value klassValue, const char* name,
 {
 	ObjClass* klass = SOLIS_AS_CLASS(klassValue);
 	ObjString* str = solisCopyString(vm, name, strlen(name));
+	solisPush(vm, SOLIS_OBJECT_VALUE(str));
+
 	ObjNative* native = solisNewNativeFunction(vm, func);
 	native->arity = arity;
 
-
-	solisPush(vm, SOLIS_OBJECT_VALUE(str));
 	solisPush(vm, SOLIS_OBJECT_VALUE(native));
 
 	solisHashTableInsert(&klass->statics, str, SOLIS_OBJECT_VALUE(native));
+	solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(str));
+	solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(native));
+	klass->version++;
 
 	solisPop(vm);
 	solisPop(vm);
@@ -286,6 +306,7 @@ void solisAddClassNativeOperator(VM* vm, Value klassValue, Operators op, SolisNa
 	//solisHashTableInsert(&klass->methods, vm->operatorStrings[op], SOLIS_OBJECT_VALUE(native));
 
 	klass->operators[op] = (Object*)native;
+	solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(native));
 
 	solisPop(vm);
 }
\ No newline at end of file
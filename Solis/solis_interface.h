@@ -26,6 +26,13 @@ const char* solisCheckString(VM* vm, int argIndex);
 */
 Value solisGetArgument(VM* vm, int argIndex);
 
+/*
+	Number of arguments the function was called with.
+
+	Only valid before the function pushes anything onto the stack.
+*/
+int solisGetArgumentCount(VM* vm);
+
 /*
 	Sets the return value from the function and passes it back to the VM. 
 
@@ -58,8 +65,9 @@ Value solisCreateClassInstance(VM* vm, const char* name, Value klass);
 
 /*
 	Add a class field to a class. 
+	Instance fields have to be added before the first instance is created, returns false if the class already has instances. 
 */
-void solisAddClassField(VM* vm, Value klassValue, const char* name, bool isStatic, Value defaultValue);
+bool solisAddClassField(VM* vm, Value klassValue, const char* name, bool isStatic, Value defaultValue);
 
 /*
 	Sets the static field of a class 
@@ -72,6 +80,9 @@ void solisSetInstanceField(VM* vm, Value instance, const char* name, Value value
 
 Value solisGetInstanceField(VM* vm, Value instance, const char* name);
 
+/*
+	Calling the class calls func instead of creating an instance. Self is the class and func returns the new object.
+*/
 void solisAddClassNativeConstructor(VM* vm, Value klassValue, SolisNativeSignature func);
 
 void solisAddClassNativeMethod(VM* vm, Value klassValue, const char* name, SolisNativeSignature func, int arity);
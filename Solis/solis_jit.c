@@ -0,0 +1,859 @@
+#include "solis_jit.h"
+
+#include "solis_object.h"
+#include "solis_vm.h"
+
+#if SOLIS_JIT_SUPPORTED
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+enum
+{
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Callee saved registers that hold interpreter state for the whole function
+#define REG_VM RBX
+#define REG_SP R12
+#define REG_SLOTS R13
+#define REG_QNAN R14
+#define REG_GLOBALS R15
+#define REG_NULL RBP
+
+// Condition codes for jcc and setcc
+#define CC_B 0x2
+#define CC_E 0x4
+#define CC_BE 0x6
+#define CC_A 0x7
+
+// ALU opcodes in their register, register form
+#define ALU_ADD 0x01
+#define ALU_AND 0x21
+#define ALU_SUB 0x29
+#define ALU_XOR 0x31
+#define ALU_CMP 0x39
+
+// ModRM extensions for the 0x81 immediate form
+#define ALU_IMM_ADD 0
+#define ALU_IMM_SUB 5
+#define ALU_IMM_CMP 7
+
+// Jump targets that aren't bytecode offsets
+#define TARGET_ERROR -1
+
+typedef struct
+{
+	// Position of the rel32 operand
+	int at;
+
+	// Bytecode offset the jump lands on
+	int target;
+} JitFixup;
+
+typedef struct
+{
+	VM* vm;
+	Chunk* chunk;
+
+	uint8_t* code;
+	int count;
+	int capacity;
+
+	// Where each instruction of the chunk starts in the machine code
+	int* labels;
+
+	JitFixup* fixups;
+	int fixupCount;
+	int fixupCapacity;
+} Assembler;
+
+static void emit(Assembler* as, uint8_t byte)
+{
+	if (as->count + 1 > as->capacity)
+	{
+		as->capacity = GROW_CAPACITY(as->capacity);
+		as->code = (uint8_t*)solisRawReallocate(as->vm, as->code, as->capacity);
+	}
+
+	as->code[as->count++] = byte;
+}
+
+static void emit32(Assembler* as, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		emit(as, (value >> (i * 8)) & 0xff);
+}
+
+static void emit64(Assembler* as, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+		emit(as, (value >> (i * 8)) & 0xff);
+}
+
+static void emitRex(Assembler* as, int reg, int rm)
+{
+	emit(as, 0x48 | ((reg >> 3) << 2) | (rm >> 3));
+}
+
+static void emitModRMReg(Assembler* as, int reg, int rm)
+{
+	emit(as, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// [base + disp32]
+static void emitModRMMem(Assembler* as, int reg, int base, int32_t disp)
+{
+	emit(as, 0x80 | ((reg & 7) << 3) | (base & 7));
+
+	// rsp and r12 need a SIB byte
+	if ((base & 7) == RSP)
+		emit(as, 0x24);
+
+	emit32(as, (uint32_t)disp);
+}
+
+static void movImm(Assembler* as, int reg, uint64_t value)
+{
+	emit(as, 0x48 | (reg >> 3));
+	emit(as, 0xb8 + (reg & 7));
+	emit64(as, value);
+}
+
+static void movLoad(Assembler* as, int reg, int base, int32_t disp)
+{
+	emitRex(as, reg, base);
+	emit(as, 0x8b);
+	emitModRMMem(as, reg, base, disp);
+}
+
+static void movStore(Assembler* as, int base, int32_t disp, int reg)
+{
+	emitRex(as, reg, base);
+	emit(as, 0x89);
+	emitModRMMem(as, reg, base, disp);
+}
+
+static void movReg(Assembler* as, int dst, int src)
+{
+	emitRex(as, src, dst);
+	emit(as, 0x89);
+	emitModRMReg(as, src, dst);
+}
+
+static void lea(Assembler* as, int dst, int base, int32_t disp)
+{
+	emitRex(as, dst, base);
+	emit(as, 0x8d);
+	emitModRMMem(as, dst, base, disp);
+}
+
+static void aluReg(Assembler* as, uint8_t opcode, int dst, int src)
+{
+	emitRex(as, src, dst);
+	emit(as, opcode);
+	emitModRMReg(as, src, dst);
+}
+
+static void aluImm(Assembler* as, int extension, int reg, int32_t value)
+{
+	emitRex(as, 0, reg);
+	emit(as, 0x81);
+	emitModRMReg(as, extension, reg);
+	emit32(as, (uint32_t)value);
+}
+
+static void movqToXmm(Assembler* as, int xmm, int reg)
+{
+	emit(as, 0x66);
+	emitRex(as, xmm, reg);
+	emit(as, 0x0f);
+	emit(as, 0x6e);
+	emitModRMReg(as, xmm, reg);
+}
+
+static void movqFromXmm(Assembler* as, int reg, int xmm)
+{
+	emit(as, 0x66);
+	emitRex(as, xmm, reg);
+	emit(as, 0x0f);
+	emit(as, 0x7e);
+	emitModRMReg(as, xmm, reg);
+}
+
+// Scalar double operations on xmm0 to xmm7
+static void sse(Assembler* as, uint8_t prefix, uint8_t opcode, int dst, int src)
+{
+	emit(as, prefix);
+	emit(as, 0x0f);
+	emit(as, opcode);
+	emitModRMReg(as, dst, src);
+}
+
+// Sets eax to 0 or 1 from a condition
+static void setccEax(Assembler* as, int cc)
+{
+	emit(as, 0x0f);
+	emit(as, 0x90 | cc);
+	emit(as, 0xc0);
+
+	// movzx eax, al
+	emit(as, 0x0f);
+	emit(as, 0xb6);
+	emit(as, 0xc0);
+}
+
+static void callAbsolute(Assembler* as, void* function)
+{
+	movImm(as, RAX, (uint64_t)(uintptr_t)function);
+	emit(as, 0xff);
+	emit(as, 0xd0);
+}
+
+// Returns the position of the rel32 so it can be patched
+static int jcc(Assembler* as, int cc)
+{
+	emit(as, 0x0f);
+	emit(as, 0x80 | cc);
+	emit32(as, 0);
+	return as->count - 4;
+}
+
+static int jmp(Assembler* as)
+{
+	emit(as, 0xe9);
+	emit32(as, 0);
+	return as->count - 4;
+}
+
+static void patchHere(Assembler* as, int at)
+{
+	int32_t rel = as->count - (at + 4);
+	memcpy(&as->code[at], &rel, sizeof(int32_t));
+}
+
+static void addFixup(Assembler* as, int at, int target)
+{
+	if (as->fixupCount + 1 > as->fixupCapacity)
+	{
+		as->fixupCapacity = GROW_CAPACITY(as->fixupCapacity);
+		as->fixups = (JitFixup*)solisRawReallocate(as->vm, as->fixups, sizeof(JitFixup) * as->fixupCapacity);
+	}
+
+	as->fixups[as->fixupCount].at = at;
+	as->fixups[as->fixupCount].target = target;
+	as->fixupCount++;
+}
+
+// cc of -1 is an unconditional jump
+static void jumpTo(Assembler* as, int cc, int target)
+{
+	addFixup(as, cc < 0 ? jmp(as) : jcc(as, cc), target);
+}
+
+static void pushReg(Assembler* as, int reg)
+{
+	movStore(as, REG_SP, 0, reg);
+	aluImm(as, ALU_IMM_ADD, REG_SP, sizeof(Value));
+}
+
+static void popReg(Assembler* as, int reg)
+{
+	aluImm(as, ALU_IMM_SUB, REG_SP, sizeof(Value));
+	movLoad(as, reg, REG_SP, 0);
+}
+
+// Jumps when reg doesn't hold a number, returns the jump to patch
+static int notNumber(Assembler* as, int reg)
+{
+	movReg(as, RDX, reg);
+	aluReg(as, ALU_AND, RDX, REG_QNAN);
+	aluReg(as, ALU_CMP, RDX, REG_QNAN);
+	return jcc(as, CC_E);
+}
+
+// Sets the flags so CC_B means reg is null or false
+static void testFalsy(Assembler* as, int reg)
+{
+	// null and false are the two tags right after each other
+	aluReg(as, ALU_SUB, reg, REG_NULL);
+	aluImm(as, ALU_IMM_CMP, reg, 2);
+}
+
+static void boolFromEax(Assembler* as)
+{
+	movImm(as, RCX, SOLIS_FALSE_VAL);
+	aluReg(as, ALU_ADD, RAX, RCX);
+}
+
+// Helpers can allocate and call into the VM so they need to see the real stack top
+static void syncSp(Assembler* as)
+{
+	movStore(as, REG_VM, (int32_t)offsetof(VM, sp), REG_SP);
+}
+
+static void reloadSp(Assembler* as)
+{
+	movLoad(as, REG_SP, REG_VM, (int32_t)offsetof(VM, sp));
+}
+
+static void checkHelperResult(Assembler* as)
+{
+	// test al, al
+	emit(as, 0x84);
+	emit(as, 0xc0);
+
+	jumpTo(as, CC_E, TARGET_ERROR);
+}
+
+static void operatorCall(Assembler* as, uint8_t* ip, int op)
+{
+	syncSp(as);
+	movReg(as, RDI, REG_VM);
+	movImm(as, RSI, (uint64_t)(uintptr_t)ip);
+	movImm(as, RDX, (uint64_t)op);
+	callAbsolute(as, (void*)solisJitBinaryOperator);
+	checkHelperResult(as);
+	reloadSp(as);
+}
+
+static void negateCall(Assembler* as, uint8_t* ip)
+{
+	syncSp(as);
+	movReg(as, RDI, REG_VM);
+	movImm(as, RSI, (uint64_t)(uintptr_t)ip);
+	callAbsolute(as, (void*)solisJitNegate);
+	checkHelperResult(as);
+	reloadSp(as);
+}
+
+static void concatenateCall(Assembler* as, uint8_t* ip, int count)
+{
+	syncSp(as);
+	movReg(as, RDI, REG_VM);
+	movImm(as, RSI, (uint64_t)(uintptr_t)ip);
+	movImm(as, RDX, (uint64_t)count);
+	callAbsolute(as, (void*)solisJitConcatenate);
+	checkHelperResult(as);
+	reloadSp(as);
+}
+
+static void raiseError(Assembler* as, uint8_t* ip, const char* message)
+{
+	syncSp(as);
+	movReg(as, RDI, REG_VM);
+	movImm(as, RSI, (uint64_t)(uintptr_t)ip);
+	movImm(as, RDX, (uint64_t)(uintptr_t)message);
+	callAbsolute(as, (void*)solisJitRaiseError);
+	jumpTo(as, -1, TARGET_ERROR);
+}
+
+static void epilogue(Assembler* as)
+{
+	// add rsp, 8
+	aluImm(as, ALU_IMM_ADD, RSP, 8);
+
+	// pop r15, r14, r13, r12, rbp, rbx
+	emit(as, 0x41); emit(as, 0x5f);
+	emit(as, 0x41); emit(as, 0x5e);
+	emit(as, 0x41); emit(as, 0x5d);
+	emit(as, 0x41); emit(as, 0x5c);
+	emit(as, 0x5d);
+	emit(as, 0x5b);
+
+	emit(as, 0xc3);
+}
+
+static void prologue(Assembler* as)
+{
+	// push rbx, rbp, r12, r13, r14, r15
+	emit(as, 0x53);
+	emit(as, 0x55);
+	emit(as, 0x41); emit(as, 0x54);
+	emit(as, 0x41); emit(as, 0x55);
+	emit(as, 0x41); emit(as, 0x56);
+	emit(as, 0x41); emit(as, 0x57);
+
+	// Keep the stack 16 byte aligned for calls
+	aluImm(as, ALU_IMM_SUB, RSP, 8);
+
+	movReg(as, REG_VM, RDI);
+	movReg(as, REG_SLOTS, RSI);
+	reloadSp(as);
+
+	movImm(as, REG_QNAN, QNAN);
+	movImm(as, REG_NULL, SOLIS_NULL_VAL);
+
+	movLoad(as, RAX, REG_VM, (int32_t)offsetof(VM, currentModule));
+	movLoad(as, REG_GLOBALS, RAX, (int32_t)(offsetof(ObjModule, globals) + offsetof(ValueBuffer, data)));
+}
+
+static Value jitValuesEqual(Value a, Value b)
+{
+	return SOLIS_BOOL_VALUE(solisValuesEqual(a, b));
+}
+
+/*
+	Operands are in rax and rcx, pushes the result.
+	Numbers use the SSE opcode in place, anything else goes through the operator table.
+	An opcode of 0 always calls the operator.
+*/
+static void arithmetic(Assembler* as, uint8_t* ip, uint8_t opcode, int op)
+{
+	int done = -1;
+
+	if (opcode != 0)
+	{
+		int slowA = notNumber(as, RAX);
+		int slowB = notNumber(as, RCX);
+
+		movqToXmm(as, 0, RAX);
+		movqToXmm(as, 1, RCX);
+		sse(as, 0xf2, opcode, 0, 1);
+		movqFromXmm(as, RAX, 0);
+		pushReg(as, RAX);
+
+		done = jmp(as);
+
+		patchHere(as, slowA);
+		patchHere(as, slowB);
+	}
+
+	pushReg(as, RAX);
+	pushReg(as, RCX);
+	operatorCall(as, ip, op);
+
+	if (done >= 0)
+		patchHere(as, done);
+}
+
+// Operands are in rax and rcx, leaves the flags of the comparison for cc
+static void compareNumbers(Assembler* as, uint8_t* ip, bool swap, const char* message)
+{
+	int slowA = notNumber(as, RAX);
+	int slowB = notNumber(as, RCX);
+
+	movqToXmm(as, 0, RAX);
+	movqToXmm(as, 1, RCX);
+
+	int fast = jmp(as);
+
+	patchHere(as, slowA);
+	patchHere(as, slowB);
+	raiseError(as, ip, message);
+
+	patchHere(as, fast);
+
+	// ucomisd
+	emit(as, 0x66);
+	emit(as, 0x0f);
+	emit(as, 0x2e);
+	emitModRMReg(as, swap ? 1 : 0, swap ? 0 : 1);
+}
+
+// a < b is b above a, <= and >= negate the opposite comparison like the interpreter
+static void comparison(Assembler* as, uint8_t* ip, bool swap, bool negate)
+{
+	popReg(as, RCX);
+	popReg(as, RAX);
+
+	compareNumbers(as, ip, swap, "Operands must be numbers\n");
+
+	setccEax(as, CC_A);
+
+	if (negate)
+	{
+		// xor eax, 1
+		emit(as, 0x83);
+		emit(as, 0xf0);
+		emit(as, 0x01);
+	}
+
+	boolFromEax(as);
+	pushReg(as, RAX);
+}
+
+static inline uint16_t readShort(uint8_t* code, int offset)
+{
+	return (uint16_t)((code[offset] << 8) | code[offset + 1]);
+}
+
+static int32_t slotOffset(int slot)
+{
+	return (int32_t)(slot * sizeof(Value));
+}
+
+// Emits the template for one instruction, returns false if there isn't one
+static bool translate(Assembler* as, int offset)
+{
+	Chunk* chunk = as->chunk;
+	uint8_t* code = chunk->code;
+	Value* constants = chunk->constants.data;
+
+	uint8_t instruction = code[offset];
+	int after = offset + solisInstructionLength(chunk, offset);
+
+	// Helpers are given the ip the interpreter would store, past the instruction's operands
+	uint8_t* ip = code + after;
+
+	switch (instruction)
+	{
+	case OP_CONSTANT:
+		movImm(as, RAX, constants[code[offset + 1]]);
+		pushReg(as, RAX);
+		return true;
+	case OP_CONSTANT_LONG:
+		movImm(as, RAX, constants[readShort(code, offset + 1)]);
+		pushReg(as, RAX);
+		return true;
+	case OP_NIL:
+		pushReg(as, REG_NULL);
+		return true;
+	case OP_TRUE:
+	case OP_FALSE:
+		movImm(as, RAX, SOLIS_BOOL_VALUE(instruction == OP_TRUE));
+		pushReg(as, RAX);
+		return true;
+	case OP_POP:
+		aluImm(as, ALU_IMM_SUB, REG_SP, sizeof(Value));
+		return true;
+	case OP_GET_LOCAL:
+		movLoad(as, RAX, REG_SLOTS, slotOffset(readShort(code, offset + 1)));
+		pushReg(as, RAX);
+		return true;
+	case OP_SET_LOCAL:
+		movLoad(as, RAX, REG_SP, -(int32_t)sizeof(Value));
+		movStore(as, REG_SLOTS, slotOffset(readShort(code, offset + 1)), RAX);
+		return true;
+	case OP_GET_GLOBAL:
+		movLoad(as, RAX, REG_GLOBALS, slotOffset(readShort(code, offset + 1)));
+		pushReg(as, RAX);
+		return true;
+	case OP_SET_GLOBAL:
+		movLoad(as, RAX, REG_SP, -(int32_t)sizeof(Value));
+		movStore(as, REG_GLOBALS, slotOffset(readShort(code, offset + 1)), RAX);
+		return true;
+
+	case OP_ADD:
+	case OP_SUBTRACT:
+	case OP_MULTIPLY:
+	case OP_DIVIDE:
+	case OP_FLOOR_DIVIDE:
+	case OP_POWER:
+	{
+		popReg(as, RCX);
+		popReg(as, RAX);
+
+		switch (instruction)
+		{
+		case OP_ADD:		arithmetic(as, ip, 0x58, OPERATOR_ADD); break;
+		case OP_SUBTRACT:	arithmetic(as, ip, 0x5c, OPERATOR_MINUS); break;
+		case OP_MULTIPLY:	arithmetic(as, ip, 0x59, OPERATOR_STAR); break;
+		case OP_DIVIDE:		arithmetic(as, ip, 0x5e, OPERATOR_SLASH); break;
+		case OP_FLOOR_DIVIDE: arithmetic(as, ip, 0, OPERATOR_SLASH_SLASH); break;
+		default:			arithmetic(as, ip, 0, OPERATOR_POWER); break;
+		}
+		return true;
+	}
+	case OP_CONCAT:
+	{
+		// A chain of numbers is summed in place, anything else sends the whole chain to the helper
+		int count = code[offset + 1];
+		int32_t first = -(int32_t)sizeof(Value) * count;
+
+		int slow[UINT8_MAX];
+
+		movLoad(as, RAX, REG_SP, first);
+		slow[0] = notNumber(as, RAX);
+		movqToXmm(as, 0, RAX);
+
+		for (int i = 1; i < count; i++)
+		{
+			movLoad(as, RCX, REG_SP, first + (int32_t)sizeof(Value) * i);
+			slow[i] = notNumber(as, RCX);
+			movqToXmm(as, 1, RCX);
+			sse(as, 0xf2, 0x58, 0, 1);
+		}
+
+		movqFromXmm(as, RAX, 0);
+		movStore(as, REG_SP, first, RAX);
+		aluImm(as, ALU_IMM_SUB, REG_SP, (int32_t)sizeof(Value) * (count - 1));
+
+		int done = jmp(as);
+
+		for (int i = 0; i < count; i++)
+			patchHere(as, slow[i]);
+
+		concatenateCall(as, ip, count);
+		patchHere(as, done);
+		return true;
+	}
+	case OP_ADD_LOCALS:
+		movLoad(as, RAX, REG_SLOTS, slotOffset(readShort(code, offset + 1)));
+		movLoad(as, RCX, REG_SLOTS, slotOffset(readShort(code, offset + 3)));
+		arithmetic(as, ip, 0x58, OPERATOR_ADD);
+		return true;
+	case OP_ADD_LOCAL_CONST:
+	case OP_SUBTRACT_LOCAL_CONST:
+	{
+		bool add = instruction == OP_ADD_LOCAL_CONST;
+
+		movLoad(as, RAX, REG_SLOTS, slotOffset(readShort(code, offset + 1)));
+		movImm(as, RCX, constants[readShort(code, offset + 3)]);
+		arithmetic(as, ip, add ? 0x58 : 0x5c, add ? OPERATOR_ADD : OPERATOR_MINUS);
+		return true;
+	}
+	case OP_INCREMENT_LOCAL:
+	{
+		int32_t local = slotOffset(readShort(code, offset + 1));
+
+		movLoad(as, RAX, REG_SLOTS, local);
+		movImm(as, RCX, constants[readShort(code, offset + 3)]);
+		arithmetic(as, ip, 0x58, OPERATOR_ADD);
+
+		popReg(as, RAX);
+		movStore(as, REG_SLOTS, local, RAX);
+		return true;
+	}
+
+	case OP_LESS:
+		comparison(as, ip, true, false);
+		return true;
+	case OP_GREATER:
+		comparison(as, ip, false, false);
+		return true;
+	case OP_LESS_EQUAL:
+		comparison(as, ip, false, true);
+		return true;
+	case OP_GREATER_EQUAL:
+		comparison(as, ip, true, true);
+		return true;
+	case OP_EQUAL:
+		popReg(as, RSI);
+		movLoad(as, RDI, REG_SP, -(int32_t)sizeof(Value));
+		callAbsolute(as, (void*)jitValuesEqual);
+		movStore(as, REG_SP, -(int32_t)sizeof(Value), RAX);
+		return true;
+	case OP_NOT:
+		movLoad(as, RAX, REG_SP, -(int32_t)sizeof(Value));
+		testFalsy(as, RAX);
+		setccEax(as, CC_B);
+		boolFromEax(as);
+		movStore(as, REG_SP, -(int32_t)sizeof(Value), RAX);
+		return true;
+	case OP_NEGATE:
+	{
+		movLoad(as, RAX, REG_SP, -(int32_t)sizeof(Value));
+		int slow = notNumber(as, RAX);
+
+		movImm(as, RCX, SIGN_BIT);
+		aluReg(as, ALU_XOR, RAX, RCX);
+		movStore(as, REG_SP, -(int32_t)sizeof(Value), RAX);
+
+		// Vectors and matrices, anything else raises the error
+		int done = jmp(as);
+		patchHere(as, slow);
+		negateCall(as, ip);
+		patchHere(as, done);
+		return true;
+	}
+
+	case OP_JUMP:
+		jumpTo(as, -1, after + readShort(code, offset + 1));
+		return true;
+	case OP_LOOP:
+		jumpTo(as, -1, after - readShort(code, offset + 1));
+		return true;
+	case OP_JUMP_IF_FALSE:
+		movLoad(as, RAX, REG_SP, -(int32_t)sizeof(Value));
+		testFalsy(as, RAX);
+		jumpTo(as, CC_B, after + readShort(code, offset + 1));
+		return true;
+	case OP_JUMP_IF_FALSE_POP:
+		popReg(as, RAX);
+		testFalsy(as, RAX);
+		jumpTo(as, CC_B, after + readShort(code, offset + 1));
+		return true;
+	case OP_LESS_LOCAL_CONST_JUMP:
+		movLoad(as, RAX, REG_SLOTS, slotOffset(readShort(code, offset + 1)));
+		movImm(as, RCX, constants[readShort(code, offset + 3)]);
+		compareNumbers(as, ip, true, "Operands must be numbers\n");
+		jumpTo(as, CC_BE, after + readShort(code, offset + 5));
+		return true;
+	case OP_RANGE_LOOP:
+	{
+		int32_t counter = slotOffset(readShort(code, offset + 1));
+
+		movLoad(as, RAX, REG_SLOTS, counter);
+		movLoad(as, RCX, REG_SLOTS, counter + (int32_t)sizeof(Value));
+		compareNumbers(as, ip, true, "Range bounds must be numbers\n");
+		jumpTo(as, CC_BE, after + readShort(code, offset + 3));
+
+		pushReg(as, RAX);
+		return true;
+	}
+	case OP_RANGE_NEXT:
+	{
+		int32_t counter = slotOffset(readShort(code, offset + 1));
+
+		movLoad(as, RAX, REG_SLOTS, counter);
+		movqToXmm(as, 0, RAX);
+		movImm(as, RCX, SOLIS_NUMERIC_VALUE(1.0));
+		movqToXmm(as, 1, RCX);
+		sse(as, 0xf2, 0x58, 0, 1);
+		movqFromXmm(as, RAX, 0);
+		movStore(as, REG_SLOTS, counter, RAX);
+
+		jumpTo(as, -1, after - readShort(code, offset + 3));
+		return true;
+	}
+
+	case OP_CALL_0: case OP_CALL_1: case OP_CALL_2: case OP_CALL_3:
+	case OP_CALL_4: case OP_CALL_5: case OP_CALL_6: case OP_CALL_7:
+	case OP_CALL_8: case OP_CALL_9: case OP_CALL_10: case OP_CALL_11:
+	case OP_CALL_12: case OP_CALL_13: case OP_CALL_14: case OP_CALL_15:
+	case OP_CALL_16:
+		syncSp(as);
+		movReg(as, RDI, REG_VM);
+		movImm(as, RSI, (uint64_t)(uintptr_t)ip);
+		movImm(as, RDX, (uint64_t)(instruction - OP_CALL_0));
+		callAbsolute(as, (void*)solisJitCall);
+		checkHelperResult(as);
+		reloadSp(as);
+		return true;
+
+	case OP_RETURN:
+		// Leave the result where the callee was
+		movLoad(as, RAX, REG_SP, -(int32_t)sizeof(Value));
+		movStore(as, REG_SLOTS, 0, RAX);
+		lea(as, REG_SP, REG_SLOTS, sizeof(Value));
+		syncSp(as);
+
+		movImm(as, RAX, 1);
+		epilogue(as);
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool solisJitCompile(VM* vm, ObjFunction* function)
+{
+	Chunk* chunk = &function->chunk;
+
+	function->jitFailed = true;
+
+	if (chunk->count == 0)
+		return false;
+
+	Assembler as;
+	as.vm = vm;
+	as.chunk = chunk;
+	as.code = NULL;
+	as.count = 0;
+	as.capacity = 0;
+	as.fixups = NULL;
+	as.fixupCount = 0;
+	as.fixupCapacity = 0;
+	as.labels = (int*)solisRawReallocate(vm, NULL, sizeof(int) * chunk->count);
+
+	prologue(&as);
+
+	bool success = true;
+
+	for (int offset = 0; offset < chunk->count; offset += solisInstructionLength(chunk, offset))
+	{
+		as.labels[offset] = as.count;
+
+		if (!translate(&as, offset))
+		{
+			success = false;
+			break;
+		}
+	}
+
+	// Shared exit for runtime errors
+	int errorExit = as.count;
+
+	// xor eax, eax
+	emit(&as, 0x31);
+	emit(&as, 0xc0);
+	epilogue(&as);
+
+	void* memory = MAP_FAILED;
+
+	if (success)
+	{
+		for (int i = 0; i < as.fixupCount; i++)
+		{
+			JitFixup* fixup = &as.fixups[i];
+			int target = fixup->target == TARGET_ERROR ? errorExit : as.labels[fixup->target];
+
+			int32_t rel = target - (fixup->at + 4);
+			memcpy(&as.code[fixup->at], &rel, sizeof(int32_t));
+		}
+
+		// Write the code then flip the pages to executable so they are never writable and executable at once
+		memory = mmap(NULL, as.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (memory != MAP_FAILED)
+		{
+			memcpy(memory, as.code, as.count);
+
+			if (mprotect(memory, as.count, PROT_READ | PROT_EXEC) != 0)
+			{
+				munmap(memory, as.count);
+				memory = MAP_FAILED;
+			}
+		}
+	}
+
+	solisRawFree(vm, as.code);
+	solisRawFree(vm, as.labels);
+	solisRawFree(vm, as.fixups);
+
+	if (memory == MAP_FAILED)
+		return false;
+
+	function->jitCode = memory;
+	function->jitSize = (size_t)as.count;
+	function->jitFailed = false;
+
+	return true;
+}
+
+void solisJitFree(ObjFunction* function)
+{
+	if (function->jitCode == NULL)
+		return;
+
+	munmap(function->jitCode, function->jitSize);
+
+	function->jitCode = NULL;
+	function->jitSize = 0;
+}
+
+#else
+
+bool solisJitCompile(VM* vm, ObjFunction* function)
+{
+	function->jitFailed = true;
+	return false;
+}
+
+void solisJitFree(ObjFunction* function)
+{
+
+}
+
+#endif
+
+void solisJitRaiseError(VM* vm, uint8_t* ip, const char* message)
+{
+	vm->frames[vm->frameCount - 1].ip = ip;
+
+	solisVMRaiseError(vm, "%s", message);
+}
@@ -0,0 +1,48 @@
+#ifndef SOLIS_JIT_H
+#define SOLIS_JIT_H
+
+#include "solis_common.h"
+#include "solis_value.h"
+
+/*
+	Baseline JIT that translates the stack bytecode of a function into x86-64 machine code.
+	Each opcode is a fixed template, anything slow calls back into the VM.
+	Only NaN boxed values on x86-64 Linux are supported, everywhere else functions stay interpreted.
+*/
+#if defined(__x86_64__) && defined(__linux__) && defined(SOLIS_NAN_BOXING)
+#define SOLIS_JIT_SUPPORTED 1
+#else
+#define SOLIS_JIT_SUPPORTED 0
+#endif
+
+// Number of calls before a function is compiled
+#define SOLIS_JIT_DEFAULT_THRESHOLD 100
+
+/*
+	Compiled code for a function.
+	Runs with a frame already pushed for the function and the callee and arguments at slots.
+	Returns false on a runtime error, otherwise the result is left at slots[0].
+*/
+typedef bool (*SolisJitFunction)(VM* vm, Value* slots);
+
+/*
+	Compiles the function, returns false if it uses an opcode without a template.
+	A function that fails is never tried again.
+*/
+bool solisJitCompile(VM* vm, ObjFunction* function);
+
+/*
+	Frees the machine code of a function
+*/
+void solisJitFree(ObjFunction* function);
+
+/*
+	Helpers called from generated code, ip is where the interpreter would be so errors report the right line
+*/
+bool solisJitBinaryOperator(VM* vm, uint8_t* ip, int op);
+bool solisJitNegate(VM* vm, uint8_t* ip);
+bool solisJitConcatenate(VM* vm, uint8_t* ip, int count);
+bool solisJitCall(VM* vm, uint8_t* ip, int argCount);
+void solisJitRaiseError(VM* vm, uint8_t* ip, const char* message);
+
+#endif // SOLIS_JIT_H
@@ -4,20 +4,68 @@
 #include "solis_hashtable.h"
 #include <string.h>
 #include "solis_vm.h"
+#include "solis_jit.h"
 
 #include <stdio.h>
 
-Object* solisAllocateObject(VM* vm, size_t size, ObjectType type)
+const char* solisObjectTypeName(ObjectType type)
+{
+	switch (type) {
+	case OBJ_FUNCTION: return "function";
+	case OBJ_STRING: return "string";
+	case OBJ_CLOSURE: return "closure";
+	case OBJ_UPVALUE: return "upvalue";
+	case OBJ_NATIVE_FUNCTION: return "native function";
+	case OBJ_ENUM: return "enum";
+	case OBJ_USERDATA: return "userdata";
+	case OBJ_CLASS: return "class";
+	case OBJ_INSTANCE: return "instance";
+	case OBJ_BOUND_METHOD: return "bound method";
+	case OBJ_LIST: return "list";
+	case OBJ_MODULE: return "module";
+	case OBJ_DICTIONARY: return "dictionary";
+	case OBJ_WEAK_REF: return "weak ref";
+	case OBJ_WEAK_TABLE: return "weak table";
+	case OBJ_TYPED_ARRAY: return "typed array";
+	case OBJ_VECTOR: return "vector";
+	case OBJ_MATRIX: return "matrix";
+	case OBJ_STRING_BUILDER: return "string builder";
+	default: return "unknown";
+	}
+}
+
+// Objects holding memory of their own have to be freed when they die, the rest can just be written over
+static bool ownsMemory(ObjectType type)
 {
-	Object* object = (Object*)solisReallocate(vm, NULL, 0, size);
-	object->type = type;
+	switch (type) {
+	case OBJ_STRING:
+	case OBJ_FUNCTION:
+	case OBJ_CLOSURE:
+	case OBJ_ENUM:
+	case OBJ_USERDATA:
+	case OBJ_CLASS:
+	case OBJ_LIST:
+	case OBJ_MODULE:
+	case OBJ_DICTIONARY:
+	case OBJ_WEAK_TABLE:
+	case OBJ_TYPED_ARRAY:
+	case OBJ_STRING_BUILDER:
+		return true;
+	default:
+		return false;
+	}
+}
 
-	// Add the object to the chain
-	// Needed for GC
-	object->next = vm->objects;
-	vm->objects = object;
+Object* solisAllocateObject(VM* vm, size_t size, ObjectType type)
+{
+	bool inBlock;
+	Object* object = (Object*)solisAllocateObjectMemory(vm, size, ownsMemory(type), &inBlock);
+	object->type = (uint8_t)type;
+	object->classObj = NULL;
 
 	object->isMarked = false;
+	object->isRemembered = false;
+	object->inBlock = inBlock;
 
 #ifdef SOLIS_DEBUG_LOG_GC
 	printf("%p allocate %zu for %d\n", (void*)object, size, type);
@@ -26,6 +74,37 @@ Object* solisAllocateObject(VM* vm, size_t size, ObjectType type)
 	return object;
 }
 
+size_t solisObjectSize(Object* object)
+{
+	switch (object->type) {
+	case OBJ_STRING: return sizeof(ObjString);
+	case OBJ_FUNCTION: return sizeof(ObjFunction);
+	case OBJ_CLOSURE: return sizeof(ObjClosure);
+	case OBJ_UPVALUE: return sizeof(ObjUpvalue);
+	case OBJ_NATIVE_FUNCTION: return sizeof(ObjNative);
+	case OBJ_ENUM: return sizeof(ObjEnum);
+	case OBJ_USERDATA: return sizeof(ObjUserdata);
+	case OBJ_CLASS: return sizeof(ObjClass);
+	case OBJ_INSTANCE: return sizeof(ObjInstance) + sizeof(Value) * ((ObjInstance*)object)->fieldCount;
+	case OBJ_BOUND_METHOD: return sizeof(ObjBoundMethod);
+	case OBJ_LIST: return sizeof(ObjList);
+	case OBJ_MODULE: return sizeof(ObjModule);
+	case OBJ_DICTIONARY: return sizeof(ObjDictionary);
+	case OBJ_WEAK_REF: return sizeof(ObjWeakRef);
+	case OBJ_WEAK_TABLE: return sizeof(ObjWeakTable);
+	case OBJ_TYPED_ARRAY: return sizeof(ObjTypedArray);
+	case OBJ_VECTOR: return sizeof(ObjVector);
+	case OBJ_MATRIX: return sizeof(ObjMatrix);
+	case OBJ_STRING_BUILDER: return sizeof(ObjStringBuilder);
+	default: return sizeof(Object);
+	}
+}
+
+static void releaseObject(VM* vm, Object* object)
+{
+	solisFreeObjectMemory(vm, object);
+}
+
 void solisFreeObject(VM* vm, Object* object)
 {
 #ifdef SOLIS_DEBUG_LOG_GC
@@ -35,32 +114,34 @@ void solisFreeObject(VM* vm, Object* object)
 	switch (object->type) {
 	case OBJ_STRING: {
 		ObjString* string = (ObjString*)object;
-		SOLIS_FREE_ARRAY(vm, char, string->chars, string->length + 1);
-		SOLIS_FREE(vm, ObjString, object);
+		SOLIS_FREE_SMALL(vm, char, string->chars, string->length + 1);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_FUNCTION: {
 		ObjFunction* function = (ObjFunction*)object;
 		solisFreeChunk(vm, &function->chunk);
-		SOLIS_FREE(vm, ObjFunction, object);
+		solisFreeChunk(vm, &function->registerChunk);
+		solisJitFree(function);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_CLOSURE:
 	{
 		ObjClosure* closure = (ObjClosure*)object;
 		
-		SOLIS_FREE_ARRAY(vm, ObjUpvalue*, closure->upvalues, closure->upvalueCount);
-		SOLIS_FREE(vm, ObjClosure, object);
+		SOLIS_FREE_SMALL(vm, ObjUpvalue*, closure->upvalues, closure->upvalueCount);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_NATIVE_FUNCTION:
 	{
-		SOLIS_FREE(vm, ObjNative, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_ENUM: {
 		solisFreeHashTable(&((ObjEnum*)object)->fields);
-		SOLIS_FREE(vm, ObjEnum, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_USERDATA:
@@ -71,39 +152,38 @@ void solisFreeObject(VM* vm, Object* object)
 		if (userdata->cleanupFunc)
 			userdata->cleanupFunc(userdata->userdata);
 
-		SOLIS_FREE(vm, ObjUserdata, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_CLASS:
 	{
 		ObjClass* klass = (ObjClass*)object;
 		solisFreeHashTable(&klass->fields);
+		solisValueBufferClear(vm, &klass->fieldDefaults);
 		solisFreeHashTable(&klass->methods);
 		solisFreeHashTable(&klass->statics);
 		// SOLIS_FREE(vm, ObjClosure, klass->constructor);
-		SOLIS_FREE(vm, ObjClass, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_INSTANCE: {
-		ObjInstance* instance = (ObjInstance*)object;
-		solisFreeHashTable(&instance->fields);
-		SOLIS_FREE(vm, ObjInstance, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_BOUND_METHOD: {
-		SOLIS_FREE(vm, ObjBoundMethod, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_UPVALUE: 
 	{
-		SOLIS_FREE(vm, ObjUpvalue, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_LIST:
 	{
 		ObjList* list = (ObjList*)object;
 		solisValueBufferClear(vm, &list->values);
-		SOLIS_FREE(vm, ObjList, object);
+		releaseObject(vm, object);
 		break;
 	}
 	case OBJ_MODULE:
@@ -112,9 +192,47 @@ void solisFreeObject(VM* vm, Object* object)
 		ObjModule* mdl = (ObjModule*)object;
 		solisValueBufferClear(vm, &mdl->globals);
 		solisFreeHashTable(&mdl->globalMap);
+		releaseObject(vm, object);
 
 		break;
 	}
+	case OBJ_DICTIONARY:
+	{
+		solisFreeValueTable(vm, &((ObjDictionary*)object)->table);
+		releaseObject(vm, object);
+		break;
+	}
+	case OBJ_WEAK_TABLE:
+	{
+		solisFreeValueTable(vm, &((ObjWeakTable*)object)->table);
+		releaseObject(vm, object);
+		break;
+	}
+	case OBJ_WEAK_REF:
+	{
+		releaseObject(vm, object);
+		break;
+	}
+	case OBJ_TYPED_ARRAY:
+	{
+		ObjTypedArray* array = (ObjTypedArray*)object;
+		SOLIS_FREE_SMALL(vm, uint8_t, array->data, solisArrayElementSize(array->kind) * array->count);
+		releaseObject(vm, object);
+		break;
+	}
+	case OBJ_VECTOR:
+	case OBJ_MATRIX:
+	{
+		releaseObject(vm, object);
+		break;
+	}
+	case OBJ_STRING_BUILDER:
+	{
+		ObjStringBuilder* builder = (ObjStringBuilder*)object;
+		SOLIS_FREE_ARRAY(vm, char, builder->chars, builder->capacity);
+		releaseObject(vm, object);
+		break;
+	}
 	}
 }
 
@@ -147,7 +265,7 @@ ObjString* solisCopyString(VM* vm, const char* chars, int length)
 	}
 
 	// + 1 so we can add the null terminator
-	char* heapChars = SOLIS_ALLOCATE(vm, char, length + 1);
+	char* heapChars = SOLIS_ALLOCATE_SMALL(vm, char, length + 1);
 	memcpy(heapChars, chars, length);
 	heapChars[length] = '\0';
 
@@ -164,7 +282,7 @@ ObjString* solisTakeString(VM* vm, char* chars, int length)
 
 	if (interned != NULL)
 	{
-		SOLIS_FREE_ARRAY(vm, char, chars, length + 1);
+		SOLIS_FREE_SMALL(vm, char, chars, length + 1);
 		return interned;
 	}
 
@@ -174,7 +292,7 @@ ObjString* solisTakeString(VM* vm, char* chars, int length)
 ObjString* solisConcatenateStrings(VM* vm, ObjString* a, ObjString* b)
 {
 	int length = a->length + b->length;
-	char* chars = SOLIS_ALLOCATE(vm, char, length + 1);
+	char* chars = SOLIS_ALLOCATE_SMALL(vm, char, length + 1);
 	memcpy(chars, a->chars, a->length);
 	memcpy(chars + a->length, b->chars, b->length);
 	chars[length] = '\0';
@@ -182,6 +300,27 @@ ObjString* solisConcatenateStrings(VM* vm, ObjString* a, ObjString* b)
 	return solisTakeString(vm, chars, length);
 }
 
+ObjString* solisConcatenateStringValues(VM* vm, const Value* strings, int count)
+{
+	int length = 0;
+	for (int i = 0; i < count; i++)
+		length += SOLIS_AS_STRING(strings[i])->length;
+
+	char* chars = SOLIS_ALLOCATE_SMALL(vm, char, length + 1);
+
+	int offset = 0;
+	for (int i = 0; i < count; i++)
+	{
+		ObjString* string = SOLIS_AS_STRING(strings[i]);
+		memcpy(chars + offset, string->chars, string->length);
+		offset += string->length;
+	}
+
+	chars[length] = '\0';
+
+	return solisTakeString(vm, chars, length);
+}
+
 
 
 ObjFunction* solisNewFunction(VM* vm)
@@ -190,17 +329,21 @@ ObjFunction* solisNewFunction(VM* vm)
 	function->arity = 0;
 	function->upvalueCount = 0;
 	function->name = NULL;
+	function->registerCount = 0;
+	function->callCount = 0;
+	function->jitCode = NULL;
+	function->jitSize = 0;
+	function->jitFailed = false;
 	solisInitChunk(vm, &function->chunk);
+	solisInitChunk(vm, &function->registerChunk);
 	return function;
 }
 
 
 ObjClosure* solisNewClosure(VM* vm, ObjFunction* function)
 {
-	ObjClosure* closure = ALLOCATE_OBJ(vm, ObjClosure, OBJ_CLOSURE);
-	closure->function = function;
-
-	ObjUpvalue** upvalues = SOLIS_ALLOCATE(vm, ObjUpvalue*,
+	// The array is allocated first since allocating can collect and nothing refers to the closure yet
+	ObjUpvalue** upvalues = SOLIS_ALLOCATE_SMALL(vm, ObjUpvalue*,
 		function->upvalueCount);
 
 	for (int i = 0; i < function->upvalueCount; i++) 
@@ -208,6 +351,9 @@ ObjClosure* solisNewClosure(VM* vm, ObjFunction* function)
 		upvalues[i] = NULL;
 	}
 
+	ObjClosure* closure = ALLOCATE_OBJ(vm, ObjClosure, OBJ_CLOSURE);
+	closure->function = function;
+
 	closure->upvalues = upvalues;
 	closure->upvalueCount = function->upvalueCount;
 
@@ -261,9 +407,13 @@ ObjClass* solisNewClass(VM* vm, ObjString* name)
 	klass->name = name;
 
 	klass->constructor = NULL;
+	klass->nativeConstructor = NULL;
 	klass->obj.classObj = klass;
+	klass->version = 0;
+	klass->hasInstances = false;
 
 	solisInitHashTable(&klass->fields, vm);
+	solisValueBufferInit(vm, &klass->fieldDefaults);
 	solisInitHashTable(&klass->methods, vm);
 	solisInitHashTable(&klass->statics, vm);
 
@@ -274,16 +424,61 @@ ObjClass* solisNewClass(VM* vm, ObjString* name)
 
 ObjInstance* solisNewInstance(VM* vm, ObjClass* klass)
 {
-	ObjInstance* instance = ALLOCATE_OBJ(vm, ObjInstance, OBJ_INSTANCE);
+	int fieldCount = klass->fieldDefaults.count;
+
+	ObjInstance* instance = (ObjInstance*)solisAllocateObject(vm, sizeof(ObjInstance) + sizeof(Value) * fieldCount, OBJ_INSTANCE);
 	instance->klass = klass;
 
 	instance->obj.classObj = klass;
+	klass->hasInstances = true;
+
+	instance->fieldCount = fieldCount;
+
+	if (fieldCount > 0)
+		memcpy(instance->fields, klass->fieldDefaults.data, sizeof(Value) * fieldCount);
 
-	solisInitHashTable(&instance->fields, vm);
-	solisHashTableCopy(&klass->fields, &instance->fields);
 	return instance;
 }
 
+int solisDefineClassField(VM* vm, ObjClass* klass, ObjString* name, Value defaultValue)
+{
+	int slot = solisGetFieldSlot(klass, name);
+
+	if (slot != -1)
+	{
+		klass->fieldDefaults.data[slot] = defaultValue;
+		solisWriteBarrier(vm, (Object*)klass, defaultValue);
+		return slot;
+	}
+
+	// Existing instances have no room for another slot
+	if (klass->hasInstances)
+		return -1;
+
+	slot = klass->fieldDefaults.count;
+
+	// Keep the default reachable while the buffers grow
+	solisPush(vm, defaultValue);
+	solisValueBufferWrite(vm, &klass->fieldDefaults, defaultValue);
+	solisHashTableInsert(&klass->fields, name, SOLIS_NUMERIC_VALUE((double)slot));
+	solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(name));
+	solisWriteBarrier(vm, (Object*)klass, defaultValue);
+	solisPop(vm);
+
+	klass->version++;
+
+	return slot;
+}
+
+int solisGetFieldSlot(ObjClass* klass, ObjString* name)
+{
+	Value slot;
+	if (!solisHashTableGet(&klass->fields, name, &slot))
+		return -1;
+
+	return (int)SOLIS_AS_NUMBER(slot);
+}
+
 ObjBoundMethod* solisNewBoundMethod(VM* vm, Value receiver, ObjClosure* closure)
 {
 	ObjBoundMethod* bound = ALLOCATE_OBJ(vm, ObjBoundMethod, OBJ_BOUND_METHOD);
@@ -319,6 +514,127 @@ ObjModule* solisNewModule(VM* vm)
 
 	solisInitHashTable(&mdl->globalMap, vm);
 	solisValueBufferInit(vm, &mdl->globals);
+	mdl->closure = NULL;
 
 	return mdl;
-}
\ No newline at end of file
+}
+
+ObjDictionary* solisNewDictionary(VM* vm)
+{
+	ObjDictionary* dictionary = ALLOCATE_OBJ(vm, ObjDictionary, OBJ_DICTIONARY);
+	dictionary->obj.classObj = vm->dictionaryClass;
+	solisInitValueTable(&dictionary->table);
+
+	return dictionary;
+}
+
+void solisDictionarySet(VM* vm, ObjDictionary* dictionary, Value key, Value value)
+{
+	solisValueTableSet(vm, &dictionary->table, key, value);
+	solisWriteBarrier(vm, (Object*)dictionary, key);
+	solisWriteBarrier(vm, (Object*)dictionary, value);
+}
+
+ObjWeakRef* solisNewWeakRef(VM* vm, Value target)
+{
+	ObjWeakRef* ref = ALLOCATE_OBJ(vm, ObjWeakRef, OBJ_WEAK_REF);
+	ref->obj.classObj = vm->weakRefClass;
+	ref->target = target;
+	ref->tracedEpoch = 0;
+
+	ref->nextWeak = vm->weakObjects;
+	vm->weakObjects = (Object*)ref;
+
+	return ref;
+}
+
+ObjWeakTable* solisNewWeakTable(VM* vm)
+{
+	ObjWeakTable* table = ALLOCATE_OBJ(vm, ObjWeakTable, OBJ_WEAK_TABLE);
+	table->obj.classObj = vm->weakTableClass;
+	solisInitValueTable(&table->table);
+	table->tracedEpoch = 0;
+
+	table->nextWeak = vm->weakObjects;
+	vm->weakObjects = (Object*)table;
+
+	return table;
+}
+
+ObjTypedArray* solisNewTypedArray(VM* vm, SolisArrayKind kind, int count)
+{
+	// Nothing refers to the storage yet so it doesn't matter if the object allocation collects
+	size_t bytes = solisArrayElementSize(kind) * count;
+	void* data = SOLIS_ALLOCATE_SMALL(vm, uint8_t, bytes);
+	if (bytes > 0)
+		memset(data, 0, bytes);
+
+	ObjTypedArray* array = ALLOCATE_OBJ(vm, ObjTypedArray, OBJ_TYPED_ARRAY);
+	array->obj.classObj = vm->typedArrayClasses[kind];
+	array->kind = kind;
+	array->count = count;
+	array->data = data;
+
+	return array;
+}
+
+ObjVector* solisNewVector(VM* vm, int size)
+{
+	ObjVector* vector = ALLOCATE_OBJ(vm, ObjVector, OBJ_VECTOR);
+	vector->obj.classObj = vm->vectorClasses[size - 2];
+	vector->size = size;
+
+	for (int i = 0; i < 4; i++)
+		vector->v[i] = 0.0;
+
+	return vector;
+}
+
+ObjMatrix* solisNewMatrix(VM* vm)
+{
+	ObjMatrix* matrix = ALLOCATE_OBJ(vm, ObjMatrix, OBJ_MATRIX);
+	matrix->obj.classObj = vm->matrixClass;
+
+	for (int i = 0; i < 16; i++)
+		matrix->m[i] = 0.0;
+
+	return matrix;
+}
+
+ObjStringBuilder* solisNewStringBuilder(VM* vm)
+{
+	ObjStringBuilder* builder = ALLOCATE_OBJ(vm, ObjStringBuilder, OBJ_STRING_BUILDER);
+	builder->obj.classObj = vm->stringBuilderClass;
+	builder->chars = NULL;
+	builder->length = 0;
+	builder->capacity = 0;
+
+	return builder;
+}
+
+void solisStringBuilderAppend(VM* vm, ObjStringBuilder* builder, const char* chars, int length)
+{
+	if (length == 0)
+		return;
+
+	// Appending a builder to itself, find the characters again if the buffer moves
+	bool own = builder->chars != NULL && chars >= builder->chars && chars < builder->chars + builder->capacity;
+	size_t ownOffset = own ? (size_t)(chars - builder->chars) : 0;
+
+	if (builder->length + length > builder->capacity)
+	{
+		int capacity = GROW_CAPACITY(builder->capacity);
+		while (capacity < builder->length + length)
+			capacity *= 2;
+
+		// The builder is reachable from the caller so a collection here won't free it
+		builder->chars = (char*)solisReallocate(vm, builder->chars, builder->capacity, capacity);
+		builder->capacity = capacity;
+
+		if (own)
+			chars = builder->chars + ownOffset;
+	}
+
+	memcpy(builder->chars + builder->length, chars, length);
+	builder->length += length;
+}
@@ -8,19 +8,29 @@
 
 #include "solis_interface.h"
 #include "solis_hashtable.h"
+#include "solis_simd.h"
 
 
+/*
+	Kept to 16 bytes since every object pays for it.
+	Objects are found through the heap rather than a list, see LargeObject in solis_gc.h for the ones outside of the blocks.
+*/
 struct Object
 {
-	ObjectType type;
-
 	ObjClass* classObj;
 
-	// is the object marked by the gc
+	// An ObjectType, a byte is enough so it packs in with the flags
+	uint8_t type;
+
+	// is the object marked by the gc, objects in a block are marked in the block's bitmap instead
+	// Marks are kept after a collection so a marked object is an old one
 	bool isMarked;
 
-	// Next object in the allocated linked list
-	Object* next;
+	// Set while an old object is in the remembered set
+	bool isRemembered;
+
+	// Set if the object lives in a nursery block rather than its own allocation
+	bool inBlock;
 };
 
 /*
@@ -52,6 +62,17 @@ struct ObjFunction
 	int upvalueCount;
 	Chunk chunk;
 	ObjString* name;
+
+	// Register mode version of the function, empty when it couldn't be compiled for registers
+	// It shares the constants of chunk
+	Chunk registerChunk;
+	int registerCount;
+
+	// Baseline JIT state, jitCode is NULL until the function gets hot enough to compile
+	int callCount;
+	void* jitCode;
+	size_t jitSize;
+	bool jitFailed;
 };
 
 typedef struct ObjUpvalue {
@@ -129,6 +150,10 @@ struct ObjClass
 	// Constructor is stored here to make it easily accessable without a lookup in a hash table 
 	ObjClosure* constructor;
 
+	// Set for classes whose objects are made natively, it is called in place of creating an instance
+	// with the class as self and returns the new object
+	SolisNativeSignature nativeConstructor;
+
 	// NOTE: Experiment to see if storing operators like this is better 
 	// This makes the class object quite big.. might want to do something slightly different storage wise 
 	Object* operators[OPERATOR_COUNT];
@@ -136,8 +161,21 @@ struct ObjClass
 	// This is all the static variables that belong to the class instead 
 	HashTable statics;
 
+	// Maps each field name to its slot in the instance field array
+	// Every instance of the class shares this layout
 	HashTable fields;
+
+	// Default value for each field slot, copied straight into new instances
+	ValueBuffer fieldDefaults;
+
 	HashTable methods;
+
+	// Bumped whenever a field, method or static is added to the class
+	// Inline caches compare against this to know if they are stale
+	uint32_t version;
+
+	// Set once an instance has been created, instances store their fields inline so the layout can't grow after that
+	bool hasInstances;
 };
 
 #define SOLIS_IS_CLASS(value) solisIsObjType(value, OBJ_CLASS)
@@ -149,8 +187,12 @@ struct ObjInstance
 
 	ObjClass* klass;
 
-	// These fields are initialised with the fields from the klass object
-	HashTable fields;
+	// Number of field slots the instance was created with
+	int fieldCount;
+
+	// Field values stored inline, indexed by the slots in klass->fields
+	// These fields are initialised with the field defaults from the klass object
+	Value fields[];
 };
 
 #define SOLIS_IS_INSTANCE(value) solisIsObjType(value, OBJ_INSTANCE)
@@ -196,6 +238,122 @@ struct ObjModule
 	ObjClosure* closure;
 };
 
+/*
+	Maps any value to another, written {key: value} in scripts. Numbers compare by value and objects by identity,
+	strings are interned so equal strings are the same key.
+*/
+struct ObjDictionary
+{
+	Object obj;
+
+	ValueTable table;
+};
+
+#define SOLIS_IS_DICTIONARY(value) solisIsObjType(value, OBJ_DICTIONARY)
+#define SOLIS_AS_DICTIONARY(value) ((ObjDictionary*)SOLIS_AS_OBJECT(value))
+
+/*
+	Holds onto an object without keeping it alive, the collector sets target to null once nothing else does.
+	Values that aren't objects are never cleared.
+*/
+struct ObjWeakRef
+{
+	Object obj;
+
+	Value target;
+
+	// Every weak object is linked so the collector can clear them once marking is done
+	Object* nextWeak;
+
+	// The collection that last traced it, only those have to be looked at afterwards
+	uint32_t tracedEpoch;
+};
+
+#define SOLIS_IS_WEAK_REF(value) solisIsObjType(value, OBJ_WEAK_REF)
+#define SOLIS_AS_WEAK_REF(value) ((ObjWeakRef*)SOLIS_AS_OBJECT(value))
+
+/*
+	A table whose object keys are weak. An entry's value is only kept alive while its key is,
+	so a value referring back to its own key doesn't keep the entry around.
+	Entries are removed by the collector once their key dies, keys that aren't objects are held like any other table.
+	Keys are compared by identity, strings are interned so equal strings are the same key.
+*/
+struct ObjWeakTable
+{
+	Object obj;
+
+	ValueTable table;
+
+	Object* nextWeak;
+	uint32_t tracedEpoch;
+};
+
+#define SOLIS_IS_WEAK_TABLE(value) solisIsObjType(value, OBJ_WEAK_TABLE)
+#define SOLIS_AS_WEAK_TABLE(value) ((ObjWeakTable*)SOLIS_AS_OBJECT(value))
+
+/*
+	A fixed length array of unboxed numbers, Float64Array, Float32Array or Int32Array in scripts.
+	Numbers are converted to the element type when they are stored and come back out as numbers.
+	Bulk operations on them run the kernels in solis_simd.
+*/
+struct ObjTypedArray
+{
+	Object obj;
+
+	SolisArrayKind kind;
+
+	int count;
+	void* data;
+};
+
+#define SOLIS_IS_TYPED_ARRAY(value) solisIsObjType(value, OBJ_TYPED_ARRAY)
+#define SOLIS_AS_TYPED_ARRAY(value) ((ObjTypedArray*)SOLIS_AS_OBJECT(value))
+
+/*
+	Vec2, Vec3 and Vec4 in scripts. The components are stored in the object and never change,
+	every operation makes a new vector so they behave like numbers.
+	There is always room for four components, the ones past size are kept at 0 so all sizes share the same code.
+*/
+struct ObjVector
+{
+	Object obj;
+
+	int size;
+	double v[4];
+};
+
+#define SOLIS_IS_VECTOR(value) solisIsObjType(value, OBJ_VECTOR)
+#define SOLIS_AS_VECTOR(value) ((ObjVector*)SOLIS_AS_OBJECT(value))
+
+/*
+	Mat4 in scripts, a 4x4 matrix stored column major so m[column * 4 + row]. Like vectors it never changes.
+*/
+struct ObjMatrix
+{
+	Object obj;
+
+	double m[16];
+};
+
+#define SOLIS_IS_MATRIX(value) solisIsObjType(value, OBJ_MATRIX)
+#define SOLIS_AS_MATRIX(value) ((ObjMatrix*)SOLIS_AS_OBJECT(value))
+
+/*
+	StringBuilder in scripts, a growable buffer of characters.
+	Appending doesn't make any strings, the contents are hashed and interned once when toString is called.
+*/
+struct ObjStringBuilder
+{
+	Object obj;
+
+	char* chars;
+	int length;
+	int capacity;
+};
+
+#define SOLIS_IS_STRING_BUILDER(value) solisIsObjType(value, OBJ_STRING_BUILDER)
+#define SOLIS_AS_STRING_BUILDER(value) ((ObjStringBuilder*)SOLIS_AS_OBJECT(value))
+
 /*
 	Returns the specified value is equal to the type
 	If the value is not an object it returns false.
@@ -213,6 +371,7 @@ ObjString* solisCopyString(VM* vm, const char* chars, int length);
 
 /*
 	Takes owner ship of the supplied values and combines them into a String object
+	The characters must have been allocated with SOLIS_ALLOCATE_SMALL, length + 1 of them
 */
 ObjString* solisTakeString(VM* vm, char* chars, int length);
 
@@ -221,6 +380,12 @@ ObjString* solisTakeString(VM* vm, char* chars, int length);
 */
 ObjString* solisConcatenateStrings(VM* vm, ObjString* a, ObjString* b);
 
+/*
+	Joins count strings into one, the result is sized, hashed and interned once.
+	Every value must be a string and stay reachable until this returns.
+*/
+ObjString* solisConcatenateStringValues(VM* vm, const Value* strings, int count);
+
 
 ObjFunction* solisNewFunction(VM* vm);
 
@@ -238,6 +403,76 @@ ObjClass* solisNewClass(VM* vm, ObjString* name);
 
 ObjInstance* solisNewInstance(VM* vm, ObjClass* klass);
 
+ObjDictionary* solisNewDictionary(VM* vm);
+
+/*
+	Sets a dictionary entry and applies the write barrier for the key and value
+*/
+void solisDictionarySet(VM* vm, ObjDictionary* dictionary, Value key, Value value);
+
+ObjWeakRef* solisNewWeakRef(VM* vm, Value target);
+
+ObjWeakTable* solisNewWeakTable(VM* vm);
+
+/*
+	Creates a typed array of count elements, all 0
+*/
+ObjTypedArray* solisNewTypedArray(VM* vm, SolisArrayKind kind, int count);
+
+/*
+	Creates a vector of 2, 3 or 4 components, all 0
+*/
+ObjVector* solisNewVector(VM* vm, int size);
+
+/*
+	Creates a matrix of all 0
+*/
+ObjMatrix* solisNewMatrix(VM* vm);
+
+ObjStringBuilder* solisNewStringBuilder(VM* vm);
+
+/*
+	Appends length characters, the buffer at least doubles when it runs out so appending is amortised constant time
+*/
+void solisStringBuilderAppend(VM* vm, ObjStringBuilder* builder, const char* chars, int length);
+
+static inline double solisTypedArrayGet(ObjTypedArray* array, int index)
+{
+	switch (array->kind) {
+	case SOLIS_ARRAY_FLOAT32: return ((float*)array->data)[index];
+	case SOLIS_ARRAY_INT32: return ((int32_t*)array->data)[index];
+	default: return ((double*)array->data)[index];
+	}
+}
+
+static inline void solisTypedArraySet(ObjTypedArray* array, int index, double value)
+{
+	switch (array->kind) {
+	case SOLIS_ARRAY_FLOAT32: ((float*)array->data)[index] = (float)value; break;
+	case SOLIS_ARRAY_INT32: ((int32_t*)array->data)[index] = solisToInt32(value); break;
+	default: ((double*)array->data)[index] = value; break;
+	}
+}
+
+/*
+	Adds a field slot to the class layout. If the field already exists its default value is replaced. 
+	Returns the slot index of the field, or -1 without adding it when the class already has instances. 
+*/
+int solisDefineClassField(VM* vm, ObjClass* klass, ObjString* name, Value defaultValue);
+
+/*
+	Returns the slot index of a field in the class layout or -1 if the class has no field with that name
+*/
+int solisGetFieldSlot(ObjClass* klass, ObjString* name);
+
+/*
+	Reads a field slot from an instance. The layout is fixed once a class has instances so every slot is stored inline. 
+*/
+static inline Value solisGetInstanceSlot(ObjInstance* instance, int slot)
+{
+	return instance->fields[slot];
+}
+
 ObjBoundMethod* solisNewBoundMethod(VM* vm, Value receiver, ObjClosure* closure);
 
 ObjBoundMethod* solisNewNativeBoundMethod(VM* vm, Value receiver, ObjNative* closure);
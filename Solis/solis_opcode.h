@@ -37,6 +37,12 @@ OPCODE(JUMP_IF_FALSE)
 OPCODE(JUMP)
 OPCODE(LOOP)
 
+OPCODE(RANGE_LOOP)
+OPCODE(RANGE_NEXT)
+
+OPCODE(FOR_ITER)
+OPCODE(FOR_NEXT)
+
 OPCODE(CALL_0)
 OPCODE(CALL_1)
 OPCODE(CALL_2)
@@ -80,4 +86,17 @@ OPCODE(INVOKE)
 OPCODE(CREATE_LIST)
 OPCODE(APPEND_LIST)
 
+OPCODE(CREATE_DICTIONARY)
+OPCODE(INSERT_DICTIONARY)
+
+OPCODE(JUMP_IF_FALSE_POP)
+OPCODE(LESS_EQUAL)
+OPCODE(GREATER_EQUAL)
+OPCODE(ADD_LOCALS)
+OPCODE(ADD_LOCAL_CONST)
+OPCODE(SUBTRACT_LOCAL_CONST)
+OPCODE(INCREMENT_LOCAL)
+OPCODE(LESS_LOCAL_CONST_JUMP)
+OPCODE(CONCAT)
+
 OPCODE(RETURN)
@@ -1,5 +1,8 @@
 
 #include "solis_os.h"
+#include "solis_allocator.h"
+
+#include <stdlib.h>
 
 
 #ifdef SOLIS_WINDOWS
@@ -28,4 +31,123 @@ void* solisGetProcAddress(LibraryHandle handle, const char* func)
 	return (void*)GetProcAddress((HMODULE)handle, func);
 }
 
-#endif
\ No newline at end of file
+#else
+#include <dlfcn.h>
+#include <pthread.h>
+
+LibraryHandle solisOpenLibrary(const char* path)
+{
+	return (LibraryHandle)dlopen(path, RTLD_NOW | RTLD_LOCAL);
+}
+
+void solisCloseLibrary(LibraryHandle handle)
+{
+	if (handle != NULL)
+		dlclose(handle);
+}
+
+void* solisGetProcAddress(LibraryHandle handle, const char* func)
+{
+	return dlsym(handle, func);
+}
+
+#endif
+
+// The thread function is wrapped to fit what each platform expects
+// It is allocated and freed on the VM's thread so the VM's allocator never has to be thread safe
+typedef struct
+{
+	ThreadFunction func;
+	void* data;
+
+#ifdef SOLIS_WINDOWS
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+} Thread;
+
+#ifdef SOLIS_WINDOWS
+
+static DWORD WINAPI threadEntry(LPVOID param)
+{
+	Thread* thread = (Thread*)param;
+
+	thread->func(thread->data);
+	return 0;
+}
+
+ThreadHandle solisCreateThread(VM* vm, ThreadFunction func, void* data)
+{
+	Thread* thread = (Thread*)solisRawReallocate(vm, NULL, sizeof(Thread));
+
+	thread->func = func;
+	thread->data = data;
+	thread->handle = CreateThread(NULL, 0, threadEntry, thread, 0, NULL);
+
+	if (thread->handle == NULL)
+	{
+		solisRawFree(vm, thread);
+		return NULL;
+	}
+
+	return (ThreadHandle)thread;
+}
+
+void solisJoinThread(VM* vm, ThreadHandle handle)
+{
+	Thread* thread = (Thread*)handle;
+
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+
+	solisRawFree(vm, thread);
+}
+
+void solisYieldThread(void)
+{
+	SwitchToThread();
+}
+
+#else
+#include <sched.h>
+
+static void* threadEntry(void* param)
+{
+	Thread* thread = (Thread*)param;
+
+	thread->func(thread->data);
+	return NULL;
+}
+
+ThreadHandle solisCreateThread(VM* vm, ThreadFunction func, void* data)
+{
+	Thread* thread = (Thread*)solisRawReallocate(vm, NULL, sizeof(Thread));
+
+	thread->func = func;
+	thread->data = data;
+
+	if (pthread_create(&thread->handle, NULL, threadEntry, thread) != 0)
+	{
+		solisRawFree(vm, thread);
+		return NULL;
+	}
+
+	return (ThreadHandle)thread;
+}
+
+void solisJoinThread(VM* vm, ThreadHandle handle)
+{
+	Thread* thread = (Thread*)handle;
+
+	pthread_join(thread->handle, NULL);
+
+	solisRawFree(vm, thread);
+}
+
+void solisYieldThread(void)
+{
+	sched_yield();
+}
+
+#endif
@@ -17,6 +17,11 @@
 #define SOLIS_PLATFORM_STRING "Apple"
 #endif
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "solis_common.h"
+
 typedef void* LibraryHandle;
 
 LibraryHandle solisOpenLibrary(const char* path);
@@ -25,4 +30,71 @@ void solisCloseLibrary(LibraryHandle handle);
 
 void* solisGetProcAddress(LibraryHandle handle, const char* func);
 
+/*
+	Threads, only used to share work inside the collector
+*/
+
+typedef void* ThreadHandle;
+
+typedef void (*ThreadFunction)(void* data);
+
+// The thread is allocated through the VM's allocator, it returns NULL if the thread couldn't be started
+ThreadHandle solisCreateThread(VM* vm, ThreadFunction func, void* data);
+
+// Waits for the thread to return and releases it
+void solisJoinThread(VM* vm, ThreadHandle thread);
+
+void solisYieldThread(void);
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+#define SOLIS_THREAD_LOCAL __declspec(thread)
+
+// These are all full barriers
+static inline bool solisAtomicExchangeBool(volatile bool* target, bool value)
+{
+	return _InterlockedExchange8((volatile char*)target, (char)value) != 0;
+}
+
+static inline int solisAtomicAdd(volatile int* target, int value)
+{
+	return _InterlockedExchangeAdd((volatile long*)target, value) + value;
+}
+
+static inline int solisAtomicLoad(volatile int* target)
+{
+	return _InterlockedOr((volatile long*)target, 0);
+}
+
+// Returns the bits set before the or
+static inline uint64_t solisAtomicOr64(volatile uint64_t* target, uint64_t bits)
+{
+	return (uint64_t)_InterlockedOr64((volatile long long*)target, (long long)bits);
+}
+#else
+#define SOLIS_THREAD_LOCAL _Thread_local
+
+static inline bool solisAtomicExchangeBool(volatile bool* target, bool value)
+{
+	return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline int solisAtomicAdd(volatile int* target, int value)
+{
+	return __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline int solisAtomicLoad(volatile int* target)
+{
+	return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+}
+
+// Returns the bits set before the or
+static inline uint64_t solisAtomicOr64(volatile uint64_t* target, uint64_t bits)
+{
+	return __atomic_fetch_or(target, bits, __ATOMIC_SEQ_CST);
+}
+#endif
+
 #endif // SOLIS_OS_H
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include "solis_peephole.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "solis_object.h"
+#include "solis_allocator.h"
+
+// A jump operand in the new code that has to be pointed at the new location of its target
+typedef struct
+{
+	int operand;
+	int from;
+	int target;
+	bool backwards;
+} Relocation;
+
+typedef struct
+{
+	int count;
+	int operands[2];
+	bool backwards;
+} JumpInfo;
+
+typedef struct
+{
+	Chunk* chunk;
+
+	// Number of jumps landing on each offset of the original code
+	int* incoming;
+
+	// Start of the instruction before each instruction start
+	int* previous;
+
+	// Instructions that are removed because a superinstruction took over their work
+	bool* deleted;
+
+	// Where each instruction of the original code starts in the new code
+	int* map;
+
+	uint8_t* code;
+	int* lines;
+	int count;
+
+	Relocation* relocations;
+	int relocationCount;
+} Peephole;
+
+static inline uint16_t readShort(uint8_t* code, int offset)
+{
+	return (uint16_t)((code[offset] << 8) | code[offset + 1]);
+}
+
+static inline void writeShort(uint8_t* code, int offset, uint16_t value)
+{
+	code[offset] = (value >> 8) & 0xff;
+	code[offset + 1] = value & 0xff;
+}
+
+static JumpInfo getJumpInfo(uint8_t instruction)
+{
+	JumpInfo info = { 0 };
+
+	switch (instruction)
+	{
+	case OP_JUMP:
+	case OP_JUMP_IF_FALSE:
+	case OP_JUMP_IF_FALSE_POP:
+		info.count = 1;
+		info.operands[0] = 1;
+		break;
+	case OP_LOOP:
+		info.count = 1;
+		info.operands[0] = 1;
+		info.backwards = true;
+		break;
+	case OP_RANGE_LOOP:
+		info.count = 1;
+		info.operands[0] = 3;
+		break;
+	case OP_RANGE_NEXT:
+		info.count = 1;
+		info.operands[0] = 3;
+		info.backwards = true;
+		break;
+	case OP_FOR_ITER:
+	case OP_FOR_NEXT:
+		info.count = 2;
+		info.operands[0] = 3;
+		info.operands[1] = 5;
+		break;
+	case OP_LESS_LOCAL_CONST_JUMP:
+		info.count = 1;
+		info.operands[0] = 5;
+		break;
+	default:
+		break;
+	}
+
+	return info;
+}
+
+static int jumpTarget(Chunk* chunk, int offset, int length, JumpInfo* info, int index)
+{
+	int jump = readShort(chunk->code, offset + info->operands[index]);
+
+	return info->backwards ? offset + length - jump : offset + length + jump;
+}
+
+static void emitByte(Peephole* p, uint8_t byte, int oldOffset)
+{
+	p->code[p->count] = byte;
+	p->lines[p->count] = p->chunk->lines.data[oldOffset];
+	p->count++;
+}
+
+static void emitShort(Peephole* p, uint16_t value, int oldOffset)
+{
+	emitByte(p, (value >> 8) & 0xff, oldOffset);
+	emitByte(p, value & 0xff, oldOffset);
+}
+
+static void addRelocation(Peephole* p, int operand, int from, int target, bool backwards)
+{
+	Relocation* relocation = &p->relocations[p->relocationCount++];
+	relocation->operand = operand;
+	relocation->from = from;
+	relocation->target = target;
+	relocation->backwards = backwards;
+}
+
+// Reads the index of an OP_CONSTANT or OP_CONSTANT_LONG, returns false for anything else
+static bool readConstant(Chunk* chunk, int offset, uint16_t* constant)
+{
+	if (chunk->code[offset] == OP_CONSTANT)
+	{
+		*constant = chunk->code[offset + 1];
+		return true;
+	}
+
+	if (chunk->code[offset] == OP_CONSTANT_LONG)
+	{
+		*constant = readShort(chunk->code, offset + 1);
+		return true;
+	}
+
+	return false;
+}
+
+// The POP at the target of a JUMP_IF_FALSE can be folded into the jump when nothing else reaches it
+static bool canFoldJumpPop(Peephole* p, int offset, int* target)
+{
+	Chunk* chunk = p->chunk;
+
+	*target = offset + 3 + readShort(chunk->code, offset + 1);
+
+	if (*target >= chunk->count || chunk->code[*target] != OP_POP || p->incoming[*target] != 1)
+		return false;
+
+	int previous = p->previous[*target];
+
+	if (previous < 0)
+		return false;
+
+	switch (chunk->code[previous])
+	{
+	case OP_JUMP:
+	case OP_LOOP:
+	case OP_RANGE_NEXT:
+	case OP_RETURN:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+	Tries to match a superinstruction starting at offset.
+	Returns how many bytes of the original code were replaced or 0 if nothing matched.
+*/
+static int fuse(Peephole* p, int offset)
+{
+	Chunk* chunk = p->chunk;
+	uint8_t* code = chunk->code;
+
+	// Decode up to 5 instructions, stopping at anything a jump lands on
+	int starts[6];
+	int instructionCount = 0;
+
+	starts[0] = offset;
+	while (instructionCount < 5 && starts[instructionCount] < chunk->count)
+	{
+		int start = starts[instructionCount];
+
+		if (instructionCount > 0 && (p->incoming[start] != 0 || p->deleted[start]))
+			break;
+
+		starts[instructionCount + 1] = start + solisInstructionLength(chunk, start);
+		instructionCount++;
+	}
+
+#define OP_AT(index) (instructionCount > (index) ? code[starts[index]] : -1)
+
+	uint16_t constant;
+	int target;
+
+	if (OP_AT(0) == OP_GET_LOCAL && instructionCount > 1 && readConstant(chunk, starts[1], &constant))
+	{
+		uint16_t slot = readShort(code, offset + 1);
+
+		// i = i + k
+		if (OP_AT(2) == OP_ADD && OP_AT(3) == OP_SET_LOCAL && OP_AT(4) == OP_POP
+			&& readShort(code, starts[3] + 1) == slot)
+		{
+			emitByte(p, OP_INCREMENT_LOCAL, offset);
+			emitShort(p, slot, offset);
+			emitShort(p, constant, offset);
+
+			return starts[5] - offset;
+		}
+
+		// while i < k do
+		if (OP_AT(2) == OP_LESS && OP_AT(3) == OP_JUMP_IF_FALSE && OP_AT(4) == OP_POP
+			&& canFoldJumpPop(p, starts[3], &target))
+		{
+			p->deleted[target] = true;
+
+			int start = p->count;
+			emitByte(p, OP_LESS_LOCAL_CONST_JUMP, offset);
+			emitShort(p, slot, offset);
+			emitShort(p, constant, offset);
+			emitShort(p, 0xffff, offset);
+
+			addRelocation(p, start + 5, p->count, target, false);
+
+			return starts[5] - offset;
+		}
+
+		if (OP_AT(2) == OP_ADD || OP_AT(2) == OP_SUBTRACT)
+		{
+			emitByte(p, OP_AT(2) == OP_ADD ? OP_ADD_LOCAL_CONST : OP_SUBTRACT_LOCAL_CONST, offset);
+			emitShort(p, slot, offset);
+			emitShort(p, constant, offset);
+
+			return starts[3] - offset;
+		}
+	}
+
+	if (OP_AT(0) == OP_GET_LOCAL && OP_AT(1) == OP_GET_LOCAL && OP_AT(2) == OP_ADD)
+	{
+		emitByte(p, OP_ADD_LOCALS, offset);
+		emitShort(p, readShort(code, offset + 1), offset);
+		emitShort(p, readShort(code, starts[1] + 1), offset);
+
+		return starts[3] - offset;
+	}
+
+	// >= and <= are compiled as the negated comparison
+	if ((OP_AT(0) == OP_LESS || OP_AT(0) == OP_GREATER) && OP_AT(1) == OP_NOT)
+	{
+		emitByte(p, OP_AT(0) == OP_LESS ? OP_GREATER_EQUAL : OP_LESS_EQUAL, offset);
+
+		return starts[2] - offset;
+	}
+
+	// The condition of an if or while is popped on both paths
+	if (OP_AT(0) == OP_JUMP_IF_FALSE && OP_AT(1) == OP_POP && canFoldJumpPop(p, offset, &target))
+	{
+		p->deleted[target] = true;
+
+		int start = p->count;
+		emitByte(p, OP_JUMP_IF_FALSE_POP, offset);
+		emitShort(p, 0xffff, offset);
+
+		addRelocation(p, start + 1, p->count, target, false);
+
+		return starts[2] - offset;
+	}
+
+#undef OP_AT
+
+	return 0;
+}
+
+void solisPeepholeOptimize(VM* vm, Chunk* chunk)
+{
+	int count = chunk->count;
+
+	if (count == 0)
+		return;
+
+	// Scratch space, raw memory that isn't counted so a collection can't run mid pass
+	Peephole p;
+	p.chunk = chunk;
+	p.incoming = (int*)solisRawReallocate(vm, NULL, sizeof(int) * (count + 1));
+	p.previous = (int*)solisRawReallocate(vm, NULL, sizeof(int) * (count + 1));
+	p.deleted = (bool*)solisRawReallocate(vm, NULL, sizeof(bool) * (count + 1));
+	p.map = (int*)solisRawReallocate(vm, NULL, sizeof(int) * (count + 1));
+	p.code = (uint8_t*)solisRawReallocate(vm, NULL, sizeof(uint8_t) * count);
+	p.lines = (int*)solisRawReallocate(vm, NULL, sizeof(int) * count);
+	p.relocations = (Relocation*)solisRawReallocate(vm, NULL, sizeof(Relocation) * count);
+	p.count = 0;
+	p.relocationCount = 0;
+
+	memset(p.incoming, 0, sizeof(int) * (count + 1));
+	memset(p.deleted, 0, sizeof(bool) * (count + 1));
+
+	// Find every jump target so no superinstruction swallows one
+	int last = -1;
+	for (int offset = 0; offset < count; offset += solisInstructionLength(chunk, offset))
+	{
+		p.previous[offset] = last;
+		last = offset;
+
+		uint8_t instruction = chunk->code[offset];
+		int length = solisInstructionLength(chunk, offset);
+		JumpInfo info = getJumpInfo(instruction);
+
+		for (int i = 0; i < info.count; i++)
+		{
+			p.incoming[jumpTarget(chunk, offset, length, &info, i)]++;
+		}
+
+		// OP_FOR_ITER returns into OP_FOR_NEXT after calling next and skips over it otherwise
+		if (instruction == OP_FOR_ITER)
+		{
+			p.incoming[offset + length]++;
+			p.incoming[offset + length + SOLIS_FOR_NEXT_LENGTH]++;
+		}
+	}
+
+	int offset = 0;
+	while (offset < count)
+	{
+		p.map[offset] = p.count;
+
+		if (p.deleted[offset])
+		{
+			offset += solisInstructionLength(chunk, offset);
+			continue;
+		}
+
+		int replaced = fuse(&p, offset);
+
+		if (replaced > 0)
+		{
+			offset += replaced;
+			continue;
+		}
+
+		// Copy the instruction as is, its jumps still point into the old code
+		int length = solisInstructionLength(chunk, offset);
+		int start = p.count;
+
+		for (int i = 0; i < length; i++)
+		{
+			emitByte(&p, chunk->code[offset + i], offset);
+		}
+
+		JumpInfo info = getJumpInfo(chunk->code[offset]);
+
+		for (int i = 0; i < info.count; i++)
+		{
+			addRelocation(&p, start + info.operands[i], start + length, jumpTarget(chunk, offset, length, &info, i), info.backwards);
+		}
+
+		offset += length;
+	}
+
+	p.map[count] = p.count;
+
+	for (int i = 0; i < p.relocationCount; i++)
+	{
+		Relocation* relocation = &p.relocations[i];
+		int target = p.map[relocation->target];
+
+		int jump = relocation->backwards ? relocation->from - target : target - relocation->from;
+		writeShort(p.code, relocation->operand, (uint16_t)jump);
+	}
+
+	// The new code is never longer than the old so it fits in the existing buffers
+	memcpy(chunk->code, p.code, sizeof(uint8_t) * p.count);
+	memcpy(chunk->lines.data, p.lines, sizeof(int) * p.count);
+	chunk->count = p.count;
+	chunk->lines.count = p.count;
+
+	solisRawFree(vm, p.incoming);
+	solisRawFree(vm, p.previous);
+	solisRawFree(vm, p.deleted);
+	solisRawFree(vm, p.map);
+	solisRawFree(vm, p.code);
+	solisRawFree(vm, p.lines);
+	solisRawFree(vm, p.relocations);
+}
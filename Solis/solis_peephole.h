@@ -0,0 +1,14 @@
+#ifndef SOLIS_PEEPHOLE_H
+#define SOLIS_PEEPHOLE_H
+
+#include "solis_common.h"
+#include "solis_chunk.h"
+
+/*
+	Rewrites common instruction sequences in a finished chunk into superinstructions.
+	Jumps, loops and line info are relocated to match the new code.
+	Sequences that something jumps into the middle of are left alone.
+*/
+void solisPeepholeOptimize(VM* vm, Chunk* chunk);
+
+#endif // SOLIS_PEEPHOLE_H
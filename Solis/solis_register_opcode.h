@@ -0,0 +1,43 @@
+OPCODE(MOVE)
+OPCODE(LOAD_CONSTANT)
+OPCODE(LOAD_NULL)
+OPCODE(LOAD_TRUE)
+OPCODE(LOAD_FALSE)
+
+OPCODE(GET_GLOBAL)
+OPCODE(SET_GLOBAL)
+
+OPCODE(ADD)
+OPCODE(SUBTRACT)
+OPCODE(MULTIPLY)
+OPCODE(DIVIDE)
+OPCODE(FLOOR_DIVIDE)
+OPCODE(POWER)
+
+OPCODE(ADD_CONSTANT)
+OPCODE(SUBTRACT_CONSTANT)
+
+OPCODE(EQUAL)
+OPCODE(NOT_EQUAL)
+OPCODE(LESS)
+OPCODE(LESS_EQUAL)
+OPCODE(GREATER)
+OPCODE(GREATER_EQUAL)
+
+OPCODE(NEGATE)
+OPCODE(NOT)
+
+OPCODE(JUMP)
+OPCODE(LOOP)
+OPCODE(JUMP_IF_FALSE)
+OPCODE(JUMP_IF_TRUE)
+
+OPCODE(JUMP_IF_NOT_LESS)
+OPCODE(JUMP_IF_NOT_LESS_EQUAL)
+OPCODE(JUMP_IF_NOT_GREATER)
+OPCODE(JUMP_IF_NOT_GREATER_EQUAL)
+
+OPCODE(CALL)
+
+OPCODE(RETURN)
+OPCODE(RETURN_NULL)
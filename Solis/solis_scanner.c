@@ -267,6 +267,7 @@ Token solisScanToken()
 	case '*': return makeToken(match('*') ? TOKEN_STAR_STAR : TOKEN_STAR);
 	case '.': return makeToken(match('.') ? TOKEN_DOT_DOT : TOKEN_DOT);
 	case ',': return makeToken(TOKEN_COMMA);
+	case ':': return makeToken(TOKEN_COLON);
 	case '!': return makeToken(match('=') ? TOKEN_BANGEQ : TOKEN_BANG);
 	case '=': return makeToken(match('=') ? TOKEN_EQEQ : TOKEN_EQ);
 	case ';': return makeToken(TOKEN_SEMICOLON);
@@ -274,8 +275,10 @@ Token solisScanToken()
 	case '>': return makeToken(match('=') ? TOKEN_GTEQ : TOKEN_GT);
 	case '"': return string();
 	case '\n': {
+		// The token belongs to the line it ends, instructions emitted before it is consumed report that line
+		Token token = makeToken(TOKEN_LINE);
 		scanner.line++;
-		return makeToken(TOKEN_LINE);
+		return token;
 	}
 	}
 
@@ -298,7 +301,7 @@ TokenList solisScanSource(VM* vm, const char* source)
 		
 		list.count++;
 
-		list.tokens = (Token*)solisReallocate(vm, list.tokens, sizeof(Token) * list.count - 1, sizeof(Token) * list.count);
+		list.tokens = (Token*)solisReallocate(vm, list.tokens, sizeof(Token) * (list.count - 1), sizeof(Token) * list.count);
 
 		// Check if its been allocated 
 		SOLIS_ASSERT(list.tokens);
@@ -31,6 +31,7 @@ typedef enum SolisTokenType
 	TOKEN_DOT_DOT,
 
 	TOKEN_COMMA, 
+	TOKEN_COLON,
 
 	TOKEN_EQ,
 	TOKEN_EQEQ, 
@@ -133,9 +134,10 @@ TokenList solisScanSource(VM* vm, const char* source);
 /*
 	Free a token list allocation
 */
-static inline void solisFreeTokenList(TokenList* list)
+static inline void solisFreeTokenList(VM* vm, TokenList* list)
 {
-	SOLIS_FREE_FUNC(list->tokens);
+	solisReallocate(vm, list->tokens, sizeof(Token) * list->count, 0);
+	list->tokens = NULL;
 	list->count = 0;
 }
 
@@ -0,0 +1,1185 @@
+#include "solis_simd.h"
+
+#include <stdbool.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOLIS_SIMD_SSE2_BUILD
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled for that target on their own and only used once the CPU says it has them
+#if defined(SOLIS_SIMD_SSE2_BUILD) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define SOLIS_SIMD_AVX2_BUILD
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+// Plain loops, used where there is no SIMD and for the tails the vector loops leave
+
+static void fillF64(void* data, int count, double value)
+{
+	double* d = (double*)data;
+	for (int i = 0; i < count; i++)
+		d[i] = value;
+}
+
+static double sumF64(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	double total = 0.0;
+	for (int i = 0; i < count; i++)
+		total += d[i];
+	return total;
+}
+
+static double minF64(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	double m = d[0];
+	for (int i = 1; i < count; i++)
+		if (d[i] < m) m = d[i];
+	return m;
+}
+
+static double maxF64(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	double m = d[0];
+	for (int i = 1; i < count; i++)
+		if (d[i] > m) m = d[i];
+	return m;
+}
+
+static double dotF64(const void* a, const void* b, int count)
+{
+	const double* x = (const double*)a;
+	const double* y = (const double*)b;
+	double total = 0.0;
+	for (int i = 0; i < count; i++)
+		total += x[i] * y[i];
+	return total;
+}
+
+static void axpyF64(void* y, const void* x, double a, int count)
+{
+	double* d = (double*)y;
+	const double* s = (const double*)x;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] + a * s[i];
+}
+
+static void scaleF64(void* data, double a, int count)
+{
+	double* d = (double*)data;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] * a;
+}
+
+static void addF64(void* a, const void* b, int count)
+{
+	double* d = (double*)a;
+	const double* s = (const double*)b;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] + s[i];
+}
+
+static void mulF64(void* a, const void* b, int count)
+{
+	double* d = (double*)a;
+	const double* s = (const double*)b;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] * s[i];
+}
+
+static void fillF32(void* data, int count, double value)
+{
+	float* d = (float*)data;
+	float v = (float)value;
+	for (int i = 0; i < count; i++)
+		d[i] = v;
+}
+
+static double sumF32(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	double total = 0.0;
+	for (int i = 0; i < count; i++)
+		total += d[i];
+	return total;
+}
+
+static double minF32(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	float m = d[0];
+	for (int i = 1; i < count; i++)
+		if (d[i] < m) m = d[i];
+	return m;
+}
+
+static double maxF32(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	float m = d[0];
+	for (int i = 1; i < count; i++)
+		if (d[i] > m) m = d[i];
+	return m;
+}
+
+static double dotF32(const void* a, const void* b, int count)
+{
+	const float* x = (const float*)a;
+	const float* y = (const float*)b;
+	double total = 0.0;
+	for (int i = 0; i < count; i++)
+		total += (double)x[i] * (double)y[i];
+	return total;
+}
+
+static void axpyF32(void* y, const void* x, double a, int count)
+{
+	float* d = (float*)y;
+	const float* s = (const float*)x;
+	float f = (float)a;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] + f * s[i];
+}
+
+static void scaleF32(void* data, double a, int count)
+{
+	float* d = (float*)data;
+	float f = (float)a;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] * f;
+}
+
+static void addF32(void* a, const void* b, int count)
+{
+	float* d = (float*)a;
+	const float* s = (const float*)b;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] + s[i];
+}
+
+static void mulF32(void* a, const void* b, int count)
+{
+	float* d = (float*)a;
+	const float* s = (const float*)b;
+	for (int i = 0; i < count; i++)
+		d[i] = d[i] * s[i];
+}
+
+static void fillI32(void* data, int count, double value)
+{
+	int32_t* d = (int32_t*)data;
+	int32_t v = solisToInt32(value);
+	for (int i = 0; i < count; i++)
+		d[i] = v;
+}
+
+static double sumI32(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	double total = 0.0;
+	for (int i = 0; i < count; i++)
+		total += d[i];
+	return total;
+}
+
+static double minI32(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	int32_t m = d[0];
+	for (int i = 1; i < count; i++)
+		if (d[i] < m) m = d[i];
+	return m;
+}
+
+static double maxI32(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	int32_t m = d[0];
+	for (int i = 1; i < count; i++)
+		if (d[i] > m) m = d[i];
+	return m;
+}
+
+static double dotI32(const void* a, const void* b, int count)
+{
+	const int32_t* x = (const int32_t*)a;
+	const int32_t* y = (const int32_t*)b;
+	double total = 0.0;
+	for (int i = 0; i < count; i++)
+		total += (double)x[i] * (double)y[i];
+	return total;
+}
+
+// Scaling by any number goes through doubles, so these two are loops at every level
+static void axpyI32(void* y, const void* x, double a, int count)
+{
+	int32_t* d = (int32_t*)y;
+	const int32_t* s = (const int32_t*)x;
+	for (int i = 0; i < count; i++)
+		d[i] = solisToInt32(d[i] + a * s[i]);
+}
+
+static void scaleI32(void* data, double a, int count)
+{
+	int32_t* d = (int32_t*)data;
+	for (int i = 0; i < count; i++)
+		d[i] = solisToInt32(d[i] * a);
+}
+
+// Unsigned so overflow wraps instead of being undefined
+static void addI32(void* a, const void* b, int count)
+{
+	int32_t* d = (int32_t*)a;
+	const int32_t* s = (const int32_t*)b;
+	for (int i = 0; i < count; i++)
+		d[i] = (int32_t)((uint32_t)d[i] + (uint32_t)s[i]);
+}
+
+static void mulI32(void* a, const void* b, int count)
+{
+	int32_t* d = (int32_t*)a;
+	const int32_t* s = (const int32_t*)b;
+	for (int i = 0; i < count; i++)
+		d[i] = (int32_t)((uint32_t)d[i] * (uint32_t)s[i]);
+}
+
+// Each column of the result is the columns of a weighted by a column of b
+static void mat4TransformScalar(double* out, const double* m, const double* v)
+{
+	for (int row = 0; row < 4; row++)
+	{
+		double total = 0.0;
+		for (int k = 0; k < 4; k++)
+			total += m[k * 4 + row] * v[k];
+		out[row] = total;
+	}
+}
+
+static void mat4MultiplyScalar(double* out, const double* a, const double* b)
+{
+	for (int column = 0; column < 4; column++)
+		mat4TransformScalar(out + column * 4, a, b + column * 4);
+}
+
+static const SolisArrayKernels scalarKernels[SOLIS_ARRAY_KIND_COUNT] = {
+	[SOLIS_ARRAY_FLOAT64] = { fillF64, sumF64, minF64, maxF64, dotF64, axpyF64, scaleF64, addF64, mulF64 },
+	[SOLIS_ARRAY_FLOAT32] = { fillF32, sumF32, minF32, maxF32, dotF32, axpyF32, scaleF32, addF32, mulF32 },
+	[SOLIS_ARRAY_INT32] = { fillI32, sumI32, minI32, maxI32, dotI32, axpyI32, scaleI32, addI32, mulI32 },
+};
+
+#ifdef SOLIS_SIMD_SSE2_BUILD
+
+// Two registers are accumulated at once so each add doesn't wait on the one before
+
+static void fillF64SSE2(void* data, int count, double value)
+{
+	double* d = (double*)data;
+	__m128d v = _mm_set1_pd(value);
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(d + i, v);
+	fillF64(d + i, count - i, value);
+}
+
+static double sumF64SSE2(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		acc0 = _mm_add_pd(acc0, _mm_loadu_pd(d + i));
+		acc1 = _mm_add_pd(acc1, _mm_loadu_pd(d + i + 2));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	return lanes[0] + lanes[1] + sumF64(d + i, count - i);
+}
+
+// Every lane starts at the first element so a leading NaN carries through like it does in the loop
+static double minF64SSE2(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	__m128d m = _mm_set1_pd(d[0]);
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		m = _mm_min_pd(_mm_loadu_pd(d + i), m);
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, m);
+	double result = lanes[1] < lanes[0] ? lanes[1] : lanes[0];
+	for (; i < count; i++)
+		if (d[i] < result) result = d[i];
+	return result;
+}
+
+static double maxF64SSE2(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	__m128d m = _mm_set1_pd(d[0]);
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		m = _mm_max_pd(_mm_loadu_pd(d + i), m);
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, m);
+	double result = lanes[1] > lanes[0] ? lanes[1] : lanes[0];
+	for (; i < count; i++)
+		if (d[i] > result) result = d[i];
+	return result;
+}
+
+static double dotF64SSE2(const void* a, const void* b, int count)
+{
+	const double* x = (const double*)a;
+	const double* y = (const double*)b;
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	return lanes[0] + lanes[1] + dotF64(x + i, y + i, count - i);
+}
+
+static void axpyF64SSE2(void* y, const void* x, double a, int count)
+{
+	double* d = (double*)y;
+	const double* s = (const double*)x;
+	__m128d factor = _mm_set1_pd(a);
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(d + i, _mm_add_pd(_mm_loadu_pd(d + i), _mm_mul_pd(factor, _mm_loadu_pd(s + i))));
+	axpyF64(d + i, s + i, a, count - i);
+}
+
+static void scaleF64SSE2(void* data, double a, int count)
+{
+	double* d = (double*)data;
+	__m128d factor = _mm_set1_pd(a);
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(d + i, _mm_mul_pd(_mm_loadu_pd(d + i), factor));
+	scaleF64(d + i, a, count - i);
+}
+
+static void addF64SSE2(void* a, const void* b, int count)
+{
+	double* d = (double*)a;
+	const double* s = (const double*)b;
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(d + i, _mm_add_pd(_mm_loadu_pd(d + i), _mm_loadu_pd(s + i)));
+	addF64(d + i, s + i, count - i);
+}
+
+static void mulF64SSE2(void* a, const void* b, int count)
+{
+	double* d = (double*)a;
+	const double* s = (const double*)b;
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(d + i, _mm_mul_pd(_mm_loadu_pd(d + i), _mm_loadu_pd(s + i)));
+	mulF64(d + i, s + i, count - i);
+}
+
+static void fillF32SSE2(void* data, int count, double value)
+{
+	float* d = (float*)data;
+	__m128 v = _mm_set1_ps((float)value);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(d + i, v);
+	fillF32(d + i, count - i, value);
+}
+
+// Floats are widened to doubles before they are added up
+static double sumF32SSE2(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(d + i);
+		acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(v));
+		acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	return lanes[0] + lanes[1] + sumF32(d + i, count - i);
+}
+
+static double minF32SSE2(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	__m128 m = _mm_set1_ps(d[0]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		m = _mm_min_ps(_mm_loadu_ps(d + i), m);
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, m);
+	float result = lanes[0];
+	for (int l = 1; l < 4; l++)
+		if (lanes[l] < result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] < result) result = d[i];
+	return result;
+}
+
+static double maxF32SSE2(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	__m128 m = _mm_set1_ps(d[0]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		m = _mm_max_ps(_mm_loadu_ps(d + i), m);
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, m);
+	float result = lanes[0];
+	for (int l = 1; l < 4; l++)
+		if (lanes[l] > result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] > result) result = d[i];
+	return result;
+}
+
+static double dotF32SSE2(const void* a, const void* b, int count)
+{
+	const float* x = (const float*)a;
+	const float* y = (const float*)b;
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_cvtps_pd(vx), _mm_cvtps_pd(vy)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(vx, vx)), _mm_cvtps_pd(_mm_movehl_ps(vy, vy))));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	return lanes[0] + lanes[1] + dotF32(x + i, y + i, count - i);
+}
+
+static void axpyF32SSE2(void* y, const void* x, double a, int count)
+{
+	float* d = (float*)y;
+	const float* s = (const float*)x;
+	__m128 factor = _mm_set1_ps((float)a);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(d + i), _mm_mul_ps(factor, _mm_loadu_ps(s + i))));
+	axpyF32(d + i, s + i, a, count - i);
+}
+
+static void scaleF32SSE2(void* data, double a, int count)
+{
+	float* d = (float*)data;
+	__m128 factor = _mm_set1_ps((float)a);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(d + i, _mm_mul_ps(_mm_loadu_ps(d + i), factor));
+	scaleF32(d + i, a, count - i);
+}
+
+static void addF32SSE2(void* a, const void* b, int count)
+{
+	float* d = (float*)a;
+	const float* s = (const float*)b;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(d + i, _mm_add_ps(_mm_loadu_ps(d + i), _mm_loadu_ps(s + i)));
+	addF32(d + i, s + i, count - i);
+}
+
+static void mulF32SSE2(void* a, const void* b, int count)
+{
+	float* d = (float*)a;
+	const float* s = (const float*)b;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(d + i, _mm_mul_ps(_mm_loadu_ps(d + i), _mm_loadu_ps(s + i)));
+	mulF32(d + i, s + i, count - i);
+}
+
+static void fillI32SSE2(void* data, int count, double value)
+{
+	int32_t* d = (int32_t*)data;
+	__m128i v = _mm_set1_epi32(solisToInt32(value));
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i*)(d + i), v);
+	fillI32(d + i, count - i, value);
+}
+
+// The high two lanes of an int vector, moved down so they can be converted
+static inline __m128i highHalf(__m128i v)
+{
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+static double sumI32SSE2(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(d + i));
+		acc0 = _mm_add_pd(acc0, _mm_cvtepi32_pd(v));
+		acc1 = _mm_add_pd(acc1, _mm_cvtepi32_pd(highHalf(v)));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	return lanes[0] + lanes[1] + sumI32(d + i, count - i);
+}
+
+// SSE2 has no min or max for ints so the compare picks between the two
+static double minI32SSE2(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	__m128i m = _mm_set1_epi32(d[0]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(d + i));
+		__m128i less = _mm_cmplt_epi32(v, m);
+		m = _mm_or_si128(_mm_and_si128(less, v), _mm_andnot_si128(less, m));
+	}
+
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, m);
+	int32_t result = lanes[0];
+	for (int l = 1; l < 4; l++)
+		if (lanes[l] < result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] < result) result = d[i];
+	return result;
+}
+
+static double maxI32SSE2(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	__m128i m = _mm_set1_epi32(d[0]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(d + i));
+		__m128i greater = _mm_cmpgt_epi32(v, m);
+		m = _mm_or_si128(_mm_and_si128(greater, v), _mm_andnot_si128(greater, m));
+	}
+
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, m);
+	int32_t result = lanes[0];
+	for (int l = 1; l < 4; l++)
+		if (lanes[l] > result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] > result) result = d[i];
+	return result;
+}
+
+static double dotI32SSE2(const void* a, const void* b, int count)
+{
+	const int32_t* x = (const int32_t*)a;
+	const int32_t* y = (const int32_t*)b;
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i vx = _mm_loadu_si128((const __m128i*)(x + i));
+		__m128i vy = _mm_loadu_si128((const __m128i*)(y + i));
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_cvtepi32_pd(vx), _mm_cvtepi32_pd(vy)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_cvtepi32_pd(highHalf(vx)), _mm_cvtepi32_pd(highHalf(vy))));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	return lanes[0] + lanes[1] + dotI32(x + i, y + i, count - i);
+}
+
+static void addI32SSE2(void* a, const void* b, int count)
+{
+	int32_t* d = (int32_t*)a;
+	const int32_t* s = (const int32_t*)b;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(d + i)), _mm_loadu_si128((const __m128i*)(s + i)));
+		_mm_storeu_si128((__m128i*)(d + i), v);
+	}
+	addI32(d + i, s + i, count - i);
+}
+
+// SSE2 only multiplies the even lanes, the odd ones are shifted down and done separately
+static inline __m128i mulLow32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static void mulI32SSE2(void* a, const void* b, int count)
+{
+	int32_t* d = (int32_t*)a;
+	const int32_t* s = (const int32_t*)b;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = mulLow32(_mm_loadu_si128((const __m128i*)(d + i)), _mm_loadu_si128((const __m128i*)(s + i)));
+		_mm_storeu_si128((__m128i*)(d + i), v);
+	}
+	mulI32(d + i, s + i, count - i);
+}
+
+// A column is two registers
+static void mat4TransformSSE2(double* out, const double* m, const double* v)
+{
+	__m128d low = _mm_setzero_pd();
+	__m128d high = _mm_setzero_pd();
+
+	for (int k = 0; k < 4; k++)
+	{
+		__m128d weight = _mm_set1_pd(v[k]);
+		low = _mm_add_pd(low, _mm_mul_pd(_mm_loadu_pd(m + k * 4), weight));
+		high = _mm_add_pd(high, _mm_mul_pd(_mm_loadu_pd(m + k * 4 + 2), weight));
+	}
+
+	_mm_storeu_pd(out, low);
+	_mm_storeu_pd(out + 2, high);
+}
+
+static void mat4MultiplySSE2(double* out, const double* a, const double* b)
+{
+	for (int column = 0; column < 4; column++)
+		mat4TransformSSE2(out + column * 4, a, b + column * 4);
+}
+
+static const SolisArrayKernels sse2Kernels[SOLIS_ARRAY_KIND_COUNT] = {
+	[SOLIS_ARRAY_FLOAT64] = { fillF64SSE2, sumF64SSE2, minF64SSE2, maxF64SSE2, dotF64SSE2, axpyF64SSE2, scaleF64SSE2, addF64SSE2, mulF64SSE2 },
+	[SOLIS_ARRAY_FLOAT32] = { fillF32SSE2, sumF32SSE2, minF32SSE2, maxF32SSE2, dotF32SSE2, axpyF32SSE2, scaleF32SSE2, addF32SSE2, mulF32SSE2 },
+	[SOLIS_ARRAY_INT32] = { fillI32SSE2, sumI32SSE2, minI32SSE2, maxI32SSE2, dotI32SSE2, axpyI32, scaleI32, addI32SSE2, mulI32SSE2 },
+};
+
+#endif // SOLIS_SIMD_SSE2_BUILD
+
+#ifdef SOLIS_SIMD_AVX2_BUILD
+
+AVX2_FUNCTION static void fillF64AVX2(void* data, int count, double value)
+{
+	double* d = (double*)data;
+	__m256d v = _mm256_set1_pd(value);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd(d + i, v);
+	fillF64(d + i, count - i, value);
+}
+
+AVX2_FUNCTION static double sumF64AVX2(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(d + i));
+		acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(d + i + 4));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumF64(d + i, count - i);
+}
+
+AVX2_FUNCTION static double minF64AVX2(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	__m256d m = _mm256_set1_pd(d[0]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		m = _mm256_min_pd(_mm256_loadu_pd(d + i), m);
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, m);
+	double result = lanes[0];
+	for (int l = 1; l < 4; l++)
+		if (lanes[l] < result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] < result) result = d[i];
+	return result;
+}
+
+AVX2_FUNCTION static double maxF64AVX2(const void* data, int count)
+{
+	const double* d = (const double*)data;
+	__m256d m = _mm256_set1_pd(d[0]);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		m = _mm256_max_pd(_mm256_loadu_pd(d + i), m);
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, m);
+	double result = lanes[0];
+	for (int l = 1; l < 4; l++)
+		if (lanes[l] > result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] > result) result = d[i];
+	return result;
+}
+
+AVX2_FUNCTION static double dotF64AVX2(const void* a, const void* b, int count)
+{
+	const double* x = (const double*)a;
+	const double* y = (const double*)b;
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotF64(x + i, y + i, count - i);
+}
+
+AVX2_FUNCTION static void axpyF64AVX2(void* y, const void* x, double a, int count)
+{
+	double* d = (double*)y;
+	const double* s = (const double*)x;
+	__m256d factor = _mm256_set1_pd(a);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd(d + i, _mm256_add_pd(_mm256_loadu_pd(d + i), _mm256_mul_pd(factor, _mm256_loadu_pd(s + i))));
+	axpyF64(d + i, s + i, a, count - i);
+}
+
+AVX2_FUNCTION static void scaleF64AVX2(void* data, double a, int count)
+{
+	double* d = (double*)data;
+	__m256d factor = _mm256_set1_pd(a);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd(d + i, _mm256_mul_pd(_mm256_loadu_pd(d + i), factor));
+	scaleF64(d + i, a, count - i);
+}
+
+AVX2_FUNCTION static void addF64AVX2(void* a, const void* b, int count)
+{
+	double* d = (double*)a;
+	const double* s = (const double*)b;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd(d + i, _mm256_add_pd(_mm256_loadu_pd(d + i), _mm256_loadu_pd(s + i)));
+	addF64(d + i, s + i, count - i);
+}
+
+AVX2_FUNCTION static void mulF64AVX2(void* a, const void* b, int count)
+{
+	double* d = (double*)a;
+	const double* s = (const double*)b;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd(d + i, _mm256_mul_pd(_mm256_loadu_pd(d + i), _mm256_loadu_pd(s + i)));
+	mulF64(d + i, s + i, count - i);
+}
+
+AVX2_FUNCTION static void fillF32AVX2(void* data, int count, double value)
+{
+	float* d = (float*)data;
+	__m256 v = _mm256_set1_ps((float)value);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(d + i, v);
+	fillF32(d + i, count - i, value);
+}
+
+AVX2_FUNCTION static double sumF32AVX2(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 v = _mm256_loadu_ps(d + i);
+		acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+		acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumF32(d + i, count - i);
+}
+
+AVX2_FUNCTION static double minF32AVX2(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	__m256 m = _mm256_set1_ps(d[0]);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_min_ps(_mm256_loadu_ps(d + i), m);
+
+	float lanes[8];
+	_mm256_storeu_ps(lanes, m);
+	float result = lanes[0];
+	for (int l = 1; l < 8; l++)
+		if (lanes[l] < result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] < result) result = d[i];
+	return result;
+}
+
+AVX2_FUNCTION static double maxF32AVX2(const void* data, int count)
+{
+	const float* d = (const float*)data;
+	__m256 m = _mm256_set1_ps(d[0]);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_max_ps(_mm256_loadu_ps(d + i), m);
+
+	float lanes[8];
+	_mm256_storeu_ps(lanes, m);
+	float result = lanes[0];
+	for (int l = 1; l < 8; l++)
+		if (lanes[l] > result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] > result) result = d[i];
+	return result;
+}
+
+AVX2_FUNCTION static double dotF32AVX2(const void* a, const void* b, int count)
+{
+	const float* x = (const float*)a;
+	const float* y = (const float*)b;
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(vx)), _mm256_cvtps_pd(_mm256_castps256_ps128(vy))));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(vx, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(vy, 1))));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotF32(x + i, y + i, count - i);
+}
+
+AVX2_FUNCTION static void axpyF32AVX2(void* y, const void* x, double a, int count)
+{
+	float* d = (float*)y;
+	const float* s = (const float*)x;
+	__m256 factor = _mm256_set1_ps((float)a);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_mul_ps(factor, _mm256_loadu_ps(s + i))));
+	axpyF32(d + i, s + i, a, count - i);
+}
+
+AVX2_FUNCTION static void scaleF32AVX2(void* data, double a, int count)
+{
+	float* d = (float*)data;
+	__m256 factor = _mm256_set1_ps((float)a);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_loadu_ps(d + i), factor));
+	scaleF32(d + i, a, count - i);
+}
+
+AVX2_FUNCTION static void addF32AVX2(void* a, const void* b, int count)
+{
+	float* d = (float*)a;
+	const float* s = (const float*)b;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_loadu_ps(s + i)));
+	addF32(d + i, s + i, count - i);
+}
+
+AVX2_FUNCTION static void mulF32AVX2(void* a, const void* b, int count)
+{
+	float* d = (float*)a;
+	const float* s = (const float*)b;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(d + i, _mm256_mul_ps(_mm256_loadu_ps(d + i), _mm256_loadu_ps(s + i)));
+	mulF32(d + i, s + i, count - i);
+}
+
+AVX2_FUNCTION static void fillI32AVX2(void* data, int count, double value)
+{
+	int32_t* d = (int32_t*)data;
+	__m256i v = _mm256_set1_epi32(solisToInt32(value));
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_si256((__m256i*)(d + i), v);
+	fillI32(d + i, count - i, value);
+}
+
+AVX2_FUNCTION static double sumI32AVX2(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(d + i));
+		acc0 = _mm256_add_pd(acc0, _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)));
+		acc1 = _mm256_add_pd(acc1, _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumI32(d + i, count - i);
+}
+
+AVX2_FUNCTION static double minI32AVX2(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	__m256i m = _mm256_set1_epi32(d[0]);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_min_epi32(_mm256_loadu_si256((const __m256i*)(d + i)), m);
+
+	int32_t lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	int32_t result = lanes[0];
+	for (int l = 1; l < 8; l++)
+		if (lanes[l] < result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] < result) result = d[i];
+	return result;
+}
+
+AVX2_FUNCTION static double maxI32AVX2(const void* data, int count)
+{
+	const int32_t* d = (const int32_t*)data;
+	__m256i m = _mm256_set1_epi32(d[0]);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+		m = _mm256_max_epi32(_mm256_loadu_si256((const __m256i*)(d + i)), m);
+
+	int32_t lanes[8];
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	int32_t result = lanes[0];
+	for (int l = 1; l < 8; l++)
+		if (lanes[l] > result) result = lanes[l];
+	for (; i < count; i++)
+		if (d[i] > result) result = d[i];
+	return result;
+}
+
+AVX2_FUNCTION static double dotI32AVX2(const void* a, const void* b, int count)
+{
+	const int32_t* x = (const int32_t*)a;
+	const int32_t* y = (const int32_t*)b;
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i vx = _mm256_loadu_si256((const __m256i*)(x + i));
+		__m256i vy = _mm256_loadu_si256((const __m256i*)(y + i));
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(vx)), _mm256_cvtepi32_pd(_mm256_castsi256_si128(vy))));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(vx, 1)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(vy, 1))));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotI32(x + i, y + i, count - i);
+}
+
+AVX2_FUNCTION static void addI32AVX2(void* a, const void* b, int count)
+{
+	int32_t* d = (int32_t*)a;
+	const int32_t* s = (const int32_t*)b;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(d + i)), _mm256_loadu_si256((const __m256i*)(s + i)));
+		_mm256_storeu_si256((__m256i*)(d + i), v);
+	}
+	addI32(d + i, s + i, count - i);
+}
+
+AVX2_FUNCTION static void mulI32AVX2(void* a, const void* b, int count)
+{
+	int32_t* d = (int32_t*)a;
+	const int32_t* s = (const int32_t*)b;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(d + i)), _mm256_loadu_si256((const __m256i*)(s + i)));
+		_mm256_storeu_si256((__m256i*)(d + i), v);
+	}
+	mulI32(d + i, s + i, count - i);
+}
+
+// A column fits in one register, the columns of a are loaded once for all of b
+AVX2_FUNCTION static void mat4MultiplyAVX2(double* out, const double* a, const double* b)
+{
+	__m256d columns[4];
+	for (int k = 0; k < 4; k++)
+		columns[k] = _mm256_loadu_pd(a + k * 4);
+
+	for (int column = 0; column < 4; column++)
+	{
+		__m256d total = _mm256_setzero_pd();
+		for (int k = 0; k < 4; k++)
+			total = _mm256_add_pd(total, _mm256_mul_pd(columns[k], _mm256_set1_pd(b[column * 4 + k])));
+
+		_mm256_storeu_pd(out + column * 4, total);
+	}
+}
+
+AVX2_FUNCTION static void mat4TransformAVX2(double* out, const double* m, const double* v)
+{
+	__m256d total = _mm256_setzero_pd();
+	for (int k = 0; k < 4; k++)
+		total = _mm256_add_pd(total, _mm256_mul_pd(_mm256_loadu_pd(m + k * 4), _mm256_set1_pd(v[k])));
+
+	_mm256_storeu_pd(out, total);
+}
+
+static const SolisArrayKernels avx2Kernels[SOLIS_ARRAY_KIND_COUNT] = {
+	[SOLIS_ARRAY_FLOAT64] = { fillF64AVX2, sumF64AVX2, minF64AVX2, maxF64AVX2, dotF64AVX2, axpyF64AVX2, scaleF64AVX2, addF64AVX2, mulF64AVX2 },
+	[SOLIS_ARRAY_FLOAT32] = { fillF32AVX2, sumF32AVX2, minF32AVX2, maxF32AVX2, dotF32AVX2, axpyF32AVX2, scaleF32AVX2, addF32AVX2, mulF32AVX2 },
+	[SOLIS_ARRAY_INT32] = { fillI32AVX2, sumI32AVX2, minI32AVX2, maxI32AVX2, dotI32AVX2, axpyI32, scaleI32, addI32AVX2, mulI32AVX2 },
+};
+
+// The OS has to save the wide registers too, not just the CPU have them
+static bool cpuHasAVX2(void)
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // SOLIS_SIMD_AVX2_BUILD
+
+static SolisSimdLevel detectLevel(void)
+{
+#if defined(SOLIS_SIMD_AVX2_BUILD)
+	if (cpuHasAVX2())
+		return SOLIS_SIMD_AVX2;
+#endif
+
+#if defined(SOLIS_SIMD_SSE2_BUILD)
+	return SOLIS_SIMD_SSE2;
+#else
+	return SOLIS_SIMD_SCALAR;
+#endif
+}
+
+SolisSimdLevel solisSimdLevel(void)
+{
+	// Every thread works out the same answer so it doesn't matter which one stores it
+	static int level = -1;
+
+	if (level < 0)
+		level = (int)detectLevel();
+
+	return (SolisSimdLevel)level;
+}
+
+const char* solisSimdLevelName(SolisSimdLevel level)
+{
+	switch (level) {
+	case SOLIS_SIMD_SCALAR: return "scalar";
+	case SOLIS_SIMD_SSE2: return "sse2";
+	case SOLIS_SIMD_AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+const SolisArrayKernels* solisGetArrayKernels(SolisArrayKind kind)
+{
+	switch (solisSimdLevel()) {
+#if defined(SOLIS_SIMD_AVX2_BUILD)
+	case SOLIS_SIMD_AVX2: return &avx2Kernels[kind];
+#endif
+#if defined(SOLIS_SIMD_SSE2_BUILD)
+	case SOLIS_SIMD_SSE2: return &sse2Kernels[kind];
+#endif
+	default: return &scalarKernels[kind];
+	}
+}
+
+void solisMat4Multiply(double* out, const double* a, const double* b)
+{
+	switch (solisSimdLevel()) {
+#if defined(SOLIS_SIMD_AVX2_BUILD)
+	case SOLIS_SIMD_AVX2: mat4MultiplyAVX2(out, a, b); break;
+#endif
+#if defined(SOLIS_SIMD_SSE2_BUILD)
+	case SOLIS_SIMD_SSE2: mat4MultiplySSE2(out, a, b); break;
+#endif
+	default: mat4MultiplyScalar(out, a, b); break;
+	}
+}
+
+void solisMat4Transform(double* out, const double* m, const double* v)
+{
+	switch (solisSimdLevel()) {
+#if defined(SOLIS_SIMD_AVX2_BUILD)
+	case SOLIS_SIMD_AVX2: mat4TransformAVX2(out, m, v); break;
+#endif
+#if defined(SOLIS_SIMD_SSE2_BUILD)
+	case SOLIS_SIMD_SSE2: mat4TransformSSE2(out, m, v); break;
+#endif
+	default: mat4TransformScalar(out, m, v); break;
+	}
+}
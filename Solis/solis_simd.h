@@ -0,0 +1,92 @@
+#ifndef SOLIS_SIMD_H
+#define SOLIS_SIMD_H
+
+#include "solis_common.h"
+
+/*
+	Bulk kernels over the unboxed storage of typed arrays.
+	The widest instruction set the CPU has is picked the first time kernels are asked for,
+	AVX2 then SSE2 on x86 and plain loops everywhere else, so one build runs well on any machine.
+	Sums and dot products are accumulated in doubles across several lanes,
+	the order they are added in depends on the instruction set so the last bits can differ between machines.
+*/
+
+typedef enum
+{
+	SOLIS_SIMD_SCALAR,
+	SOLIS_SIMD_SSE2,
+	SOLIS_SIMD_AVX2
+} SolisSimdLevel;
+
+/*
+	Kernels for one element type, data is count elements of it.
+	Float32 arrays are worked on in single precision, Int32 add and mul wrap around.
+*/
+typedef struct
+{
+	void (*fill)(void* data, int count, double value);
+
+	double (*sum)(const void* data, int count);
+
+	// count must be at least 1, a NaN is only returned when it is the first element
+	double (*min)(const void* data, int count);
+	double (*max)(const void* data, int count);
+
+	double (*dot)(const void* a, const void* b, int count);
+
+	// y = y + a * x
+	void (*axpy)(void* y, const void* x, double a, int count);
+
+	void (*scale)(void* data, double a, int count);
+
+	// a = a + b and a = a * b elementwise
+	void (*add)(void* a, const void* b, int count);
+	void (*mul)(void* a, const void* b, int count);
+} SolisArrayKernels;
+
+/*
+	Returns the instruction set the kernels use on this machine
+*/
+SolisSimdLevel solisSimdLevel(void);
+
+const char* solisSimdLevelName(SolisSimdLevel level);
+
+const SolisArrayKernels* solisGetArrayKernels(SolisArrayKind kind);
+
+/*
+	4x4 matrices are column major, out = a * b. out can't be a or b.
+	Every instruction set adds the products in the same order so results match across machines.
+*/
+void solisMat4Multiply(double* out, const double* a, const double* b);
+
+/*
+	out = m * v for a vector of four, out can't be v
+*/
+void solisMat4Transform(double* out, const double* m, const double* v);
+
+static inline size_t solisArrayElementSize(SolisArrayKind kind)
+{
+	switch (kind) {
+	case SOLIS_ARRAY_FLOAT64: return sizeof(double);
+	case SOLIS_ARRAY_FLOAT32: return sizeof(float);
+	case SOLIS_ARRAY_INT32: return sizeof(int32_t);
+	default: return 0;
+	}
+}
+
+/*
+	Numbers stored in an Int32Array are truncated towards zero, out of range values saturate and NaN becomes 0
+*/
+static inline int32_t solisToInt32(double value)
+{
+	if (value != value)
+		return 0;
+	if (value >= 2147483647.0)
+		return INT32_MAX;
+	if (value <= -2147483648.0)
+		return INT32_MIN;
+
+	return (int32_t)value;
+}
+
+#endif // SOLIS_SIMD_H
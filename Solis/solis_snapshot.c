@@ -0,0 +1,612 @@
+#include "solis_snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "solis_vm.h"
+#include "solis_gc.h"
+#include "solis_object.h"
+
+// Characters of a string's value written out, the size still counts all of them
+#define SNAPSHOT_STRING_PREVIEW 64
+
+typedef struct
+{
+	// NULL for the roots
+	Object* object;
+
+	// References are stored together for each object, in the order the objects were found
+	int firstEdge;
+	int edgeCount;
+
+	uint64_t size;
+	uint64_t retained;
+	int dominator;
+
+	// Position in a depth first postorder from the roots
+	int postorder;
+} SnapshotNode;
+
+typedef struct
+{
+	VM* vm;
+
+	SnapshotNode* nodes;
+	int nodeCount;
+	int nodeCapacity;
+
+	int* edges;
+	int edgeCount;
+	int edgeCapacity;
+
+	// Maps objects to their node, open addressing with no deletes
+	Object** keys;
+	int* indices;
+	int tableCapacity;
+} Snapshot;
+
+typedef struct
+{
+	const char* name;
+	uint64_t count;
+	uint64_t bytes;
+} SnapshotGroup;
+
+static uint32_t hashObject(Object* object)
+{
+	uint64_t bits = (uint64_t)(uintptr_t)object >> 3;
+	return (uint32_t)((bits * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+static void growTable(Snapshot* snapshot)
+{
+	int oldCapacity = snapshot->tableCapacity;
+	Object** oldKeys = snapshot->keys;
+	int* oldIndices = snapshot->indices;
+
+	snapshot->tableCapacity = oldCapacity == 0 ? 1024 : oldCapacity * 2;
+	snapshot->keys = (Object**)solisRawReallocate(snapshot->vm, NULL, sizeof(Object*) * snapshot->tableCapacity);
+	snapshot->indices = (int*)solisRawReallocate(snapshot->vm, NULL, sizeof(int) * snapshot->tableCapacity);
+	memset(snapshot->keys, 0, sizeof(Object*) * snapshot->tableCapacity);
+
+	int mask = snapshot->tableCapacity - 1;
+
+	for (int i = 0; i < oldCapacity; i++)
+	{
+		if (oldKeys[i] == NULL)
+			continue;
+
+		int slot = hashObject(oldKeys[i]) & mask;
+		while (snapshot->keys[slot] != NULL)
+			slot = (slot + 1) & mask;
+
+		snapshot->keys[slot] = oldKeys[i];
+		snapshot->indices[slot] = oldIndices[i];
+	}
+
+	solisRawFree(snapshot->vm, oldKeys);
+	solisRawFree(snapshot->vm, oldIndices);
+}
+
+static int addNode(Snapshot* snapshot, Object* object)
+{
+	if (snapshot->nodeCapacity < snapshot->nodeCount + 1)
+	{
+		snapshot->nodeCapacity = GROW_CAPACITY(snapshot->nodeCapacity);
+		snapshot->nodes = (SnapshotNode*)solisRawReallocate(snapshot->vm, snapshot->nodes, sizeof(SnapshotNode) * snapshot->nodeCapacity);
+	}
+
+	SnapshotNode* node = &snapshot->nodes[snapshot->nodeCount];
+	node->object = object;
+	node->firstEdge = 0;
+	node->edgeCount = 0;
+	node->size = 0;
+	node->retained = 0;
+	node->dominator = -1;
+	node->postorder = -1;
+
+	return snapshot->nodeCount++;
+}
+
+static int findNode(Snapshot* snapshot, Object* object)
+{
+	// Kept at most half full
+	if (snapshot->nodeCount * 2 >= snapshot->tableCapacity)
+		growTable(snapshot);
+
+	int mask = snapshot->tableCapacity - 1;
+	int slot = hashObject(object) & mask;
+
+	while (snapshot->keys[slot] != NULL)
+	{
+		if (snapshot->keys[slot] == object)
+			return snapshot->indices[slot];
+
+		slot = (slot + 1) & mask;
+	}
+
+	int index = addNode(snapshot, object);
+	snapshot->keys[slot] = object;
+	snapshot->indices[slot] = index;
+
+	return index;
+}
+
+static void visitReference(VM* vm, Object* object, void* data)
+{
+	Snapshot* snapshot = (Snapshot*)data;
+	int index = findNode(snapshot, object);
+
+	if (snapshot->edgeCapacity < snapshot->edgeCount + 1)
+	{
+		snapshot->edgeCapacity = GROW_CAPACITY(snapshot->edgeCapacity);
+		snapshot->edges = (int*)solisRawReallocate(vm, snapshot->edges, sizeof(int) * snapshot->edgeCapacity);
+	}
+
+	snapshot->edges[snapshot->edgeCount++] = index;
+}
+
+static uint64_t tableBytes(HashTable* table)
+{
+	return (sizeof(TableEntry) + sizeof(uint8_t)) * (uint64_t)table->capacity;
+}
+
+// Constants aren't included, the register chunk shares them with the stack chunk
+static uint64_t valueTableBytes(ValueTable* table)
+{
+	return (sizeof(uint32_t) + sizeof(ValueTableEntry)) * (uint64_t)table->capacity;
+}
+
+static uint64_t chunkBytes(Chunk* chunk)
+{
+	return (uint64_t)chunk->capacity + sizeof(int) * (uint64_t)chunk->lines.capacity
+		+ sizeof(InlineCache) * (uint64_t)chunk->caches.capacity;
+}
+
+// The object and the buffers only it points at
+static uint64_t objectBytes(Object* object)
+{
+	uint64_t size = solisObjectSize(object);
+
+	switch (object->type) {
+	case OBJ_STRING:
+		size += ((ObjString*)object)->length + 1;
+		break;
+	case OBJ_FUNCTION:
+		size += chunkBytes(&((ObjFunction*)object)->chunk) + chunkBytes(&((ObjFunction*)object)->registerChunk);
+		size += sizeof(Value) * (uint64_t)((ObjFunction*)object)->chunk.constants.capacity;
+		break;
+	case OBJ_CLOSURE:
+		size += sizeof(ObjUpvalue*) * (uint64_t)((ObjClosure*)object)->upvalueCount;
+		break;
+	case OBJ_ENUM:
+		size += tableBytes(&((ObjEnum*)object)->fields);
+		break;
+	case OBJ_CLASS: {
+		ObjClass* klass = (ObjClass*)object;
+		size += tableBytes(&klass->fields) + tableBytes(&klass->methods) + tableBytes(&klass->statics);
+		size += sizeof(Value) * (uint64_t)klass->fieldDefaults.capacity;
+		break;
+	}
+	case OBJ_LIST:
+		size += sizeof(Value) * (uint64_t)((ObjList*)object)->values.capacity;
+		break;
+	case OBJ_MODULE: {
+		ObjModule* mdl = (ObjModule*)object;
+		size += sizeof(Value) * (uint64_t)mdl->globals.capacity + tableBytes(&mdl->globalMap);
+		break;
+	}
+	case OBJ_DICTIONARY:
+		size += valueTableBytes(&((ObjDictionary*)object)->table);
+		break;
+	case OBJ_WEAK_TABLE:
+		size += valueTableBytes(&((ObjWeakTable*)object)->table);
+		break;
+	case OBJ_TYPED_ARRAY: {
+		ObjTypedArray* array = (ObjTypedArray*)object;
+		size += solisArrayElementSize(array->kind) * (uint64_t)array->count;
+		break;
+	}
+	case OBJ_STRING_BUILDER:
+		size += (uint64_t)((ObjStringBuilder*)object)->capacity;
+		break;
+	default:
+		break;
+	}
+
+	return size;
+}
+
+// Finds every reachable object, breadth first so each object's references are stored together
+static void traceHeap(Snapshot* snapshot)
+{
+	VM* vm = snapshot->vm;
+
+	int root = addNode(snapshot, NULL);
+	snapshot->nodes[root].firstEdge = 0;
+	solisTraceRoots(vm, visitReference, snapshot);
+	snapshot->nodes[root].edgeCount = snapshot->edgeCount;
+
+	for (int i = 1; i < snapshot->nodeCount; i++)
+	{
+		int first = snapshot->edgeCount;
+		solisTraceObject(vm, snapshot->nodes[i].object, visitReference, snapshot);
+
+		snapshot->nodes[i].firstEdge = first;
+		snapshot->nodes[i].edgeCount = snapshot->edgeCount - first;
+		snapshot->nodes[i].size = objectBytes(snapshot->nodes[i].object);
+	}
+}
+
+// Fills in each node's postorder and returns the nodes in that order
+static int* postorderNodes(Snapshot* snapshot)
+{
+	VM* vm = snapshot->vm;
+	int count = snapshot->nodeCount;
+
+	int* order = (int*)solisRawReallocate(vm, NULL, sizeof(int) * count);
+	int* stack = (int*)solisRawReallocate(vm, NULL, sizeof(int) * count);
+	int* cursor = (int*)solisRawReallocate(vm, NULL, sizeof(int) * count);
+
+	int next = 0;
+	int top = 0;
+
+	// A node is on the stack at most once, visited marks it before it is pushed
+	stack[top++] = 0;
+	cursor[0] = 0;
+	snapshot->nodes[0].postorder = -2;
+
+	while (top > 0)
+	{
+		int index = stack[top - 1];
+		SnapshotNode* node = &snapshot->nodes[index];
+
+		if (cursor[index] < node->edgeCount)
+		{
+			int target = snapshot->edges[node->firstEdge + cursor[index]++];
+
+			if (snapshot->nodes[target].postorder == -1)
+			{
+				snapshot->nodes[target].postorder = -2;
+				cursor[target] = 0;
+				stack[top++] = target;
+			}
+
+			continue;
+		}
+
+		node->postorder = next;
+		order[next++] = index;
+		top--;
+	}
+
+	solisRawFree(vm, stack);
+	solisRawFree(vm, cursor);
+
+	return order;
+}
+
+static int intersect(SnapshotNode* nodes, int a, int b)
+{
+	while (a != b)
+	{
+		while (nodes[a].postorder < nodes[b].postorder)
+			a = nodes[a].dominator;
+
+		while (nodes[b].postorder < nodes[a].postorder)
+			b = nodes[b].dominator;
+	}
+
+	return a;
+}
+
+/*
+	Dominators with the iterative algorithm from "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy.
+	Then every object's retained size is added to its dominator's, children come before their dominator in postorder.
+*/
+static void computeDominators(Snapshot* snapshot)
+{
+	VM* vm = snapshot->vm;
+	SnapshotNode* nodes = snapshot->nodes;
+	int count = snapshot->nodeCount;
+
+	int* order = postorderNodes(snapshot);
+
+	// Predecessors of each node, grouped the same way as the references
+	int* firstPredecessor = (int*)solisRawReallocate(vm, NULL, sizeof(int) * (count + 1));
+	int* predecessors = (int*)solisRawReallocate(vm, NULL, sizeof(int) * (snapshot->edgeCount + 1));
+	memset(firstPredecessor, 0, sizeof(int) * (count + 1));
+
+	for (int i = 0; i < snapshot->edgeCount; i++)
+		firstPredecessor[snapshot->edges[i] + 1]++;
+
+	for (int i = 0; i < count; i++)
+		firstPredecessor[i + 1] += firstPredecessor[i];
+
+	int* filled = (int*)solisRawReallocate(vm, NULL, sizeof(int) * count);
+	memset(filled, 0, sizeof(int) * count);
+
+	for (int i = 0; i < count; i++)
+	{
+		for (int j = 0; j < nodes[i].edgeCount; j++)
+		{
+			int target = snapshot->edges[nodes[i].firstEdge + j];
+			predecessors[firstPredecessor[target] + filled[target]++] = i;
+		}
+	}
+
+	nodes[0].dominator = 0;
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		// Reverse postorder, skipping the roots which come last
+		for (int k = count - 2; k >= 0; k--)
+		{
+			int index = order[k];
+			int dominator = -1;
+
+			for (int p = firstPredecessor[index]; p < firstPredecessor[index + 1]; p++)
+			{
+				int predecessor = predecessors[p];
+
+				if (nodes[predecessor].dominator == -1)
+					continue;
+
+				dominator = dominator == -1 ? predecessor : intersect(nodes, predecessor, dominator);
+			}
+
+			if (nodes[index].dominator != dominator)
+			{
+				nodes[index].dominator = dominator;
+				changed = true;
+			}
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+		nodes[i].retained = nodes[i].size;
+
+	for (int k = 0; k < count - 1; k++)
+	{
+		int index = order[k];
+		nodes[nodes[index].dominator].retained += nodes[index].retained;
+	}
+
+	solisRawFree(vm, order);
+	solisRawFree(vm, firstPredecessor);
+	solisRawFree(vm, predecessors);
+	solisRawFree(vm, filled);
+}
+
+static void writeEscaped(FILE* file, const char* chars, int length)
+{
+	fputc('"', file);
+
+	for (int i = 0; i < length; i++)
+	{
+		unsigned char c = (unsigned char)chars[i];
+
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(file, "\\u%04x", c);
+		else
+			fputc(c, file);
+	}
+
+	fputc('"', file);
+}
+
+static void writeString(FILE* file, ObjString* string, int limit)
+{
+	if (string == NULL)
+	{
+		fprintf(file, "null");
+		return;
+	}
+
+	writeEscaped(file, string->chars, string->length < limit ? string->length : limit);
+}
+
+// Instances are grouped by their class, everything else by its type
+static const char* groupName(Object* object)
+{
+	if (object->type == OBJ_INSTANCE)
+	{
+		ObjString* name = ((ObjInstance*)object)->klass->name;
+		if (name != NULL)
+			return name->chars;
+	}
+
+	return solisObjectTypeName((ObjectType)object->type);
+}
+
+static void writeObject(FILE* file, Snapshot* snapshot, int index)
+{
+	SnapshotNode* node = &snapshot->nodes[index];
+	Object* object = node->object;
+
+	fprintf(file, "{\"id\":%d", index);
+
+	if (object == NULL)
+		fprintf(file, ",\"type\":\"roots\"");
+	else
+	{
+		fprintf(file, ",\"type\":\"%s\"", solisObjectTypeName((ObjectType)object->type));
+
+		switch (object->type) {
+		case OBJ_INSTANCE:
+			fprintf(file, ",\"class\":");
+			writeString(file, ((ObjInstance*)object)->klass->name, INT32_MAX);
+			break;
+		case OBJ_CLASS:
+			fprintf(file, ",\"name\":");
+			writeString(file, ((ObjClass*)object)->name, INT32_MAX);
+			break;
+		case OBJ_FUNCTION:
+			fprintf(file, ",\"name\":");
+			writeString(file, ((ObjFunction*)object)->name, INT32_MAX);
+			break;
+		case OBJ_CLOSURE:
+			fprintf(file, ",\"name\":");
+			writeString(file, ((ObjClosure*)object)->function->name, INT32_MAX);
+			break;
+		case OBJ_STRING:
+			fprintf(file, ",\"value\":");
+			writeString(file, (ObjString*)object, SNAPSHOT_STRING_PREVIEW);
+			break;
+		default:
+			break;
+		}
+	}
+
+	fprintf(file, ",\"size\":%llu,\"retained\":%llu,\"dominator\":%d,\"references\":[",
+		(unsigned long long)node->size, (unsigned long long)node->retained, node->dominator);
+
+	for (int i = 0; i < node->edgeCount; i++)
+		fprintf(file, i == 0 ? "%d" : ",%d", snapshot->edges[node->firstEdge + i]);
+
+	fprintf(file, "]}");
+}
+
+static void writeGroups(FILE* file, Snapshot* snapshot)
+{
+	VM* vm = snapshot->vm;
+
+	SnapshotGroup* groups = NULL;
+	int groupCount = 0;
+	int groupCapacity = 0;
+
+	for (int i = 1; i < snapshot->nodeCount; i++)
+	{
+		const char* name = groupName(snapshot->nodes[i].object);
+
+		int group = 0;
+		while (group < groupCount && strcmp(groups[group].name, name) != 0)
+			group++;
+
+		if (group == groupCount)
+		{
+			if (groupCapacity < groupCount + 1)
+			{
+				groupCapacity = GROW_CAPACITY(groupCapacity);
+				groups = (SnapshotGroup*)solisRawReallocate(vm, groups, sizeof(SnapshotGroup) * groupCapacity);
+			}
+
+			groups[group].name = name;
+			groups[group].count = 0;
+			groups[group].bytes = 0;
+			groupCount++;
+		}
+
+		groups[group].count++;
+		groups[group].bytes += snapshot->nodes[i].size;
+	}
+
+	fprintf(file, "\"classes\":[\n");
+
+	for (int i = 0; i < groupCount; i++)
+	{
+		fprintf(file, "{\"name\":");
+		writeEscaped(file, groups[i].name, (int)strlen(groups[i].name));
+		fprintf(file, ",\"count\":%llu,\"bytes\":%llu}%s\n",
+			(unsigned long long)groups[i].count, (unsigned long long)groups[i].bytes, i + 1 < groupCount ? "," : "");
+	}
+
+	fprintf(file, "],\n");
+
+	solisRawFree(vm, groups);
+}
+
+// The objects retaining the most, each with the dominators between it and the roots
+static void writeRetainers(FILE* file, Snapshot* snapshot)
+{
+	int top[SOLIS_SNAPSHOT_TOP_RETAINERS];
+	int topCount = 0;
+
+	for (int i = 1; i < snapshot->nodeCount; i++)
+	{
+		uint64_t retained = snapshot->nodes[i].retained;
+
+		if (topCount == SOLIS_SNAPSHOT_TOP_RETAINERS && retained <= snapshot->nodes[top[topCount - 1]].retained)
+			continue;
+
+		int at = topCount < SOLIS_SNAPSHOT_TOP_RETAINERS ? topCount++ : topCount - 1;
+
+		while (at > 0 && snapshot->nodes[top[at - 1]].retained < retained)
+		{
+			top[at] = top[at - 1];
+			at--;
+		}
+
+		top[at] = i;
+	}
+
+	fprintf(file, "\"retainers\":[\n");
+
+	for (int i = 0; i < topCount; i++)
+	{
+		SnapshotNode* node = &snapshot->nodes[top[i]];
+
+		fprintf(file, "{\"id\":%d,\"group\":", top[i]);
+
+		const char* name = groupName(node->object);
+		writeEscaped(file, name, (int)strlen(name));
+
+		fprintf(file, ",\"retained\":%llu,\"path\":[", (unsigned long long)node->retained);
+
+		for (int index = node->dominator; ; index = snapshot->nodes[index].dominator)
+		{
+			fprintf(file, index == node->dominator ? "%d" : ",%d", index);
+
+			if (index == 0)
+				break;
+		}
+
+		fprintf(file, "]}%s\n", i + 1 < topCount ? "," : "");
+	}
+
+	fprintf(file, "]\n");
+}
+
+bool solisWriteHeapSnapshot(VM* vm, const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	Snapshot snapshot;
+	memset(&snapshot, 0, sizeof(Snapshot));
+	snapshot.vm = vm;
+
+	traceHeap(&snapshot);
+	computeDominators(&snapshot);
+
+	fprintf(file, "{\n\"objectCount\":%d,\n\"bytes\":%llu,\n",
+		snapshot.nodeCount - 1, (unsigned long long)snapshot.nodes[0].retained);
+
+	fprintf(file, "\"objects\":[\n");
+	for (int i = 0; i < snapshot.nodeCount; i++)
+	{
+		writeObject(file, &snapshot, i);
+		fprintf(file, "%s\n", i + 1 < snapshot.nodeCount ? "," : "");
+	}
+	fprintf(file, "],\n");
+
+	writeGroups(file, &snapshot);
+	writeRetainers(file, &snapshot);
+
+	fprintf(file, "}\n");
+
+	bool success = fclose(file) == 0;
+
+	solisRawFree(vm, snapshot.nodes);
+	solisRawFree(vm, snapshot.edges);
+	solisRawFree(vm, snapshot.keys);
+	solisRawFree(vm, snapshot.indices);
+
+	return success;
+}
@@ -0,0 +1,25 @@
+#ifndef SOLIS_SNAPSHOT_H
+#define SOLIS_SNAPSHOT_H
+
+#include "solis_common.h"
+#include "solis_value.h"
+
+/*
+	Heap snapshots are JSON files describing every object reachable from the roots the collector marks from.
+	Each object has its type, class, size, the objects it references and its dominator,
+	the object every path from the roots to it goes through. Object 0 stands for the roots.
+	Sizes include the buffers an object owns, retained sizes are everything that would die along with the object.
+	Objects are grouped by class name, or by type for objects that aren't instances,
+	and the objects retaining the most memory are listed with the chain of dominators keeping them alive.
+	Taking a snapshot never allocates on the VM heap so it can be done at any point, even mid collection.
+*/
+
+// Objects listed in the retainer summary
+#define SOLIS_SNAPSHOT_TOP_RETAINERS 20
+
+/*
+	Writes a snapshot of the live heap to path, returns false if the file can't be written
+*/
+bool solisWriteHeapSnapshot(VM* vm, const char* path);
+
+#endif // SOLIS_SNAPSHOT_H
@@ -7,6 +7,7 @@
 
 #include "solis_hashtable.h"
 #include "solis_chunk.h"
+#include "solis_vecmath.h"
 
 #include <string.h>
 
@@ -15,6 +16,10 @@ bool solisValuesEqual(Value a, Value b)
 {
 	if (solisValuesSame(a, b)) return true;
 
+	// Vectors and matrices are values, two with the same components are equal
+	if (SOLIS_IS_VECTOR(a) || SOLIS_IS_MATRIX(a))
+		return solisVectorsEqual(a, b);
+
 	if (SOLIS_IS_STRING(a))
 	{
 		ObjString* astr = SOLIS_AS_STRING(a);
@@ -28,6 +33,34 @@ bool solisValuesEqual(Value a, Value b)
 	return false;
 }
 
+uint32_t solisHashValue(Value value)
+{
+	if (SOLIS_IS_STRING(value))
+		return SOLIS_AS_STRING(value)->hash;
+
+	uint64_t bits;
+
+	if (SOLIS_IS_OBJECT(value))
+		bits = (uint64_t)(uintptr_t)SOLIS_AS_OBJECT(value);
+	else if (SOLIS_IS_NUMERIC(value))
+	{
+		// Adding zero turns -0 into 0 as they are the same key
+		double number = SOLIS_AS_NUMBER(value) + 0.0;
+		memcpy(&bits, &number, sizeof(double));
+	}
+	else if (SOLIS_IS_BOOL(value))
+		bits = SOLIS_AS_BOOL(value) ? 2 : 1;
+	else
+		bits = 0;
+
+	// Mix the bits so nearby addresses and whole numbers spread over the table
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdull;
+	bits ^= bits >> 33;
+
+	return (uint32_t)bits;
+}
+
 void solisPrintValueType(Value value)
 {
 	if (SOLIS_IS_OBJECT(value))
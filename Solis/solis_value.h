@@ -15,6 +15,16 @@ Object* solisAllocateObject(VM* vm, size_t size, ObjectType type);
 
 void solisFreeObject(VM* vm, Object* object);
 
+/*
+	Size of the object itself, not counting any buffers it owns
+*/
+size_t solisObjectSize(Object* object);
+
+/*
+	Lower case name of an object type, for diagnostics
+*/
+const char* solisObjectTypeName(ObjectType type);
+
 #define ALLOCATE_OBJ(vm, type, objectType) \
     (type*)solisAllocateObject(vm, sizeof(type), objectType) 
 
@@ -168,6 +178,12 @@ static inline bool solisValuesSame(Value a, Value b)
 */
 bool solisValuesEqual(Value a, Value b);
 
+/*
+	Hashes a value for tables keyed by any value, values that are the same hash the same.
+	Strings use their interned hash and other objects their address.
+*/
+uint32_t solisHashValue(Value value);
+
 
 
 // Helper functions for printing
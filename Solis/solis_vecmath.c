@@ -0,0 +1,243 @@
+#include "solis_vecmath.h"
+#include "solis_object.h"
+#include "solis_vm.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOLIS_VECMATH_SSE2
+#include <emmintrin.h>
+#endif
+
+// Four components at a time in two registers, a call through the dispatched kernels would cost more than the work
+
+static inline void add4(double* out, const double* a, const double* b)
+{
+#ifdef SOLIS_VECMATH_SSE2
+	_mm_storeu_pd(out, _mm_add_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)));
+	_mm_storeu_pd(out + 2, _mm_add_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2)));
+#else
+	for (int i = 0; i < 4; i++)
+		out[i] = a[i] + b[i];
+#endif
+}
+
+static inline void sub4(double* out, const double* a, const double* b)
+{
+#ifdef SOLIS_VECMATH_SSE2
+	_mm_storeu_pd(out, _mm_sub_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)));
+	_mm_storeu_pd(out + 2, _mm_sub_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2)));
+#else
+	for (int i = 0; i < 4; i++)
+		out[i] = a[i] - b[i];
+#endif
+}
+
+static inline void mul4(double* out, const double* a, const double* b)
+{
+#ifdef SOLIS_VECMATH_SSE2
+	_mm_storeu_pd(out, _mm_mul_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)));
+	_mm_storeu_pd(out + 2, _mm_mul_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2)));
+#else
+	for (int i = 0; i < 4; i++)
+		out[i] = a[i] * b[i];
+#endif
+}
+
+static inline void div4(double* out, const double* a, const double* b)
+{
+#ifdef SOLIS_VECMATH_SSE2
+	_mm_storeu_pd(out, _mm_div_pd(_mm_loadu_pd(a), _mm_loadu_pd(b)));
+	_mm_storeu_pd(out + 2, _mm_div_pd(_mm_loadu_pd(a + 2), _mm_loadu_pd(b + 2)));
+#else
+	for (int i = 0; i < 4; i++)
+		out[i] = a[i] / b[i];
+#endif
+}
+
+static inline void scale4(double* out, const double* a, double s)
+{
+#ifdef SOLIS_VECMATH_SSE2
+	__m128d factor = _mm_set1_pd(s);
+	_mm_storeu_pd(out, _mm_mul_pd(_mm_loadu_pd(a), factor));
+	_mm_storeu_pd(out + 2, _mm_mul_pd(_mm_loadu_pd(a + 2), factor));
+#else
+	for (int i = 0; i < 4; i++)
+		out[i] = a[i] * s;
+#endif
+}
+
+// Dividing or scaling by infinity can leave NaN in the unused components
+static inline void clearUnused(ObjVector* vector)
+{
+	for (int i = vector->size; i < 4; i++)
+		vector->v[i] = 0.0;
+}
+
+static bool vectorWithVector(VM* vm, int op, ObjVector* a, ObjVector* b, Value* result)
+{
+	if (a->size != b->size)
+		return false;
+
+	if (op != OPERATOR_ADD && op != OPERATOR_MINUS && op != OPERATOR_STAR && op != OPERATOR_SLASH)
+		return false;
+
+	// Both operands are still on the stack so the allocation can't free them
+	ObjVector* out = solisNewVector(vm, a->size);
+
+	switch (op) {
+	case OPERATOR_ADD: add4(out->v, a->v, b->v); break;
+	case OPERATOR_MINUS: sub4(out->v, a->v, b->v); break;
+	case OPERATOR_STAR: mul4(out->v, a->v, b->v); break;
+	default: div4(out->v, a->v, b->v); break;
+	}
+
+	clearUnused(out);
+
+	*result = SOLIS_OBJECT_VALUE(out);
+	return true;
+}
+
+static bool vectorWithNumber(VM* vm, int op, ObjVector* a, double s, Value* result)
+{
+	if (op != OPERATOR_STAR && op != OPERATOR_SLASH)
+		return false;
+
+	ObjVector* out = solisNewVector(vm, a->size);
+
+	scale4(out->v, a->v, op == OPERATOR_STAR ? s : 1.0 / s);
+	clearUnused(out);
+
+	*result = SOLIS_OBJECT_VALUE(out);
+	return true;
+}
+
+static bool matrixWithMatrix(VM* vm, int op, ObjMatrix* a, ObjMatrix* b, Value* result)
+{
+	if (op != OPERATOR_ADD && op != OPERATOR_MINUS && op != OPERATOR_STAR)
+		return false;
+
+	ObjMatrix* out = solisNewMatrix(vm);
+
+	switch (op) {
+	case OPERATOR_ADD:
+		for (int i = 0; i < 16; i += 4)
+			add4(out->m + i, a->m + i, b->m + i);
+		break;
+	case OPERATOR_MINUS:
+		for (int i = 0; i < 16; i += 4)
+			sub4(out->m + i, a->m + i, b->m + i);
+		break;
+	default:
+		solisMat4Multiply(out->m, a->m, b->m);
+		break;
+	}
+
+	*result = SOLIS_OBJECT_VALUE(out);
+	return true;
+}
+
+static bool matrixWithNumber(VM* vm, int op, ObjMatrix* a, double s, Value* result)
+{
+	if (op != OPERATOR_STAR && op != OPERATOR_SLASH)
+		return false;
+
+	ObjMatrix* out = solisNewMatrix(vm);
+
+	double factor = op == OPERATOR_STAR ? s : 1.0 / s;
+	for (int i = 0; i < 16; i += 4)
+		scale4(out->m + i, a->m + i, factor);
+
+	*result = SOLIS_OBJECT_VALUE(out);
+	return true;
+}
+
+static bool matrixWithVector(VM* vm, int op, ObjMatrix* a, ObjVector* v, Value* result)
+{
+	if (op != OPERATOR_STAR || v->size < 3)
+		return false;
+
+	ObjVector* out = solisNewVector(vm, v->size);
+
+	double point[4] = { v->v[0], v->v[1], v->v[2], v->size == 3 ? 1.0 : v->v[3] };
+	solisMat4Transform(out->v, a->m, point);
+	clearUnused(out);
+
+	*result = SOLIS_OBJECT_VALUE(out);
+	return true;
+}
+
+bool solisVectorArithmetic(VM* vm, int op, Value a, Value b, Value* result)
+{
+	if (SOLIS_IS_VECTOR(a))
+	{
+		if (SOLIS_IS_VECTOR(b))
+			return vectorWithVector(vm, op, SOLIS_AS_VECTOR(a), SOLIS_AS_VECTOR(b), result);
+		if (SOLIS_IS_NUMERIC(b))
+			return vectorWithNumber(vm, op, SOLIS_AS_VECTOR(a), SOLIS_AS_NUMBER(b), result);
+		return false;
+	}
+
+	if (SOLIS_IS_MATRIX(a))
+	{
+		if (SOLIS_IS_MATRIX(b))
+			return matrixWithMatrix(vm, op, SOLIS_AS_MATRIX(a), SOLIS_AS_MATRIX(b), result);
+		if (SOLIS_IS_VECTOR(b))
+			return matrixWithVector(vm, op, SOLIS_AS_MATRIX(a), SOLIS_AS_VECTOR(b), result);
+		if (SOLIS_IS_NUMERIC(b))
+			return matrixWithNumber(vm, op, SOLIS_AS_MATRIX(a), SOLIS_AS_NUMBER(b), result);
+		return false;
+	}
+
+	// Scaling is the same either way round, only multiplying has the number first
+	if (SOLIS_IS_NUMERIC(a) && op == OPERATOR_STAR)
+	{
+		if (SOLIS_IS_VECTOR(b))
+			return vectorWithNumber(vm, op, SOLIS_AS_VECTOR(b), SOLIS_AS_NUMBER(a), result);
+		if (SOLIS_IS_MATRIX(b))
+			return matrixWithNumber(vm, op, SOLIS_AS_MATRIX(b), SOLIS_AS_NUMBER(a), result);
+	}
+
+	return false;
+}
+
+bool solisVectorNegate(VM* vm, Value value, Value* result)
+{
+	if (SOLIS_IS_VECTOR(value))
+		return vectorWithNumber(vm, OPERATOR_STAR, SOLIS_AS_VECTOR(value), -1.0, result);
+	if (SOLIS_IS_MATRIX(value))
+		return matrixWithNumber(vm, OPERATOR_STAR, SOLIS_AS_MATRIX(value), -1.0, result);
+
+	return false;
+}
+
+bool solisVectorsEqual(Value a, Value b)
+{
+	if (SOLIS_IS_VECTOR(a) && SOLIS_IS_VECTOR(b))
+	{
+		ObjVector* x = SOLIS_AS_VECTOR(a);
+		ObjVector* y = SOLIS_AS_VECTOR(b);
+
+		if (x->size != y->size)
+			return false;
+
+		for (int i = 0; i < x->size; i++)
+		{
+			if (x->v[i] != y->v[i])
+				return false;
+		}
+
+		return true;
+	}
+
+	if (SOLIS_IS_MATRIX(a) && SOLIS_IS_MATRIX(b))
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			if (SOLIS_AS_MATRIX(a)->m[i] != SOLIS_AS_MATRIX(b)->m[i])
+				return false;
+		}
+
+		return true;
+	}
+
+	return false;
+}
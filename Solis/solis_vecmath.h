@@ -0,0 +1,50 @@
+#ifndef SOLIS_VECMATH_H
+#define SOLIS_VECMATH_H
+
+#include "solis_common.h"
+#include "solis_value.h"
+
+/*
+	Arithmetic for Vec2, Vec3, Vec4 and Mat4.
+	The VM tries these before looking an operator up so vector math doesn't go through a native call,
+	the operator natives registered on the classes use them as well.
+
+	Vectors of the same size add, subtract, multiply and divide component wise, and scale by a number.
+	Matrices add and subtract, multiply with another matrix, scale by a number and transform vectors.
+	A Vec3 is transformed as a point, with a w of 1 that is dropped from the result.
+*/
+
+/*
+	Stores the result of a op b in result when the operands are ones vector math handles.
+	Returns false without raising an error otherwise, so the caller can fall back to the operator table.
+*/
+bool solisVectorArithmetic(VM* vm, int op, Value a, Value b, Value* result);
+
+/*
+	Negates every component of a vector or matrix, returns false for anything else
+*/
+bool solisVectorNegate(VM* vm, Value value, Value* result);
+
+/*
+	True when both are vectors of the same size or both are matrices, and every component is equal
+*/
+bool solisVectorsEqual(Value a, Value b);
+
+/*
+	The component named by a field, x, y, z or w, or -1
+*/
+static inline int solisVectorComponentIndex(const char* name, int length)
+{
+	if (length != 1)
+		return -1;
+
+	switch (name[0]) {
+	case 'x': return 0;
+	case 'y': return 1;
+	case 'z': return 2;
+	case 'w': return 3;
+	default: return -1;
+	}
+}
+
+#endif // SOLIS_VECMATH_H
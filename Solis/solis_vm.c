@@ -8,6 +8,9 @@
 #include <math.h>
 
 #include "solis_core.h"
+#include "solis_jit.h"
+#include "solis_cache.h"
+#include "solis_vecmath.h"
 
 #include "terminal.h"
 #include <stdarg.h>
@@ -18,6 +21,10 @@ static bool callValue(VM* vm, Value callee, int argCount);
 static bool callClosure(VM* vm, ObjClosure* closure, int argCount);
 static bool callNativeFunction(VM* vm, SolisNativeSignature func, int numArgs);
 static bool callOperator(VM* vm, int op, int numArgs);
+static CallFrame* pushRegisterFrame(VM* vm, ObjClosure* closure, Value* slots);
+
+static InterpretResult run(VM* vm, int baseFrame);
+static InterpretResult runRegister(VM* vm, int baseFrame);
 
 
 static int __openVMs = 0;
@@ -26,6 +33,39 @@ static int __openVMs = 0;
 
 void solisInitVM(VM* vm, bool sandboxed)
 {
+	SolisVMConfig config;
+	config.sandboxed = sandboxed;
+	config.executionMode = SOLIS_EXECUTION_STACK;
+	config.jit = false;
+	config.jitThreshold = 0;
+	config.coreCachePath = NULL;
+	config.nurserySize = 0;
+	config.gcThreads = 0;
+	config.allocator = NULL;
+	config.gcPacing.growFactor = 0;
+	config.gcPacing.minHeap = 0;
+	config.gcPacing.maxHeap = 0;
+
+	solisInitVMWithConfig(vm, &config);
+}
+
+void solisInitVMWithConfig(VM* vm, const SolisVMConfig* config)
+{
+	bool sandboxed = config->sandboxed;
+
+	// Has to be set before anything is allocated
+	vm->allocator = solisDefaultAllocator();
+	if (config->allocator != NULL)
+	{
+		vm->allocator.reallocate = config->allocator->reallocate;
+		vm->allocator.userdata = config->allocator->userdata;
+
+		if (config->allocator->allocateAligned != NULL && config->allocator->freeAligned != NULL)
+		{
+			vm->allocator.allocateAligned = config->allocator->allocateAligned;
+			vm->allocator.freeAligned = config->allocator->freeAligned;
+		}
+	}
 
 	if (__openVMs == 0)
 		terminalInit();
@@ -33,6 +73,9 @@ void solisInitVM(VM* vm, bool sandboxed)
 	__openVMs++;
 
 	vm->sandboxed = sandboxed;
+	vm->executionMode = config->executionMode;
+	vm->jitEnabled = config->jit && SOLIS_JIT_SUPPORTED;
+	vm->jitThreshold = config->jitThreshold > 0 ? config->jitThreshold : SOLIS_JIT_DEFAULT_THRESHOLD;
 
 	vm->sp = vm->stack;
 	vm->objects = NULL;
@@ -48,17 +91,66 @@ void solisInitVM(VM* vm, bool sandboxed)
 	vm->apiStack = NULL;
 
 	vm->allocatedBytes = 0;
-	vm->nextGC = 1024 * 1024;
+	vm->liveBytes = 0;
 
 	vm->greyCapacity = 0;
 	vm->greyCount = 0;
 	vm->greyStack = NULL;
+
+	vm->youngObjects = NULL;
+	vm->youngBytes = 0;
+	vm->blockBytes = 0;
+	vm->youngBlockBytes = 0;
+	vm->markedBytes = 0;
+	memset(vm->markedObjects, 0, sizeof(vm->markedObjects));
+	memset(&vm->gcStats, 0, sizeof(vm->gcStats));
+	vm->referenceVisitor = NULL;
+	vm->referenceVisitorData = NULL;
+	vm->rememberedCount = 0;
+	vm->rememberedCapacity = 0;
+	vm->rememberedSet = NULL;
+	vm->minorCollection = false;
+	vm->weakObjects = NULL;
+	vm->gcEpoch = 0;
+	vm->gcState = SOLIS_GC_IDLE;
+	vm->gcDebt = 0;
+	vm->sweepingObjects = NULL;
+	vm->markThreadCount = config->gcThreads > 1 ? config->gcThreads : 1;
+	solisInitNursery(vm, config->nurserySize);
+	solisInitSmallAllocator(&vm->smallAllocator);
+
+	// Sets the first threshold, which needs the nursery size
+	solisSetGCPacing(vm, &config->gcPacing);
+
+	// Young objects count towards the heap so leave room for the nursery before the first full collection
+	vm->nextGC += vm->nursery.size;
 	vm->errorRaised = false;
 
+	vm->inlineCacheStats.hits = 0;
+	vm->inlineCacheStats.misses = 0;
+
 	vm->boolClass = NULL;
 	vm->stringClass = NULL;
 	vm->numberClass = NULL;
 	vm->listClass = NULL;
+	vm->rangeClass = NULL;
+	vm->dictionaryClass = NULL;
+	vm->weakRefClass = NULL;
+	vm->weakTableClass = NULL;
+
+	for (int i = 0; i < SOLIS_ARRAY_KIND_COUNT; i++)
+		vm->typedArrayClasses[i] = NULL;
+
+	for (int i = 0; i < 3; i++)
+		vm->vectorClasses[i] = NULL;
+
+	vm->matrixClass = NULL;
+	vm->stringBuilderClass = NULL;
+	vm->stopIterationClass = NULL;
+
+	vm->currentModule = NULL;
+	memset(vm->operatorStrings, 0, sizeof(vm->operatorStrings));
+	vm->iterateString = NULL;
 
 
 	solisInitHashTable(&vm->strings, vm);
@@ -78,26 +170,39 @@ void solisInitVM(VM* vm, bool sandboxed)
 	vm->operatorStrings[OPERATOR_DOTDOT] = solisCopyString(vm, "..", 2);
 	vm->operatorStrings[OPERATOR_SUBSCRIPT_SET] = solisCopyString(vm, "[]=", 3);
 
+	vm->iterateString = solisCopyString(vm, "iterate", 7);
 
 
-	solisInitialiseCore(vm, sandboxed);
+
+	solisInitialiseCore(vm, sandboxed, config->coreCachePath);
 
 }
 
-static void freeObjects(VM* vm)
+static void freeObjectList(VM* vm, Object* object)
 {
-	Object* object = vm->objects;
 	while (object != NULL) {
-		Object* next = object->next;
+		Object* next = SOLIS_LARGE_HEADER(object)->next;
 		solisFreeObject(vm, object);
 		object = next;
 	}
+}
+
+static void freeObjects(VM* vm)
+{
+	freeObjectList(vm, vm->objects);
+	freeObjectList(vm, vm->youngObjects);
+	freeObjectList(vm, vm->sweepingObjects);
 
+	solisFreeNursery(vm);
+
+	// Freeing the objects gives their buffers back first
+	solisFreeSmallAllocator(vm, &vm->smallAllocator);
 }
 
 void solisFreeVM(VM* vm)
 {
-	free(vm->greyStack);
+	solisRawFree(vm, vm->greyStack);
+	solisRawFree(vm, vm->rememberedSet);
 
 	SOLIS_FREE_ARRAY(vm, CallFrame, vm->frames, vm->frameCapacity);
 
@@ -151,10 +256,70 @@ static void closeUpvalues(VM* vm, Value* last)
 		ObjUpvalue* upvalue = vm->openUpvalues;
 		upvalue->closed = *upvalue->location;
 		upvalue->location = &upvalue->closed;
+		solisWriteBarrier(vm, (Object*)upvalue, upvalue->closed);
 		vm->openUpvalues = upvalue->next;
 	}
 }
 
+static inline InlineCacheEntry* findInlineCache(InlineCache* cache, ObjClass* klass, bool isStatic)
+{
+	for (int i = 0; i < cache->count; i++)
+	{
+		InlineCacheEntry* entry = &cache->entries[i];
+
+		if (entry->klass == klass && entry->isStatic == isStatic && entry->version == klass->version)
+			return entry;
+	}
+
+	return NULL;
+}
+
+// function owns the cache, it needs a barrier for what the entry points at
+static void updateInlineCache(VM* vm, ObjFunction* function, InlineCache* cache, ObjClass* klass, bool isStatic, InlineCacheKind kind, int slot, Value value)
+{
+	InlineCacheEntry* entry = NULL;
+
+	// Reuse a stale entry for the same receiver before taking a new one
+	for (int i = 0; i < cache->count; i++)
+	{
+		if (cache->entries[i].klass == klass && cache->entries[i].isStatic == isStatic)
+		{
+			entry = &cache->entries[i];
+			break;
+		}
+	}
+
+	if (entry == NULL)
+	{
+		// Once the site has seen too many classes just keep recycling the last entry
+		if (cache->count < SOLIS_INLINE_CACHE_SIZE)
+			entry = &cache->entries[cache->count++];
+		else
+			entry = &cache->entries[SOLIS_INLINE_CACHE_SIZE - 1];
+	}
+
+	entry->klass = klass;
+	entry->version = klass->version;
+	entry->isStatic = isStatic;
+	entry->kind = kind;
+	entry->slot = slot;
+	entry->value = value;
+
+	solisWriteBarrier(vm, (Object*)function, SOLIS_OBJECT_VALUE(klass));
+	solisWriteBarrier(vm, (Object*)function, value);
+}
+
+static inline bool callMethod(VM* vm, Value method, int argCount)
+{
+	if (SOLIS_IS_CLOSURE(method))
+		return callClosure(vm, SOLIS_AS_CLOSURE(method), argCount);
+
+	if (argCount != SOLIS_AS_NATIVE(method)->arity)
+		return false;
+
+	return callNativeFunction(vm, SOLIS_AS_NATIVE(method)->nativeFunction, argCount);
+}
+
 static bool invokeFromClass(VM* vm, ObjClass* klass, ObjString* name, int argCount, bool isStatic) {
 	Value method;
 
@@ -173,36 +338,183 @@ static bool invokeFromClass(VM* vm, ObjClass* klass, ObjString* name, int argCou
 		}
 	}
 
-	if (SOLIS_IS_CLOSURE(method))
-		return callClosure(vm, SOLIS_AS_CLOSURE(method), argCount);
-	else
+	return callMethod(vm, method, argCount);
+}
+
+static bool invoke(VM* vm, ObjFunction* function, InlineCache* cache, ObjString* name, int argCount) 
+{
+	Value receiver = solisPeek(vm, argCount);
+
+	ObjClass* klass = solisGetClassForValue(vm, receiver);
+
+	if (klass == NULL)
+		return false;
+
+	// Statics can be reassigned at runtime so they are always looked up
+	if (SOLIS_IS_CLASS(receiver))
+		return invokeFromClass(vm, klass, name, argCount, true);
+
+	InlineCacheEntry* entry = findInlineCache(cache, klass, false);
+
+	if (entry != NULL)
+	{
+		vm->inlineCacheStats.hits++;
+		return callMethod(vm, entry->value, argCount);
+	}
+
+	vm->inlineCacheStats.misses++;
+
+	Value method;
+	if (!solisHashTableGet(&klass->methods, name, &method))
+		return false;
+
+	updateInlineCache(vm, function, cache, klass, false, CACHE_METHOD, 0, method);
+
+	return callMethod(vm, method, argCount);
+}
+
+// Calls a binary operator whose operands are already on the stack and leaves the result in their place
+// Operators are always native so this completes before returning
+static bool callBinaryOperator(VM* vm, int op)
+{
+	Value result;
+	if (solisVectorArithmetic(vm, op, vm->sp[-2], vm->sp[-1], &result))
+	{
+		vm->sp[-2] = result;
+		vm->sp--;
+		return true;
+	}
+
+	ObjClass* klass = solisGetClassForValue(vm, solisPeek(vm, 1));
+	Object* obj = klass != NULL ? klass->operators[op] : NULL;
+
+	if (obj == NULL || obj->type != OBJ_NATIVE_FUNCTION)
+	{
+		solisVMRaiseError(vm, "Object does not contain operator: %s\n", vm->operatorStrings[op]->chars);
+		return false;
+	}
+
+	return callNativeFunction(vm, ((ObjNative*)obj)->nativeFunction, 1);
+}
+
+// Adds the top count values left to right and leaves the result in place of the first
+// All strings are joined in one go, anything else is added a pair at a time like OP_ADD
+static bool concatenate(VM* vm, int count)
+{
+	Value* operands = vm->sp - count;
+
+	bool strings = true;
+	for (int i = 0; i < count && strings; i++)
+		strings = SOLIS_IS_STRING(operands[i]);
+
+	if (strings)
+	{
+		// The operands stay on the stack until the result is made
+		operands[0] = SOLIS_OBJECT_VALUE(solisConcatenateStringValues(vm, operands, count));
+		vm->sp = operands + 1;
+		return true;
+	}
+
+	for (int i = 1; i < count; i++)
 	{
-		if (argCount != SOLIS_AS_NATIVE(method)->arity)
+		Value a = operands[0];
+		Value b = operands[i];
+
+		if (SOLIS_IS_NUMERIC(a) && SOLIS_IS_NUMERIC(b))
+		{
+			operands[0] = SOLIS_NUMERIC_VALUE(SOLIS_AS_NUMBER(a) + SOLIS_AS_NUMBER(b));
+			continue;
+		}
+
+		// The remaining operands stay below the pair so nothing is collected
+		solisPush(vm, a);
+		solisPush(vm, b);
+
+		if (!callBinaryOperator(vm, OPERATOR_ADD))
 			return false;
 
-		return callNativeFunction(vm, SOLIS_AS_NATIVE(method)->nativeFunction, argCount);
+		operands[0] = solisPop(vm);
 	}
+
+	vm->sp = operands + 1;
+	return true;
 }
 
-static bool invoke(VM* vm, ObjString* name, int argCount) 
+bool solisJitConcatenate(VM* vm, uint8_t* ip, int count)
 {
-	Value receiver = solisPeek(vm, argCount);
+	vm->frames[vm->frameCount - 1].ip = ip;
+
+	return concatenate(vm, count);
+}
 
-	ObjClass* klass = NULL;
-	if (!SOLIS_IS_INSTANCE(receiver))
-		klass = solisGetClassForValue(vm, receiver);
+bool solisJitBinaryOperator(VM* vm, uint8_t* ip, int op)
+{
+	vm->frames[vm->frameCount - 1].ip = ip;
 
-	bool isStatic = SOLIS_IS_CLASS(receiver);
+	Value a = vm->sp[-2];
+	Value b = vm->sp[-1];
 
-	if (klass == NULL)
-		klass = SOLIS_AS_INSTANCE(receiver)->klass;
-	
-		
-	return invokeFromClass(vm, klass, name, argCount, isStatic);
-	
+	if (SOLIS_IS_NUMERIC(a) && SOLIS_IS_NUMERIC(b))
+	{
+		double x = SOLIS_AS_NUMBER(a);
+		double y = SOLIS_AS_NUMBER(b);
+		double result = 0.0;
+
+		switch (op)
+		{
+		case OPERATOR_ADD:			result = x + y; break;
+		case OPERATOR_MINUS:		result = x - y; break;
+		case OPERATOR_STAR:			result = x * y; break;
+		case OPERATOR_SLASH:		result = x / y; break;
+		case OPERATOR_SLASH_SLASH:	result = floor(x / y); break;
+		case OPERATOR_POWER:		result = pow(x, y); break;
+		default: break;
+		}
+
+		vm->sp--;
+		vm->sp[-1] = SOLIS_NUMERIC_VALUE(result);
+		return true;
+	}
+
+	return callBinaryOperator(vm, op);
+}
+
+bool solisJitNegate(VM* vm, uint8_t* ip)
+{
+	vm->frames[vm->frameCount - 1].ip = ip;
+
+	Value result;
+	if (!solisVectorNegate(vm, vm->sp[-1], &result))
+	{
+		solisVMRaiseError(vm, "Negate error\n");
+		return false;
+	}
+
+	vm->sp[-1] = result;
+	return true;
+}
+
+bool solisJitCall(VM* vm, uint8_t* ip, int argCount)
+{
+	vm->frames[vm->frameCount - 1].ip = ip;
+
+	int baseFrame = vm->frameCount;
+
+	if (!callValue(vm, vm->sp[-argCount - 1], argCount))
+	{
+		solisVMRaiseError(vm, "Failed to call function\n");
+		return false;
+	}
+
+	// Stack functions that were called still need to be run
+	if (vm->frameCount > baseFrame)
+		return run(vm, baseFrame) == INTERPRET_ALL_GOOD;
+
+	return true;
 }
 
-static InterpretResult run(VM* vm)
+// Runs until the frame at baseFrame returns, so register functions can call back into stack functions
+static InterpretResult run(VM* vm, int baseFrame)
 {
 	CallFrame* frame = &vm->frames[vm->frameCount - 1];
 
@@ -217,8 +529,8 @@ static InterpretResult run(VM* vm)
 
 #define STORE_FRAME() frame->ip = ip
 
+// Calls can grow the frame array so frame must not be written through once they return
 #define LOAD_FRAME()			\
-	STORE_FRAME();				\
 	frame = &vm->frames[vm->frameCount - 1]; \
 	ip = frame->ip;				\
 	closure = frame->closure;	\
@@ -232,6 +544,7 @@ static InterpretResult run(VM* vm)
 #define READ_SHORT() (ip+=2, (uint16_t)((ip[-2] << 8) | ip[-1]))
 #define READ_CONSTANT() (closure->function->chunk.constants.data[READ_BYTE()])
 #define READ_CONSTANT_LONG() (closure->function->chunk.constants.data[READ_SHORT()])
+#define READ_CACHE() (&closure->function->chunk.caches.data[READ_SHORT()])
 
 #define PUSH(val) (*vm->sp++ = val)
 #define POP() (*(--vm->sp))
@@ -310,11 +623,15 @@ do {																		\
 	{
 		// Just negate the value on the stack
 		// No need to pop and push 
-		// TODO: Improve this
-		if (SOLIS_IS_NUMERIC(PEEK()))
-			PUSH(SOLIS_NUMERIC_VALUE(-SOLIS_AS_NUMBER(POP())));
+		Value* ptr = PEEK_PTR();
+		Value result;
+		if (SOLIS_IS_NUMERIC(*ptr))
+			*ptr = SOLIS_NUMERIC_VALUE(-SOLIS_AS_NUMBER(*ptr));
+		else if (solisVectorNegate(vm, *ptr, &result))
+			*ptr = result;
 		else
 		{
+			STORE_FRAME();
 			solisVMRaiseError( vm, "Negate error\n");
 			return INTERPRET_RUNTIME_ERROR;
 		}
@@ -338,26 +655,97 @@ do {																		\
 	}
 	CASE_CODE(GREATER) :
 	{
-
-		Value a = POP();
-		Value val = POP();
+		Value b = POP();
+		Value* a = PEEK_PTR();
 
 		// Check if the values are numeric values
-		if (SOLIS_IS_NUMERIC(val) && SOLIS_IS_NUMERIC(a))
-			PUSH(SOLIS_BOOL_VALUE(SOLIS_AS_NUMBER(val) > SOLIS_AS_NUMBER(a)));
+		if (!SOLIS_IS_NUMERIC(*a) || !SOLIS_IS_NUMERIC(b))
+		{
+			STORE_FRAME();
+			solisVMRaiseError(vm, "Operands must be numbers\n");
+			return INTERPRET_RUNTIME_ERROR;
+		}
+
+		*a = SOLIS_BOOL_VALUE(SOLIS_AS_NUMBER(*a) > SOLIS_AS_NUMBER(b));
 
 		DISPATCH();
 	}
 	CASE_CODE(LESS) :
 	{
-
-		Value a = POP();
-		Value val = POP();
+		Value b = POP();
+		Value* a = PEEK_PTR();
 
 		// Check if the values are numeric values
-		if (SOLIS_IS_NUMERIC(val) && SOLIS_IS_NUMERIC(a))
-			PUSH(SOLIS_BOOL_VALUE(SOLIS_AS_NUMBER(val) < SOLIS_AS_NUMBER(a)));
+		if (!SOLIS_IS_NUMERIC(*a) || !SOLIS_IS_NUMERIC(b))
+		{
+			STORE_FRAME();
+			solisVMRaiseError(vm, "Operands must be numbers\n");
+			return INTERPRET_RUNTIME_ERROR;
+		}
+
+		*a = SOLIS_BOOL_VALUE(SOLIS_AS_NUMBER(*a) < SOLIS_AS_NUMBER(b));
+
+		DISPATCH();
+	}
+	CASE_CODE(LESS_EQUAL) :
+	CASE_CODE(GREATER_EQUAL) :
+	{
+		Value b = POP();
+		Value* a = PEEK_PTR();
+
+		if (!SOLIS_IS_NUMERIC(*a) || !SOLIS_IS_NUMERIC(b))
+		{
+			STORE_FRAME();
+			solisVMRaiseError(vm, "Operands must be numbers\n");
+			return INTERPRET_RUNTIME_ERROR;
+		}
+
+		// Negate the opposite comparison so NaN behaves like the unfused GREATER, NOT and LESS, NOT
+		if (instruction == OP_LESS_EQUAL)
+			*a = SOLIS_BOOL_VALUE(!(SOLIS_AS_NUMBER(*a) > SOLIS_AS_NUMBER(b)));
+		else
+			*a = SOLIS_BOOL_VALUE(!(SOLIS_AS_NUMBER(*a) < SOLIS_AS_NUMBER(b)));
+
+		DISPATCH();
+	}
+	CASE_CODE(LESS_LOCAL_CONST_JUMP) :
+	{
+		Value a = frame->slots[READ_SHORT()];
+		Value b = READ_CONSTANT_LONG();
+		uint16_t offset = READ_SHORT();
+
+		if (!SOLIS_IS_NUMERIC(a) || !SOLIS_IS_NUMERIC(b))
+		{
+			STORE_FRAME();
+			solisVMRaiseError(vm, "Operands must be numbers\n");
+			return INTERPRET_RUNTIME_ERROR;
+		}
+
+		if (!(SOLIS_AS_NUMBER(a) < SOLIS_AS_NUMBER(b)))
+			ip += offset;
+
+		DISPATCH();
+	}
+	CASE_CODE(INCREMENT_LOCAL) :
+	{
+		Value* local = &frame->slots[READ_SHORT()];
+		Value b = READ_CONSTANT_LONG();
+
+		if (SOLIS_IS_NUMERIC(*local) && SOLIS_IS_NUMERIC(b))
+		{
+			*local = SOLIS_NUMERIC_VALUE(SOLIS_AS_NUMBER(*local) + SOLIS_AS_NUMBER(b));
+			DISPATCH();
+		}
+
+		PUSH(*local);
+		PUSH(b);
+
+		STORE_FRAME();
+
+		if (!callBinaryOperator(vm, OPERATOR_ADD))
+			return INTERPRET_RUNTIME_ERROR;
 
+		*local = POP();
 		DISPATCH();
 	}
 	{
@@ -365,66 +753,206 @@ do {																		\
 		uint8_t op = 0;
 		uint8_t argCount = 0;
 
-	CASE_CODE(SUBSCRIPT_SET) :
-
-		op = OPERATOR_SUBSCRIPT_SET;
-		argCount = 2;
-
-		goto completeOpCall;
+	// Numbers are by far the most common operands so handle them in place, then vectors and matrices
+	// Anything else goes through the operator table of the class
+#define NUMERIC_BINARY_OP(operator, expr)									\
+		{																	\
+			Value b = PEEK();												\
+			Value* a = PEEK_PTR() - 1;										\
+			if (SOLIS_IS_NUMERIC(*a) && SOLIS_IS_NUMERIC(b))				\
+			{																\
+				double x = SOLIS_AS_NUMBER(*a);								\
+				double y = SOLIS_AS_NUMBER(b);								\
+				*a = SOLIS_NUMERIC_VALUE(expr);								\
+				DROP();														\
+				DISPATCH();													\
+			}																\
+			Value result;													\
+			if (solisVectorArithmetic(vm, operator, *a, b, &result))		\
+			{																\
+				*a = result;												\
+				DROP();														\
+				DISPATCH();													\
+			}																\
+			op = operator;													\
+			argCount = 1;													\
+			goto completeOpCall;											\
+		}
 
 	CASE_CODE(ADD) :
+		NUMERIC_BINARY_OP(OPERATOR_ADD, x + y);
 	CASE_CODE(SUBTRACT) :
+		NUMERIC_BINARY_OP(OPERATOR_MINUS, x - y);
 	CASE_CODE(MULTIPLY) :
+		NUMERIC_BINARY_OP(OPERATOR_STAR, x * y);
 	CASE_CODE(DIVIDE) :
+		NUMERIC_BINARY_OP(OPERATOR_SLASH, x / y);
 	CASE_CODE(FLOOR_DIVIDE) :
+		NUMERIC_BINARY_OP(OPERATOR_SLASH_SLASH, floor(x / y));
 	CASE_CODE(POWER) :
-	CASE_CODE(SUBSCRIPT_GET) :
-	CASE_CODE(DOTDOT):
-		
+		NUMERIC_BINARY_OP(OPERATOR_POWER, pow(x, y));
 
-		op = instruction - OP_ADD;
-		argCount = 1;
+	// Superinstructions from the peephole pass, anything that isn't a number falls back to the operator call
+	CASE_CODE(ADD_LOCALS) :
+	{
+		Value a = frame->slots[READ_SHORT()];
+		Value b = frame->slots[READ_SHORT()];
 
-	completeOpCall:
+		if (SOLIS_IS_NUMERIC(a) && SOLIS_IS_NUMERIC(b))
+		{
+			PUSH(SOLIS_NUMERIC_VALUE(SOLIS_AS_NUMBER(a) + SOLIS_AS_NUMBER(b)));
+			DISPATCH();
+		}
 
-		Value val = PEEK_OFF(argCount);
+		PUSH(a);
+		PUSH(b);
 
-		ObjClass* klass = solisGetClassForValue(vm, val);
+		op = OPERATOR_ADD;
+		argCount = 1;
+		goto completeOpCall;
+	}
+	CASE_CODE(ADD_LOCAL_CONST) :
+	CASE_CODE(SUBTRACT_LOCAL_CONST) :
+	{
+		Value a = frame->slots[READ_SHORT()];
+		Value b = READ_CONSTANT_LONG();
 
-		Object* obj = klass->operators[op];
+		bool add = instruction == OP_ADD_LOCAL_CONST;
 
-		if (obj == NULL)
+		if (SOLIS_IS_NUMERIC(a) && SOLIS_IS_NUMERIC(b))
 		{
-			solisVMRaiseError(vm, "Object does not contain operator: %s\n", vm->operatorStrings[op]->chars);
-			return INTERPRET_RUNTIME_ERROR;
+			double x = SOLIS_AS_NUMBER(a);
+			double y = SOLIS_AS_NUMBER(b);
+
+			PUSH(SOLIS_NUMERIC_VALUE(add ? x + y : x - y));
+			DISPATCH();
 		}
 
-		if (obj->type == OBJ_NATIVE_FUNCTION)
+		PUSH(a);
+		PUSH(b);
+
+		op = add ? OPERATOR_ADD : OPERATOR_MINUS;
+		argCount = 1;
+		goto completeOpCall;
+	}
+
+#undef NUMERIC_BINARY_OP
+
+	// Typed arrays are read and written in place, anything else or an index out of range goes to the operator
+	CASE_CODE(SUBSCRIPT_SET) :
+	{
+		Value receiver = PEEK_OFF(2);
+		Value index = PEEK_OFF(1);
+		Value value = PEEK();
+
+		if (SOLIS_IS_TYPED_ARRAY(receiver) && SOLIS_IS_NUMERIC(index) && SOLIS_IS_NUMERIC(value))
 		{
-			if (!callNativeFunction(vm, ((ObjNative*)obj)->nativeFunction, argCount))
+			ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(receiver);
+			double i = SOLIS_AS_NUMBER(index);
+
+			if (i >= 0.0 && i < (double)array->count)
 			{
-				return INTERPRET_RUNTIME_ERROR;
+				solisTypedArraySet(array, (int)i, SOLIS_AS_NUMBER(value));
+
+				DROP();
+				DROP();
+				*PEEK_PTR() = SOLIS_NULL_VALUE();
+				DISPATCH();
 			}
 		}
-		else
+
+		op = OPERATOR_SUBSCRIPT_SET;
+		argCount = 2;
+
+		goto completeOpCall;
+	}
+
+	CASE_CODE(SUBSCRIPT_GET) :
+	{
+		Value receiver = PEEK_OFF(1);
+		Value index = PEEK();
+
+		if (SOLIS_IS_TYPED_ARRAY(receiver) && SOLIS_IS_NUMERIC(index))
 		{
-			if (!callClosure(vm, ((ObjClosure*)obj), argCount))
+			ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(receiver);
+			double i = SOLIS_AS_NUMBER(index);
+
+			if (i >= 0.0 && i < (double)array->count)
 			{
-				return INTERPRET_RUNTIME_ERROR;
+				DROP();
+				*PEEK_PTR() = SOLIS_NUMERIC_VALUE(solisTypedArrayGet(array, (int)i));
+				DISPATCH();
 			}
 		}
 
-		DISPATCH();
+		op = OPERATOR_SUBSCRIPT_GET;
+		argCount = 1;
+
+		goto completeOpCall;
 	}
 
-	CASE_CODE(POP) :
+	CASE_CODE(CONCAT) :
 	{
-		DROP();
+		uint8_t count = READ_BYTE();
+
+		STORE_FRAME();
+
+		if (!concatenate(vm, count))
+			return INTERPRET_RUNTIME_ERROR;
+
 		DISPATCH();
 	}
-	CASE_CODE(CREATE_LIST) :
-	{
-		ObjList* list = solisNewList(vm);
+
+	CASE_CODE(DOTDOT):
+		
+
+		op = instruction - OP_ADD;
+		argCount = 1;
+
+	completeOpCall:
+
+		// Operators can raise errors so they need the position of this instruction
+		STORE_FRAME();
+
+		Value val = PEEK_OFF(argCount);
+
+		ObjClass* klass = solisGetClassForValue(vm, val);
+
+		// Null has no class and so no operators
+		Object* obj = klass != NULL ? klass->operators[op] : NULL;
+
+		if (obj == NULL)
+		{
+			solisVMRaiseError(vm, "Object does not contain operator: %s\n", vm->operatorStrings[op]->chars);
+			return INTERPRET_RUNTIME_ERROR;
+		}
+
+		if (obj->type == OBJ_NATIVE_FUNCTION)
+		{
+			if (!callNativeFunction(vm, ((ObjNative*)obj)->nativeFunction, argCount))
+			{
+				return INTERPRET_RUNTIME_ERROR;
+			}
+		}
+		else
+		{
+			if (!callClosure(vm, ((ObjClosure*)obj), argCount))
+			{
+				return INTERPRET_RUNTIME_ERROR;
+			}
+		}
+
+		DISPATCH();
+	}
+
+	CASE_CODE(POP) :
+	{
+		DROP();
+		DISPATCH();
+	}
+	CASE_CODE(CREATE_LIST) :
+	{
+		ObjList* list = solisNewList(vm);
 		PUSH(SOLIS_OBJECT_VALUE(list));
 		DISPATCH();
 	}
@@ -437,7 +965,25 @@ do {																		\
 
 		ObjList* l = SOLIS_AS_LIST(list);
 		solisValueBufferWrite(vm, &l->values, val);
+		solisWriteBarrier(vm, (Object*)l, val);
+
+		DROP();
+
+		DISPATCH();
+	}
+	CASE_CODE(CREATE_DICTIONARY) :
+	{
+		ObjDictionary* dictionary = solisNewDictionary(vm);
+		PUSH(SOLIS_OBJECT_VALUE(dictionary));
+		DISPATCH();
+	}
+	CASE_CODE(INSERT_DICTIONARY) :
+	{
+		// Only used by dictionary literals, the key and value stay on the stack until they are in the table
+		ObjDictionary* dictionary = SOLIS_AS_DICTIONARY(PEEK_OFF(2));
+		solisDictionarySet(vm, dictionary, PEEK_OFF(1), PEEK());
 
+		DROP();
 		DROP();
 
 		DISPATCH();
@@ -473,7 +1019,9 @@ do {																		\
 	}
 	CASE_CODE(SET_UPVALUE) :
 	{
-		*frame->closure->upvalues[READ_SHORT()]->location = PEEK();
+		ObjUpvalue* upvalue = frame->closure->upvalues[READ_SHORT()];
+		*upvalue->location = PEEK();
+		solisWriteBarrier(vm, (Object*)upvalue, PEEK());
 		DISPATCH();
 	}
 	CASE_CODE(CLOSE_UPVALUE) :
@@ -494,6 +1042,14 @@ do {																		\
 
 		DISPATCH();
 	}
+	CASE_CODE(JUMP_IF_FALSE_POP) :
+	{
+		uint16_t offset = READ_SHORT();
+		if (solisIsFalsy(POP()))
+			ip += offset;
+
+		DISPATCH();
+	}
 	CASE_CODE(JUMP) :
 	{
 		uint16_t offset = READ_SHORT();
@@ -506,6 +1062,206 @@ do {																		\
 		ip -= offset;
 		DISPATCH();
 	}
+	CASE_CODE(RANGE_LOOP) :
+	{
+		// The counter and limit of a range for loop sit next to each other in the frame
+		Value* counter = &frame->slots[READ_SHORT()];
+		uint16_t offset = READ_SHORT();
+
+		if (!SOLIS_IS_NUMERIC(counter[0]) || !SOLIS_IS_NUMERIC(counter[1]))
+		{
+			STORE_FRAME();
+			solisVMRaiseError(vm, "Range bounds must be numbers\n");
+			return INTERPRET_RUNTIME_ERROR;
+		}
+
+		if (SOLIS_AS_NUMBER(counter[0]) < SOLIS_AS_NUMBER(counter[1]))
+			PUSH(counter[0]);
+		else
+			ip += offset;
+
+		DISPATCH();
+	}
+	CASE_CODE(RANGE_NEXT) :
+	{
+		Value* counter = &frame->slots[READ_SHORT()];
+		uint16_t offset = READ_SHORT();
+
+		*counter = SOLIS_NUMERIC_VALUE(SOLIS_AS_NUMBER(*counter) + 1);
+
+		ip -= offset;
+		DISPATCH();
+	}
+	CASE_CODE(FOR_ITER) :
+	{
+		// The sequence and iterator of a for loop sit next to each other in the frame
+		Value* seq = &frame->slots[READ_SHORT()];
+		uint16_t bodyOffset = READ_SHORT();
+		uint16_t exitOffset = READ_SHORT();
+		ObjString* name = SOLIS_AS_STRING(READ_CONSTANT_LONG());
+		InlineCache* cache = READ_CACHE();
+
+		if (SOLIS_IS_LIST(seq[0]))
+		{
+			ObjList* list = SOLIS_AS_LIST(seq[0]);
+
+			// The iterator is the index of the last element
+			int index = SOLIS_IS_NULL(seq[1]) ? 0 : (int)SOLIS_AS_NUMBER(seq[1]) + 1;
+
+			if (index >= list->values.count)
+			{
+				ip += exitOffset;
+				DISPATCH();
+			}
+
+			seq[1] = SOLIS_NUMERIC_VALUE((double)index);
+			PUSH(list->values.data[index]);
+
+			ip += bodyOffset;
+			DISPATCH();
+		}
+
+		if (SOLIS_IS_TYPED_ARRAY(seq[0]))
+		{
+			ObjTypedArray* array = SOLIS_AS_TYPED_ARRAY(seq[0]);
+
+			int index = SOLIS_IS_NULL(seq[1]) ? 0 : (int)SOLIS_AS_NUMBER(seq[1]) + 1;
+
+			if (index >= array->count)
+			{
+				ip += exitOffset;
+				DISPATCH();
+			}
+
+			seq[1] = SOLIS_NUMERIC_VALUE((double)index);
+			PUSH(SOLIS_NUMERIC_VALUE(solisTypedArrayGet(array, index)));
+
+			ip += bodyOffset;
+			DISPATCH();
+		}
+
+		if (SOLIS_IS_DICTIONARY(seq[0]))
+		{
+			ValueTable* table = &SOLIS_AS_DICTIONARY(seq[0])->table;
+
+			// The iterator is the slot of the last key, the loop variable is the key
+			int slot = SOLIS_IS_NULL(seq[1]) ? 0 : (int)SOLIS_AS_NUMBER(seq[1]) + 1;
+
+			while (slot < table->capacity && !solisValueTableOccupied(table, slot))
+				slot++;
+
+			if (slot >= table->capacity)
+			{
+				ip += exitOffset;
+				DISPATCH();
+			}
+
+			seq[1] = SOLIS_NUMERIC_VALUE((double)slot);
+			PUSH(table->entries[slot].key);
+
+			ip += bodyOffset;
+			DISPATCH();
+		}
+
+		ObjClass* klass = solisGetClassForValue(vm, seq[0]);
+
+		if (klass != NULL && klass == vm->rangeClass && SOLIS_IS_INSTANCE(seq[0]))
+		{
+			ObjInstance* range = SOLIS_AS_INSTANCE(seq[0]);
+
+			Value min = solisGetInstanceSlot(range, vm->rangeMinSlot);
+			Value max = solisGetInstanceSlot(range, vm->rangeMaxSlot);
+			Value step = solisGetInstanceSlot(range, vm->rangeStepSlot);
+
+			if (SOLIS_IS_NUMERIC(min) && SOLIS_IS_NUMERIC(max) && SOLIS_IS_NUMERIC(step))
+			{
+				// The iterator is the index of the step so it matches Range.iteratorValue
+				double index = SOLIS_IS_NULL(seq[1]) ? 0.0 : SOLIS_AS_NUMBER(seq[1]) + 1.0;
+				double value = SOLIS_AS_NUMBER(min) + index * SOLIS_AS_NUMBER(step);
+
+				double stepValue = SOLIS_AS_NUMBER(step);
+				bool inRange = stepValue > 0.0 ? value < SOLIS_AS_NUMBER(max) : (stepValue < 0.0 && value > SOLIS_AS_NUMBER(max));
+
+				if (!inRange)
+				{
+					ip += exitOffset;
+					DISPATCH();
+				}
+
+				seq[1] = SOLIS_NUMERIC_VALUE(index);
+				PUSH(SOLIS_NUMERIC_VALUE(value));
+
+				ip += bodyOffset;
+				DISPATCH();
+			}
+		}
+
+		if (klass != NULL && !SOLIS_IS_CLASS(seq[0]))
+		{
+			InlineCacheEntry* entry = findInlineCache(cache, klass, false);
+			Value method;
+
+			if (entry != NULL)
+			{
+				vm->inlineCacheStats.hits++;
+				method = entry->value;
+			}
+			else
+			{
+				vm->inlineCacheStats.misses++;
+
+				// Remember classes without next as well so they go straight to iterate
+				// A class defining iterate keeps using it even if it also has a next method
+				Value iterate;
+				if (!solisHashTableGet(&klass->methods, name, &method) || solisHashTableGet(&klass->methods, vm->iterateString, &iterate))
+					method = SOLIS_NULL_VALUE();
+
+				updateInlineCache(vm, frame->closure->function, cache, klass, false, CACHE_METHOD, 0, method);
+			}
+
+			if (!SOLIS_IS_NULL(method))
+			{
+				STORE_FRAME();
+
+				// Call next() on the iterator, the result is handled by OP_FOR_NEXT once it returns
+				PUSH(seq[0]);
+
+				if (!callMethod(vm, method, 0))
+				{
+					solisVMRaiseError(vm, "Can't invoke method '%s'\n", name->chars);
+					return INTERPRET_RUNTIME_ERROR;
+				}
+
+				LOAD_FRAME();
+				DISPATCH();
+			}
+		}
+
+		// Skip OP_FOR_NEXT and fall back to iterate and iteratorValue
+		ip += SOLIS_FOR_NEXT_LENGTH;
+		DISPATCH();
+	}
+	CASE_CODE(FOR_NEXT) :
+	{
+		// The sequence slot is only used by OP_FOR_ITER, the iterator keeps its own position
+		ip += 2;
+		uint16_t bodyOffset = READ_SHORT();
+		uint16_t exitOffset = READ_SHORT();
+
+		// The value returned by next is the loop variable unless it is StopIteration
+		Value result = PEEK();
+
+		if (SOLIS_IS_CLASS(result) && SOLIS_AS_CLASS(result) == vm->stopIterationClass)
+		{
+			DROP();
+			ip += exitOffset;
+			DISPATCH();
+		}
+
+		ip += bodyOffset;
+
+		DISPATCH();
+	}
 	CASE_CODE(CLOSURE) :
 	{
 		Value obj = READ_CONSTANT_LONG();
@@ -527,9 +1283,10 @@ do {																		\
 			{
 				closure->upvalues[i] = frame->closure->upvalues[index];
 			}
-		}
 
-		LOAD_FRAME();
+			// Capturing can collect so the closure may already be old
+			solisWriteBarrier(vm, (Object*)closure, SOLIS_OBJECT_VALUE(closure->upvalues[i]));
+		}
 
 		DISPATCH();
 	}
@@ -601,8 +1358,25 @@ do {																		\
 
 		ObjClass* subclass = SOLIS_AS_CLASS(PEEK());
 
-		solisHashTableCopy(&SOLIS_AS_CLASS(superclass)->methods, &subclass->methods);
-		solisHashTableCopy(&SOLIS_AS_CLASS(superclass)->fields, &subclass->fields);
+		ObjClass* super = SOLIS_AS_CLASS(superclass);
+
+		solisHashTableCopy(&super->methods, &subclass->methods);
+
+		// Give the subclass its own slot for each inherited field
+		for (int i = 0; i < super->fields.capacity; i++)
+		{
+			TableEntry* entry = &super->fields.entries[i];
+			if (entry->key != NULL)
+			{
+				int slot = (int)SOLIS_AS_NUMBER(entry->value);
+				solisDefineClassField(vm, subclass, entry->key, super->fieldDefaults.data[slot]);
+			}
+		}
+
+		subclass->version++;
+
+		// The copied methods could be young while the subclass was promoted partway through
+		solisRememberObject(vm, (Object*)subclass);
 
 		DROP();
 		DISPATCH();
@@ -614,7 +1388,12 @@ do {																		\
 		Value val = PEEK();
 		ObjClass* klass = SOLIS_AS_CLASS(solisPeek(vm, 1));
 
-		solisHashTableInsert(&klass->fields, name, val);
+		if (solisDefineClassField(vm, klass, name, val) == -1)
+		{
+			STORE_FRAME();
+			solisVMRaiseError(vm, "Cannot add field '%s' to a class that already has instances\n", name->chars);
+			return INTERPRET_RUNTIME_ERROR;
+		}
 
 		DROP();
 		DISPATCH();
@@ -628,6 +1407,9 @@ do {																		\
 		ObjClass* klass = SOLIS_AS_CLASS(solisPeek(vm, 1));
 
 		solisHashTableInsert(instruction == OP_DEFINE_METHOD ? &klass->methods : &klass->statics, name, val);
+		solisWriteBarrier(vm, (Object*)klass, SOLIS_OBJECT_VALUE(name));
+		solisWriteBarrier(vm, (Object*)klass, val);
+		klass->version++;
 
 		DROP();
 
@@ -643,6 +1425,7 @@ do {																		\
 		ObjClass* klass = SOLIS_AS_CLASS(solisPeek(vm, 1));
 
 		klass->constructor = SOLIS_AS_CLOSURE(val);
+		solisWriteBarrier(vm, (Object*)klass, val);
 
 		DROP();
 
@@ -651,25 +1434,101 @@ do {																		\
 	CASE_CODE(GET_FIELD) :
 	{
 		ObjString* name = SOLIS_AS_STRING(READ_CONSTANT_LONG());
+		InlineCache* cache = READ_CACHE();
+
+		Value receiver = PEEK();
+
+		// Vector components aren't fields, they are read straight out of the vector
+		if (SOLIS_IS_VECTOR(receiver))
+		{
+			int component = solisVectorComponentIndex(name->chars, name->length);
+
+			if (component >= 0 && component < SOLIS_AS_VECTOR(receiver)->size)
+			{
+				DROP();
+				PUSH(SOLIS_NUMERIC_VALUE(SOLIS_AS_VECTOR(receiver)->v[component]));
+
+				DISPATCH();
+			}
+		}
+
+		ObjClass* objectClass = solisGetClassForValue(vm, receiver);
+
+		bool isStatic = !SOLIS_IS_INSTANCE(receiver);
+
+		if (objectClass)
+		{
+			InlineCacheEntry* entry = findInlineCache(cache, objectClass, isStatic);
+
+			if (entry != NULL)
+			{
+				Value value;
+
+				switch (entry->kind)
+				{
+				case CACHE_FIELD:
+				{
+					value = solisGetInstanceSlot(SOLIS_AS_INSTANCE(receiver), entry->slot);
+					break;
+				}
+				case CACHE_STATIC:
+				{
+					Value* staticValue = solisHashTableSlotValue(&objectClass->statics, entry->slot, name);
+
+					if (staticValue == NULL)
+						goto getFieldMiss;
+
+					value = *staticValue;
+					break;
+				}
+				case CACHE_METHOD:
+				{
+					ObjBoundMethod* bound = NULL;
+
+					if (SOLIS_IS_CLOSURE(entry->value))
+						bound = solisNewBoundMethod(vm, receiver, SOLIS_AS_CLOSURE(entry->value));
+					else
+						bound = solisNewNativeBoundMethod(vm, receiver, SOLIS_AS_NATIVE(entry->value));
+
+					value = SOLIS_OBJECT_VALUE(bound);
+					break;
+				}
+				}
+
+				vm->inlineCacheStats.hits++;
+
+				DROP();
+				PUSH(value);
+
+				DISPATCH();
+			}
+
+		getFieldMiss:
+			vm->inlineCacheStats.misses++;
+		}
 
 		// TODO: This could be improved
 		// Maybe an invoke? 
 
-		ObjClass* objectClass = solisGetClassForValue(vm, PEEK());
-
-		if (objectClass && !SOLIS_IS_INSTANCE(PEEK()))
+		if (objectClass && isStatic)
 		{
 			Value value;
-			if (solisHashTableGet(&objectClass->statics, name, &value))
+			int staticSlot = solisHashTableFindSlot(&objectClass->statics, name);
+
+			if (staticSlot != -1)
 			{
+				updateInlineCache(vm, frame->closure->function, cache, objectClass, true, CACHE_STATIC, staticSlot, SOLIS_NULL_VALUE());
+
 				DROP();
-				PUSH(value);
+				PUSH(*solisHashTableSlotValue(&objectClass->statics, staticSlot, name));
 
 				DISPATCH();
 			}
 
 			if (solisHashTableGet(&objectClass->methods, name, &value))
 			{
+				updateInlineCache(vm, frame->closure->function, cache, objectClass, true, CACHE_METHOD, 0, value);
+
 				ObjBoundMethod* bound = NULL;
 
 				if (SOLIS_IS_CLOSURE(value))
@@ -685,14 +1544,22 @@ do {																		\
 
 			}
 
-			solisVMRaiseError(vm, "Can't get field from class: '%s'\n", name);
+			STORE_FRAME();
+			solisVMRaiseError(vm, "Can't get field from class: '%s'\n", name->chars);
 			return INTERPRET_RUNTIME_ERROR;
 			
 		}
 		else 
 		{
+			if (!SOLIS_IS_OBJECT(receiver))
+			{
+				STORE_FRAME();
+				solisVMRaiseError(vm, "Object does not have fields\n");
+				return INTERPRET_RUNTIME_ERROR;
+			}
+
 			// TODO: Maybe remake Enum as a class With static fields 
-			Object* object = SOLIS_AS_OBJECT(PEEK());
+			Object* object = SOLIS_AS_OBJECT(receiver);
 			switch (object->type)
 			{
 			case OBJ_ENUM:
@@ -701,6 +1568,7 @@ do {																		\
 				Value val;
 				if (!solisHashTableGet(&enumObj->fields, name, &val))
 				{
+					STORE_FRAME();
 					solisVMRaiseError( vm, "Failed to get field from enum\n");
 					return INTERPRET_RUNTIME_ERROR;
 				}
@@ -715,173 +1583,627 @@ do {																		\
 			{
 				ObjInstance* instance = (ObjInstance*)object;
 
-				Value value;
-				if (solisHashTableGet(&instance->fields, name, &value))
-				{
-					DROP();
-					PUSH(value);
-				}
-				else if (solisHashTableGet(&instance->klass->methods, name, &value))
-				{
-					ObjBoundMethod* bound = NULL;
-					
-					if (SOLIS_IS_CLOSURE(value))
-						bound = solisNewBoundMethod(vm, SOLIS_OBJECT_VALUE(instance), SOLIS_AS_CLOSURE(value));
-					else 
-						bound = solisNewNativeBoundMethod(vm, SOLIS_OBJECT_VALUE(instance), SOLIS_AS_NATIVE(value));
+				Value value;
+				int slot = solisGetFieldSlot(instance->klass, name);
+
+				if (slot != -1)
+				{
+					updateInlineCache(vm, frame->closure->function, cache, instance->klass, false, CACHE_FIELD, slot, SOLIS_NULL_VALUE());
+
+					DROP();
+					PUSH(solisGetInstanceSlot(instance, slot));
+				}
+				else if (solisHashTableGet(&instance->klass->methods, name, &value))
+				{
+					updateInlineCache(vm, frame->closure->function, cache, instance->klass, false, CACHE_METHOD, 0, value);
+
+					ObjBoundMethod* bound = NULL;
+					
+					if (SOLIS_IS_CLOSURE(value))
+						bound = solisNewBoundMethod(vm, SOLIS_OBJECT_VALUE(instance), SOLIS_AS_CLOSURE(value));
+					else 
+						bound = solisNewNativeBoundMethod(vm, SOLIS_OBJECT_VALUE(instance), SOLIS_AS_NATIVE(value));
+
+					DROP();
+					PUSH(SOLIS_OBJECT_VALUE(bound));
+				}
+				else if ((slot = solisHashTableFindSlot(&instance->klass->statics, name)) != -1)
+				{
+					value = *solisHashTableSlotValue(&instance->klass->statics, slot, name);
+
+					updateInlineCache(vm, frame->closure->function, cache, instance->klass, false, CACHE_STATIC, slot, SOLIS_NULL_VALUE());
+
+					DROP();
+					PUSH(value);
+				}
+				else
+				{
+					STORE_FRAME();
+					solisVMRaiseError(vm, "Can't get field from instance.\n");
+					return INTERPRET_RUNTIME_ERROR;
+				}
+
+				break;
+			}
+			default:
+				// Return an error
+				// We can't access the fields
+				STORE_FRAME();
+				solisVMRaiseError(vm, "Object does not have fields\n");
+				return INTERPRET_RUNTIME_ERROR;
+				break;
+			}
+		}
+
+
+
+		DISPATCH();
+	}
+	CASE_CODE(SET_FIELD) : 
+	{
+		ObjString* name = SOLIS_AS_STRING(READ_CONSTANT_LONG());
+		InlineCache* cache = READ_CACHE();
+
+
+		if (SOLIS_IS_OBJECT(solisPeek(vm, 1)))
+		{
+			Object* object = SOLIS_AS_OBJECT(solisPeek(vm, 1));
+			switch (object->type)
+			{
+			case OBJ_INSTANCE:
+			{
+				ObjInstance* instance = (ObjInstance*)object;
+
+				InlineCacheEntry* entry = findInlineCache(cache, instance->klass, false);
+
+				if (entry != NULL)
+				{
+					if (entry->kind == CACHE_FIELD && entry->slot < instance->fieldCount)
+					{
+						vm->inlineCacheStats.hits++;
+
+						instance->fields[entry->slot] = POP();
+						solisWriteBarrier(vm, object, instance->fields[entry->slot]);
+						DROP();
+						PUSH(instance->fields[entry->slot]);
+
+						break;
+					}
+
+					// The static is written where the cache last found it, unless the table has moved it since
+					Value* staticValue = entry->kind == CACHE_STATIC ? solisHashTableSlotValue(&instance->klass->statics, entry->slot, name) : NULL;
+
+					if (staticValue != NULL)
+					{
+						vm->inlineCacheStats.hits++;
+
+						*staticValue = PEEK();
+						solisWriteBarrier(vm, (Object*)instance->klass, PEEK());
+
+						Value value = POP();
+						DROP();
+						PUSH(value);
+
+						break;
+					}
+				}
+
+				vm->inlineCacheStats.misses++;
+
+				int slot = solisGetFieldSlot(instance->klass, name);
+
+				if (slot != -1 && slot < instance->fieldCount)
+				{
+					instance->fields[slot] = PEEK();
+					solisWriteBarrier(vm, object, PEEK());
+					updateInlineCache(vm, frame->closure->function, cache, instance->klass, false, CACHE_FIELD, slot, SOLIS_NULL_VALUE());
+				}
+				else
+				{
+					int staticSlot = slot == -1 ? solisHashTableFindSlot(&instance->klass->statics, name) : -1;
+
+					if (staticSlot == -1)
+					{
+						STORE_FRAME();
+						solisVMRaiseError(vm, "Cannot set field that does not exist in class\n");
+						return INTERPRET_RUNTIME_ERROR;
+					}
+
+					*solisHashTableSlotValue(&instance->klass->statics, staticSlot, name) = PEEK();
+					solisWriteBarrier(vm, (Object*)instance->klass, PEEK());
+
+					updateInlineCache(vm, frame->closure->function, cache, instance->klass, false, CACHE_STATIC, staticSlot, SOLIS_NULL_VALUE());
+				}
+
+				Value value = POP();
+				DROP();
+				PUSH(value);
+
+				break;
+			}
+			case OBJ_CLASS:
+			{
+				ObjClass* klass = (ObjClass*)object;
+
+				Value* staticValue = solisHashTableSlotValue(&klass->statics, solisHashTableFindSlot(&klass->statics, name), name);
+
+				if (staticValue == NULL)
+				{
+					STORE_FRAME();
+					solisVMRaiseError(vm, "Can't set a static field that doesn't exist in class\n");
+					return INTERPRET_RUNTIME_ERROR;
+				}
+
+				*staticValue = PEEK();
+				solisWriteBarrier(vm, object, PEEK());
+
+				Value value = POP();
+				DROP();
+				PUSH(value);
+
+				break;
+			}
+			default:
+				// Return an error
+				// We can't access the fields
+				STORE_FRAME();
+				solisVMRaiseError(vm, "Can't get field\n");
+				return INTERPRET_RUNTIME_ERROR;
+				break;
+			}
+		}
+
+		DISPATCH();
+	}
+	CASE_CODE(INVOKE) :
+	{
+		ObjString* method = SOLIS_AS_STRING(READ_CONSTANT_LONG());
+		int argCount = READ_BYTE();
+		InlineCache* cache = READ_CACHE();
+
+		STORE_FRAME();
+
+		if (!invoke(vm, frame->closure->function, cache, method, argCount))
+		{
+			solisVMRaiseError(vm, "Can't invoke method '%s'\n", method->chars);
+			return INTERPRET_RUNTIME_ERROR;
+		}
+
+		LOAD_FRAME();
+		DISPATCH();
+	}
+	CASE_CODE(RETURN) :
+	{
+		Value result = POP();
+		closeUpvalues(vm, frame->slots);
+		vm->frameCount--;
+
+		if (vm->frameCount == baseFrame)
+		{
+			if (baseFrame == 0)
+			{
+				DROP();
+				return INTERPRET_ALL_GOOD;
+			}
+
+			// Leave the result where the callee was like any other call
+			vm->sp = frame->slots;
+			PUSH(result);
+			return INTERPRET_ALL_GOOD;
+		}
+
+		vm->sp = frame->slots;
+		PUSH(result);
+
+		LOAD_FRAME();
+
+		DISPATCH();
+	}
+	}
+
+
+
+	return INTERPRET_ALL_GOOD;
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef INTERPRET_LOOP
+#undef CASE_CODE
+#undef DISPATCH
+#undef READ_CONSTANT
+#undef READ_CONSTANT_LONG
+#undef READ_CACHE
+}
+
+// Calls the operator of a class for register operands, the stack above the registers is used to pass them
+static bool callRegisterOperator(VM* vm, Value* result, Value a, Value b, int op)
+{
+	*vm->sp++ = a;
+	*vm->sp++ = b;
+
+	if (!callBinaryOperator(vm, op))
+		return false;
+
+	*result = *(--vm->sp);
+	return true;
+}
+
+// Executes register chunks until the frame at baseFrame returns
+// Calls between register functions stay within this loop, anything else goes through callValue
+static InterpretResult runRegister(VM* vm, int baseFrame)
+{
+	CallFrame* frame = &vm->frames[vm->frameCount - 1];
+
+	uint8_t* ip = frame->ip;
+	Value* regs = frame->slots;
+	ObjFunction* function = frame->closure->function;
+	Value* constants = function->chunk.constants.data;
+
+	Value* globals = vm->currentModule->globals.data;
+
+#define LOAD_REGISTER_FRAME()							\
+	frame = &vm->frames[vm->frameCount - 1];			\
+	ip = frame->ip;										\
+	regs = frame->slots;								\
+	function = frame->closure->function;				\
+	constants = function->chunk.constants.data;			\
+	vm->sp = regs + function->registerCount
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip+=2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+
+#if SOLIS_COMPUTED_GOTO
+
+	static void* dispatchTable[] = {
+#define OPCODE(name) &&register_##name,
+#include "solis_register_opcode.h"
+#undef OPCODE
+	};
+
+#define INTERPRET_LOOP DISPATCH();
+#define CASE_CODE(name) register_##name
+#define DISPATCH() goto *dispatchTable[READ_BYTE()]
+
+#else 
+
+#define INTERPRET_LOOP							\
+	register_loop:								\
+		switch(READ_BYTE())						\
+
+#define CASE_CODE(name) case ROP_##name
+#define DISPATCH() goto register_loop
+
+#endif
+
+#define REGISTER_BINARY_OP(operator, expr)									\
+	{																		\
+		uint8_t a = READ_BYTE();											\
+		Value left = regs[READ_BYTE()];										\
+		Value right = regs[READ_BYTE()];									\
+		if (SOLIS_IS_NUMERIC(left) && SOLIS_IS_NUMERIC(right))				\
+		{																	\
+			double x = SOLIS_AS_NUMBER(left);								\
+			double y = SOLIS_AS_NUMBER(right);								\
+			regs[a] = SOLIS_NUMERIC_VALUE(expr);							\
+			DISPATCH();														\
+		}																	\
+		STORE_FRAME();														\
+		if (!callRegisterOperator(vm, &regs[a], left, right, operator))		\
+			return INTERPRET_RUNTIME_ERROR;									\
+		DISPATCH();															\
+	}
+
+#define REGISTER_COMPARISON(expr)											\
+	{																		\
+		uint8_t a = READ_BYTE();											\
+		Value left = regs[READ_BYTE()];										\
+		Value right = regs[READ_BYTE()];									\
+		if (!SOLIS_IS_NUMERIC(left) || !SOLIS_IS_NUMERIC(right))			\
+		{																	\
+			STORE_FRAME();													\
+			solisVMRaiseError(vm, "Operands must be numbers\n");			\
+			return INTERPRET_RUNTIME_ERROR;									\
+		}																	\
+		double x = SOLIS_AS_NUMBER(left);									\
+		double y = SOLIS_AS_NUMBER(right);									\
+		regs[a] = SOLIS_BOOL_VALUE(expr);									\
+		DISPATCH();															\
+	}
+
+	// Jumps when the comparison is false
+#define REGISTER_COMPARE_JUMP(expr)											\
+	{																		\
+		Value left = regs[READ_BYTE()];										\
+		Value right = regs[READ_BYTE()];									\
+		uint16_t offset = READ_SHORT();										\
+		if (!SOLIS_IS_NUMERIC(left) || !SOLIS_IS_NUMERIC(right))			\
+		{																	\
+			STORE_FRAME();													\
+			solisVMRaiseError(vm, "Operands must be numbers\n");			\
+			return INTERPRET_RUNTIME_ERROR;									\
+		}																	\
+		double x = SOLIS_AS_NUMBER(left);									\
+		double y = SOLIS_AS_NUMBER(right);									\
+		if (!(expr))														\
+			ip += offset;													\
+		DISPATCH();															\
+	}
+
+	INTERPRET_LOOP
+	{
+	CASE_CODE(MOVE) :
+	{
+		uint8_t a = READ_BYTE();
+		regs[a] = regs[READ_BYTE()];
+		DISPATCH();
+	}
+	CASE_CODE(LOAD_CONSTANT) :
+	{
+		uint8_t a = READ_BYTE();
+		regs[a] = constants[READ_SHORT()];
+		DISPATCH();
+	}
+	CASE_CODE(LOAD_NULL) :
+		regs[READ_BYTE()] = SOLIS_NULL_VALUE();
+		DISPATCH();
+	CASE_CODE(LOAD_TRUE) :
+		regs[READ_BYTE()] = SOLIS_BOOL_VALUE(true);
+		DISPATCH();
+	CASE_CODE(LOAD_FALSE) :
+		regs[READ_BYTE()] = SOLIS_BOOL_VALUE(false);
+		DISPATCH();
+	CASE_CODE(GET_GLOBAL) :
+	{
+		uint8_t a = READ_BYTE();
+		regs[a] = globals[READ_SHORT()];
+		DISPATCH();
+	}
+	CASE_CODE(SET_GLOBAL) :
+	{
+		uint8_t a = READ_BYTE();
+		globals[READ_SHORT()] = regs[a];
+		DISPATCH();
+	}
+	CASE_CODE(ADD) :
+		REGISTER_BINARY_OP(OPERATOR_ADD, x + y);
+	CASE_CODE(SUBTRACT) :
+		REGISTER_BINARY_OP(OPERATOR_MINUS, x - y);
+	CASE_CODE(MULTIPLY) :
+		REGISTER_BINARY_OP(OPERATOR_STAR, x * y);
+	CASE_CODE(DIVIDE) :
+		REGISTER_BINARY_OP(OPERATOR_SLASH, x / y);
+	CASE_CODE(FLOOR_DIVIDE) :
+		REGISTER_BINARY_OP(OPERATOR_SLASH_SLASH, floor(x / y));
+	CASE_CODE(POWER) :
+		REGISTER_BINARY_OP(OPERATOR_POWER, pow(x, y));
+	CASE_CODE(ADD_CONSTANT) :
+	CASE_CODE(SUBTRACT_CONSTANT) :
+	{
+		bool add = ip[-1] == ROP_ADD_CONSTANT;
+
+		uint8_t a = READ_BYTE();
+		Value left = regs[READ_BYTE()];
+		Value right = constants[READ_SHORT()];
 
-					DROP();
-					PUSH(SOLIS_OBJECT_VALUE(bound));
-				}
-				else if (solisHashTableGet(&instance->klass->statics, name, &value))
-				{
-					DROP();
-					PUSH(value);
-				}
-				else
-				{
-					solisVMRaiseError(vm, "Can't get field from instance.\n");
-					return INTERPRET_RUNTIME_ERROR;
-				}
+		if (SOLIS_IS_NUMERIC(left) && SOLIS_IS_NUMERIC(right))
+		{
+			double x = SOLIS_AS_NUMBER(left);
+			double y = SOLIS_AS_NUMBER(right);
 
-				break;
-			}
-			default:
-				// Return an error
-				// We can't access the fields
-				solisVMRaiseError(vm, "Object does not have fields\n");
-				return INTERPRET_RUNTIME_ERROR;
-				break;
-			}
+			regs[a] = SOLIS_NUMERIC_VALUE(add ? x + y : x - y);
+			DISPATCH();
 		}
 
+		STORE_FRAME();
 
+		if (!callRegisterOperator(vm, &regs[a], left, right, add ? OPERATOR_ADD : OPERATOR_MINUS))
+			return INTERPRET_RUNTIME_ERROR;
 
 		DISPATCH();
 	}
-	CASE_CODE(SET_FIELD) : 
+	CASE_CODE(EQUAL) :
+	CASE_CODE(NOT_EQUAL) :
 	{
-		ObjString* name = SOLIS_AS_STRING(READ_CONSTANT_LONG());
+		bool equal = ip[-1] == ROP_EQUAL;
 
+		uint8_t a = READ_BYTE();
+		Value left = regs[READ_BYTE()];
+		Value right = regs[READ_BYTE()];
 
-		if (SOLIS_IS_OBJECT(solisPeek(vm, 1)))
+		regs[a] = SOLIS_BOOL_VALUE(solisValuesEqual(left, right) == equal);
+		DISPATCH();
+	}
+	// <= and >= negate the opposite comparison so NaN behaves like the stack bytecode
+	CASE_CODE(LESS) :
+		REGISTER_COMPARISON(x < y);
+	CASE_CODE(LESS_EQUAL) :
+		REGISTER_COMPARISON(!(x > y));
+	CASE_CODE(GREATER) :
+		REGISTER_COMPARISON(x > y);
+	CASE_CODE(GREATER_EQUAL) :
+		REGISTER_COMPARISON(!(x < y));
+	CASE_CODE(NEGATE) :
+	{
+		uint8_t a = READ_BYTE();
+		Value value = regs[READ_BYTE()];
+
+		if (!SOLIS_IS_NUMERIC(value))
 		{
-			Object* object = SOLIS_AS_OBJECT(solisPeek(vm, 1));
-			switch (object->type)
-			{
-			case OBJ_INSTANCE:
+			STORE_FRAME();
+
+			Value result;
+			if (!solisVectorNegate(vm, value, &result))
 			{
-				ObjInstance* instance = (ObjInstance*)object;
+				solisVMRaiseError(vm, "Negate error\n");
+				return INTERPRET_RUNTIME_ERROR;
+			}
 
-				// This is a really bad way of doing it... lol 
-				int error = 0;
-				if (solisHashTableInsert(&instance->fields, name, PEEK()))
-				{
-					// Delete it from the hash table
-					solisHashTableDelete(&instance->fields, name);
-					error++;
-				}
+			regs[a] = result;
+			DISPATCH();
+		}
 
-				if (solisHashTableInsert(&instance->klass->statics, name, PEEK()))
-				{
-					solisHashTableDelete(&instance->klass->statics, name);
-					error++;
-				}
-				
+		regs[a] = SOLIS_NUMERIC_VALUE(-SOLIS_AS_NUMBER(value));
+		DISPATCH();
+	}
+	CASE_CODE(NOT) :
+	{
+		uint8_t a = READ_BYTE();
+		regs[a] = SOLIS_BOOL_VALUE(solisIsFalsy(regs[READ_BYTE()]));
+		DISPATCH();
+	}
+	CASE_CODE(JUMP) :
+	{
+		uint16_t offset = READ_SHORT();
+		ip += offset;
+		DISPATCH();
+	}
+	CASE_CODE(LOOP) :
+	{
+		uint16_t offset = READ_SHORT();
+		ip -= offset;
+		DISPATCH();
+	}
+	CASE_CODE(JUMP_IF_FALSE) :
+	{
+		Value condition = regs[READ_BYTE()];
+		uint16_t offset = READ_SHORT();
 
-				if (error == 2)
-				{
-					solisVMRaiseError(vm, "Cannot set field that does not exist in class\n");
-					return INTERPRET_RUNTIME_ERROR;
-				}
+		if (solisIsFalsy(condition))
+			ip += offset;
 
-				Value value = POP();
-				DROP();
-				PUSH(value);
+		DISPATCH();
+	}
+	CASE_CODE(JUMP_IF_TRUE) :
+	{
+		Value condition = regs[READ_BYTE()];
+		uint16_t offset = READ_SHORT();
 
-				break;
-			}
-			case OBJ_CLASS:
-			{
-				ObjClass* klass = (ObjClass*)object;
+		if (!solisIsFalsy(condition))
+			ip += offset;
 
-				if (solisHashTableInsert(&klass->statics, name, PEEK()))
-				{
-					// Delete it from the hash table
-					solisHashTableDelete(&klass->statics, name);
+		DISPATCH();
+	}
+	CASE_CODE(JUMP_IF_NOT_LESS) :
+		REGISTER_COMPARE_JUMP(x < y);
+	CASE_CODE(JUMP_IF_NOT_LESS_EQUAL) :
+		REGISTER_COMPARE_JUMP(!(x > y));
+	CASE_CODE(JUMP_IF_NOT_GREATER) :
+		REGISTER_COMPARE_JUMP(x > y);
+	CASE_CODE(JUMP_IF_NOT_GREATER_EQUAL) :
+		REGISTER_COMPARE_JUMP(!(x < y));
+	CASE_CODE(CALL) :
+	{
+		uint8_t a = READ_BYTE();
+		int argCount = READ_BYTE();
+		Value callee = regs[a];
 
-					solisVMRaiseError(vm, "Can't set a static field that doesn't exist in class\n");
-					return INTERPRET_RUNTIME_ERROR;
-				}
+		STORE_FRAME();
 
-				Value value = POP();
-				DROP();
-				PUSH(value);
+		if (SOLIS_IS_CLOSURE(callee) && SOLIS_AS_CLOSURE(callee)->function->registerChunk.count > 0)
+		{
+			ObjClosure* target = SOLIS_AS_CLOSURE(callee);
 
-				break;
-			}
-			default:
-				// Return an error
-				// We can't access the fields
-				solisVMRaiseError(vm, "Can't get field\n");
+			if (argCount != target->function->arity)
+			{
+				solisVMRaiseError(vm, "Failed to call function\n");
 				return INTERPRET_RUNTIME_ERROR;
-				break;
 			}
+
+			pushRegisterFrame(vm, target, &regs[a]);
+
+			LOAD_REGISTER_FRAME();
+			DISPATCH();
 		}
 
-		DISPATCH();
-	}
-	CASE_CODE(INVOKE) :
-	{
-		STORE_FRAME();
+		// Everything else expects its arguments on top of the stack
+		vm->sp = &regs[a + argCount + 1];
 
-		ObjString* method = SOLIS_AS_STRING(READ_CONSTANT_LONG());
-		int argCount = READ_BYTE();
+		int frameCount = vm->frameCount;
 
-		if (!invoke(vm, method, argCount))
+		if (!callValue(vm, callee, argCount))
 		{
-			solisVMRaiseError(vm, "Can't invoke method '%s'\n", method->chars);
+			solisVMRaiseError(vm, "Failed to call function\n");
 			return INTERPRET_RUNTIME_ERROR;
 		}
 
-		LOAD_FRAME();
+		// A stack function was pushed, run it until it returns back to us
+		if (vm->frameCount > frameCount && run(vm, frameCount) != INTERPRET_ALL_GOOD)
+			return INTERPRET_RUNTIME_ERROR;
+
+		// The result is left where the callee was
+		// The frames may have been reallocated by the call
+		LOAD_REGISTER_FRAME();
 		DISPATCH();
 	}
 	CASE_CODE(RETURN) :
+	CASE_CODE(RETURN_NULL) :
 	{
-		Value result = POP();
-		closeUpvalues(vm, frame->slots);
+		Value result = ip[-1] == ROP_RETURN ? regs[READ_BYTE()] : SOLIS_NULL_VALUE();
+
 		vm->frameCount--;
 
-		if (vm->frameCount == 0)
+		if (vm->frameCount == baseFrame)
 		{
-			DROP();
+			vm->sp = regs;
+			*vm->sp++ = result;
 			return INTERPRET_ALL_GOOD;
 		}
 
-		vm->sp = frame->slots;
-		PUSH(result);
-
-		LOAD_FRAME();
+		// Only register frames are pushed from within this loop so the caller is one too
+		regs[0] = result;
 
+		LOAD_REGISTER_FRAME();
 		DISPATCH();
 	}
 	}
 
-
-
 	return INTERPRET_ALL_GOOD;
 
+#undef REGISTER_BINARY_OP
+#undef REGISTER_COMPARISON
+#undef REGISTER_COMPARE_JUMP
+#undef LOAD_REGISTER_FRAME
 #undef READ_BYTE
 #undef READ_SHORT
 #undef INTERPRET_LOOP
 #undef CASE_CODE
 #undef DISPATCH
-#undef READ_CONSTANT
-#undef READ_CONSTANT_LONG
 }
 
 
+static inline CallFrame* pushFrame(VM* vm)
+{
+	// Grow our frames
+	if (vm->frameCount + 1 >= vm->frameCapacity)
+	{
+		int oldCapacity = vm->frameCapacity * sizeof(CallFrame);
+		vm->frameCapacity = GROW_CAPACITY(vm->frameCapacity);
+
+		vm->frames = (CallFrame*)solisReallocate(vm, vm->frames, oldCapacity, vm->frameCapacity * sizeof(CallFrame));
+	}
+
+	return &vm->frames[vm->frameCount++];
+}
+
+// The callee and its arguments are already in place at slots
+static CallFrame* pushRegisterFrame(VM* vm, ObjClosure* closure, Value* slots)
+{
+	ObjFunction* function = closure->function;
+
+	CallFrame* frame = pushFrame(vm);
+	frame->closure = closure;
+	frame->ip = function->registerChunk.code;
+	frame->slots = slots;
+
+	// Clear the registers past the arguments so the GC doesn't keep stale values alive
+	for (Value* slot = slots + function->arity + 1; slot < slots + function->registerCount; slot++)
+		*slot = SOLIS_NULL_VALUE();
+
+	vm->sp = slots + function->registerCount;
+
+	return frame;
+}
+
 static inline bool callClosure(VM* vm, ObjClosure* closure, int argCount)
 {
 	if (argCount != closure->function->arity)
@@ -890,16 +2212,40 @@ static inline bool callClosure(VM* vm, ObjClosure* closure, int argCount)
 		return false;
 	}
 
-	// Grow our frames
-	if (vm->frameCount + 1 >= vm->frameCapacity)
+	ObjFunction* function = closure->function;
+
+	// The top level script is only ever run once so it isn't worth compiling
+	if (vm->jitEnabled && function->jitCode == NULL && !function->jitFailed && function->name != NULL
+		&& ++function->callCount >= vm->jitThreshold)
 	{
-		int oldCapacity = vm->frameCapacity * sizeof(CallFrame);
-		vm->frameCapacity = GROW_CAPACITY(vm->frameCapacity);
+		solisJitCompile(vm, function);
+	}
 
-		vm->frames = (CallFrame*)solisReallocate(vm, vm->frames, oldCapacity, vm->frameCapacity * sizeof(CallFrame));
+	// Compiled functions run to completion like a native
+	if (function->jitCode != NULL)
+	{
+		CallFrame* frame = pushFrame(vm);
+		frame->closure = closure;
+		frame->ip = function->chunk.code;
+		frame->slots = vm->sp - argCount - 1;
+
+		if (!((SolisJitFunction)function->jitCode)(vm, frame->slots))
+			return false;
+
+		vm->frameCount--;
+		return true;
 	}
 
-	CallFrame* frame = &vm->frames[vm->frameCount++];
+	// Functions compiled for register mode run to completion here and leave their result like a native would
+	if (closure->function->registerChunk.count > 0)
+	{
+		int baseFrame = vm->frameCount;
+		pushRegisterFrame(vm, closure, vm->sp - argCount - 1);
+
+		return runRegister(vm, baseFrame) == INTERPRET_ALL_GOOD;
+	}
+
+	CallFrame* frame = pushFrame(vm);
 	frame->closure = closure;
 	frame->ip = closure->function->chunk.code;
 	frame->slots = vm->sp - argCount - 1;
@@ -941,6 +2287,11 @@ static bool callValue(VM* vm, Value callee, int argCount)
 	case OBJ_CLASS:
 	{
 		ObjClass* klass = (ObjClass*)obj;
+
+		// Native types make their own object, the class is left as self
+		if (klass->nativeConstructor)
+			return callNativeFunction(vm, klass->nativeConstructor, argCount);
+
 		vm->sp[-argCount - 1] = SOLIS_OBJECT_VALUE(solisNewInstance(vm, klass));
 
 		// Call the constructor if we have one 
@@ -991,6 +2342,24 @@ static bool callOperator(VM* vm, int op, int numArgs)
 	return true;
 }
 
+// Runs the script closure of the current module
+static InterpretResult runModule(VM* vm, const char* source, const char* sourceName)
+{
+	vm->moduleName = sourceName;
+	vm->source = source;
+
+	ObjClosure* closure = vm->currentModule->closure;
+
+	solisPush(vm, SOLIS_OBJECT_VALUE(closure));
+	vm->errorRaised = false;
+
+	callClosure(vm, closure, 0);
+	
+	InterpretResult result = run(vm, 0);
+
+	return result;
+}
+
 InterpretResult solisInterpret(VM* vm, const char* source, const char* sourceName)
 {
 	//solisFreeChunk(vm->currentModule->)
@@ -1003,18 +2372,44 @@ InterpretResult solisInterpret(VM* vm, const char* source, const char* sourceNam
 	}
 
 	// solisDisassembleChunk(&function->chunk, "Script");
-	
-	vm->moduleName = sourceName;
-	vm->source = source;
 
-	ObjClosure* closure = vm->currentModule->closure;
+	return runModule(vm, source, sourceName);
+}
 
-	solisPush(vm, SOLIS_OBJECT_VALUE(closure));
-	callClosure(vm, closure, 0);
-	
-	InterpretResult result = run(vm);
+InterpretResult solisInterpretCached(VM* vm, const char* source, const char* sourceName, const char* cachePath)
+{
+	uint64_t hash = solisHashSource(source);
 
-	return result;
+	if (solisReadBytecodeFile(vm, vm->currentModule, cachePath, true, hash))
+		return runModule(vm, source, sourceName);
+
+	int globalBase = vm->currentModule->globals.count;
+
+	if (!solisCompile(vm, source, vm->currentModule, sourceName))
+		return INTERPRET_COMPILE_ERROR;
+
+	// A cache that can't be written just means the next run compiles again
+	solisWriteBytecodeFile(vm, vm->currentModule, globalBase, hash, cachePath);
+
+	return runModule(vm, source, sourceName);
+}
+
+InterpretResult solisInterpretBytecode(VM* vm, const char* path, const char* sourceName)
+{
+	if (!solisReadBytecodeFile(vm, vm->currentModule, path, false, 0))
+		return INTERPRET_COMPILE_ERROR;
+
+	return runModule(vm, NULL, sourceName);
+}
+
+bool solisCompileToBytecode(VM* vm, const char* source, const char* sourceName, const char* path)
+{
+	int globalBase = vm->currentModule->globals.count;
+
+	if (!solisCompile(vm, source, vm->currentModule, sourceName))
+		return false;
+
+	return solisWriteBytecodeFile(vm, vm->currentModule, globalBase, solisHashSource(source), path);
 }
 
 
@@ -1046,11 +2441,20 @@ InterpretResult solisCallFunction(VM* vm, Value function, Value* args, int argCo
 	for (int i = 0; i < argCount; i++)
 		solisPush(vm, args[i]);
 
-	callClosure(vm, closure, argCount);
+	vm->errorRaised = false;
+
+	int frameCount = vm->frameCount;
+
+	if (!callClosure(vm, closure, argCount))
+		return INTERPRET_RUNTIME_ERROR;
+
+	// Register functions have already run to completion inside callClosure
+	if (vm->frameCount == frameCount)
+		return INTERPRET_ALL_GOOD;
 
 	// TODO: Check if its running
 
-	return run(vm);
+	return run(vm, 0);
 
 }
 
@@ -1079,6 +2483,8 @@ InterpretResult solisCallInstanceMethod(VM* vm, Value instance, const char* meth
 
 void solisPushGlobal(VM* vm, const char* name, Value value)
 {
+	// The value may only be held by the caller so keep it alive while the name is allocated
+	solisPush(vm, value);
 
 	ObjString* str = solisCopyString(vm, name, strlen(name));
 
@@ -1107,6 +2513,7 @@ void solisPushGlobal(VM* vm, const char* name, Value value)
 	}
 
 	solisPop(vm);
+	solisPop(vm);
 }
 
 Value solisGetGlobal(VM* vm, const char* name)
@@ -1144,6 +2551,17 @@ void solisPushGlobalCFunction(VM* vm, const char* name, SolisNativeSignature fun
 	solisPop(vm);
 }
 
+SolisInlineCacheStats solisGetInlineCacheStats(VM* vm)
+{
+	return vm->inlineCacheStats;
+}
+
+void solisResetInlineCacheStats(VM* vm)
+{
+	vm->inlineCacheStats.hits = 0;
+	vm->inlineCacheStats.misses = 0;
+}
+
 void solisDumpGlobals(VM* vm)
 {
 	for (int i = 0; i < vm->currentModule->globals.count; i++)
@@ -1207,15 +2625,27 @@ static void printSourceLineVm( const char* source, int line)
 
 void solisVMRaiseError(VM* vm, const char* message, ...)
 {
-	CallFrame* currentFrame = &vm->frames[vm->frameCount - 1];
+	// Only report the first error, callers further up unwinding from it would just repeat it
+	if (vm->errorRaised)
+		return;
 
-	vm->currentInstruction = (int)(currentFrame->ip - currentFrame->closure->function->chunk.code);
+	CallFrame* currentFrame = &vm->frames[vm->frameCount - 1];
 
-	int instOffset = vm->currentInstruction;
 	Chunk* chunk = &currentFrame->closure->function->chunk;
 
+	// Register frames execute out of the register chunk, the ip can be just past its last instruction
+	Chunk* registerChunk = &currentFrame->closure->function->registerChunk;
+	if (currentFrame->ip >= registerChunk->code && currentFrame->ip <= registerChunk->code + registerChunk->count)
+		chunk = registerChunk;
+
+	vm->currentInstruction = (int)(currentFrame->ip - chunk->code);
+
+	// The frame's ip is past the faulting instruction's operands by the time it is stored
+	// Its last byte is still on the right line, the next instruction may not be
+	int instOffset = vm->currentInstruction > 0 ? vm->currentInstruction - 1 : 0;
+
 	// Get the line
-	int line = currentFrame->closure->function->chunk.lines.data[instOffset];
+	int line = chunk->lines.data[instOffset];
 
 
 	terminalPushForeground(TERMINAL_FG_RED);
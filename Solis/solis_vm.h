@@ -7,6 +7,8 @@
 #include "solis_hashtable.h"
 
 #include "solis_object.h"
+#include "solis_gc.h"
+#include "solis_allocator.h"
 
 #define FRAMES_MAX 64
 #define STACK_MAX (FRAMES_MAX * UINT8_COUNT)
@@ -19,6 +21,56 @@ typedef enum
 	INTERPRET_COMPILE_ERROR
 } InterpretResult;
 
+/*
+	How function bodies are compiled and executed.
+	Register mode compiles plain functions into three address code that runs in its own loop,
+	anything it can't handle keeps using the stack bytecode. 
+*/
+typedef enum
+{
+	SOLIS_EXECUTION_STACK,
+	SOLIS_EXECUTION_REGISTER
+} SolisExecutionMode;
+
+/*
+	Options for solisInitVMWithConfig
+*/
+typedef struct
+{
+	bool sandboxed;
+	SolisExecutionMode executionMode;
+
+	// Compile hot functions to machine code, ignored where the JIT isn't supported
+	bool jit;
+
+	// Calls before a function is compiled, 0 uses the default
+	int jitThreshold;
+
+	// Bytes of young objects allocated between minor collections, 0 uses the default
+	size_t nurserySize;
+
+	// Threads sharing the marking of a large collection, 0 or 1 marks on the calling thread
+	int gcThreads;
+
+	// When full collections start, zeroed fields use the defaults
+	SolisGCPacing gcPacing;
+
+	// Bytecode cache for the core module, NULL always compiles it
+	const char* coreCachePath;
+
+	// Where all of the VM's memory comes from, NULL uses the default allocator
+	const SolisAllocator* allocator;
+} SolisVMConfig;
+
+/*
+	Counters for the inline caches on field access and method invokes
+*/
+typedef struct
+{
+	uint64_t hits;
+	uint64_t misses;
+} SolisInlineCacheStats;
+
 typedef struct {
 
 	//ObjFunction* function;
@@ -32,6 +84,11 @@ struct VM
 {
 	bool sandboxed;
 
+	SolisExecutionMode executionMode;
+
+	bool jitEnabled;
+	int jitThreshold;
+
 	CallFrame* frames;
 	int frameCount;
 	int frameCapacity;
@@ -68,15 +125,97 @@ struct VM
 	int greyCapacity;
 	Object** greyStack;
 
+	// Objects too big for a block that haven't survived a collection yet, old ones are in objects
+	Object* youngObjects;
+	uint64_t youngBytes;
+
+	// Bytes of objects in blocks, all of them and just the young ones
+	uint64_t blockBytes;
+	uint64_t youngBlockBytes;
+
+	// Bytes of objects in blocks marked by the running collection
+	uint64_t markedBytes;
+
+	// Objects of each type marked by the running full collection
+	uint64_t markedObjects[OBJ_TYPE_COUNT];
+
+	// The heap left after the last full cycle, the next threshold is grown from it
+	uint64_t liveBytes;
+
+	SolisGCPacing gcPacing;
+	SolisGCStats gcStats;
+
+	// Set while something other than the collector is following references, see solisTraceRoots
+	SolisReferenceVisitor referenceVisitor;
+	void* referenceVisitorData;
+
+	SolisNursery nursery;
+
+	// Size classes for the small buffers objects own
+	SolisSmallAllocator smallAllocator;
+
+	SolisAllocator allocator;
+
+	// Old objects written to since the last collection that may point at young ones
+	int rememberedCount;
+	int rememberedCapacity;
+	Object** rememberedSet;
+
+	// Set while a minor collection is running
+	bool minorCollection;
+
+	// Every weak ref and weak table, cleared of dead objects after each collection's marking
+	Object* weakObjects;
+
+	// Bumped when a collection starts marking, weak objects are stamped with it when traced
+	uint32_t gcEpoch;
+
+	// Where the incremental cycle is up to
+	SolisGCState gcState;
+
+	// Bytes allocated since the cycle last did some work
+	uint64_t gcDebt;
+
+	// Old objects the running cycle hasn't swept yet
+	Object* sweepingObjects;
+
+	// Threads used to mark large collections, including the one running the VM
+	int markThreadCount;
+
 	ObjClass* numberClass;
 	ObjClass* stringClass;
 	ObjClass* boolClass;
 	ObjClass* listClass;
+	ObjClass* rangeClass;
+	ObjClass* dictionaryClass;
+	ObjClass* weakRefClass;
+	ObjClass* weakTableClass;
+
+	// Indexed by SolisArrayKind
+	ObjClass* typedArrayClasses[SOLIS_ARRAY_KIND_COUNT];
+
+	// Vec2, Vec3 and Vec4, indexed by size - 2
+	ObjClass* vectorClasses[3];
+	ObjClass* matrixClass;
+	ObjClass* stringBuilderClass;
+
+	// Returned by an iterator's next method once it has run out of values
+	ObjClass* stopIterationClass;
+
+	// Field slots of Range so for loops can step ranges without looking the fields up
+	int rangeMinSlot;
+	int rangeMaxSlot;
+	int rangeStepSlot;
 
 	ObjString* operatorStrings[OPERATOR_COUNT];
 
+	// Looked up by OP_FOR_ITER so classes with iterate aren't taken for iterators
+	ObjString* iterateString;
+
 	ObjModule* currentModule;
 
+	SolisInlineCacheStats inlineCacheStats;
+
 	bool errorRaised;
 };
 
@@ -86,11 +225,33 @@ struct VM
 */
 InterpretResult solisInterpret(VM* vm, const char* source, const char* sourceName);
 
+/*
+	Like solisInterpret but loads the compiled script from cachePath when it was written from the same source.
+	Otherwise the source is compiled and the cache is rewritten.
+*/
+InterpretResult solisInterpretCached(VM* vm, const char* source, const char* sourceName, const char* cachePath);
+
+/*
+	Runs a bytecode file written by solisCompileToBytecode or solisInterpretCached without the source.
+	Returns INTERPRET_COMPILE_ERROR if the file can't be loaded.
+*/
+InterpretResult solisInterpretBytecode(VM* vm, const char* path, const char* sourceName);
+
+/*
+	Compiles a source string and writes it to a bytecode file without running it
+*/
+bool solisCompileToBytecode(VM* vm, const char* source, const char* sourceName, const char* path);
+
 /*
 	Initialises a VM ready to be used
 */
 void solisInitVM(VM* vm, bool sandboxed);
 
+/*
+	Initialises a VM with the options in config
+*/
+void solisInitVMWithConfig(VM* vm, const SolisVMConfig* config);
+
 /*
 	Frees all the memory associated with the VM. 
 	Must not call any VM related functions on the VM after this. 
@@ -152,6 +313,16 @@ static inline bool solisIsFalsy(Value value)
 
 void solisDumpGlobals(VM* vm);
 
+/*
+	Returns how many field and method lookups were served by inline caches since the VM started or the last reset
+*/
+SolisInlineCacheStats solisGetInlineCacheStats(VM* vm);
+
+/*
+	Resets the inline cache hit and miss counters
+*/
+void solisResetInlineCacheStats(VM* vm);
+
 static inline ObjClass* solisGetClassForValue(VM* vm, Value value)
 {
 
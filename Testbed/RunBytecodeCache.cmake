@@ -0,0 +1,108 @@
+# Runs one Testbed script through the .solc bytecode files written by --compile and --cache
+# Every way of running it has to print what running the source does, stale and truncated files have to be recompiled
+# The script is copied to WORK_DIR so the .solc files are never written next to the sources
+#
+# cmake -DSOLIS_CLI=<path to SolisCLI> -DSCRIPT=<path to script> -DWORK_DIR=<dir> -P RunBytecodeCache.cmake
+
+if (NOT SOLIS_CLI OR NOT SCRIPT OR NOT WORK_DIR)
+	message(FATAL_ERROR "SOLIS_CLI, SCRIPT and WORK_DIR have to be set")
+endif()
+
+get_filename_component(scriptFile "${SCRIPT}" NAME)
+get_filename_component(scriptName "${SCRIPT}" NAME_WE)
+
+set(source "${WORK_DIR}/${scriptFile}")
+set(bytecodeFile "${scriptName}.solc")
+set(bytecode "${WORK_DIR}/${bytecodeFile}")
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+file(COPY "${SCRIPT}" DESTINATION "${WORK_DIR}")
+
+string(ASCII 27 escape)
+
+# Runs the CLI in WORK_DIR, fails unless it exits with expectedResult and stores what it printed in outputVar
+function(runSolis step expectedResult outputVar)
+	execute_process(
+		COMMAND "${SOLIS_CLI}" ${ARGN}
+		WORKING_DIRECTORY "${WORK_DIR}"
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE output
+		RESULT_VARIABLE result
+		TIMEOUT 600
+	)
+
+	string(REGEX REPLACE "${escape}\\[[0-9;]*m" "" output "${output}")
+	string(REGEX REPLACE "Elapsed: *\n[^\n]*" "Elapsed: <time>" output "${output}")
+
+	if (NOT result EQUAL expectedResult)
+		message(FATAL_ERROR "${step}: exited with ${result}, expected ${expectedResult}\n${output}")
+	endif()
+
+	set(${outputVar} "${output}" PARENT_SCOPE)
+endfunction()
+
+function(expectOutput step output expected)
+	if (NOT "${output}" STREQUAL "${expected}")
+		message(FATAL_ERROR "${step}: printed something different\n-- expected --\n${expected}\n-- got --\n${output}")
+	endif()
+endfunction()
+
+runSolis("source" 0 expected "${scriptFile}")
+
+# --compile writes the file without running anything, running the file gives the same output
+runSolis("--compile" 0 output --compile "${scriptFile}")
+expectOutput("--compile" "${output}" "")
+
+if (NOT EXISTS "${bytecode}")
+	message(FATAL_ERROR "--compile didn't write ${bytecodeFile}")
+endif()
+
+runSolis("compiled file" 0 output "${bytecodeFile}")
+expectOutput("compiled file" "${output}" "${expected}")
+
+# --cache loads an up to date file, and writes one when there is none
+runSolis("warm cache" 0 output --cache "${scriptFile}")
+expectOutput("warm cache" "${output}" "${expected}")
+
+file(REMOVE "${bytecode}")
+
+runSolis("cold cache" 0 output --cache "${scriptFile}")
+expectOutput("cold cache" "${output}" "${expected}")
+
+runSolis("file written by --cache" 0 output "${bytecodeFile}")
+expectOutput("file written by --cache" "${output}" "${expected}")
+
+# Changing the source makes the file stale, --cache compiles again and replaces it
+file(APPEND "${source}" "\nprintln(\"edited\")\n")
+string(APPEND expected "edited\n")
+
+runSolis("stale cache" 0 output --cache "${scriptFile}")
+expectOutput("stale cache" "${output}" "${expected}")
+
+runSolis("file replaced after a stale cache" 0 output "${bytecodeFile}")
+expectOutput("file replaced after a stale cache" "${output}" "${expected}")
+
+# Cut off after the magic, CMake can't write the zero bytes that follow it
+file(WRITE "${bytecode}" "SOLC")
+
+runSolis("truncated file" 65 output "${bytecodeFile}")
+
+if (NOT output MATCHES "Could not load compiled file")
+	message(FATAL_ERROR "truncated file: wasn't reported as unloadable\n${output}")
+endif()
+
+runSolis("truncated cache" 0 output --cache "${scriptFile}")
+expectOutput("truncated cache" "${output}" "${expected}")
+
+runSolis("file replaced after a truncated cache" 0 output "${bytecodeFile}")
+expectOutput("file replaced after a truncated cache" "${output}" "${expected}")
+
+# A file holds code for one execution mode, the other is refused and --cache recompiles for it
+runSolis("file from another mode" 65 output --register "${bytecodeFile}")
+
+runSolis("cache from another mode" 0 output --register --cache "${scriptFile}")
+expectOutput("cache from another mode" "${output}" "${expected}")
+
+runSolis("file replaced for another mode" 0 output --register "${bytecodeFile}")
+expectOutput("file replaced for another mode" "${output}" "${expected}")
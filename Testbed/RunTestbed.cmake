@@ -0,0 +1,91 @@
+# Runs one Testbed script with the stack interpreter, the register interpreter and the JIT
+# The stack output has to match <name>.expected next to the script and the other modes have to match the stack output
+# The JIT compiles every function on its first call so it is used even by short scripts
+#
+# A script that is meant to fail says so on a line of its own, "-- expect runtime error" or "-- expect compile error",
+# any other script has to finish without an error
+#
+# cmake -DSOLIS_CLI=<path to SolisCLI> -DSCRIPT=<path to script> [-DOUTPUT_DIR=<dir>] [-DUPDATE_EXPECTED=ON] -P RunTestbed.cmake
+# UPDATE_EXPECTED writes the stack output to the .expected file instead of comparing against it
+
+if (NOT SOLIS_CLI OR NOT SCRIPT)
+	message(FATAL_ERROR "SOLIS_CLI and SCRIPT have to be set")
+endif()
+
+get_filename_component(scriptDir "${SCRIPT}" DIRECTORY)
+get_filename_component(scriptFile "${SCRIPT}" NAME)
+get_filename_component(scriptName "${SCRIPT}" NAME_WE)
+
+set(expectedFile "${scriptDir}/${scriptName}.expected")
+
+# The CLI's exit codes for a compile and a runtime error
+set(expectedResult 0)
+file(STRINGS "${SCRIPT}" markers REGEX "^-- expect (runtime|compile) error")
+
+if (markers MATCHES "runtime")
+	set(expectedResult 70)
+elseif (markers MATCHES "compile")
+	set(expectedResult 65)
+endif()
+
+set(modes stack register jit)
+set(stackFlags "")
+set(registerFlags "--register")
+set(jitFlags "--jit" "--jit-threshold=1")
+
+string(ASCII 27 escape)
+
+foreach(mode ${modes})
+	# Run from the script's directory so errors name the file the same way in every mode
+	execute_process(
+		COMMAND "${SOLIS_CLI}" ${${mode}Flags} "${scriptFile}"
+		WORKING_DIRECTORY "${scriptDir}"
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE output
+		RESULT_VARIABLE result
+		TIMEOUT 600
+	)
+
+	# Colours and timings would only get in the way of comparing
+	string(REGEX REPLACE "${escape}\\[[0-9;]*m" "" output "${output}")
+	string(REGEX REPLACE "Elapsed: *\n[^\n]*" "Elapsed: <time>" output "${output}")
+
+	if (NOT result EQUAL expectedResult)
+		message(FATAL_ERROR "${scriptFile} exited with ${result} in ${mode} mode, expected ${expectedResult}\n${output}")
+	endif()
+
+	if (OUTPUT_DIR)
+		file(WRITE "${OUTPUT_DIR}/${scriptName}.${mode}.txt" "${output}")
+	endif()
+
+	set(${mode}Output "${output}")
+endforeach()
+
+if (UPDATE_EXPECTED)
+	file(WRITE "${expectedFile}" "${stackOutput}")
+	return()
+endif()
+
+if (NOT EXISTS "${expectedFile}")
+	message(FATAL_ERROR "${scriptFile} has no ${scriptName}.expected, run with -DUPDATE_EXPECTED=ON to create it\n-- stack --\n${stackOutput}")
+endif()
+
+file(READ "${expectedFile}" expectedOutput)
+
+set(failed FALSE)
+
+if (NOT "${stackOutput}" STREQUAL "${expectedOutput}")
+	message(SEND_ERROR "${scriptFile} doesn't match ${scriptName}.expected\n-- expected --\n${expectedOutput}\n-- stack --\n${stackOutput}")
+	set(failed TRUE)
+endif()
+
+foreach(mode register jit)
+	if (NOT "${${mode}Output}" STREQUAL "${stackOutput}")
+		message(SEND_ERROR "${scriptFile} printed something different in ${mode} mode\n-- stack --\n${stackOutput}\n-- ${mode} --\n${${mode}Output}")
+		set(failed TRUE)
+	endif()
+endforeach()
+
+if (failed)
+	message(FATAL_ERROR "${scriptFile} does not match")
+endif()